@@ -0,0 +1,178 @@
+#pragma once
+
+#include "core/database.h"
+#include <string>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+namespace distributeddb {
+
+struct BitcaskOptions {
+    // The active data file is closed and a new one started past this size
+    uint64_t max_file_size;
+    
+    // Merge once dead bytes are this fraction of all data, and at least merge_min_dead_bytes
+    double merge_dead_ratio;
+    uint64_t merge_min_dead_bytes;
+    
+    // How often the merge thread checks the thresholds
+    uint32_t merge_check_interval_ms;
+    
+    // fdatasync the active file after every write
+    bool sync_writes;
+    
+    size_t keydir_shards;
+    
+    // Threads used to rebuild the keydir at startup
+    size_t recovery_threads;
+    
+    BitcaskOptions()
+        : max_file_size(64 * 1024 * 1024), merge_dead_ratio(0.5),
+          merge_min_dead_bytes(64 * 1024 * 1024), merge_check_interval_ms(1000),
+          sync_writes(false), keydir_shards(256), recovery_threads(4) {}
+};
+
+// Bitcask-style log-structured hash table. Every write is appended to the
+// active data file and the in-memory keydir maps each key to the file, offset
+// and size of its latest record, so memory holds keys only and a GET is a
+// single pread. A background merge rewrites the live records of the closed
+// files and drops the rest. Each closed file gets a hint file listing its
+// keydir entries, so startup reads hints instead of scanning the data.
+//
+// Data record: u32 crc32c | u8 type | u64 seq | u32 key_len | u32 value_len | key | value
+// The CRC covers everything after it. Hint files hold the same fields minus
+// the value, plus the record offset, and end in a CRC and magic footer.
+class BitcaskDatabase : public Database {
+public:
+    explicit BitcaskDatabase(const BitcaskOptions& options = BitcaskOptions());
+    ~BitcaskDatabase() override;
+    
+    OperationResult initialize(const std::string& data_dir) override;
+    void shutdown() override;
+    std::shared_ptr<Transaction> begin_transaction() override;
+    std::unordered_map<std::string, std::string> get_stats() const override;
+    OperationResult compact() override;
+    OperationResult backup(const std::string& backup_path) override;
+    OperationResult restore(const std::string& backup_path) override;
+    OperationResult freeze_backup_files(BackupFileSet& file_set) override;
+    void release_backup_files(const BackupFileSet& file_set) override;
+
+private:
+    friend class BitcaskTransaction;
+    
+    // Where the latest record of a key lives
+    struct KeyDirEntry {
+        uint32_t file_id;
+        uint32_t value_size;
+        uint64_t offset;    // Start of the record
+        uint64_t seq;
+    };
+    
+    struct alignas(64) KeyDirShard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, KeyDirEntry> entries;
+    };
+    
+    // One data file, open for reads for as long as anyone holds it. Closed
+    // files may be unlinked by a merge while a reader still has the fd.
+    struct DataFile {
+        uint32_t id;
+        std::string path;
+        int fd;
+        std::atomic<uint64_t> size;
+        
+        DataFile(uint32_t file_id, std::string file_path, int file_fd, uint64_t file_size)
+            : id(file_id), path(std::move(file_path)), fd(file_fd), size(file_size) {}
+        ~DataFile();
+    };
+    
+    BitcaskOptions options_;
+    std::string data_dir_;
+    bool initialized_;
+    std::atomic<uint64_t> next_transaction_id_;
+    
+    std::vector<std::unique_ptr<KeyDirShard>> keydir_;
+    std::hash<std::string> hasher_;
+    
+    // Guards files_; readers take it shared to pin a file
+    mutable std::shared_mutex files_mutex_;
+    std::map<uint32_t, std::shared_ptr<DataFile>> files_;
+    
+    // Serializes appends to the active file and file rotation
+    std::mutex write_mutex_;
+    std::shared_ptr<DataFile> active_;
+    std::string active_hints_;      // Hint records for the active file, written out when it closes
+    uint32_t next_file_id_;
+    uint64_t next_seq_;
+    
+    // Serializes merges with backup and restore
+    std::mutex merge_mutex_;
+    std::thread merge_thread_;
+    std::mutex merge_wait_mutex_;
+    std::condition_variable merge_cv_;
+    bool stopping_;
+    
+    // Statistics
+    std::atomic<uint64_t> total_bytes_;
+    std::atomic<uint64_t> live_bytes_;
+    std::atomic<uint64_t> merge_count_;
+    std::atomic<uint64_t> merge_reclaimed_bytes_;
+    std::atomic<uint64_t> hint_files_loaded_;
+    std::atomic<uint64_t> data_files_scanned_;
+    uint64_t recovery_ms_;
+    std::atomic<uint64_t> next_stream_id_;
+    
+    std::string data_path(uint32_t id) const {
+        return data_dir_ + "/bitcask_" + std::to_string(id) + ".data";
+    }
+    std::string hint_path(uint32_t id) const {
+        return data_dir_ + "/bitcask_" + std::to_string(id) + ".hint";
+    }
+    std::string merge_marker_path() const { return data_dir_ + "/MERGE"; }
+    
+    KeyDirShard& shard_for(const std::string& key) {
+        return *keydir_[hasher_(key) % keydir_.size()];
+    }
+    const KeyDirShard& shard_for(const std::string& key) const {
+        return *keydir_[hasher_(key) % keydir_.size()];
+    }
+    
+    // Read and write path
+    OperationResult write(uint8_t type, const std::string& key, const std::string& value);
+    bool get_value(const std::string& key, std::string& value) const;
+    bool read_value(const KeyDirEntry& entry, const std::string& key, std::string& value) const;
+    std::vector<std::pair<std::string, std::string>> scan_range(const std::string& start_key,
+                                                                const std::string& end_key,
+                                                                size_t limit) const;
+    std::shared_ptr<DataFile> pin_file(uint32_t id) const;
+    
+    // File management; the _locked variants need write_mutex_
+    std::shared_ptr<DataFile> open_data_file(uint32_t id, bool create);
+    bool rotate_active_locked();
+    bool write_hint_file(uint32_t id, const std::string& hints) const;
+    
+    // Startup: load one file's entries into the keydir, from its hint file if it has one
+    bool load_data_file(const std::shared_ptr<DataFile>& file, uint64_t& max_seq);
+    bool load_hint_file(const std::shared_ptr<DataFile>& file, uint64_t& max_seq);
+    bool scan_data_file(const std::shared_ptr<DataFile>& file, uint64_t& max_seq);
+    void apply_recovered(const std::string& key, const KeyDirEntry& entry);
+    OperationResult load_directory();
+    void finish_pending_merge();
+    void clear_state();
+    
+    // Merge
+    void merge_loop();
+    bool should_merge() const;
+    bool merge();
+};
+
+} // namespace distributeddb
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core/database.h"
+#include "storage/mmap_btree.h"
+#include <string>
+#include <memory>
+#include <atomic>
+
+namespace distributeddb {
+
+// Ordered engine whose data file is itself the index: a copy-on-write B+tree
+// in a memory-mapped file. A transaction reads from one snapshot, buffers its
+// writes, and commits them as a single write transaction, so restart needs no
+// log replay and readers run alongside the one writer without blocking.
+class BTreeDatabase : public Database {
+public:
+    explicit BTreeDatabase(const MmapBTreeOptions& options = MmapBTreeOptions());
+    ~BTreeDatabase() override;
+    
+    OperationResult initialize(const std::string& data_dir) override;
+    void shutdown() override;
+    std::shared_ptr<Transaction> begin_transaction() override;
+    std::unordered_map<std::string, std::string> get_stats() const override;
+    OperationResult compact() override;
+    OperationResult backup(const std::string& backup_path) override;
+    OperationResult restore(const std::string& backup_path) override;
+    OperationResult freeze_backup_files(BackupFileSet& file_set) override;
+    void release_backup_files(const BackupFileSet& file_set) override;
+
+private:
+    friend class BTreeTransaction;
+    
+    std::string data_dir_;
+    bool initialized_;
+    std::atomic<uint64_t> next_transaction_id_;
+    std::atomic<uint64_t> next_stream_id_;
+    MmapBTree tree_;
+    
+    std::string tree_path() const { return data_dir_ + "/btree.db"; }
+};
+
+} // namespace distributeddb
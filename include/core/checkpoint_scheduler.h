@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+namespace distributeddb {
+
+// When to take an automatic checkpoint. A threshold of zero disables that trigger.
+struct CheckpointPolicy {
+    uint64_t wal_bytes_threshold;
+    uint64_t wal_records_threshold;
+    std::chrono::seconds interval;
+    std::chrono::milliseconds poll_interval;
+    
+    CheckpointPolicy()
+        : wal_bytes_threshold(64 * 1024 * 1024), wal_records_threshold(1000000),
+          interval(300), poll_interval(1000) {}
+};
+
+// Background thread that triggers checkpoints once the WAL has grown past
+// the policy thresholds or the interval has elapsed
+class CheckpointScheduler {
+public:
+    // Returns {bytes, records} appended to the WAL so far
+    using ProgressFunction = std::function<std::pair<uint64_t, uint64_t>()>;
+    using CheckpointFunction = std::function<bool()>;
+    
+    CheckpointScheduler(const CheckpointPolicy& policy,
+                        ProgressFunction progress,
+                        CheckpointFunction checkpoint);
+    ~CheckpointScheduler();
+    
+    void start();
+    void stop();
+    
+    // Run a checkpoint on the calling thread, serialized with the scheduler
+    bool run_now(const std::string& reason = "manual");
+    
+    // Run fn with checkpoints held off, e.g. while WAL segments are being copied
+    bool run_exclusive(const std::function<bool()>& fn);
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+
+private:
+    void scheduler_loop();
+    std::string due_reason();
+    
+    CheckpointPolicy policy_;
+    ProgressFunction progress_;
+    CheckpointFunction checkpoint_;
+    
+    std::thread thread_;
+    bool running_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::mutex run_mutex_; // One checkpoint at a time
+    
+    // WAL position and time of the last checkpoint start
+    uint64_t base_bytes_;
+    uint64_t base_records_;
+    std::chrono::steady_clock::time_point last_checkpoint_;
+    
+    uint64_t checkpoints_completed_;
+    uint64_t checkpoints_failed_;
+    uint64_t last_duration_ms_;
+    std::string last_reason_;
+};
+
+} // namespace distributeddb
@@ -4,6 +4,8 @@
 #include <memory>
 #include <unordered_map>
 #include <shared_mutex>
+#include <vector>
+#include <cstdint>
 
 namespace distributeddb {
 
@@ -20,15 +22,55 @@ public:
     virtual ~Transaction() = default;
     virtual std::string get(const std::string& key) = 0;
     virtual OperationResult put(const std::string& key, const std::string& value) = 0;
+    
+    // Put a key that disappears ttl_ms milliseconds from now; 0 is a plain put.
+    // Engines without expiry support refuse it.
+    virtual OperationResult put_with_ttl(const std::string& key, const std::string& value, uint64_t ttl_ms) {
+        return ttl_ms == 0 ? put(key, value) : OperationResult::SYSTEM_ERROR;
+    }
+    
     virtual OperationResult del(const std::string& key) = 0;
     virtual std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key, 
                                                                  const std::string& end_key, 
                                                                  size_t limit = 1000) = 0;
+    
+    // Delete every key with start_key <= key < end_key. Engines with range
+    // tombstones log one record and hide the keys at once; the rest delete
+    // them one by one, a scan batch at a time.
+    virtual OperationResult del_range(const std::string& start_key, const std::string& end_key) {
+        while (true) {
+            auto batch = scan(start_key, end_key);
+            size_t deleted = 0;
+            for (const auto& entry : batch) {
+                OperationResult result = del(entry.first);
+                if (result == OperationResult::SUCCESS) {
+                    deleted++;
+                } else if (result != OperationResult::KEY_NOT_FOUND) {
+                    return result;
+                }
+            }
+            if (deleted == 0) {
+                return OperationResult::SUCCESS;
+            }
+        }
+    }
     virtual OperationResult commit() = 0;
     virtual void rollback() = 0;
     virtual uint64_t get_id() const = 0;
 };
 
+// Files pinned for a streaming backup. Each file is frozen (hard-linked into
+// staging_dir) so checkpoints can keep deleting the originals meanwhile.
+struct BackupFileSet {
+    struct File {
+        std::string path;   // Frozen copy to read from
+        std::string name;   // Relative path inside the backup, e.g. "wal/wal_7.log"
+    };
+    
+    std::string staging_dir;
+    std::vector<File> files;
+};
+
 class Database {
 public:
     virtual ~Database() = default;
@@ -39,11 +81,106 @@ public:
     virtual OperationResult compact() = 0;
     virtual OperationResult backup(const std::string& backup_path) = 0;
     virtual OperationResult restore(const std::string& backup_path) = 0;
+    
+    // Transaction in an independent key space. A plain engine has only
+    // namespace 0, which is begin_transaction(); see core/namespaced_database.h.
+    virtual std::shared_ptr<Transaction> begin_transaction_in(uint32_t namespace_id) {
+        return namespace_id == 0 ? begin_transaction() : nullptr;
+    }
+    
+    // Delete a namespace with all its keys, or empty it, without visiting the keys
+    virtual OperationResult drop_namespace(uint32_t namespace_id) {
+        (void)namespace_id;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    virtual OperationResult truncate_namespace(uint32_t namespace_id) {
+        (void)namespace_id;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Load a file of key<TAB>value lines, sorted by key with no duplicates, as
+    // one unit: no transactions, no per-key WAL records, and every key becomes
+    // visible at once. Backslash, tab and newline are escaped as \\, \t and \n.
+    // entries is set to the number of keys loaded.
+    virtual OperationResult bulk_load(const std::string& input_path, uint64_t& entries) {
+        (void)input_path;
+        entries = 0;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    virtual OperationResult bulk_load_in(uint32_t namespace_id, const std::string& input_path, uint64_t& entries) {
+        if (namespace_id != 0) {
+            entries = 0;
+            return OperationResult::SYSTEM_ERROR;
+        }
+        return bulk_load(input_path, entries);
+    }
+    
+    // Link block files (storage/block_file.h) built offline into the store as
+    // one unit: no per-key writes and no per-key WAL records, only a pass that
+    // verifies each file with verify_sorted_file. The files must not overlap
+    // one another; their keys replace older values. entries is set to the
+    // number of keys ingested. The store copies the files, so the caller
+    // keeps them and may change or delete them once the call returns, but
+    // not while it runs.
+    virtual OperationResult ingest_files(const std::vector<std::string>& paths, uint64_t& entries) {
+        (void)paths;
+        entries = 0;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    virtual OperationResult ingest_files_in(uint32_t namespace_id, const std::vector<std::string>& paths,
+                                            uint64_t& entries) {
+        if (namespace_id != 0) {
+            entries = 0;
+            return OperationResult::SYSTEM_ERROR;
+        }
+        return ingest_files(paths, entries);
+    }
+    
+    // Freeze the current snapshot and WAL files for streaming to a client.
+    // Engines without on-disk files to ship leave this unsupported.
+    virtual OperationResult freeze_backup_files(BackupFileSet& file_set) {
+        (void)file_set;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Drop the frozen copies once the stream is done
+    virtual void release_backup_files(const BackupFileSet& file_set) {
+        (void)file_set;
+    }
 };
 
+// Engine settings as name=value pairs, e.g. from a command line
+using EngineOptions = std::unordered_map<std::string, std::string>;
+
 class DatabaseFactory {
 public:
     static std::shared_ptr<Database> create_database();
+    
+    // Any engine in the EngineRegistry (core/engine_registry.h) by name. Returns
+    // null and logs why if the engine is unknown or an option is invalid.
+    static std::shared_ptr<Database> create_database(const std::string& engine_name,
+                                                     const EngineOptions& options = EngineOptions());
+    
+    // Log-structured merge tree engine for data sets larger than memory
+    static std::shared_ptr<Database> create_lsm_database();
+    
+    // Bitcask-style log-structured hash for point lookups on large values
+    static std::shared_ptr<Database> create_bitcask_database();
+    
+    // Copy-on-write B+tree in a memory-mapped file; ordered, O(1) restart
+    static std::shared_ptr<Database> create_btree_database();
+    
+    // Hash engine whose table lives in memory-mapped files; restart maps them
+    static std::shared_ptr<Database> create_mmap_hash_database();
+    
+    // An engine from the registry split into namespaces, each its own instance.
+    // namespace_options are layered over options for the namespaces they name.
+    static std::shared_ptr<Database> create_namespaced_database(
+        const std::string& engine_name, const EngineOptions& options,
+        const std::unordered_map<uint32_t, EngineOptions>& namespace_options);
 };
 
 } // namespace distributeddb
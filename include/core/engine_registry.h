@@ -0,0 +1,112 @@
+#pragma once
+
+#include "core/database.h"
+#include <string>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Builds an engine from its options; on failure returns null and says why in error
+using EngineFactory = std::function<std::shared_ptr<Database>(const EngineOptions& options, std::string& error)>;
+
+// Storage engines a deployment can pick by name at startup. The built-in
+// engines are registered on first use; others may be added before the
+// database is created.
+class EngineRegistry {
+public:
+    static constexpr const char* DEFAULT_ENGINE = "hash";
+    
+    static EngineRegistry& instance();
+    
+    // False if the name is already taken
+    bool register_engine(const std::string& name, const std::string& description, EngineFactory factory);
+    
+    std::shared_ptr<Database> create(const std::string& name, const EngineOptions& options,
+                                     std::string& error) const;
+    
+    bool contains(const std::string& name) const;
+    
+    // Registered names in sorted order
+    std::vector<std::string> engine_names() const;
+    std::string description(const std::string& name) const;
+
+private:
+    EngineRegistry();
+    
+    struct Engine {
+        std::string description;
+        EngineFactory factory;
+    };
+    
+    mutable std::mutex mutex_;
+    std::map<std::string, Engine> engines_;
+};
+
+// Reads typed settings out of EngineOptions for an engine factory. Bad values
+// and options nobody asked for are collected, so a typo fails the startup
+// instead of being silently ignored.
+class EngineOptionReader {
+public:
+    explicit EngineOptionReader(const EngineOptions& options) : options_(options) {}
+    
+    // Leaves value untouched when the option is absent. Integers accept a
+    // k, m or g suffix (powers of 1024); booleans accept true/false/1/0.
+    template<typename T>
+    void read(const std::string& name, T& value) {
+        std::string text;
+        if (!take(name, text)) {
+            return;
+        }
+        
+        bool ok;
+        if constexpr (std::is_same_v<T, bool>) {
+            ok = parse_bool(text, value);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            double parsed = 0.0;
+            ok = parse_double(text, parsed);
+            value = static_cast<T>(parsed);
+        } else {
+            static_assert(std::is_unsigned_v<T>, "engine options are unsigned, floating point or bool");
+            uint64_t parsed = 0;
+            ok = parse_unsigned(text, parsed) && parsed <= std::numeric_limits<T>::max();
+            if (ok) {
+                value = static_cast<T>(parsed);
+            }
+        }
+        if (!ok) {
+            fail("invalid value '" + text + "' for option " + name);
+        }
+    }
+    
+    void read(const std::string& name, std::string& value) {
+        take(name, value);
+    }
+    
+    // Record an error found by the caller, e.g. an out-of-range setting
+    void fail(const std::string& message);
+    
+    // Reports bad values and unused options; true if there were none
+    bool finish(std::string& error) const;
+
+private:
+    const EngineOptions& options_;
+    std::vector<std::string> used_;
+    std::string errors_;
+    
+    bool take(const std::string& name, std::string& text);
+    static bool parse_bool(const std::string& text, bool& value);
+    static bool parse_double(const std::string& text, double& value);
+    static bool parse_unsigned(const std::string& text, uint64_t& value);
+};
+
+// Splits "name=value" into an EngineOptions entry; false if there is no '='
+bool parse_engine_option(const std::string& argument, EngineOptions& options);
+
+} // namespace distributeddb
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace distributeddb {
+
+// Resolves the paths a client names for BULK_LOAD or INGEST, relative ones
+// against import_dir, and accepts only regular files that really lie inside
+// it once symlinks and ".." are resolved. import_dir must be canonical; an
+// empty one refuses every path. Returns the error for the client, or an
+// empty string with paths replaced by their canonical form.
+std::string resolve_import_paths(const std::string& import_dir, std::vector<std::string>& paths);
+
+} // namespace distributeddb
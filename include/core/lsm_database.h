@@ -0,0 +1,174 @@
+#pragma once
+
+#include "core/database.h"
+#include "storage/wal.h"
+#include "storage/memtable.h"
+#include "storage/sstable.h"
+#include "storage/block_file.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <vector>
+
+namespace distributeddb {
+
+struct LSMDatabaseOptions {
+    // Memtable size that triggers a switch to a fresh one and a flush
+    size_t memtable_size;
+    
+    // Sealed memtables waiting for flush before writers stall
+    size_t max_immutable_memtables;
+    
+    // Level 0 file count that triggers compaction, and the count that stalls writes
+    size_t level0_compaction_trigger;
+    size_t level0_stop_writes;
+    
+    // Level 1 size limit; each deeper level may hold level_size_multiplier times more
+    uint64_t level1_max_bytes;
+    double level_size_multiplier;
+    size_t max_levels;
+    
+    // Compaction output is split into files of about this size
+    uint64_t target_file_size;
+    
+    size_t bloom_bits_per_key;
+    
+    // SSTable block size and compression
+    BlockFileOptions table_format;
+    
+    LSMDatabaseOptions()
+        : memtable_size(16 * 1024 * 1024), max_immutable_memtables(2),
+          level0_compaction_trigger(4), level0_stop_writes(12),
+          level1_max_bytes(64 * 1024 * 1024), level_size_multiplier(10.0), max_levels(7),
+          target_file_size(8 * 1024 * 1024), bloom_bits_per_key(10) {
+        table_format.block_size = 4 * 1024;
+    }
+};
+
+// Log-structured merge tree: writes go to the WAL and a sorted memtable, full
+// memtables are flushed to immutable SSTables in level 0, and a background
+// thread merges levels so each level past 0 is one sorted, non-overlapping run.
+// Only the memtables live in RAM, so the data set can be far larger than memory.
+class LSMDatabase : public Database {
+public:
+    explicit LSMDatabase(const LSMDatabaseOptions& options = LSMDatabaseOptions());
+    ~LSMDatabase() override;
+    
+    OperationResult initialize(const std::string& data_dir) override;
+    void shutdown() override;
+    std::shared_ptr<Transaction> begin_transaction() override;
+    std::unordered_map<std::string, std::string> get_stats() const override;
+    OperationResult compact() override;
+    OperationResult backup(const std::string& backup_path) override;
+    OperationResult restore(const std::string& backup_path) override;
+    OperationResult freeze_backup_files(BackupFileSet& file_set) override;
+    void release_backup_files(const BackupFileSet& file_set) override;
+    
+    // Hard-link verified files into the tree, or copy them across file
+    // systems, and publish them with one manifest write. Each goes to the
+    // deepest level where no newer data overlaps it; memtables holding keys
+    // in its range are flushed first. The sources must not change afterwards.
+    OperationResult ingest_files(const std::vector<std::string>& paths, uint64_t& entries) override;
+    
+    // Seal the active memtable and wait until every memtable is on disk
+    OperationResult flush();
+
+private:
+    friend class LSMTransaction;
+    
+    using Level = std::vector<std::shared_ptr<SSTable>>;
+    
+    // Immutable set of live tables. Level 0 is ordered newest first, the
+    // other levels by smallest key.
+    struct Version {
+        std::vector<Level> levels;
+    };
+    
+    // Everything a read has to consult, pinned so flushes and compactions
+    // can swap state underneath it
+    struct ReadView {
+        std::shared_ptr<MemTable> mem;
+        std::vector<std::shared_ptr<MemTable>> imm;
+        std::shared_ptr<const Version> version;
+    };
+    
+    LSMDatabaseOptions options_;
+    std::string data_dir_;
+    bool initialized_;
+    std::atomic<uint64_t> next_transaction_id_;
+    std::shared_ptr<WriteAheadLog> wal_;
+    
+    // Writers hold it shared; sealing the memtable takes it exclusively
+    std::shared_mutex switch_mutex_;
+    
+    // Guards mem_, imm_, version_, log_segment_ and stopping_
+    mutable std::mutex state_mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::shared_ptr<MemTable> mem_;
+    std::deque<std::shared_ptr<MemTable>> imm_;     // Newest first
+    std::shared_ptr<const Version> version_;
+    uint64_t log_segment_;                          // Oldest WAL segment not yet in a table
+    bool stopping_;
+    
+    // Serializes flushes, compactions and manifest writes
+    std::mutex compaction_mutex_;
+    std::vector<std::string> compact_pointer_;
+    std::atomic<uint64_t> next_file_;
+    std::thread background_;
+    
+    // Statistics
+    std::atomic<uint64_t> user_bytes_written_;
+    std::atomic<uint64_t> flush_count_;
+    std::atomic<uint64_t> flush_bytes_;
+    std::atomic<uint64_t> compaction_count_;
+    std::atomic<uint64_t> trivial_move_count_;
+    std::atomic<uint64_t> compaction_bytes_read_;
+    std::atomic<uint64_t> compaction_bytes_written_;
+    std::atomic<uint64_t> stall_count_;
+    std::atomic<uint64_t> stall_us_;
+    std::atomic<uint64_t> ingested_files_;
+    std::atomic<uint64_t> ingested_keys_;
+    std::atomic<uint64_t> next_stream_id_;
+    
+    std::string table_path(uint64_t number) const {
+        return data_dir_ + "/table_" + std::to_string(number) + ".sst";
+    }
+    std::string manifest_path() const { return data_dir_ + "/MANIFEST"; }
+    
+    // Read and write path
+    OperationResult write(BlockEntryType type, const std::string& key, const std::string& value,
+                          uint64_t transaction_id);
+    bool get_value(const std::string& key, std::string& value) const;
+    std::vector<std::pair<std::string, std::string>> scan_range(const std::string& start_key,
+                                                                const std::string& end_key,
+                                                                size_t limit) const;
+    ReadView read_view() const;
+    
+    // Memtable switching; the _locked variants need state_mutex_ and, for
+    // anything that replaces mem_, an exclusive switch_mutex_
+    bool make_room_for_write();
+    bool seal_memtable_locked();
+    
+    // Background work
+    void background_loop();
+    bool flush_oldest_immutable();
+    bool compact_once();
+    bool compact_level(size_t level, const Level& inputs);
+    bool write_tables(EntryIterator& input, bool drop_tombstones, uint64_t max_file_size,
+                      Level& outputs, uint64_t& bytes_written);
+    size_t pick_compaction_level(const Version& version) const;
+    uint64_t max_bytes_for_level(size_t level) const;
+    
+    // Manifest: live tables per level and the WAL segment replay starts from
+    bool write_manifest(const std::string& path, const Version& version, uint64_t log_segment) const;
+    bool read_manifest(const std::string& path, std::vector<std::vector<uint64_t>>& levels,
+                       uint64_t& next_file, uint64_t& log_segment) const;
+};
+
+} // namespace distributeddb
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "core/database.h"
+#include "core/checkpoint_scheduler.h"
+#include "storage/wal.h"
+#include "storage/mmap_hash_table.h"
+#include <string>
+#include <memory>
+#include <atomic>
+
+namespace distributeddb {
+
+struct MmapHashDatabaseOptions {
+    MmapHashTableOptions table;
+    CheckpointPolicy checkpoint;
+    
+    // A checkpoint also compacts the arena once dead bytes are this fraction
+    // of it, and at least compact_min_dead_bytes
+    double compact_dead_ratio;
+    uint64_t compact_min_dead_bytes;
+    
+    MmapHashDatabaseOptions() : compact_dead_ratio(0.5), compact_min_dead_bytes(64 * 1024 * 1024) {}
+};
+
+// The hash engine with its table in memory-mapped files (storage/mmap_hash_table.h)
+// rather than on the heap. Changes go to the WAL and then straight into the
+// mapped table, with the same read-committed semantics as PersistentDatabase.
+// A checkpoint syncs the table instead of writing a snapshot, and restart after
+// a clean shutdown maps the files without touching a single key.
+class MmapHashDatabase : public Database {
+public:
+    explicit MmapHashDatabase(const MmapHashDatabaseOptions& options = MmapHashDatabaseOptions());
+    ~MmapHashDatabase() override;
+    
+    OperationResult initialize(const std::string& data_dir) override;
+    void shutdown() override;
+    std::shared_ptr<Transaction> begin_transaction() override;
+    std::unordered_map<std::string, std::string> get_stats() const override;
+    OperationResult compact() override;
+    OperationResult backup(const std::string& backup_path) override;
+    OperationResult restore(const std::string& backup_path) override;
+    OperationResult freeze_backup_files(BackupFileSet& file_set) override;
+    void release_backup_files(const BackupFileSet& file_set) override;
+    
+    // Sync the table and delete the WAL segments it covers
+    OperationResult checkpoint();
+
+private:
+    friend class MmapHashTransaction;
+    
+    MmapHashDatabaseOptions options_;
+    MmapHashTable table_;
+    std::string data_dir_;
+    bool initialized_;
+    std::atomic<uint64_t> next_transaction_id_;
+    std::atomic<uint64_t> next_stream_id_;
+    std::shared_ptr<WriteAheadLog> wal_;
+    std::unique_ptr<CheckpointScheduler> scheduler_;
+    
+    uint64_t last_recovery_us_;
+    uint64_t replayed_records_;
+    
+    bool write_checkpoint();
+    bool compact_table();
+    
+    // Start a new WAL segment and drop every older one
+    bool discard_wal();
+};
+
+} // namespace distributeddb
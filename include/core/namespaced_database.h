@@ -0,0 +1,149 @@
+#pragma once
+
+#include "core/database.h"
+#include <string>
+#include <memory>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+namespace distributeddb {
+
+struct NamespacedDatabaseOptions {
+    std::string engine;                                     // Registry name of every namespace's engine
+    EngineOptions defaults;                                 // Settings of every namespace
+    std::unordered_map<uint32_t, EngineOptions> overrides;  // Per namespace, layered over defaults
+    
+    // Namespaces are created on first use; past this many, new ids are refused
+    uint32_t max_namespaces;
+    
+    NamespacedDatabaseOptions() : max_namespaces(1024) {}
+};
+
+// Independent key spaces in one process. Every namespace is a separate engine
+// instance with its own table, locks, WAL stream, checkpoint schedule and
+// options, so a bulk load into one never stalls the others.
+//
+// Namespace 0 lives in the data directory itself, exactly as a plain engine
+// would, so existing data directories open unchanged. Namespace N lives in
+// namespaces/N.<generation>; the NAMESPACES manifest next to them names the
+// live generation of each. Dropping or truncating a namespace rewrites the
+// manifest and swaps the instance out, whatever its size; the old instance is
+// shut down and deleted in the background once no transaction uses it.
+class NamespacedDatabase : public Database {
+public:
+    explicit NamespacedDatabase(const NamespacedDatabaseOptions& options);
+    ~NamespacedDatabase() override;
+    
+    OperationResult initialize(const std::string& data_dir) override;
+    void shutdown() override;
+    std::shared_ptr<Transaction> begin_transaction() override;
+    std::unordered_map<std::string, std::string> get_stats() const override;
+    OperationResult compact() override;
+    OperationResult backup(const std::string& backup_path) override;
+    OperationResult restore(const std::string& backup_path) override;
+    OperationResult freeze_backup_files(BackupFileSet& file_set) override;
+    void release_backup_files(const BackupFileSet& file_set) override;
+    
+    std::shared_ptr<Transaction> begin_transaction_in(uint32_t namespace_id) override;
+    
+    OperationResult bulk_load(const std::string& input_path, uint64_t& entries) override;
+    OperationResult bulk_load_in(uint32_t namespace_id, const std::string& input_path, uint64_t& entries) override;
+    OperationResult ingest_files(const std::vector<std::string>& paths, uint64_t& entries) override;
+    OperationResult ingest_files_in(uint32_t namespace_id, const std::vector<std::string>& paths,
+                                    uint64_t& entries) override;
+    
+    // Namespace 0 holds the data directory itself and cannot be dropped or truncated
+    OperationResult drop_namespace(uint32_t namespace_id) override;
+    OperationResult truncate_namespace(uint32_t namespace_id) override;
+    
+    // Check that the engine accepts the settings of every namespace
+    static bool validate(const NamespacedDatabaseOptions& options, std::string& error);
+    
+private:
+    struct Namespace {
+        uint64_t generation;
+        std::shared_ptr<Database> database;
+    };
+    
+    // An instance swapped out by drop, truncate or restore, or a directory no
+    // manifest refers to (database is then null)
+    struct Retired {
+        std::shared_ptr<Database> database;
+        std::string dir;
+    };
+    
+    NamespacedDatabaseOptions options_;
+    std::string data_dir_;
+    bool initialized_;
+    
+    // Guards the map; held exclusively only to swap an entry
+    mutable std::shared_mutex mutex_;
+    std::map<uint32_t, Namespace> namespaces_;
+    
+    // Serializes creating, dropping and truncating, each of which writes the
+    // manifest before it changes the map. Engines are opened without it: an
+    // id in opening_ has an instance being initialized, and other changes to
+    // that id wait on opening_cv_ until it is published or abandoned.
+    std::mutex manifest_mutex_;
+    std::condition_variable opening_cv_;
+    std::set<uint32_t> opening_;
+    uint64_t next_generation_;
+    
+    mutable std::mutex retired_mutex_;
+    std::condition_variable retired_cv_;
+    std::vector<Retired> retired_;
+    std::thread reaper_;
+    bool stopping_;
+    
+    // Frozen namespace files of each streaming backup, by its staging directory
+    std::mutex frozen_mutex_;
+    std::unordered_map<std::string, std::vector<std::pair<std::shared_ptr<Database>, BackupFileSet>>> frozen_;
+    
+    std::atomic<uint64_t> namespaces_created_;
+    std::atomic<uint64_t> namespaces_dropped_;
+    std::atomic<uint64_t> namespaces_truncated_;
+    std::atomic<uint64_t> instances_reaped_;
+    
+    std::string namespaces_dir() const;
+    std::string manifest_path() const;
+    std::string namespace_dir(uint32_t namespace_id, uint64_t generation) const;
+    
+    std::shared_ptr<Database> find(uint32_t namespace_id) const;
+    
+    // The namespace's instance, created on first use; null past max_namespaces
+    std::shared_ptr<Database> find_or_create(uint32_t namespace_id);
+    
+    // Build and initialize a namespace's engine in its generation's directory
+    std::shared_ptr<Database> open_namespace(uint32_t namespace_id, uint64_t generation);
+    
+    // Holding manifest_lock: wait until namespace_id (every id when all) is
+    // not being opened
+    void wait_opened(std::unique_lock<std::mutex>& manifest_lock, uint32_t namespace_id, bool all = false);
+    
+    // Holding manifest_lock: open a new generation of namespace_id with the
+    // lock released, then publish it. Null if it could not be opened.
+    std::shared_ptr<Database> open_and_publish(std::unique_lock<std::mutex>& manifest_lock, uint32_t namespace_id);
+    
+    // Caller holds manifest_mutex_; generations maps each live namespace but 0
+    bool write_manifest(const std::map<uint32_t, uint64_t>& generations);
+    bool read_manifest(std::map<uint32_t, uint64_t>& generations);
+    std::map<uint32_t, uint64_t> live_generations() const;
+    
+    // Swap namespace_id to fresh (null drops it) and retire the old instance
+    OperationResult replace_namespace(uint32_t namespace_id, uint64_t generation, std::shared_ptr<Database> fresh);
+    
+    void retire(std::shared_ptr<Database> database, const std::string& dir);
+    void reaper_loop();
+    
+    // Shut down and delete whatever no transaction uses; all of it when forced
+    void reap(bool force);
+};
+
+} // namespace distributeddb
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "core/database.h"
+#include "core/checkpoint_scheduler.h"
+#include "storage/wal.h"
+#include "storage/sharded_table.h"
+#include "storage/block_file.h"
+#include "storage/value_log.h"
+#include "storage/tier_manager.h"
+#include "storage/timing_wheel.h"
+#include "storage/range_index.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <atomic>
+#include <vector>
+
+namespace distributeddb {
+
+// How a checkpoint captures the table
+enum class CheckpointMode {
+    FUZZY,  // Walk the shards under their own locks, repair with WAL replay
+    FORK    // Serialize a copy-on-write image of the process in a child
+};
+
+struct PersistentDatabaseOptions {
+    CheckpointPolicy checkpoint;
+    CheckpointMode checkpoint_mode;
+    size_t shard_count;
+    
+    // A fork checkpoint's child is killed after this long and a fuzzy
+    // checkpoint written instead; 0 waits for it however long it takes
+    uint64_t fork_timeout_ms;
+    
+    // Delta checkpoints taken between two full ones; 0 always writes full snapshots
+    size_t max_delta_chain;
+    
+    // Snapshot block size and compression
+    BlockFileOptions snapshot_format;
+    
+    // Threads used to load snapshot blocks at startup; 0 uses every core
+    size_t recovery_threads;
+    
+    // Partition files written and read in parallel by backup/restore; 0 uses every core
+    size_t backup_partitions;
+    
+    // Values at least this large live only in a value log under data_dir/vlog
+    // and the table holds a pointer to them; 0 keeps every value inline. The
+    // table format is fixed when the database is created: a database that has
+    // a value log keeps using it, and one with inline data cannot start one.
+    size_t value_separation_threshold;
+    ValueLogOptions value_log;
+    
+    // Memory budget for values. Past it the coldest values are compressed,
+    // then moved to scratch files under data_dir/spill until read again.
+    TierOptions tiering;
+    
+    // Keys put with a TTL are removed by a thread that wakes every
+    // expiry_interval_ms and deletes at most expiry_budget due keys per wake;
+    // reads skip an expired key, and delete it, in the meantime
+    uint32_t expiry_interval_ms;
+    size_t expiry_budget;
+    
+    // Also keep the keys in order, in ranges split and merged by load, so a
+    // scan returns the first keys of its range in order instead of whichever
+    // it meets first walking the shards. Costs a copy of every key.
+    bool ordered_index;
+    RangeIndexOptions ranges;
+    
+    PersistentDatabaseOptions()
+        : checkpoint_mode(CheckpointMode::FUZZY), shard_count(256), fork_timeout_ms(600000), max_delta_chain(8),
+          recovery_threads(0), backup_partitions(0), value_separation_threshold(0),
+          expiry_interval_ms(100), expiry_budget(10000), ordered_index(false) {}
+};
+
+// In-memory hash table made durable by the WAL and periodic snapshots
+class PersistentDatabase : public Database {
+public:
+    explicit PersistentDatabase(const PersistentDatabaseOptions& options = PersistentDatabaseOptions());
+    ~PersistentDatabase() override;
+    
+    OperationResult initialize(const std::string& data_dir) override;
+    void shutdown() override;
+    std::shared_ptr<Transaction> begin_transaction() override;
+    std::unordered_map<std::string, std::string> get_stats() const override;
+    OperationResult compact() override;
+    OperationResult backup(const std::string& backup_path) override;
+    OperationResult restore(const std::string& backup_path) override;
+    OperationResult freeze_backup_files(BackupFileSet& file_set) override;
+    void release_backup_files(const BackupFileSet& file_set) override;
+    
+    // Both write or link block files into the data directory, log one
+    // BULK_LOAD record naming them and move their entries into the table under
+    // every shard lock. Ingested files are linked as they are unless a value
+    // log needs the values rewritten. Checkpoints and backups are held off
+    // while either runs.
+    OperationResult bulk_load(const std::string& input_path, uint64_t& entries) override;
+    OperationResult ingest_files(const std::vector<std::string>& paths, uint64_t& entries) override;
+    
+    // Snapshot the table and delete the WAL segments the snapshot covers
+    OperationResult checkpoint();
+
+private:
+    friend class PersistentTransaction;
+    
+    PersistentDatabaseOptions options_;
+    ShardedTable table_;
+    std::string data_dir_;
+    bool initialized_;
+    std::atomic<uint64_t> next_transaction_id_;
+    std::shared_ptr<WriteAheadLog> wal_;
+    std::unique_ptr<CheckpointScheduler> scheduler_;
+    
+    // Current snapshot chain: full snapshot LSN and deltas taken on top of it
+    uint64_t base_lsn_;
+    std::atomic<uint64_t> delta_count_;
+    std::atomic<bool> need_full_;
+    std::atomic<uint64_t> last_checkpoint_entries_;
+    
+    // Fork checkpoint measurements
+    std::atomic<uint64_t> fork_count_;
+    std::atomic<uint64_t> last_fork_pause_us_;
+    std::atomic<uint64_t> last_cow_pages_;
+    
+    // Backup and restore throughput
+    std::atomic<uint64_t> last_backup_bytes_;
+    std::atomic<uint64_t> last_backup_us_;
+    std::atomic<uint64_t> last_restore_bytes_;
+    std::atomic<uint64_t> last_restore_us_;
+    std::atomic<uint64_t> next_stream_id_;
+    
+    // Value separation; null when every value is inline
+    std::unique_ptr<ValueLog> value_log_;
+    std::thread gc_thread_;
+    std::mutex gc_wait_mutex_;
+    std::condition_variable gc_cv_;
+    bool gc_stopping_;
+    std::atomic<uint64_t> gc_count_;
+    std::atomic<uint64_t> gc_moved_bytes_;
+    
+    // Compresses and spills cold values; null without a memory budget or compression
+    std::unique_ptr<TierManager> tier_;
+    
+    // Key expiry. The wheel holds one timer per TTL put; keys expired but not
+    // yet logged wait in expired_keys_ for the next EXPIRE batch.
+    TimingWheel expiry_wheel_;
+    std::thread expiry_thread_;
+    std::mutex expiry_wait_mutex_;
+    std::condition_variable expiry_cv_;
+    bool expiry_stopping_;
+    std::mutex expired_mutex_;
+    std::vector<std::string> expired_keys_;
+    uint64_t expired_horizon_;                  // Guarded by expired_mutex_
+    std::atomic<uint64_t> expired_count_;
+    std::atomic<uint64_t> lazy_expired_count_;
+    std::atomic<uint64_t> expire_batches_;
+    
+    // Ordered keys for scans; null unless ordered_index is set
+    std::unique_ptr<RangeIndex> range_index_;
+    
+    // Snapshot files of bulk loads the WAL still refers to, by the LSN of their
+    // BULK_LOAD record. Only changed with checkpoints held off.
+    std::vector<std::pair<uint64_t, std::string>> bulk_files_;
+    std::atomic<uint64_t> bulk_loads_;
+    std::atomic<uint64_t> bulk_loaded_keys_;
+    
+    // Deleted ranges wait in each shard until the expiry thread erases the
+    // keys they hide; these are the ones it has yet to reach
+    struct PendingRange {
+        std::string start;
+        std::string end;
+        uint64_t lsn;
+    };
+    mutable std::mutex pending_ranges_mutex_;
+    std::vector<PendingRange> pending_ranges_;
+    std::atomic<uint64_t> ranges_deleted_;
+    std::atomic<uint64_t> range_purged_keys_;
+    
+    std::string checkpoint_path() const { return data_dir_ + "/checkpoint.db"; }
+    std::string delta_path(uint64_t segment) const {
+        return data_dir_ + "/checkpoint.delta." + std::to_string(segment);
+    }
+    
+    // Delta files in the data directory, ordered by the segment they start at
+    std::vector<std::string> list_deltas() const;
+    
+    bool write_checkpoint();
+    bool write_fuzzy_checkpoint(const std::string& path, bool full, uint64_t covered_segment,
+                                uint64_t& start_lsn, uint64_t& entries);
+    bool write_fork_checkpoint(const std::string& path, bool full, uint64_t covered_segment,
+                               uint64_t& start_lsn, uint64_t& entries);
+    bool write_backup(const std::string& backup_dir);
+    bool read_backup(const std::string& backup_dir);
+    
+    bool recover_from_checkpoint(uint64_t& first_segment, uint64_t& start_lsn);
+    bool recover_from_wal(uint64_t first_segment, uint64_t start_lsn);
+    
+    std::string bulk_path(const std::string& name) const { return data_dir_ + "/" + name; }
+    
+    // Loads run one at a time and each logs a record, so the next LSN keeps
+    // names unique; the record itself gets a later one
+    std::string bulk_name(size_t file) const {
+        return "bulk." + std::to_string(wal_->next_lsn()) + "." + std::to_string(file);
+    }
+    
+    bool write_bulk_load(const std::string& input_path, uint64_t& entries);
+    bool write_ingest(const std::vector<std::string>& paths, uint64_t& entries);
+    
+    // The table's form of a bulk value, appending it to the value log if it
+    // is past the separation threshold; appended values are listed in separated
+    bool store_bulk_value(const std::string& key, std::string&& value, std::string& stored,
+                          std::vector<std::pair<std::string, ValuePointer>>& separated);
+    
+    // Check the named bulk files in the data directory with
+    // verify_sorted_file, publish them with one BULK_LOAD record and stream
+    // them into the table block by block. They must not overlap. Leaves the
+    // files in place on failure.
+    bool link_bulk_files(const std::vector<std::string>& names, bool sync_value_log, uint64_t& entries);
+    
+    // Delete the bulk files of records before lsn, which a snapshot now covers,
+    // or at startup every bulk file the WAL does not refer to
+    void remove_bulk_files_before(uint64_t lsn);
+    void remove_stale_bulk_files();
+    
+    std::string value_log_dir() const { return data_dir_ + "/vlog"; }
+    std::string spill_dir() const { return data_dir_ + "/spill"; }
+    bool open_value_log();
+    void gc_loop();
+    
+    // Move the live values out of value log segments at least min_dead_ratio
+    // dead, then delete them. Runs with checkpoints and backups held off.
+    bool collect_value_log(double min_dead_ratio);
+    bool collect_segment(uint64_t segment);
+    
+    // Read the values of spilled entries in a copy of a shard taken under its lock
+    bool resolve_spilled(size_t shard, std::vector<std::pair<std::string, std::string>>& entries) const;
+    
+    // Account for an entry loaded during recovery and spill if over budget
+    void track_recovered(size_t shard, const std::string& key, size_t old_size, size_t new_size);
+    
+    // Remove key if its expiry time is at or before now_ms and queue it for
+    // the WAL. Shard lock held exclusively.
+    bool expire_locked(size_t shard, const std::string& key, uint64_t now_ms);
+    
+    // Take the shard lock and expire key, for a read that found it expired
+    void expire_lazily(size_t shard, const std::string& key);
+    
+    // Log the queued expirations as EXPIRE batches
+    bool flush_expired();
+    
+    // Log one DELETE_RANGE record and hide [start_key, end_key) in every shard,
+    // holding every shard lock so no write falls between the two
+    bool delete_range(const std::string& start_key, const std::string& end_key, uint64_t transaction_id);
+    
+    // Erase those of keys, all in the one shard, that a pending range still
+    // hides. Takes the shard lock.
+    void purge_keys(size_t shard, const std::vector<std::string>& keys);
+    
+    // Erase the keys hidden by the ranges pending now, a batch at a time, then
+    // drop the ranges. Walks the range index when there is one, else every shard.
+    void purge_dropped_ranges();
+    
+    // Restart the wheel with a timer for every key that has an expiry time
+    void rebuild_expiry_wheel();
+    
+    // Load every key in the table into the range index. Shard locks held or
+    // the table not yet shared.
+    void rebuild_range_index();
+    void expiry_loop();
+};
+
+} // namespace distributeddb
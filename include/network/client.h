@@ -4,6 +4,7 @@
 #include <boost/asio.hpp>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace distributeddb {
 
@@ -18,12 +19,35 @@ public:
     
     // Database operations
     std::string get(const std::string& key);
-    bool put(const std::string& key, const std::string& value);
+    bool put(const std::string& key, const std::string& value, uint64_t ttl_ms = 0);
     bool del(const std::string& key);
+    
+    // Delete every key from start_key up to, not including, end_key in one request
+    bool del_range(const std::string& start_key, const std::string& end_key);
+    
     std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key, 
                                                           const std::string& end_key, 
                                                           size_t limit = 1000);
     bool ping();
+    
+    // Namespace that get, put, del and scan address; 0 unless set
+    void use_namespace(uint32_t namespace_id) { namespace_id_ = namespace_id; }
+    
+    // Remove a namespace with all its keys, or empty it
+    bool drop_namespace(uint32_t namespace_id);
+    bool truncate_namespace(uint32_t namespace_id);
+    
+    // Load a sorted key<TAB>value file, a path on the server, into the current
+    // namespace in one step. Returns the number of keys loaded.
+    uint64_t bulk_load(const std::string& server_path);
+    
+    // Link sorted block files, paths on the server whose key ranges do not
+    // overlap, into the current namespace. Returns the number of keys ingested.
+    uint64_t ingest(const std::vector<std::string>& server_paths);
+    
+    // Stream the server's snapshot and WAL files into target_dir, which can
+    // then be used as a data directory. Returns the number of bytes received.
+    uint64_t backup(const std::string& target_dir);
 
 private:
     Message send_request(const Message& request);
@@ -36,6 +60,7 @@ private:
     uint16_t port_;
     bool connected_;
     std::atomic<uint32_t> request_id_;
+    uint32_t namespace_id_;
 };
 
 } // namespace distributeddb
@@ -15,9 +15,20 @@ enum class MessageType : uint8_t {
     PING = 5,
     PONG = 6,
     ERROR = 7,
-    SUCCESS = 8
+    SUCCESS = 8,
+    BACKUP = 9,         // Request a streaming backup of the server's data files
+    BACKUP_FILE = 10,   // key = relative file name, value = byte count; raw bytes follow
+    DROP_NAMESPACE = 11,        // Delete the request's namespace and everything in it
+    TRUNCATE_NAMESPACE = 12,    // Empty the request's namespace but keep it
+    BULK_LOAD = 13,             // key = sorted key<TAB>value file on the server; reply value = keys loaded
+    INGEST = 14,                // key = sorted block files on the server, one per line; reply value = keys ingested
+    DELETE_RANGE = 15           // Delete every key from key up to, not including, value
 };
 
+// Set in the type byte when a 4-byte namespace id follows the fixed header;
+// without it a message addresses namespace 0
+constexpr uint8_t NAMESPACE_FLAG = 0x80;
+
 // Protocol message structure
 struct Message {
     MessageType type;
@@ -27,7 +38,14 @@ struct Message {
     std::string key;
     std::string value;
     
-    Message() : type(MessageType::GET), id(0), key_length(0), value_length(0) {}
+    // PUT only: milliseconds until the key expires, 0 for never. Sent as an
+    // optional 8-byte trailer so messages without a TTL are unchanged.
+    uint64_t ttl_ms;
+    
+    // Namespace the request operates on
+    uint32_t namespace_id;
+    
+    Message() : type(MessageType::GET), id(0), key_length(0), value_length(0), ttl_ms(0), namespace_id(0) {}
     
     // Serialize message to bytes
     std::vector<uint8_t> serialize() const;
@@ -37,8 +55,11 @@ struct Message {
     
     // Get message size in bytes
     size_t size() const {
-        return sizeof(MessageType) + sizeof(uint32_t) * 3 + key_length + value_length;
+        return sizeof(MessageType) + sizeof(uint32_t) * 3 + (namespace_id != 0 ? sizeof(namespace_id) : 0) +
+               key_length + value_length + (has_ttl() ? sizeof(ttl_ms) : 0);
     }
+    
+    bool has_ttl() const { return type == MessageType::PUT && ttl_ms > 0; }
 };
 
 // Protocol constants
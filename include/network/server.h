@@ -20,6 +20,7 @@ class ConnectionHandler : public std::enable_shared_from_this<ConnectionHandler>
 public:
     ConnectionHandler(boost::asio::ip::tcp::socket socket, 
                      std::shared_ptr<Database> database,
+                     std::string import_dir,
                      std::function<void()> on_disconnect);
     
     void start();
@@ -32,8 +33,14 @@ private:
     void handle_request(const Message& request);
     Message process_request_sync(const Message& request);
     
+    // BACKUP: stream the frozen data files on a side thread, then resume reading
+    void stream_backup(const Message& request);
+    bool write_message_sync(const Message& message);
+    bool send_file(const std::string& path, uint64_t size);
+    
     boost::asio::ip::tcp::socket socket_;
     std::shared_ptr<Database> database_;
+    std::string import_dir_;
     std::function<void()> on_disconnect_;
     std::array<uint8_t, 4> header_buffer_;
     std::vector<uint8_t> body_buffer_;
@@ -51,6 +58,10 @@ public:
     // Set the database instance
     void set_database(std::shared_ptr<Database> db) { database_ = db; }
     
+    // The only directory BULK_LOAD and INGEST may read from; without one
+    // both are refused. False if dir is not an existing directory.
+    bool set_import_dir(const std::string& dir);
+    
     // Get statistics
     uint32_t get_connection_count() const { return connection_count_.load(); }
     uint64_t get_total_requests() const { return total_requests_.load(); }
@@ -69,6 +80,7 @@ private:
     
     boost::asio::ip::tcp::acceptor acceptor_;
     std::shared_ptr<Database> database_;
+    std::string import_dir_;
     std::atomic<bool> running_;
     std::vector<std::thread> worker_threads_;
     std::atomic<uint32_t> connection_count_;
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Bump allocator for objects that all die together, such as the nodes of one
+// memtable. allocate() is thread-safe and lock-free except when a new block
+// has to be carved; memory is only returned when the arena is destroyed.
+class Arena {
+public:
+    explicit Arena(size_t block_size = 1024 * 1024);
+    ~Arena();
+    
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    
+    // Returns 8-byte aligned memory
+    char* allocate(size_t bytes);
+    
+    // Returns memory aligned to a power of two above 8, e.g. a cache line
+    char* allocate_aligned(size_t bytes, size_t alignment);
+    
+    // Bytes reserved from the system, including unused block tails
+    size_t memory_usage() const { return memory_usage_.load(std::memory_order_relaxed); }
+
+private:
+    struct Block {
+        std::atomic<size_t> used;
+        size_t capacity;
+        char* data;
+    };
+    
+    Block* new_block(size_t capacity);
+    
+    size_t block_size_;
+    std::atomic<Block*> current_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::atomic<size_t> memory_usage_;
+};
+
+inline Arena::Arena(size_t block_size)
+    : block_size_(block_size), current_(nullptr), memory_usage_(0) {
+    current_ = new_block(block_size_);
+}
+
+inline Arena::~Arena() {
+    for (auto& block : blocks_) {
+        delete[] block->data;
+    }
+}
+
+inline char* Arena::allocate(size_t bytes) {
+    bytes = (bytes + 7) & ~static_cast<size_t>(7);
+    
+    // Large objects get a block of their own so they do not waste the tail
+    // of the shared one
+    if (bytes > block_size_ / 4) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Block* block = new_block(bytes);
+        block->used = bytes;
+        return block->data;
+    }
+    
+    while (true) {
+        Block* block = current_.load(std::memory_order_acquire);
+        size_t offset = block->used.fetch_add(bytes, std::memory_order_relaxed);
+        if (offset + bytes <= block->capacity) {
+            return block->data + offset;
+        }
+        
+        // Block exhausted; one thread replaces it, the others retry
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_.load(std::memory_order_relaxed) == block) {
+            current_.store(new_block(block_size_), std::memory_order_release);
+        }
+    }
+}
+
+inline char* Arena::allocate_aligned(size_t bytes, size_t alignment) {
+    uintptr_t raw = reinterpret_cast<uintptr_t>(allocate(bytes + alignment - 8));
+    return reinterpret_cast<char*>((raw + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+}
+
+// Called with mutex_ held, or from the constructor
+inline Arena::Block* Arena::new_block(size_t capacity) {
+    auto block = std::make_unique<Block>();
+    block->used = 0;
+    block->capacity = capacity;
+    block->data = new char[capacity];
+    memory_usage_.fetch_add(capacity, std::memory_order_relaxed);
+    
+    Block* raw = block.get();
+    blocks_.push_back(std::move(block));
+    return raw;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,859 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace distributeddb {
+
+// Adaptive Radix Tree (Leis et al., ICDE 2013): an ordered index over byte
+// string keys that branches on one key byte per level. A lookup costs one
+// step per distinguishing byte rather than a full key comparison per level,
+// so long shared prefixes such as "tenant:1234:user:" are nearly free.
+//
+// Inner nodes change layout as they fill:
+//   Node4    up to 4 sorted key bytes and children, searched linearly
+//   Node16   up to 16 sorted key bytes, searched with one SSE2 compare
+//   Node48   a 256-entry byte index into 48 child slots
+//   Node256  one child slot per byte value
+// A chain of single-child levels is collapsed into its node's prefix. The
+// first MAX_PREFIX bytes are kept inline; longer prefixes are skipped
+// optimistically on lookup and checked against a leaf below when a write
+// needs them (the paper's hybrid scheme). Leaves hold the whole key, so a
+// lookup always ends with one full comparison. A key that ends inside the
+// tree, such as "user:1" beside "user:10", is the terminal leaf of the node
+// where it ends and sorts before that node's children.
+//
+// Not thread-safe: callers serialize writers against readers.
+template<typename Value>
+class AdaptiveRadixTree {
+public:
+    AdaptiveRadixTree() : root_(nullptr), size_(0), memory_(0), node_counts_{0, 0, 0, 0} {}
+    ~AdaptiveRadixTree() { clear(); }
+    
+    AdaptiveRadixTree(const AdaptiveRadixTree&) = delete;
+    AdaptiveRadixTree& operator=(const AdaptiveRadixTree&) = delete;
+    
+    // Insert or overwrite; true if the key was new
+    bool insert(const std::string& key, const Value& value);
+    
+    // Pointer to the stored value, valid until the next write; null if absent
+    const Value* find(const std::string& key) const;
+    
+    std::optional<Value> get(const std::string& key) const {
+        const Value* value = find(key);
+        return value != nullptr ? std::optional<Value>(*value) : std::nullopt;
+    }
+    
+    bool remove(const std::string& key);
+    
+    // Entries with start_key <= key < end_key, in key order
+    std::vector<std::pair<std::string, Value>> scan(const std::string& start_key,
+                                                    const std::string& end_key,
+                                                    size_t limit = 1000) const {
+        std::vector<std::pair<std::string, Value>> out;
+        if (root_ != nullptr && limit > 0 && start_key < end_key) {
+            collect(root_, 0, start_key, true, &end_key, limit, out);
+        }
+        return out;
+    }
+    
+    // Entries whose key starts with prefix, in key order
+    std::vector<std::pair<std::string, Value>> scan_prefix(const std::string& prefix,
+                                                           size_t limit = 1000) const;
+    
+    size_t size() const { return size_; }
+    
+    // Bytes held by nodes, leaves and out-of-line key storage. Memory a Value
+    // owns itself is not counted.
+    size_t memory_usage() const { return memory_; }
+    
+    std::unordered_map<std::string, size_t> get_stats() const;
+    
+    void clear();
+
+private:
+    static constexpr uint32_t MAX_PREFIX = 10;
+    
+    enum NodeType : uint8_t { NODE4 = 0, NODE16 = 1, NODE48 = 2, NODE256 = 3 };
+    
+    struct Leaf {
+        Leaf(const std::string& k, const Value& v) : key(k), value(v) {}
+        std::string key;
+        Value value;
+    };
+    
+    // Child slots hold inner nodes, or leaves tagged in the low pointer bit
+    struct Node {
+        explicit Node(NodeType t) : type(t), count(0), prefix_len(0), terminal(nullptr) {}
+        NodeType type;
+        uint16_t count;             // Children, not counting the terminal leaf
+        uint32_t prefix_len;
+        uint8_t prefix[MAX_PREFIX];
+        Leaf* terminal;             // Key ending right after the prefix
+    };
+    
+    struct Node4 : Node {
+        Node4() : Node(NODE4) {}
+        uint8_t keys[4];
+        Node* children[4];
+    };
+    
+    struct Node16 : Node {
+        Node16() : Node(NODE16) {}
+        uint8_t keys[16];
+        Node* children[16];
+    };
+    
+    struct Node48 : Node {
+        Node48() : Node(NODE48) {
+            std::memset(index, 0, sizeof(index));
+            std::fill(children, children + 48, nullptr);
+        }
+        uint8_t index[256];         // Slot + 1; 0 means no child
+        Node* children[48];
+    };
+    
+    struct Node256 : Node {
+        Node256() : Node(NODE256) { std::fill(children, children + 256, nullptr); }
+        Node* children[256];
+    };
+    
+    Node* root_;
+    size_t size_;
+    size_t memory_;
+    size_t node_counts_[4];
+    
+    static bool is_leaf(const Node* ref) { return (reinterpret_cast<uintptr_t>(ref) & 1) != 0; }
+    static Leaf* as_leaf(const Node* ref) {
+        return reinterpret_cast<Leaf*>(reinterpret_cast<uintptr_t>(ref) & ~static_cast<uintptr_t>(1));
+    }
+    static Node* tag_leaf(Leaf* leaf) {
+        return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(leaf) | 1);
+    }
+    static uint8_t byte_at(const std::string& key, size_t depth) {
+        return static_cast<uint8_t>(key[depth]);
+    }
+    
+    // Allocation with memory accounting
+    Leaf* new_leaf(const std::string& key, const Value& value);
+    void free_leaf(Leaf* leaf);
+    template<typename T> T* new_node();
+    void free_node(Node* node);
+    static size_t leaf_bytes(const Leaf* leaf);
+    static size_t node_bytes(NodeType type);
+    void free_tree(Node* ref);
+    
+    // Node operations
+    static Node** find_child(Node* node, uint8_t byte);
+    void add_child(Node** ref, uint8_t byte, Node* child);
+    // The byte must have a child; its slot may already be null
+    static void remove_child(Node* node, uint8_t byte);
+    void shrink(Node** ref);
+    static void copy_header(Node* to, const Node* from);
+    static void set_prefix(Node* node, const char* data, uint32_t length);
+    
+    // Leftmost leaf under ref; supplies prefix bytes past MAX_PREFIX
+    static const Leaf* minimum(const Node* ref);
+    
+    // Number of prefix bytes of node that match key from depth
+    static uint32_t match_prefix(const Node* node, const std::string& key, size_t depth);
+    
+    bool insert_at(Node** ref, const std::string& key, size_t depth, const Value& value);
+    bool remove_at(Node** ref, const std::string& key, size_t depth);
+    
+    // In-order walk from start (while bounded) to end; false once done
+    bool collect(const Node* ref, size_t depth, const std::string& start, bool bounded,
+                 const std::string* end, size_t limit, std::vector<std::pair<std::string, Value>>& out) const;
+    
+    // Calls fn(byte, child) for each child in byte order until it returns false
+    template<typename Fn>
+    static bool for_each_child(const Node* node, Fn fn);
+};
+
+template<typename Value>
+bool AdaptiveRadixTree<Value>::insert(const std::string& key, const Value& value) {
+    bool inserted = insert_at(&root_, key, 0, value);
+    size_ += inserted ? 1 : 0;
+    return inserted;
+}
+
+template<typename Value>
+const Value* AdaptiveRadixTree<Value>::find(const std::string& key) const {
+    const Node* ref = root_;
+    size_t depth = 0;
+    
+    while (ref != nullptr) {
+        if (is_leaf(ref)) {
+            const Leaf* leaf = as_leaf(ref);
+            return leaf->key == key ? &leaf->value : nullptr;
+        }
+        
+        // Only the inline bytes are compared; the leaf check covers the rest
+        if (ref->prefix_len > 0) {
+            if (key.size() < depth + ref->prefix_len) {
+                return nullptr;
+            }
+            uint32_t stored = std::min(ref->prefix_len, MAX_PREFIX);
+            if (std::memcmp(ref->prefix, key.data() + depth, stored) != 0) {
+                return nullptr;
+            }
+            depth += ref->prefix_len;
+        }
+        
+        if (depth == key.size()) {
+            const Leaf* leaf = ref->terminal;
+            return leaf != nullptr && leaf->key == key ? &leaf->value : nullptr;
+        }
+        
+        Node* const* child = find_child(const_cast<Node*>(ref), byte_at(key, depth));
+        if (child == nullptr) {
+            return nullptr;
+        }
+        ref = *child;
+        depth++;
+    }
+    return nullptr;
+}
+
+template<typename Value>
+bool AdaptiveRadixTree<Value>::remove(const std::string& key) {
+    bool removed = remove_at(&root_, key, 0);
+    size_ -= removed ? 1 : 0;
+    return removed;
+}
+
+template<typename Value>
+std::vector<std::pair<std::string, Value>> AdaptiveRadixTree<Value>::scan_prefix(const std::string& prefix,
+                                                                                   size_t limit) const {
+    std::vector<std::pair<std::string, Value>> out;
+    if (root_ == nullptr || limit == 0) {
+        return out;
+    }
+    
+    // The smallest key greater than every key with this prefix; none if the
+    // prefix is all 0xff bytes
+    std::string end = prefix;
+    while (!end.empty() && static_cast<uint8_t>(end.back()) == 0xff) {
+        end.pop_back();
+    }
+    if (!end.empty()) {
+        end.back() = static_cast<char>(static_cast<uint8_t>(end.back()) + 1);
+    }
+    
+    collect(root_, 0, prefix, true, end.empty() ? nullptr : &end, limit, out);
+    return out;
+}
+
+template<typename Value>
+std::unordered_map<std::string, size_t> AdaptiveRadixTree<Value>::get_stats() const {
+    std::unordered_map<std::string, size_t> stats;
+    stats["size"] = size_;
+    stats["memory_bytes"] = memory_;
+    stats["node4"] = node_counts_[NODE4];
+    stats["node16"] = node_counts_[NODE16];
+    stats["node48"] = node_counts_[NODE48];
+    stats["node256"] = node_counts_[NODE256];
+    return stats;
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::clear() {
+    free_tree(root_);
+    root_ = nullptr;
+    size_ = 0;
+}
+
+template<typename Value>
+typename AdaptiveRadixTree<Value>::Leaf* AdaptiveRadixTree<Value>::new_leaf(const std::string& key,
+                                                                            const Value& value) {
+    Leaf* leaf = new Leaf(key, value);
+    memory_ += leaf_bytes(leaf);
+    return leaf;
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::free_leaf(Leaf* leaf) {
+    memory_ -= leaf_bytes(leaf);
+    delete leaf;
+}
+
+template<typename Value>
+template<typename T>
+T* AdaptiveRadixTree<Value>::new_node() {
+    T* node = new T();
+    memory_ += sizeof(T);
+    node_counts_[node->type]++;
+    return node;
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::free_node(Node* node) {
+    memory_ -= node_bytes(node->type);
+    node_counts_[node->type]--;
+    switch (node->type) {
+        case NODE4: delete static_cast<Node4*>(node); break;
+        case NODE16: delete static_cast<Node16*>(node); break;
+        case NODE48: delete static_cast<Node48*>(node); break;
+        case NODE256: delete static_cast<Node256*>(node); break;
+    }
+}
+
+template<typename Value>
+size_t AdaptiveRadixTree<Value>::leaf_bytes(const Leaf* leaf) {
+    // Short keys live inside the std::string itself
+    const char* data = leaf->key.data();
+    const char* inline_begin = reinterpret_cast<const char*>(&leaf->key);
+    bool heap = data < inline_begin || data >= inline_begin + sizeof(std::string);
+    return sizeof(Leaf) + (heap ? leaf->key.capacity() + 1 : 0);
+}
+
+template<typename Value>
+size_t AdaptiveRadixTree<Value>::node_bytes(NodeType type) {
+    switch (type) {
+        case NODE4: return sizeof(Node4);
+        case NODE16: return sizeof(Node16);
+        case NODE48: return sizeof(Node48);
+        case NODE256: return sizeof(Node256);
+    }
+    return 0;
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::free_tree(Node* ref) {
+    if (ref == nullptr) {
+        return;
+    }
+    if (is_leaf(ref)) {
+        free_leaf(as_leaf(ref));
+        return;
+    }
+    
+    for_each_child(ref, [this](uint8_t, const Node* child) {
+        free_tree(const_cast<Node*>(child));
+        return true;
+    });
+    if (ref->terminal != nullptr) {
+        free_leaf(ref->terminal);
+    }
+    free_node(ref);
+}
+
+template<typename Value>
+typename AdaptiveRadixTree<Value>::Node** AdaptiveRadixTree<Value>::find_child(Node* node, uint8_t byte) {
+    switch (node->type) {
+        case NODE4: {
+            auto* n = static_cast<Node4*>(node);
+            for (uint16_t i = 0; i < n->count; ++i) {
+                if (n->keys[i] == byte) {
+                    return &n->children[i];
+                }
+            }
+            return nullptr;
+        }
+        case NODE16: {
+            auto* n = static_cast<Node16*>(node);
+#if defined(__SSE2__)
+            // All 16 key bytes compared at once; the count masks off unused slots
+            __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys));
+            __m128i matches = _mm_cmpeq_epi8(keys, _mm_set1_epi8(static_cast<char>(byte)));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches)) & ((1u << n->count) - 1);
+            return mask != 0 ? &n->children[__builtin_ctz(mask)] : nullptr;
+#else
+            for (uint16_t i = 0; i < n->count; ++i) {
+                if (n->keys[i] == byte) {
+                    return &n->children[i];
+                }
+            }
+            return nullptr;
+#endif
+        }
+        case NODE48: {
+            auto* n = static_cast<Node48*>(node);
+            return n->index[byte] != 0 ? &n->children[n->index[byte] - 1] : nullptr;
+        }
+        case NODE256: {
+            auto* n = static_cast<Node256*>(node);
+            return n->children[byte] != nullptr ? &n->children[byte] : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::copy_header(Node* to, const Node* from) {
+    to->count = from->count;
+    to->prefix_len = from->prefix_len;
+    std::memcpy(to->prefix, from->prefix, MAX_PREFIX);
+    to->terminal = from->terminal;
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::set_prefix(Node* node, const char* data, uint32_t length) {
+    node->prefix_len = length;
+    std::memcpy(node->prefix, data, std::min(length, MAX_PREFIX));
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::add_child(Node** ref, uint8_t byte, Node* child) {
+    Node* node = *ref;
+    switch (node->type) {
+        case NODE4: {
+            auto* n = static_cast<Node4*>(node);
+            if (n->count < 4) {
+                uint16_t pos = 0;
+                while (pos < n->count && n->keys[pos] < byte) pos++;
+                std::memmove(n->keys + pos + 1, n->keys + pos, n->count - pos);
+                std::memmove(n->children + pos + 1, n->children + pos, (n->count - pos) * sizeof(Node*));
+                n->keys[pos] = byte;
+                n->children[pos] = child;
+                n->count++;
+                return;
+            }
+            auto* grown = new_node<Node16>();
+            copy_header(grown, n);
+            std::memcpy(grown->keys, n->keys, 4);
+            std::memcpy(grown->children, n->children, 4 * sizeof(Node*));
+            free_node(n);
+            *ref = grown;
+            add_child(ref, byte, child);
+            return;
+        }
+        case NODE16: {
+            auto* n = static_cast<Node16*>(node);
+            if (n->count < 16) {
+#if defined(__SSE2__)
+                // Unsigned byte order via a signed compare with the sign bits flipped
+                const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+                __m128i keys = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys)), flip);
+                __m128i probe = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(byte)), flip);
+                unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmplt_epi8(probe, keys))) &
+                                ((1u << n->count) - 1);
+                uint16_t pos = mask != 0 ? static_cast<uint16_t>(__builtin_ctz(mask)) : n->count;
+#else
+                uint16_t pos = 0;
+                while (pos < n->count && n->keys[pos] < byte) pos++;
+#endif
+                std::memmove(n->keys + pos + 1, n->keys + pos, n->count - pos);
+                std::memmove(n->children + pos + 1, n->children + pos, (n->count - pos) * sizeof(Node*));
+                n->keys[pos] = byte;
+                n->children[pos] = child;
+                n->count++;
+                return;
+            }
+            auto* grown = new_node<Node48>();
+            copy_header(grown, n);
+            for (uint8_t i = 0; i < 16; ++i) {
+                grown->children[i] = n->children[i];
+                grown->index[n->keys[i]] = static_cast<uint8_t>(i + 1);
+            }
+            free_node(n);
+            *ref = grown;
+            add_child(ref, byte, child);
+            return;
+        }
+        case NODE48: {
+            auto* n = static_cast<Node48*>(node);
+            if (n->count < 48) {
+                uint8_t slot = 0;
+                while (n->children[slot] != nullptr) slot++;
+                n->children[slot] = child;
+                n->index[byte] = static_cast<uint8_t>(slot + 1);
+                n->count++;
+                return;
+            }
+            auto* grown = new_node<Node256>();
+            copy_header(grown, n);
+            for (int b = 0; b < 256; ++b) {
+                if (n->index[b] != 0) {
+                    grown->children[b] = n->children[n->index[b] - 1];
+                }
+            }
+            free_node(n);
+            *ref = grown;
+            add_child(ref, byte, child);
+            return;
+        }
+        case NODE256: {
+            auto* n = static_cast<Node256*>(node);
+            n->children[byte] = child;
+            n->count++;
+            return;
+        }
+    }
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::remove_child(Node* node, uint8_t byte) {
+    switch (node->type) {
+        case NODE4:
+        case NODE16: {
+            uint8_t* keys = node->type == NODE4 ? static_cast<Node4*>(node)->keys : static_cast<Node16*>(node)->keys;
+            Node** children = node->type == NODE4 ? static_cast<Node4*>(node)->children
+                                                  : static_cast<Node16*>(node)->children;
+            uint16_t pos = 0;
+            while (keys[pos] != byte) pos++;
+            std::memmove(keys + pos, keys + pos + 1, node->count - pos - 1);
+            std::memmove(children + pos, children + pos + 1, (node->count - pos - 1) * sizeof(Node*));
+            node->count--;
+            return;
+        }
+        case NODE48: {
+            auto* n = static_cast<Node48*>(node);
+            n->children[n->index[byte] - 1] = nullptr;
+            n->index[byte] = 0;
+            n->count--;
+            return;
+        }
+        case NODE256: {
+            auto* n = static_cast<Node256*>(node);
+            n->children[byte] = nullptr;
+            n->count--;
+            return;
+        }
+    }
+}
+
+template<typename Value>
+void AdaptiveRadixTree<Value>::shrink(Node** ref) {
+    Node* node = *ref;
+    switch (node->type) {
+        case NODE4: {
+            auto* n = static_cast<Node4*>(node);
+            if (n->count == 0 && n->terminal != nullptr) {
+                // Only the terminal leaf is left; it replaces the node
+                *ref = tag_leaf(n->terminal);
+                free_node(n);
+            } else if (n->count == 1 && n->terminal == nullptr) {
+                // Fold this node's prefix and key byte into its only child
+                Node* child = n->children[0];
+                if (!is_leaf(child)) {
+                    uint8_t merged[MAX_PREFIX];
+                    uint32_t length = 0;
+                    for (uint32_t i = 0; i < std::min(n->prefix_len, MAX_PREFIX); ++i) {
+                        merged[length++] = n->prefix[i];
+                    }
+                    if (length < MAX_PREFIX) {
+                        merged[length++] = n->keys[0];
+                    }
+                    for (uint32_t i = 0; length < MAX_PREFIX && i < std::min(child->prefix_len, MAX_PREFIX); ++i) {
+                        merged[length++] = child->prefix[i];
+                    }
+                    child->prefix_len += n->prefix_len + 1;
+                    std::memcpy(child->prefix, merged, length);
+                }
+                *ref = child;
+                free_node(n);
+            }
+            return;
+        }
+        case NODE16: {
+            auto* n = static_cast<Node16*>(node);
+            if (n->count > 3) {
+                return;
+            }
+            auto* shrunk = new_node<Node4>();
+            copy_header(shrunk, n);
+            std::memcpy(shrunk->keys, n->keys, n->count);
+            std::memcpy(shrunk->children, n->children, n->count * sizeof(Node*));
+            free_node(n);
+            *ref = shrunk;
+            shrink(ref);
+            return;
+        }
+        case NODE48: {
+            auto* n = static_cast<Node48*>(node);
+            if (n->count > 12) {
+                return;
+            }
+            auto* shrunk = new_node<Node16>();
+            copy_header(shrunk, n);
+            uint16_t count = 0;
+            for (int b = 0; b < 256; ++b) {
+                if (n->index[b] != 0) {
+                    shrunk->keys[count] = static_cast<uint8_t>(b);
+                    shrunk->children[count++] = n->children[n->index[b] - 1];
+                }
+            }
+            free_node(n);
+            *ref = shrunk;
+            return;
+        }
+        case NODE256: {
+            auto* n = static_cast<Node256*>(node);
+            if (n->count > 37) {
+                return;
+            }
+            auto* shrunk = new_node<Node48>();
+            copy_header(shrunk, n);
+            uint8_t slot = 0;
+            for (int b = 0; b < 256; ++b) {
+                if (n->children[b] != nullptr) {
+                    shrunk->children[slot] = n->children[b];
+                    shrunk->index[b] = ++slot;
+                }
+            }
+            free_node(n);
+            *ref = shrunk;
+            return;
+        }
+    }
+}
+
+template<typename Value>
+const typename AdaptiveRadixTree<Value>::Leaf* AdaptiveRadixTree<Value>::minimum(const Node* ref) {
+    while (ref != nullptr && !is_leaf(ref)) {
+        if (ref->terminal != nullptr) {
+            return ref->terminal;
+        }
+        const Node* first = nullptr;
+        for_each_child(ref, [&first](uint8_t, const Node* child) {
+            first = child;
+            return false;
+        });
+        ref = first;
+    }
+    return ref != nullptr ? as_leaf(ref) : nullptr;
+}
+
+template<typename Value>
+uint32_t AdaptiveRadixTree<Value>::match_prefix(const Node* node, const std::string& key, size_t depth) {
+    uint32_t stored = std::min(node->prefix_len, MAX_PREFIX);
+    uint32_t i = 0;
+    for (; i < stored; ++i) {
+        if (depth + i >= key.size() || node->prefix[i] != byte_at(key, depth + i)) {
+            return i;
+        }
+    }
+    if (node->prefix_len > MAX_PREFIX) {
+        const std::string& full = minimum(node)->key;
+        for (; i < node->prefix_len; ++i) {
+            if (depth + i >= key.size() || full[depth + i] != key[depth + i]) {
+                return i;
+            }
+        }
+    }
+    return i;
+}
+
+template<typename Value>
+bool AdaptiveRadixTree<Value>::insert_at(Node** ref, const std::string& key, size_t depth, const Value& value) {
+    Node* node = *ref;
+    if (node == nullptr) {
+        *ref = tag_leaf(new_leaf(key, value));
+        return true;
+    }
+    
+    if (is_leaf(node)) {
+        Leaf* existing = as_leaf(node);
+        if (existing->key == key) {
+            existing->value = value;
+            return false;
+        }
+        
+        // Two keys now share this slot: split on their first differing byte
+        size_t common = depth;
+        while (common < key.size() && common < existing->key.size() && key[common] == existing->key[common]) {
+            common++;
+        }
+        
+        auto* inner = new_node<Node4>();
+        set_prefix(inner, key.data() + depth, static_cast<uint32_t>(common - depth));
+        Node* split = inner;
+        for (Leaf* leaf : {existing, new_leaf(key, value)}) {
+            if (leaf->key.size() == common) {
+                inner->terminal = leaf;
+            } else {
+                add_child(&split, byte_at(leaf->key, common), tag_leaf(leaf));
+            }
+        }
+        *ref = split;
+        return true;
+    }
+    
+    if (node->prefix_len > 0) {
+        uint32_t matched = match_prefix(node, key, depth);
+        if (matched < node->prefix_len) {
+            // The key leaves the compressed path part way: a new node takes
+            // the shared part and the old node keeps the rest
+            const std::string& full = minimum(node)->key;
+            auto* inner = new_node<Node4>();
+            set_prefix(inner, full.data() + depth, matched);
+            
+            uint8_t old_byte = byte_at(full, depth + matched);
+            node->prefix_len -= matched + 1;
+            std::memcpy(node->prefix, full.data() + depth + matched + 1, std::min(node->prefix_len, MAX_PREFIX));
+            
+            Node* split = inner;
+            add_child(&split, old_byte, node);
+            Leaf* leaf = new_leaf(key, value);
+            if (key.size() == depth + matched) {
+                inner->terminal = leaf;
+            } else {
+                add_child(&split, byte_at(key, depth + matched), tag_leaf(leaf));
+            }
+            *ref = split;
+            return true;
+        }
+        depth += node->prefix_len;
+    }
+    
+    if (depth == key.size()) {
+        if (node->terminal != nullptr) {
+            node->terminal->value = value;
+            return false;
+        }
+        node->terminal = new_leaf(key, value);
+        return true;
+    }
+    
+    Node** child = find_child(node, byte_at(key, depth));
+    if (child != nullptr) {
+        return insert_at(child, key, depth + 1, value);
+    }
+    add_child(ref, byte_at(key, depth), tag_leaf(new_leaf(key, value)));
+    return true;
+}
+
+template<typename Value>
+bool AdaptiveRadixTree<Value>::remove_at(Node** ref, const std::string& key, size_t depth) {
+    Node* node = *ref;
+    if (node == nullptr) {
+        return false;
+    }
+    
+    if (is_leaf(node)) {
+        Leaf* leaf = as_leaf(node);
+        if (leaf->key != key) {
+            return false;
+        }
+        free_leaf(leaf);
+        *ref = nullptr;
+        return true;
+    }
+    
+    if (node->prefix_len > 0) {
+        if (match_prefix(node, key, depth) != node->prefix_len) {
+            return false;
+        }
+        depth += node->prefix_len;
+    }
+    
+    if (depth == key.size()) {
+        if (node->terminal == nullptr || node->terminal->key != key) {
+            return false;
+        }
+        free_leaf(node->terminal);
+        node->terminal = nullptr;
+        shrink(ref);
+        return true;
+    }
+    
+    uint8_t byte = byte_at(key, depth);
+    Node** child = find_child(node, byte);
+    if (child == nullptr || !remove_at(child, key, depth + 1)) {
+        return false;
+    }
+    if (*child == nullptr) {
+        remove_child(node, byte);
+        shrink(ref);
+    }
+    return true;
+}
+
+template<typename Value>
+bool AdaptiveRadixTree<Value>::collect(const Node* ref, size_t depth, const std::string& start, bool bounded,
+                                       const std::string* end, size_t limit,
+                                       std::vector<std::pair<std::string, Value>>& out) const {
+    if (is_leaf(ref)) {
+        const Leaf* leaf = as_leaf(ref);
+        if (bounded && leaf->key < start) {
+            return true;
+        }
+        if (end != nullptr && leaf->key >= *end) {
+            return false;
+        }
+        out.emplace_back(leaf->key, leaf->value);
+        return out.size() < limit;
+    }
+    
+    if (bounded && ref->prefix_len > 0) {
+        // Compare the compressed path with start: a smaller path holds only
+        // smaller keys, a larger one (or start running out) only larger keys
+        const std::string* full = ref->prefix_len > MAX_PREFIX ? &minimum(ref)->key : nullptr;
+        for (uint32_t i = 0; i < ref->prefix_len; ++i) {
+            if (depth + i >= start.size()) {
+                bounded = false;
+                break;
+            }
+            uint8_t path = i < MAX_PREFIX ? ref->prefix[i] : byte_at(*full, depth + i);
+            uint8_t bound = byte_at(start, depth + i);
+            if (path != bound) {
+                if (path < bound) {
+                    return true;
+                }
+                bounded = false;
+                break;
+            }
+        }
+    }
+    depth += ref->prefix_len;
+    
+    if (ref->terminal != nullptr && !collect(tag_leaf(ref->terminal), depth, start, bounded, end, limit, out)) {
+        return false;
+    }
+    
+    bool below_start = bounded && depth < start.size();
+    uint8_t bound = below_start ? byte_at(start, depth) : 0;
+    return for_each_child(ref, [&](uint8_t byte, const Node* child) {
+        if (below_start && byte < bound) {
+            return true;
+        }
+        return collect(child, depth + 1, start, below_start && byte == bound, end, limit, out);
+    });
+}
+
+template<typename Value>
+template<typename Fn>
+bool AdaptiveRadixTree<Value>::for_each_child(const Node* node, Fn fn) {
+    switch (node->type) {
+        case NODE4: {
+            auto* n = static_cast<const Node4*>(node);
+            for (uint16_t i = 0; i < n->count; ++i) {
+                if (!fn(n->keys[i], n->children[i])) return false;
+            }
+            return true;
+        }
+        case NODE16: {
+            auto* n = static_cast<const Node16*>(node);
+            for (uint16_t i = 0; i < n->count; ++i) {
+                if (!fn(n->keys[i], n->children[i])) return false;
+            }
+            return true;
+        }
+        case NODE48: {
+            auto* n = static_cast<const Node48*>(node);
+            for (int b = 0; b < 256; ++b) {
+                if (n->index[b] != 0 && !fn(static_cast<uint8_t>(b), n->children[n->index[b] - 1])) return false;
+            }
+            return true;
+        }
+        case NODE256: {
+            auto* n = static_cast<const Node256*>(node);
+            for (int b = 0; b < 256; ++b) {
+                if (n->children[b] != nullptr && !fn(static_cast<uint8_t>(b), n->children[b])) return false;
+            }
+            return true;
+        }
+    }
+    return true;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Block file layout
+//
+//   [block 0] ... [block N-1] [index] [footer]
+//
+//   block:  u32 raw_size | u32 stored_size | u32 crc32c(payload) | u8 compression | payload
+//           raw payload = entries of u8 type | u32 key_len | u32 value_len | key | value
+//   index:  properties, then per block: offset, size, entry count, min key, max key,
+//           then an optional filter blob (absent in files written without one).
+//           Version 2 files always carry the filter blob, followed by u64 count
+//           and that many range tombstones as start key, end key; files without
+//           range tombstones are still written as version 1.
+//   footer: u64 index_offset | u64 index_size | u32 crc32c(index) | u32 version | magic
+//
+// Every block can be verified, decompressed and decoded on its own, so readers
+// can load blocks in parallel or ship them one at a time.
+
+enum class BlockCompression : uint8_t {
+    NONE = 0,
+    ZLIB = 1
+};
+
+// Entry kinds stored in a block
+enum class BlockEntryType : uint8_t {
+    PUT = 1,
+    DELETE = 2,
+    PUT_TTL = 3     // Value prefixed with its expiry time
+};
+
+// File-wide metadata kept in the index
+struct BlockFileProperties {
+    uint64_t wal_segment;
+    uint64_t start_lsn;
+    uint64_t base_lsn;
+    uint64_t entry_count;
+    bool sorted;            // Keys are strictly increasing across the whole file
+    std::string filter;     // Serialized key filter, e.g. a bloom filter; may be empty
+    
+    // Key ranges [first, second) deleted outright; a reader drops whatever
+    // they cover from the older files it layers this one on
+    std::vector<std::pair<std::string, std::string>> range_tombstones;
+    
+    BlockFileProperties()
+        : wal_segment(0), start_lsn(0), base_lsn(0), entry_count(0), sorted(false) {}
+};
+
+struct BlockFileOptions {
+    size_t block_size;      // Target uncompressed block size
+    BlockCompression compression;
+    
+    BlockFileOptions() : block_size(64 * 1024), compression(BlockCompression::NONE) {}
+};
+
+// Index entry describing one block
+struct BlockHandle {
+    uint64_t offset;
+    uint32_t size;          // Stored size including the block header
+    uint32_t entry_count;
+    std::string min_key;
+    std::string max_key;
+    
+    BlockHandle() : offset(0), size(0), entry_count(0) {}
+};
+
+struct BlockEntry {
+    BlockEntryType type;
+    std::string key;
+    std::string value;
+};
+
+// True if this build can write and read compressed blocks
+bool block_compression_supported(BlockCompression compression);
+
+// Builds a block file under a temporary name; finish() publishes it atomically
+class BlockFileWriter {
+public:
+    BlockFileWriter(const std::string& path, const BlockFileOptions& options = BlockFileOptions());
+    ~BlockFileWriter();
+    
+    bool open();
+    
+    bool add(BlockEntryType type, const std::string& key, const std::string& value);
+    
+    // Write the index and footer with the given properties, fsync and rename
+    bool finish(BlockFileProperties properties);
+    
+    void abort();
+    
+    uint64_t get_entry_count() const { return entry_count_; }
+    uint64_t get_file_size() const { return offset_; }
+
+private:
+    bool flush_block();
+    
+    std::string path_;
+    std::string tmp_path_;
+    BlockFileOptions options_;
+    std::ofstream file_;
+    uint64_t offset_;
+    uint64_t entry_count_;
+    bool sorted_;
+    std::string last_key_;
+    
+    // Block being filled
+    std::string block_;
+    uint32_t block_entries_;
+    std::string block_min_;
+    std::string block_max_;
+    
+    std::vector<BlockHandle> index_;
+};
+
+// Random-access reader; all read methods are safe to call from several threads
+class BlockFileReader {
+public:
+    using EntryCallback = std::function<void(BlockEntry&& entry)>;
+    
+    BlockFileReader();
+    ~BlockFileReader();
+    
+    BlockFileReader(const BlockFileReader&) = delete;
+    BlockFileReader& operator=(const BlockFileReader&) = delete;
+    
+    // Open the file and verify the footer and index
+    bool open(const std::string& path);
+    void close();
+    
+    const BlockFileProperties& properties() const { return properties_; }
+    const std::vector<BlockHandle>& blocks() const { return index_; }
+    uint64_t file_size() const { return file_size_; }
+    
+    // Verify, decompress and decode one block
+    bool read_block(size_t index, std::vector<BlockEntry>& entries) const;
+    
+    // Stored bytes of one block, header included, exactly as on disk
+    bool read_raw_block(size_t index, std::string& data) const;
+    
+    // Decode every block on up to `threads` threads. on_entry is called
+    // concurrently when threads > 1 and must be thread-safe.
+    bool for_each(const EntryCallback& on_entry, size_t threads = 1) const;
+
+private:
+    bool pread_exact(uint64_t offset, void* buffer, size_t length) const;
+    
+    std::string path_;
+    int fd_;
+    uint64_t file_size_;
+    BlockFileProperties properties_;
+    std::vector<BlockHandle> index_;
+};
+
+// Key range and size of a file that passed verify_sorted_file
+struct BlockFileSummary {
+    uint64_t entry_count;
+    std::string smallest;
+    std::string largest;
+    
+    BlockFileSummary() : entry_count(0) {}
+};
+
+// Check a file built outside the store, e.g. by an offline job with
+// SnapshotWriter or SSTableBuilder, before it is linked in as is: every
+// block's checksum, keys strictly increasing across the file, and nothing but
+// PUT entries. Reads each block once; on_entry, if set, sees every entry in
+// key order. Logs why a file is refused.
+bool verify_sorted_file(const std::string& path, BlockFileSummary& summary,
+                        const BlockFileReader::EntryCallback& on_entry = nullptr);
+
+// fsync a file, or a directory so that a rename inside it is durable
+bool sync_path(const std::string& path);
+
+} // namespace distributeddb
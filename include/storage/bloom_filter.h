@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Stable 64-bit hash of a key; persisted inside filters, so it must never change
+uint64_t hash_key(const std::string& key);
+
+// Bloom filter built once over a set of keys and stored as a byte string.
+// With 10 bits per key the false positive rate is about 1%.
+class BloomFilterBuilder {
+public:
+    explicit BloomFilterBuilder(size_t bits_per_key = 10);
+    
+    void add(const std::string& key);
+    
+    // Serialize the filter: bit array followed by one byte holding the probe count
+    std::string finish();
+    
+    size_t key_count() const { return hashes_.size(); }
+
+private:
+    size_t bits_per_key_;
+    std::vector<uint64_t> hashes_;
+};
+
+class BloomFilter {
+public:
+    // An empty filter matches everything
+    static bool may_contain(const std::string& filter, const std::string& key);
+};
+
+} // namespace distributeddb
@@ -1,71 +1,680 @@
 #pragma once
 
+#include "storage/arena.h"
 #include <string>
 #include <vector>
-#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+#include <new>
+#include <cstring>
 #include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
 
 namespace distributeddb {
 
-// B-tree node structure
-template<typename KeyType, typename ValueType>
-struct BTreeNode {
-    bool is_leaf;
-    std::vector<KeyType> keys;
-    std::vector<ValueType> values;
-    std::vector<std::shared_ptr<BTreeNode<KeyType, ValueType>>> children;
+// How BTree searches a key type. Key types with heads are searched on a 64-bit
+// head per key: heads sort in the same order as their keys, ties are broken
+// on the full key, and a node compares the probe with all of its heads in a
+// few SIMD instructions. Other key types use a binary search over the keys.
+template<typename KeyType, typename Enable = void>
+struct BTreeKeyTraits {
+    static constexpr bool has_heads = false;
+    static size_t heap_bytes(const KeyType&) { return 0; }
+};
+
+// A string head is the 8 bytes after the prefix shared by every key in the
+// node, big-endian so heads compare like memcmp, zero-padded past the end
+template<>
+struct BTreeKeyTraits<std::string> {
+    static constexpr bool has_heads = true;
+    
+    static uint64_t head(const std::string& key, size_t offset) {
+        if (offset + 8 <= key.size()) {
+            uint64_t raw;
+            std::memcpy(&raw, key.data() + offset, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            raw = __builtin_bswap64(raw);
+#endif
+            return raw;
+        }
+        uint64_t value = 0;
+        for (size_t i = offset; i < offset + 8; ++i) {
+            value = (value << 8) | (i < key.size() ? static_cast<uint8_t>(key[i]) : 0);
+        }
+        return value;
+    }
+    
+    static size_t shared_length(const std::string& a, const std::string& b) {
+        size_t limit = std::min(a.size(), b.size());
+        size_t length = 0;
+        while (length < limit && a[length] == b[length]) {
+            length++;
+        }
+        return length;
+    }
     
-    BTreeNode(bool leaf = true) : is_leaf(leaf) {}
+    static const char* data(const std::string& key) { return key.data(); }
     
-    // Check if node is full
-    bool is_full(int order) const {
-        return keys.size() >= 2 * order - 1;
+    // Orders key against the length bytes at shared
+    static int compare_shared(const std::string& key, const char* shared, size_t length) {
+        int order = std::memcmp(key.data(), shared, std::min(key.size(), length));
+        if (order != 0) {
+            return order;
+        }
+        return key.size() < length ? -1 : 0;
     }
     
-    // Check if node is underflow
-    bool is_underflow(int order) const {
-        return keys.size() < order - 1;
+    static size_t heap_bytes(const std::string& key) {
+        // Short strings live inside the object
+        const char* inline_begin = reinterpret_cast<const char*>(&key);
+        bool heap = key.data() < inline_begin || key.data() >= inline_begin + sizeof(std::string);
+        return heap ? key.capacity() + 1 : 0;
     }
 };
 
-// B-tree implementation
+// In-memory B+tree. Nodes have fixed-capacity inline arrays, are aligned to
+// cache lines and come from an arena, so a descent reads a node's heads and
+// then one raw child pointer per level; nothing is chased through heap
+// vectors or shared_ptr refcounts. Leaves are chained for range scans. A node
+// that empties is unlinked and recycled instead of being merged with a
+// sibling (free-at-empty), which keeps deletes local.
+//
+// Not thread-safe: callers serialize writers against readers.
 template<typename KeyType, typename ValueType>
 class BTree {
 public:
-    explicit BTree(int order = 4);
+    // Keys per node; the heads fill two cache lines
+    static constexpr uint32_t SLOTS = 16;
+    
+    // Nodes are carved from arena blocks of this many bytes
+    explicit BTree(size_t arena_block_size = 256 * 1024)
+        : arena_(arena_block_size), root_(nullptr), size_(0), key_heap_bytes_(0),
+          leaf_nodes_(0), inner_nodes_(0), height_(0) {}
+    ~BTree() { destroy(root_); }
     
-    // Insert key-value pair
-    void insert(const KeyType& key, const ValueType& value);
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
     
-    // Get value by key
-    std::optional<ValueType> get(const KeyType& key) const;
+    // Insert or overwrite; true if the key was new
+    bool insert(const KeyType& key, const ValueType& value);
+    
+    // Pointer to the stored value, valid until the next write; null if absent
+    const ValueType* find(const KeyType& key) const;
+    
+    std::optional<ValueType> get(const KeyType& key) const {
+        const ValueType* value = find(key);
+        return value != nullptr ? std::optional<ValueType>(*value) : std::nullopt;
+    }
     
-    // Delete key
     bool remove(const KeyType& key);
     
-    // Range scan
-    std::vector<std::pair<KeyType, ValueType>> scan(const KeyType& start_key, 
-                                                   const KeyType& end_key, 
+    // Entries with start_key <= key < end_key, in key order
+    std::vector<std::pair<KeyType, ValueType>> scan(const KeyType& start_key,
+                                                   const KeyType& end_key,
                                                    size_t limit = 1000) const;
     
-    // Get tree statistics
+    // Call visit(key, value) for entries from start_key on, in key order,
+    // until it returns false
+    template<typename Visitor>
+    void visit_from(const KeyType& start_key, Visitor&& visit) const;
+    
+    size_t size() const { return size_; }
+    
+    // Arena bytes plus heap memory owned by keys
+    size_t memory_usage() const { return arena_.memory_usage() + key_heap_bytes_; }
+    
     std::unordered_map<std::string, size_t> get_stats() const;
 
 private:
-    std::shared_ptr<BTreeNode<KeyType, ValueType>> root_;
-    int order_;
+    using Traits = BTreeKeyTraits<KeyType>;
+    
+    // Shared prefix bytes kept in the node's first cache line
+    static constexpr uint32_t INLINE_PREFIX = 56;
+    
+    // The first cache line and the heads are all a search reads before it
+    // follows a child pointer; keys are touched only to break a tie between
+    // equal heads or to confirm a match in a leaf
+    struct alignas(64) Node {
+        explicit Node(bool is_leaf) : count(0), leaf(is_leaf), shared(0) {
+            std::fill(heads, heads + SLOTS, UINT64_MAX);
+        }
+        uint16_t count;
+        bool leaf;
+        uint32_t shared;            // Leading key bytes every key here has in common
+        char prefix[INLINE_PREFIX]; // Those bytes, when they fit
+        uint64_t heads[SLOTS];      // Unused slots hold UINT64_MAX
+    };
+    
+    struct Leaf : Node {
+        Leaf() : Node(true), prev(nullptr), next(nullptr) {}
+        KeyType keys[SLOTS];
+        ValueType values[SLOTS];
+        Leaf* prev;
+        Leaf* next;
+    };
+    
+    // children[i] holds the keys below keys[i], children[count] the rest.
+    // Children come right after the heads, ahead of the keys.
+    struct Inner : Node {
+        Inner() : Node(false) { std::fill(children, children + SLOTS + 1, nullptr); }
+        Node* children[SLOTS + 1];
+        KeyType keys[SLOTS];
+    };
+    
+    static KeyType* keys_of(Node* node) {
+        return node->leaf ? static_cast<Leaf*>(node)->keys : static_cast<Inner*>(node)->keys;
+    }
+    static const KeyType* keys_of(const Node* node) { return keys_of(const_cast<Node*>(node)); }
+    
+    // A node split during insert: the separator and the new right sibling
+    struct Split {
+        KeyType key;
+        Node* right = nullptr;
+    };
+    
+    Arena arena_;
+    Node* root_;
+    std::vector<Leaf*> free_leaves_;
+    std::vector<Inner*> free_inners_;
     size_t size_;
+    size_t key_heap_bytes_;
+    size_t leaf_nodes_;
+    size_t inner_nodes_;
+    size_t height_;
+    
+    // Heads below probe, over all SLOTS at once. The vector paths need a
+    // 64-bit compare, so they are chosen by the compile target (see
+    // DISTRIBUTEDDB_NATIVE_ARCH).
+    static uint32_t count_below(const uint64_t* heads, uint64_t probe);
     
-    // Helper methods
-    std::shared_ptr<BTreeNode<KeyType, ValueType>> find_leaf(const KeyType& key) const;
-    void split_child(std::shared_ptr<BTreeNode<KeyType, ValueType>> parent, int index);
-    void insert_non_full(std::shared_ptr<BTreeNode<KeyType, ValueType>> node, 
-                        const KeyType& key, const ValueType& value);
-    void remove_from_leaf(std::shared_ptr<BTreeNode<KeyType, ValueType>> node, int index);
-    void remove_from_internal(std::shared_ptr<BTreeNode<KeyType, ValueType>> node, int index);
-    void borrow_from_previous(std::shared_ptr<BTreeNode<KeyType, ValueType>> node, int index);
-    void borrow_from_next(std::shared_ptr<BTreeNode<KeyType, ValueType>> node, int index);
-    void merge(std::shared_ptr<BTreeNode<KeyType, ValueType>> node, int index);
+    // First slot whose key is not below key, and first slot above key
+    static uint32_t lower_bound(const Node* node, const KeyType& key);
+    static uint32_t upper_bound(const Node* node, const KeyType& key);
+    template<bool Upper>
+    static uint32_t search(const Node* node, const KeyType& key);
+    
+    // Recomputes the shared prefix and every head
+    static void rebuild_heads(Node* node);
+    
+    // Slot shifting; keys are moved in and out
+    static void insert_key(Node* node, uint32_t slot, KeyType key);
+    static void erase_key(Node* node, uint32_t slot);
+    
+    Leaf* new_leaf();
+    Inner* new_inner();
+    void free_node(Node* node);
+    void destroy(Node* node);
+    
+    bool insert_into(Node* node, const KeyType& key, const ValueType& value, Split& split);
+    Leaf* split_leaf(Leaf* leaf);
+    bool remove_from(Node* node, const KeyType& key, bool& emptied);
 };
 
+template<typename KeyType, typename ValueType>
+bool BTree<KeyType, ValueType>::insert(const KeyType& key, const ValueType& value) {
+    if (root_ == nullptr) {
+        root_ = new_leaf();
+        height_ = 1;
+    }
+    
+    Split split;
+    bool inserted = insert_into(root_, key, value, split);
+    if (split.right != nullptr) {
+        Inner* root = new_inner();
+        root->keys[0] = std::move(split.key);
+        root->count = 1;
+        root->children[0] = root_;
+        root->children[1] = split.right;
+        rebuild_heads(root);
+        root_ = root;
+        height_++;
+    }
+    
+    size_ += inserted ? 1 : 0;
+    return inserted;
+}
+
+template<typename KeyType, typename ValueType>
+const ValueType* BTree<KeyType, ValueType>::find(const KeyType& key) const {
+    const Node* node = root_;
+    if (node == nullptr) {
+        return nullptr;
+    }
+    while (!node->leaf) {
+        node = static_cast<const Inner*>(node)->children[upper_bound(node, key)];
+        // The heads and the first children share the next three lines
+        __builtin_prefetch(reinterpret_cast<const char*>(node) + 64);
+        __builtin_prefetch(reinterpret_cast<const char*>(node) + 128);
+        __builtin_prefetch(reinterpret_cast<const char*>(node) + 192);
+    }
+    
+    const Leaf* leaf = static_cast<const Leaf*>(node);
+    uint32_t slot = lower_bound(leaf, key);
+    return slot < leaf->count && leaf->keys[slot] == key ? &leaf->values[slot] : nullptr;
+}
+
+template<typename KeyType, typename ValueType>
+bool BTree<KeyType, ValueType>::remove(const KeyType& key) {
+    bool emptied = false;
+    if (root_ == nullptr || !remove_from(root_, key, emptied)) {
+        return false;
+    }
+    size_--;
+    
+    if (emptied) {
+        free_node(root_);
+        root_ = nullptr;
+        height_ = 0;
+        return true;
+    }
+    while (!root_->leaf && root_->count == 0) {
+        Node* only = static_cast<Inner*>(root_)->children[0];
+        static_cast<Inner*>(root_)->children[0] = nullptr;
+        free_node(root_);
+        root_ = only;
+        height_--;
+    }
+    return true;
+}
+
+template<typename KeyType, typename ValueType>
+std::vector<std::pair<KeyType, ValueType>> BTree<KeyType, ValueType>::scan(const KeyType& start_key,
+                                                                           const KeyType& end_key,
+                                                                           size_t limit) const {
+    std::vector<std::pair<KeyType, ValueType>> out;
+    if (root_ == nullptr || limit == 0 || !(start_key < end_key)) {
+        return out;
+    }
+    
+    const Node* node = root_;
+    while (!node->leaf) {
+        node = static_cast<const Inner*>(node)->children[upper_bound(node, start_key)];
+    }
+    
+    const Leaf* leaf = static_cast<const Leaf*>(node);
+    uint32_t slot = lower_bound(leaf, start_key);
+    while (leaf != nullptr) {
+        for (; slot < leaf->count; ++slot) {
+            if (!(leaf->keys[slot] < end_key)) {
+                return out;
+            }
+            out.emplace_back(leaf->keys[slot], leaf->values[slot]);
+            if (out.size() >= limit) {
+                return out;
+            }
+        }
+        leaf = leaf->next;
+        slot = 0;
+    }
+    return out;
+}
+
+template<typename KeyType, typename ValueType>
+template<typename Visitor>
+void BTree<KeyType, ValueType>::visit_from(const KeyType& start_key, Visitor&& visit) const {
+    if (root_ == nullptr) {
+        return;
+    }
+    
+    const Node* node = root_;
+    while (!node->leaf) {
+        node = static_cast<const Inner*>(node)->children[upper_bound(node, start_key)];
+    }
+    
+    const Leaf* leaf = static_cast<const Leaf*>(node);
+    uint32_t slot = lower_bound(leaf, start_key);
+    while (leaf != nullptr) {
+        for (; slot < leaf->count; ++slot) {
+            if (!visit(leaf->keys[slot], leaf->values[slot])) {
+                return;
+            }
+        }
+        leaf = leaf->next;
+        slot = 0;
+    }
+}
+
+template<typename KeyType, typename ValueType>
+std::unordered_map<std::string, size_t> BTree<KeyType, ValueType>::get_stats() const {
+    std::unordered_map<std::string, size_t> stats;
+    stats["size"] = size_;
+    stats["height"] = height_;
+    stats["leaf_nodes"] = leaf_nodes_;
+    stats["inner_nodes"] = inner_nodes_;
+    stats["free_nodes"] = free_leaves_.size() + free_inners_.size();
+    stats["arena_bytes"] = arena_.memory_usage();
+    stats["memory_bytes"] = memory_usage();
+    return stats;
+}
+
+template<typename KeyType, typename ValueType>
+uint32_t BTree<KeyType, ValueType>::count_below(const uint64_t* heads, uint64_t probe) {
+#if defined(__AVX2__)
+    // Unsigned order through a signed compare with the sign bits flipped;
+    // matching lanes are -1, so subtracting them counts
+    const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i target = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(probe)), flip);
+    __m256i counts = _mm256_setzero_si256();
+    for (uint32_t i = 0; i < SLOTS; i += 4) {
+        __m256i batch = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(heads + i)), flip);
+        counts = _mm256_sub_epi64(counts, _mm256_cmpgt_epi64(target, batch));
+    }
+    __m128i pairs = _mm_add_epi64(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+    uint32_t below = static_cast<uint32_t>(_mm_cvtsi128_si64(_mm_add_epi64(pairs, _mm_unpackhi_epi64(pairs, pairs))));
+#elif defined(__SSE4_2__)
+    const __m128i flip = _mm_set1_epi64x(INT64_MIN);
+    const __m128i target = _mm_xor_si128(_mm_set1_epi64x(static_cast<int64_t>(probe)), flip);
+    __m128i counts = _mm_setzero_si128();
+    for (uint32_t i = 0; i < SLOTS; i += 2) {
+        __m128i batch = _mm_xor_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(heads + i)), flip);
+        counts = _mm_sub_epi64(counts, _mm_cmpgt_epi64(target, batch));
+    }
+    uint32_t below = static_cast<uint32_t>(_mm_cvtsi128_si64(_mm_add_epi64(counts, _mm_unpackhi_epi64(counts, counts))));
+#else
+    // No 64-bit vector compare: a branch-free binary search, which relies on
+    // the heads being sorted and the unused slots holding UINT64_MAX
+    uint32_t below = 0;
+    for (uint32_t step = SLOTS / 2; step > 0; step /= 2) {
+        below += heads[below + step - 1] < probe ? step : 0;
+    }
+    below += heads[below] < probe ? 1 : 0;
+#endif
+    return below;
+}
+
+template<typename KeyType, typename ValueType>
+uint32_t BTree<KeyType, ValueType>::lower_bound(const Node* node, const KeyType& key) {
+    return search<false>(node, key);
+}
+
+template<typename KeyType, typename ValueType>
+uint32_t BTree<KeyType, ValueType>::upper_bound(const Node* node, const KeyType& key) {
+    return search<true>(node, key);
+}
+
+template<typename KeyType, typename ValueType>
+template<bool Upper>
+uint32_t BTree<KeyType, ValueType>::search(const Node* node, const KeyType& key) {
+    const KeyType* keys = keys_of(node);
+    if constexpr (Traits::has_heads) {
+        if (node->count == 0) {
+            return 0;
+        }
+        // A key outside the node's shared prefix sorts before or after all of it
+        if (node->shared > 0) {
+            const char* shared = node->shared <= INLINE_PREFIX ? node->prefix : Traits::data(keys[0]);
+            int order = Traits::compare_shared(key, shared, node->shared);
+            if (order != 0) {
+                return order < 0 ? 0 : node->count;
+            }
+        }
+        
+        uint64_t probe = Traits::head(key, node->shared);
+        uint32_t slot = count_below(node->heads, probe);
+        while (slot < node->count && node->heads[slot] == probe &&
+               (Upper ? !(key < keys[slot]) : keys[slot] < key)) {
+            slot++;
+        }
+        return slot;
+    } else {
+        const KeyType* end = keys + node->count;
+        return static_cast<uint32_t>((Upper ? std::upper_bound(keys, end, key)
+                                            : std::lower_bound(keys, end, key)) - keys);
+    }
+}
+
+template<typename KeyType, typename ValueType>
+void BTree<KeyType, ValueType>::rebuild_heads(Node* node) {
+    if constexpr (Traits::has_heads) {
+        const KeyType* keys = keys_of(node);
+        // Keys are sorted, so the first and last share what all of them share
+        node->shared = node->count > 0
+            ? static_cast<uint32_t>(Traits::shared_length(keys[0], keys[node->count - 1])) : 0;
+        if (node->shared <= INLINE_PREFIX) {
+            std::memcpy(node->prefix, Traits::data(keys[0]), node->shared);
+        }
+        for (uint32_t i = 0; i < SLOTS; ++i) {
+            node->heads[i] = i < node->count ? Traits::head(keys[i], node->shared) : UINT64_MAX;
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType>
+void BTree<KeyType, ValueType>::insert_key(Node* node, uint32_t slot, KeyType key) {
+    KeyType* keys = keys_of(node);
+    std::move_backward(keys + slot, keys + node->count, keys + node->count + 1);
+    std::memmove(node->heads + slot + 1, node->heads + slot, (node->count - slot) * sizeof(uint64_t));
+    keys[slot] = std::move(key);
+    node->count++;
+    
+    if constexpr (Traits::has_heads) {
+        const KeyType& neighbour = keys[slot == 0 ? node->count - 1 : 0];
+        if (node->count == 1 ||
+            Traits::compare_shared(keys[slot], Traits::data(neighbour), node->shared) != 0) {
+            rebuild_heads(node);
+        } else {
+            node->heads[slot] = Traits::head(keys[slot], node->shared);
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType>
+void BTree<KeyType, ValueType>::erase_key(Node* node, uint32_t slot) {
+    KeyType* keys = keys_of(node);
+    std::move(keys + slot + 1, keys + node->count, keys + slot);
+    std::memmove(node->heads + slot, node->heads + slot + 1, (node->count - slot - 1) * sizeof(uint64_t));
+    node->count--;
+    keys[node->count] = KeyType();
+    node->heads[node->count] = UINT64_MAX;
+}
+
+template<typename KeyType, typename ValueType>
+typename BTree<KeyType, ValueType>::Leaf* BTree<KeyType, ValueType>::new_leaf() {
+    void* memory;
+    if (!free_leaves_.empty()) {
+        memory = free_leaves_.back();
+        free_leaves_.pop_back();
+    } else {
+        memory = arena_.allocate_aligned(sizeof(Leaf), alignof(Leaf));
+    }
+    leaf_nodes_++;
+    return new (memory) Leaf();
+}
+
+template<typename KeyType, typename ValueType>
+typename BTree<KeyType, ValueType>::Inner* BTree<KeyType, ValueType>::new_inner() {
+    void* memory;
+    if (!free_inners_.empty()) {
+        memory = free_inners_.back();
+        free_inners_.pop_back();
+    } else {
+        memory = arena_.allocate_aligned(sizeof(Inner), alignof(Inner));
+    }
+    inner_nodes_++;
+    return new (memory) Inner();
+}
+
+template<typename KeyType, typename ValueType>
+void BTree<KeyType, ValueType>::free_node(Node* node) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        if (leaf->prev != nullptr) {
+            leaf->prev->next = leaf->next;
+        }
+        if (leaf->next != nullptr) {
+            leaf->next->prev = leaf->prev;
+        }
+        leaf->~Leaf();
+        free_leaves_.push_back(leaf);
+        leaf_nodes_--;
+    } else {
+        Inner* inner = static_cast<Inner*>(node);
+        inner->~Inner();
+        free_inners_.push_back(inner);
+        inner_nodes_--;
+    }
+}
+
+template<typename KeyType, typename ValueType>
+void BTree<KeyType, ValueType>::destroy(Node* node) {
+    // The arena owns the memory; this only runs key and value destructors
+    if (node == nullptr) {
+        return;
+    }
+    if (node->leaf) {
+        static_cast<Leaf*>(node)->~Leaf();
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for (uint32_t i = 0; i <= inner->count; ++i) {
+        destroy(inner->children[i]);
+    }
+    inner->~Inner();
+}
+
+template<typename KeyType, typename ValueType>
+bool BTree<KeyType, ValueType>::insert_into(Node* node, const KeyType& key, const ValueType& value,
+                                            Split& split) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        uint32_t slot = lower_bound(leaf, key);
+        if (slot < leaf->count && leaf->keys[slot] == key) {
+            leaf->values[slot] = value;
+            return false;
+        }
+        
+        Leaf* right = nullptr;
+        if (leaf->count == SLOTS) {
+            right = split_leaf(leaf);
+            if (slot > leaf->count) {
+                slot -= leaf->count;
+                leaf = right;
+            }
+        }
+        
+        std::move_backward(leaf->values + slot, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+        leaf->values[slot] = value;
+        insert_key(leaf, slot, key);
+        key_heap_bytes_ += Traits::heap_bytes(leaf->keys[slot]);
+        
+        if (right != nullptr) {
+            split.key = right->keys[0];
+            split.right = right;
+            key_heap_bytes_ += Traits::heap_bytes(split.key);
+        }
+        return true;
+    }
+    
+    Inner* inner = static_cast<Inner*>(node);
+    uint32_t slot = upper_bound(inner, key);
+    Split child;
+    bool inserted = insert_into(inner->children[slot], key, value, child);
+    if (child.right == nullptr) {
+        return inserted;
+    }
+    
+    // The child at slot split: its separator goes into keys[slot] and the new
+    // sibling into children[slot + 1]
+    Inner* target = inner;
+    if (inner->count == SLOTS) {
+        // Left keeps the lower half, the middle key moves up, right takes the rest
+        const uint32_t half = SLOTS / 2;
+        Inner* right = new_inner();
+        right->count = SLOTS - half - 1;
+        std::move(inner->keys + half + 1, inner->keys + SLOTS, right->keys);
+        std::copy(inner->children + half + 1, inner->children + SLOTS + 1, right->children);
+        split.key = std::move(inner->keys[half]);
+        split.right = right;
+        for (uint32_t i = half; i < SLOTS; ++i) {
+            inner->keys[i] = KeyType();
+            inner->children[i + 1] = nullptr;
+        }
+        inner->count = half;
+        rebuild_heads(inner);
+        rebuild_heads(right);
+        
+        if (slot > half) {
+            slot -= half + 1;
+            target = right;
+        }
+    }
+    
+    std::copy_backward(target->children + slot + 1, target->children + target->count + 1,
+                       target->children + target->count + 2);
+    target->children[slot + 1] = child.right;
+    insert_key(target, slot, std::move(child.key));
+    return inserted;
+}
+
+template<typename KeyType, typename ValueType>
+typename BTree<KeyType, ValueType>::Leaf* BTree<KeyType, ValueType>::split_leaf(Leaf* leaf) {
+    const uint32_t half = SLOTS / 2;
+    Leaf* right = new_leaf();
+    right->count = SLOTS - half;
+    std::move(leaf->keys + half, leaf->keys + SLOTS, right->keys);
+    std::move(leaf->values + half, leaf->values + SLOTS, right->values);
+    for (uint32_t i = half; i < SLOTS; ++i) {
+        leaf->keys[i] = KeyType();
+        leaf->values[i] = ValueType();
+    }
+    leaf->count = half;
+    rebuild_heads(leaf);
+    rebuild_heads(right);
+    
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next != nullptr) {
+        leaf->next->prev = right;
+    }
+    leaf->next = right;
+    return right;
+}
+
+template<typename KeyType, typename ValueType>
+bool BTree<KeyType, ValueType>::remove_from(Node* node, const KeyType& key, bool& emptied) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        uint32_t slot = lower_bound(leaf, key);
+        if (slot == leaf->count || !(leaf->keys[slot] == key)) {
+            return false;
+        }
+        key_heap_bytes_ -= Traits::heap_bytes(leaf->keys[slot]);
+        std::move(leaf->values + slot + 1, leaf->values + leaf->count, leaf->values + slot);
+        leaf->values[leaf->count - 1] = ValueType();
+        erase_key(leaf, slot);
+        emptied = leaf->count == 0;
+        return true;
+    }
+    
+    Inner* inner = static_cast<Inner*>(node);
+    uint32_t slot = upper_bound(inner, key);
+    bool child_emptied = false;
+    if (!remove_from(inner->children[slot], key, child_emptied)) {
+        return false;
+    }
+    if (!child_emptied) {
+        return true;
+    }
+    
+    free_node(inner->children[slot]);
+    if (inner->count == 0) {
+        inner->children[0] = nullptr;
+        emptied = true;
+        return true;
+    }
+    
+    // Drop the child with a separator beside it; a neighbour's range widens
+    uint32_t separator = slot > 0 ? slot - 1 : 0;
+    key_heap_bytes_ -= Traits::heap_bytes(inner->keys[separator]);
+    std::copy(inner->children + slot + 1, inner->children + inner->count + 1, inner->children + slot);
+    inner->children[inner->count] = nullptr;
+    erase_key(inner, separator);
+    return true;
+}
+
 } // namespace distributeddb
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace distributeddb {
+
+// CRC-32C (Castagnoli). Uses the SSE4.2 instruction when the CPU has it.
+uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0);
+
+} // namespace distributeddb
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "storage/block_file.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace distributeddb {
+
+// Forward cursor over sorted entries, tombstones included
+class EntryIterator {
+public:
+    virtual ~EntryIterator() = default;
+    
+    // Position at the first entry with key >= target
+    virtual void seek(const std::string& target) = 0;
+    virtual void seek_to_first() = 0;
+    
+    virtual bool valid() const = 0;
+    virtual void next() = 0;
+    
+    virtual const std::string& key() const = 0;
+    virtual const std::string& value() const = 0;
+    virtual BlockEntryType type() const = 0;
+    
+    // False once a read error was hit; valid() is false from then on
+    virtual bool ok() const { return true; }
+};
+
+// Merges sorted children into one stream with each key yielded once. Children
+// are ordered newest first: on equal keys the lowest-indexed child wins and the
+// older entries are skipped.
+class MergingIterator : public EntryIterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<EntryIterator>> children);
+    
+    void seek(const std::string& target) override;
+    void seek_to_first() override;
+    bool valid() const override { return current_ != nullptr; }
+    void next() override;
+    
+    const std::string& key() const override { return current_->key(); }
+    const std::string& value() const override { return current_->value(); }
+    BlockEntryType type() const override { return current_->type(); }
+    bool ok() const override;
+
+private:
+    void find_smallest();
+    
+    std::vector<std::unique_ptr<EntryIterator>> children_;
+    EntryIterator* current_;
+};
+
+} // namespace distributeddb
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "storage/entry_iterator.h"
+#include "storage/arena.h"
+#include "storage/skiplist.h"
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Sorted in-memory write buffer of an LSM tree, tombstones included, until it
+// is flushed to an SSTable. Backed by a lock-free skiplist over entries packed
+// into an arena, so writers never block each other or readers. Every write is
+// kept as its own (key, LSN) version; lookups and iterators see the newest.
+class MemTable {
+public:
+    explicit MemTable(uint64_t log_segment);
+    
+    // Thread-safe. Concurrent writers of one key resolve by LSN, so the result
+    // matches WAL order whatever order the inserts land in.
+    void add(BlockEntryType type, const std::string& key, const std::string& value, uint64_t lsn);
+    
+    // True if the key is present; type tells a value from a tombstone
+    bool get(const std::string& key, std::string& value, BlockEntryType& type) const;
+    
+    // Yields the newest version of each key; valid while the memtable lives
+    std::unique_ptr<EntryIterator> new_iterator() const;
+    
+    size_t approximate_memory() const { return memory_.load(std::memory_order_relaxed); }
+    
+    // Versions stored, counting overwrites
+    size_t entry_count() const { return entries_.load(std::memory_order_relaxed); }
+    bool empty() const { return entry_count() == 0; }
+    
+    // First WAL segment holding writes to this memtable
+    uint64_t log_segment() const { return log_segment_; }
+
+private:
+    // Orders packed entries by key, then newest LSN first
+    struct EntryComparator {
+        int operator()(const char* a, const char* b) const;
+    };
+    
+    using Table = SkipList<const char*, EntryComparator>;
+    
+    class Iterator;
+    
+    Arena arena_;
+    Table table_;
+    std::atomic<size_t> memory_;
+    std::atomic<size_t> entries_;
+    uint64_t log_segment_;
+};
+
+} // namespace distributeddb
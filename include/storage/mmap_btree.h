@@ -0,0 +1,203 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+namespace distributeddb {
+
+struct MmapBTreeOptions {
+    uint32_t page_size;
+    
+    // fdatasync pages and then the meta page on every commit
+    bool sync_on_commit;
+    
+    // Initial size of the read mapping; it doubles as the file grows
+    uint64_t initial_map_size;
+    
+    MmapBTreeOptions()
+        : page_size(4096), sync_on_commit(true), initial_map_size(64 * 1024 * 1024) {}
+};
+
+// Copy-on-write B+tree stored in a memory-mapped file, in the style of LMDB.
+// Each node is one page, the page-sized counterpart of BTreeNode in
+// storage/btree.h. A write transaction never modifies a committed page: it
+// copies every page on the path it changes, writes the copies to free pages,
+// and commits by writing a new meta page, alternating between the two meta
+// slots at the front of the file. The meta page is the atomic root flip.
+//
+// Readers take a snapshot (a root page plus the mapping) and search the
+// mapped pages in place without locks, so they never block the single writer
+// and the page cache does all caching. Pages a commit replaces are reused
+// only once no snapshot older than that commit remains. Opening a file reads
+// the two meta pages and nothing else.
+//
+// File layout, in pages:
+//   0, 1     meta: magic | version | page_size | txn_id | root | page_count |
+//            freelist_head | freelist_count | entry_count | crc32c
+//   leaf     u16 flags | u16 count | u32 0 | u64 0 | u16 slots[count] ... cells
+//            cell: u16 key_len | u8 flags | u32 value_len | key | value or u64 overflow page
+//   branch   u16 flags | u16 count | u32 0 | u64 leftmost child | slots ... cells
+//            cell: u16 key_len | u64 child | key; keys >= cell key go to its child
+//   overflow u16 flags | u16 0 | u32 page_count | u64 value_len | value bytes,
+//            running across page_count consecutive pages
+//   freelist u16 flags | u16 count | u32 0 | u64 next freelist page | u64 pages[count]
+class MmapBTree {
+public:
+    // One write in a batch
+    struct WriteOp {
+        bool is_delete = false;
+        std::string value;
+    };
+    using WriteBatch = std::map<std::string, WriteOp>;
+
+private:
+    struct Mapping;
+    struct ReaderTable;
+
+public:
+    // A consistent, read-only view of the tree as of one commit
+    class Snapshot {
+    public:
+        ~Snapshot();
+        uint64_t txn_id() const { return txn_id_; }
+        uint64_t entry_count() const { return entry_count_; }
+    
+    private:
+        friend class MmapBTree;
+        std::shared_ptr<Mapping> mapping_;
+        std::shared_ptr<ReaderTable> readers_;
+        uint64_t root_ = 0;
+        uint64_t txn_id_ = 0;
+        uint64_t entry_count_ = 0;
+    };
+    
+    explicit MmapBTree(const MmapBTreeOptions& options = MmapBTreeOptions());
+    ~MmapBTree();
+    
+    MmapBTree(const MmapBTree&) = delete;
+    MmapBTree& operator=(const MmapBTree&) = delete;
+    
+    // Open or create the file; O(1) in the size of the tree
+    bool open(const std::string& path);
+    void close();
+    
+    std::shared_ptr<const Snapshot> snapshot() const;
+    
+    bool get(const Snapshot& snapshot, const std::string& key, std::string& value) const;
+    
+    // Entries with start_key <= key < end_key, in key order
+    void scan(const Snapshot& snapshot, const std::string& start_key, const std::string& end_key,
+              size_t limit, std::vector<std::pair<std::string, std::string>>& out) const;
+    
+    // Apply a batch as one write transaction and commit it. Keys longer than
+    // max_key_size() are rejected. Thread-safe; writers are serialized.
+    bool apply(const WriteBatch& batch);
+    
+    size_t max_key_size() const;
+    
+    // Write a compact copy of the latest commit, every page full and no free space
+    bool copy_to(const std::string& path) const;
+    
+    // Rewrite the file compactly in place. Open snapshots keep reading the old file.
+    bool compact();
+    
+    // Replace the tree with a file written by copy_to
+    bool restore_from(const std::string& path);
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+
+private:
+    struct Meta {
+        uint64_t txn_id = 0;
+        uint64_t root = 0;              // 0 for an empty tree
+        uint64_t page_count = 2;
+        uint64_t freelist_head = 0;
+        uint64_t freelist_count = 0;
+        uint64_t entry_count = 0;
+    };
+    
+    // Decoded node, changed in memory during a write transaction
+    struct NodeValue {
+        std::string data;               // Inline value
+        uint64_t overflow_page = 0;     // First page of an overflow run, or 0
+        uint32_t size = 0;              // Value length
+    };
+    struct PageNode {
+        bool is_leaf = true;
+        std::vector<std::string> keys;
+        std::vector<NodeValue> values;      // Leaf only
+        std::vector<uint64_t> children;     // Branch only, keys.size() + 1
+    };
+    
+    MmapBTreeOptions options_;
+    std::string path_;
+    int fd_;
+    
+    // Guards meta_ and mapping_ for readers; snapshots register under it
+    mutable std::mutex state_mutex_;
+    Meta meta_;
+    std::shared_ptr<Mapping> mapping_;
+    std::shared_ptr<ReaderTable> readers_;
+    
+    // Writer state, guarded by write_mutex_
+    mutable std::mutex write_mutex_;
+    bool freelist_loaded_;
+    std::set<uint64_t> free_pages_;                         // Reusable now
+    std::map<uint64_t, std::vector<uint64_t>> pending_;     // Freed by commit txn, awaiting readers
+    std::vector<uint64_t> freelist_pages_;                  // Pages holding the committed freelist
+    
+    // Current write transaction
+    Meta txn_meta_;
+    std::unordered_map<uint64_t, std::unique_ptr<PageNode>> dirty_;
+    std::set<uint64_t> txn_allocated_;
+    std::vector<uint64_t> txn_freed_;
+    
+    // Statistics
+    uint64_t commit_count_;
+    uint64_t pages_written_;
+    
+    // Pages and mapping
+    const char* page(const Mapping& mapping, uint64_t pgno) const;
+    bool read_meta(int fd, Meta& meta) const;
+    bool write_meta(int fd, const Meta& meta) const;
+    bool ensure_mapping(uint64_t page_count);
+    bool reopen_locked();
+    size_t usable_size() const;
+    size_t max_cell_size() const;
+    
+    // Node encoding
+    PageNode decode_node(const char* data) const;
+    void encode_node(const PageNode& node, char* data) const;
+    size_t leaf_cell_size(const std::string& key, const NodeValue& value) const;
+    size_t branch_cell_size(const std::string& key) const;
+    size_t encoded_size(const PageNode& node) const;
+    bool read_value(const Mapping& mapping, const char* cell, std::string& value) const;
+    
+    // Write transaction
+    void begin_write();
+    void abort_write(const std::set<uint64_t>& saved_free);
+    uint64_t allocate(uint64_t count);
+    void free_page(uint64_t pgno);
+    void free_value(const NodeValue& value);
+    uint64_t touch(uint64_t pgno);
+    PageNode& node(uint64_t pgno) { return *dirty_.at(pgno); }
+    bool insert(const std::string& key, const std::string& data);
+    bool erase(const std::string& key);
+    void split_overflowing(std::vector<std::pair<uint64_t, size_t>>& path, uint64_t pgno);
+    void merge_underflowing(std::vector<std::pair<uint64_t, size_t>>& path, uint64_t pgno);
+    bool commit_write();
+    bool load_freelist();
+    void release_pending();
+    
+    void scan_page(const Mapping& mapping, uint64_t pgno, const std::string& start_key,
+                   const std::string& end_key, size_t limit,
+                   std::vector<std::pair<std::string, std::string>>& out) const;
+};
+
+} // namespace distributeddb
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+namespace distributeddb {
+
+struct MmapHashTableOptions {
+    // Address space reserved for the arena file; writes fail once it is full
+    uint64_t max_file_size;
+    
+    // Buckets in a new table; doubles whenever there are more keys than buckets
+    uint64_t initial_buckets;
+    
+    MmapHashTableOptions() : max_file_size(64ULL * 1024 * 1024 * 1024), initial_buckets(1 << 16) {}
+};
+
+// Chained hash table living in two memory-mapped files, so that a restart maps
+// them and checks a header instead of re-inserting every key.
+//
+// The arena file is an append-only sequence of records. Every put or delete
+// appends one, stamped with the LSN of its WAL record; a record is never
+// rewritten except for its chain link. The index file holds a header and the
+// bucket array. Buckets and chain links are file offsets into the arena, so
+// the mapping may land anywhere.
+//
+// Only a clean close marks the index trustworthy. After a crash the index is
+// rebuilt by scanning the arena up to its first torn record, and the caller
+// replays its WAL on top with replay(), which keeps whichever of the arena
+// and the WAL has the newer LSN for each key. A checkpoint syncs every
+// complete record so the WAL segments before it can be deleted.
+//
+// Concurrency follows ShardedTable: keys hash to one of STRIPES locks, which
+// callers take around get/put/remove.
+//
+// Index file: header page, then u64 bucket[bucket_count]
+//   header   magic | u32 version | u32 clean | bucket_count | entry_count |
+//            arena_end | live_bytes | max_lsn | u32 crc32c
+// Arena file: 64-byte header (magic | u32 version), then 8-byte aligned records
+//   record   u64 next | u32 crc32c | u8 type | 3 pad | u32 key_len | u32 value_len |
+//            u64 lsn | u64 hash | key | value; the CRC covers everything after it
+class MmapHashTable {
+public:
+    static constexpr size_t STRIPES = 256;
+    
+    struct alignas(64) Stripe {
+        mutable std::shared_mutex mutex;
+    };
+    
+    // Appends the WAL record for a change and stores its LSN; false if logging failed
+    using LogFunction = std::function<bool(uint64_t& lsn)>;
+    
+    explicit MmapHashTable(const MmapHashTableOptions& options = MmapHashTableOptions());
+    ~MmapHashTable();
+    
+    MmapHashTable(const MmapHashTable&) = delete;
+    MmapHashTable& operator=(const MmapHashTable&) = delete;
+    
+    // Map the files in dir, creating them if needed. After a clean close this
+    // only validates the header; otherwise it rebuilds the index from the arena.
+    bool open(const std::string& dir);
+    
+    // Sync everything and mark the index clean
+    void close();
+    
+    // Whether the last open could use the index as it was
+    bool opened_clean() const { return opened_clean_; }
+    
+    // Drop the index and rebuild it from the arena, as after a crash
+    bool rebuild();
+    
+    static uint64_t hash(const std::string& key);
+    
+    Stripe& stripe_for(uint64_t hash) { return stripes_[hash % STRIPES]; }
+    
+    // Caller holds the key's stripe lock, shared or exclusive
+    bool get(uint64_t hash, const std::string& key, std::string& value) const;
+    
+    // Caller holds the key's stripe lock exclusively. Space is taken first and
+    // then log is called, so a full arena fails before anything is logged.
+    bool put(uint64_t hash, const std::string& key, const std::string& value, const LogFunction& log);
+    bool remove(uint64_t hash, const std::string& key, const LogFunction& log);
+    
+    // Apply a WAL record during recovery unless the table already holds a
+    // newer change to the key. Single-threaded, before the table is shared.
+    bool replay(bool is_delete, const std::string& key, const std::string& value, uint64_t lsn);
+    
+    // Forget the deletes remembered for replay()
+    void finish_recovery();
+    
+    // Double the buckets if there are more keys than buckets. Takes every stripe lock.
+    void grow_if_needed();
+    
+    // Calls fn(key, value) for every entry, one stripe lock at a time; stops when fn returns false
+    void for_each(const std::function<bool(const std::string&, const std::string&)>& fn) const;
+    
+    // Make every record written so far durable. at_barrier runs while no
+    // change is in flight, e.g. to rotate the WAL: every change logged
+    // before it is covered by the sync.
+    bool checkpoint(const std::function<bool()>& at_barrier);
+    
+    // Rewrite the arena with only the live records. at_barrier runs once the
+    // old arena is durable and before it is replaced; every WAL record logged
+    // so far may then be discarded.
+    bool compact(const std::function<bool()>& at_barrier);
+    
+    // Dead bytes, and their share of the arena
+    uint64_t dead_bytes() const;
+    double dead_ratio() const;
+    
+    // Write a compact arena file with the live records to path
+    bool copy_to(const std::string& path) const;
+    
+    // Replace the contents with an arena written by copy_to
+    bool restore_from(const std::string& path);
+    
+    // Largest LSN in the table; the WAL must continue after it
+    uint64_t max_lsn() const { return max_lsn_; }
+    
+    size_t size() const { return entry_count_; }
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+
+private:
+    struct Record;
+    
+    MmapHashTableOptions options_;
+    std::string dir_;
+    bool is_open_;
+    bool opened_clean_;
+    
+    int index_fd_;
+    int arena_fd_;
+    char* index_;               // Reserved for the largest bucket array
+    char* arena_;               // Reserved for max_file_size
+    size_t index_reserved_;
+    
+    std::unique_ptr<Stripe[]> stripes_;
+    std::atomic<uint64_t> bucket_count_;    // Changes only with every stripe held
+    
+    // Arena space: records are placed at arena_end_ and the file grows ahead of it
+    mutable std::mutex arena_mutex_;
+    uint64_t arena_end_;
+    uint64_t arena_file_size_;
+    
+    std::atomic<uint64_t> entry_count_;
+    std::atomic<uint64_t> live_bytes_;
+    std::atomic<uint64_t> max_lsn_;
+    
+    // Latest delete LSN per key, from the arena scan, for replay()
+    std::unordered_map<std::string, uint64_t> recovered_deletes_;
+    
+    // Statistics
+    std::atomic<uint64_t> checkpoint_count_;
+    std::atomic<uint64_t> compaction_count_;
+    uint64_t last_open_us_;
+    uint64_t rebuilt_records_;
+    
+    std::string index_path() const { return dir_ + "/mmap_hash.idx"; }
+    std::string arena_path() const { return dir_ + "/mmap_hash.dat"; }
+    
+    uint64_t* buckets() const;
+    Record* record(uint64_t offset) const;
+    uint64_t find_link(uint64_t hash, const std::string& key, uint64_t*& slot) const;
+    
+    bool map_files();
+    void unmap_files();
+    bool create_files();
+    bool read_header();
+    bool write_header(bool clean);
+    bool set_bucket_count(uint64_t bucket_count);
+    bool double_buckets();
+    bool rebuild_locked();
+    
+    uint64_t allocate(uint64_t size);
+    uint64_t append(uint8_t type, uint64_t hash, const std::string& key, const std::string& value);
+    void publish(uint64_t offset, uint64_t lsn);
+    void discard(uint64_t offset);
+    void link(uint64_t offset);
+    
+    void lock_all() const;
+    void unlock_all() const;
+    
+    // Sequential arena image with the live records
+    bool write_arena(const std::string& path, uint64_t& records) const;
+};
+
+} // namespace distributeddb
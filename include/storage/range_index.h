@@ -0,0 +1,129 @@
+#pragma once
+
+#include "storage/btree.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace distributeddb {
+
+struct RangeIndexOptions {
+    // A range is split in two once it holds more keys than this, or sees more
+    // operations per second than split_ops
+    uint64_t split_keys;
+    uint64_t split_ops;
+    
+    // Neighbours that both see fewer operations per second than merge_ops are
+    // merged if the result holds at most split_keys / 2 keys
+    uint64_t merge_ops;
+    
+    // How often load is measured and ranges are split and merged
+    uint32_t rebalance_interval_ms;
+    
+    RangeIndexOptions()
+        : split_keys(64 * 1024), split_ops(20000), merge_ops(100), rebalance_interval_ms(1000) {}
+};
+
+// The ordered key set of a hash-partitioned table, for scans. Keys are split
+// into contiguous ranges, each a BTree with its own lock and arena, so a hot
+// range serializes only its own writers. rebalance() measures each range's
+// load and splits ranges that grew too large or too busy at their median
+// key, and merges neighbours that went cold. A split or merge builds the new
+// ranges while holding only the old one's lock, then swaps them into the
+// range list and marks the old one retired; anyone who locked a retired
+// range looks it up again.
+//
+// Only keys are kept: the table stays the home of values, and its shard lock
+// is held while a key enters or leaves so the two never disagree.
+class RangeIndex {
+public:
+    explicit RangeIndex(const RangeIndexOptions& options = RangeIndexOptions());
+    
+    RangeIndex(const RangeIndex&) = delete;
+    RangeIndex& operator=(const RangeIndex&) = delete;
+    
+    // A key entered or left the table
+    void insert(const std::string& key);
+    void remove(const std::string& key);
+    
+    // A key already present was written; counts toward its range's load only
+    void touch(const std::string& key);
+    
+    // Replace the contents with keys, given in any order, in ranges half the split size
+    void rebuild(std::vector<std::string> keys);
+    
+    // Add keys, sorted and unique, as a batch. Only the ranges they fall into
+    // are rebuilt, in ranges half the split size; the rest are left alone.
+    void insert_sorted(const std::vector<std::string>& keys);
+    
+    // Keys with start_key <= key < end_key, in order
+    std::vector<std::string> scan(const std::string& start_key, const std::string& end_key, size_t limit) const;
+    
+    // Measure load since the last call, then split and merge. One caller at a time.
+    void rebalance();
+    
+    struct RangeLoad {
+        std::string start;          // Smallest key the range may hold; empty for the first
+        size_t keys;
+        size_t memory_bytes;
+        uint64_t ops_per_sec;       // Over the last rebalance interval
+    };
+    
+    // Every range in key order
+    std::vector<RangeLoad> load() const;
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+    
+private:
+    // Ranges can be small after a split for load, so their arenas grow in small steps
+    static constexpr size_t ARENA_BLOCK_SIZE = 32 * 1024;
+    
+    struct Range {
+        explicit Range(std::string first)
+            : start(std::move(first)), keys(ARENA_BLOCK_SIZE), retired(false), ops(0), ops_per_sec(0) {}
+        
+        const std::string start;
+        mutable std::shared_mutex mutex;
+        BTree<std::string, uint8_t> keys;           // Guarded by mutex
+        bool retired;                               // Guarded by mutex
+        mutable std::atomic<uint64_t> ops;          // Since the last rebalance
+        std::atomic<uint64_t> ops_per_sec;
+    };
+    using RangePtr = std::shared_ptr<Range>;
+    
+    RangeIndexOptions options_;
+    
+    // Guards the list itself; held exclusively only to swap ranges in and out
+    mutable std::shared_mutex layout_mutex_;
+    std::vector<RangePtr> ranges_;                  // By start; the first starts at ""
+    
+    std::mutex rebalance_mutex_;
+    std::chrono::steady_clock::time_point last_rebalance_;
+    
+    std::atomic<uint64_t> splits_;
+    std::atomic<uint64_t> merges_;
+    
+    // The range key belongs to and, unless it is the last, where the next begins
+    RangePtr locate(const std::string& key, std::string* next_start = nullptr, bool* last = nullptr) const;
+    
+    // A range starting at start holding keys[from, to), which must be sorted
+    static RangePtr build(const std::string& start, const std::vector<std::string>& keys, size_t from, size_t to,
+                          uint64_t ops_per_sec);
+    
+    static std::vector<std::string> keys_of(const Range& range);
+    
+    // Replace ranges_[index, index + count) with replacements and retire them;
+    // the callers hold the old ranges' locks
+    void swap_in(size_t index, size_t count, std::vector<RangePtr> replacements);
+    
+    bool split(size_t index);
+    bool merge(size_t index);
+};
+
+} // namespace distributeddb
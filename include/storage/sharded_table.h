@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <map>
+#include <unordered_set>
+#include <functional>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Hash-partitioned key/value table with one reader-writer lock per shard.
+// Writers to different shards never contend, and a checkpointer can walk the
+// table one shard at a time instead of stopping the world.
+class ShardedTable {
+public:
+    // Where a deleted range ends, exclusive, and the LSN of the newest delete covering it
+    struct DroppedRange {
+        std::string end;
+        uint64_t lsn;
+    };
+    
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, std::string> data;
+        std::unordered_set<std::string> dirty; // Keys changed since the last checkpoint
+        std::unordered_map<std::string, uint64_t> expires; // Expiry time of keys given a TTL, ms since the epoch
+        
+        // Deleted ranges whose keys are still in data, by start and disjoint.
+        // A key in one is hidden unless rewritten records a later write to it.
+        std::map<std::string, DroppedRange> dropped;
+        std::unordered_map<std::string, uint64_t> rewritten;   // LSN of each write into a dropped range
+    };
+    
+    explicit ShardedTable(size_t shard_count = 256);
+    
+    size_t shard_count() const { return shards_.size(); }
+    
+    Shard& shard(size_t index) { return *shards_[index]; }
+    const Shard& shard(size_t index) const { return *shards_[index]; }
+    
+    size_t shard_index(const std::string& key) const {
+        return hasher_(key) % shards_.size();
+    }
+    
+    Shard& shard_for(const std::string& key) { return *shards_[shard_index(key)]; }
+    
+    // Total number of keys, taking each shard lock in turn
+    size_t size() const;
+    
+    // Dirty tracking feeds delta checkpoints; off by default
+    void set_dirty_tracking(bool enabled) { track_dirty_ = enabled; }
+    bool dirty_tracking() const { return track_dirty_; }
+    
+    // Caller holds the shard's exclusive lock
+    void mark_dirty(Shard& shard, const std::string& key) {
+        if (track_dirty_) {
+            shard.dirty.insert(key);
+        }
+    }
+    
+    // Whether a deleted range still pending in the shard hides key. Caller holds the shard lock.
+    static bool is_dropped(const Shard& shard, const std::string& key) {
+        if (shard.dropped.empty()) {
+            return false;
+        }
+        const DroppedRange* range = covering(shard, key);
+        if (range == nullptr) {
+            return false;
+        }
+        auto write = shard.rewritten.find(key);
+        return write == shard.rewritten.end() || write->second < range->lsn;
+    }
+    
+    // The pending range holding key, if any. Caller holds the shard lock.
+    static const DroppedRange* covering(const Shard& shard, const std::string& key);
+    
+    // Record a delete of [start, end) at lsn, which is newer than every range
+    // already in the shard. Shard lock held exclusively.
+    static void add_dropped(Shard& shard, const std::string& start, const std::string& end, uint64_t lsn);
+    
+    // Record a write to key at lsn, so a range deleted before it does not hide
+    // it. Shard lock held exclusively.
+    static void note_write(Shard& shard, const std::string& key, uint64_t lsn) {
+        if (!shard.dropped.empty() && covering(shard, key) != nullptr) {
+            shard.rewritten[key] = lsn;
+        }
+    }
+    
+    // Forget the ranges deleted at or before lsn once their keys are erased.
+    // Shard lock held exclusively.
+    static void remove_dropped_through(Shard& shard, uint64_t lsn);
+    
+    // Take the entries a pending range hides out of a copy of the shard's data
+    static void remove_dropped(const Shard& shard, std::vector<std::pair<std::string, std::string>>& entries);
+    
+    // Number of dirty keys across all shards
+    size_t dirty_count() const;
+    
+    // Remove every key
+    void clear();
+
+private:
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::hash<std::string> hasher_;
+    bool track_dirty_;
+};
+
+} // namespace distributeddb
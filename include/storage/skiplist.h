@@ -0,0 +1,207 @@
+#pragma once
+
+#include "storage/arena.h"
+#include <atomic>
+#include <new>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Lock-free, insert-only skiplist. Any number of threads may insert, look up
+// and iterate at the same time without locks: a node is fully built before a
+// CAS publishes it on level 0, and the upper levels are only shortcuts, so a
+// reader never observes a half-linked node. Nodes live in an Arena and are
+// never removed; callers model deletion with tombstone keys.
+//
+// Comparator: int operator()(const Key& a, const Key& b) const, returning
+// <0, 0 or >0. Keys must be unique; inserting an equal key fails.
+template<typename Key, class Comparator>
+class SkipList {
+private:
+    struct Node;
+
+public:
+    SkipList(Comparator compare, Arena* arena);
+    
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+    
+    // Thread-safe. Returns false if an equal key is already present.
+    bool insert(const Key& key);
+    
+    bool contains(const Key& key) const;
+    
+    // Forward iterator; safe to use while other threads insert. Entries
+    // inserted behind the cursor are not seen, entries ahead may be.
+    class Iterator {
+    public:
+        explicit Iterator(const SkipList* list) : list_(list), node_(nullptr) {}
+        
+        bool valid() const { return node_ != nullptr; }
+        const Key& key() const { return node_->key; }
+        void next() { node_ = node_->next(0); }
+        
+        // Position at the first entry >= target
+        void seek(const Key& target) { node_ = list_->find_greater_or_equal(target); }
+        void seek_to_first() { node_ = list_->head_->next(0); }
+    
+    private:
+        const SkipList* list_;
+        Node* node_;
+    };
+
+private:
+    static constexpr int MAX_HEIGHT = 12;
+    static constexpr unsigned BRANCHING = 4;
+    
+    struct Node {
+        explicit Node(const Key& k) : key(k) {}
+        
+        Key key;
+        
+        Node* next(int level) const { return next_[level].load(std::memory_order_acquire); }
+        void set_next_relaxed(int level, Node* node) { next_[level].store(node, std::memory_order_relaxed); }
+        bool cas_next(int level, Node* expected, Node* node) {
+            return next_[level].compare_exchange_strong(expected, node, std::memory_order_release,
+                                                        std::memory_order_relaxed);
+        }
+        
+        // Array of length height; the node is allocated with room for it
+        std::atomic<Node*> next_[1];
+    };
+    
+    Node* new_node(const Key& key, int height);
+    int random_height();
+    
+    // On one level, starting from before: find the pair with before.key < key <= after.key.
+    // Returns false if after.key equals key.
+    bool find_splice(const Key& key, Node* before, int level, Node** out_prev, Node** out_next) const;
+    
+    Node* find_greater_or_equal(const Key& key) const;
+    
+    Comparator compare_;
+    Arena* arena_;
+    Node* head_;
+    std::atomic<int> max_height_;
+};
+
+template<typename Key, class Comparator>
+SkipList<Key, Comparator>::SkipList(Comparator compare, Arena* arena)
+    : compare_(compare), arena_(arena), head_(new_node(Key(), MAX_HEIGHT)), max_height_(1) {
+    for (int level = 0; level < MAX_HEIGHT; ++level) {
+        head_->set_next_relaxed(level, nullptr);
+    }
+}
+
+template<typename Key, class Comparator>
+typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::new_node(const Key& key, int height) {
+    size_t bytes = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+    char* memory = arena_->allocate(bytes);
+    Node* node = new (memory) Node(key);
+    for (int level = 1; level < height; ++level) {
+        new (&node->next_[level]) std::atomic<Node*>(nullptr);
+    }
+    return node;
+}
+
+template<typename Key, class Comparator>
+int SkipList<Key, Comparator>::random_height() {
+    // Per-thread xorshift, so concurrent inserts do not share RNG state
+    thread_local uint64_t state = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<uintptr_t>(&state);
+    int height = 1;
+    while (height < MAX_HEIGHT) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if (state % BRANCHING != 0) break;
+        height++;
+    }
+    return height;
+}
+
+template<typename Key, class Comparator>
+bool SkipList<Key, Comparator>::find_splice(const Key& key, Node* before, int level,
+                                            Node** out_prev, Node** out_next) const {
+    while (true) {
+        Node* after = before->next(level);
+        if (after == nullptr) {
+            *out_prev = before;
+            *out_next = nullptr;
+            return true;
+        }
+        int cmp = compare_(after->key, key);
+        if (cmp >= 0) {
+            *out_prev = before;
+            *out_next = after;
+            return cmp != 0;
+        }
+        before = after;
+    }
+}
+
+template<typename Key, class Comparator>
+bool SkipList<Key, Comparator>::insert(const Key& key) {
+    int height = random_height();
+    
+    // Raise the list height first so the search below covers our levels
+    int max_height = max_height_.load(std::memory_order_relaxed);
+    while (height > max_height) {
+        if (max_height_.compare_exchange_weak(max_height, height)) {
+            max_height = height;
+            break;
+        }
+    }
+    
+    Node* prev[MAX_HEIGHT];
+    Node* next[MAX_HEIGHT];
+    Node* before = head_;
+    for (int level = max_height - 1; level >= 0; --level) {
+        if (!find_splice(key, before, level, &prev[level], &next[level])) {
+            return false;
+        }
+        before = prev[level];
+    }
+    
+    Node* node = new_node(key, height);
+    
+    // Link bottom-up. Level 0 is the commit point; a failed CAS means a
+    // concurrent insert landed in our gap, so search again from prev.
+    for (int level = 0; level < height; ++level) {
+        while (true) {
+            node->set_next_relaxed(level, next[level]);
+            if (prev[level]->cas_next(level, next[level], node)) {
+                break;
+            }
+            if (!find_splice(key, prev[level], level, &prev[level], &next[level]) && level == 0) {
+                // Lost a race with an equal key; the node stays unreachable in the arena
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+template<typename Key, class Comparator>
+typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::find_greater_or_equal(const Key& key) const {
+    Node* node = head_;
+    int level = max_height_.load(std::memory_order_relaxed) - 1;
+    while (true) {
+        Node* next = node->next(level);
+        if (next != nullptr && compare_(next->key, key) < 0) {
+            node = next;
+        } else if (level == 0) {
+            return next;
+        } else {
+            level--;
+        }
+    }
+}
+
+template<typename Key, class Comparator>
+bool SkipList<Key, Comparator>::contains(const Key& key) const {
+    Node* node = find_greater_or_equal(key);
+    return node != nullptr && compare_(node->key, key) == 0;
+}
+
+} // namespace distributeddb
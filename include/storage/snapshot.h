@@ -0,0 +1,90 @@
+#pragma once
+
+#include "storage/block_file.h"
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Snapshot file header
+struct SnapshotHeader {
+    uint64_t wal_segment;   // First WAL segment recovery has to read
+    uint64_t start_lsn;     // WAL position when the snapshot started
+    uint64_t base_lsn;      // start_lsn of the full snapshot a delta applies to, 0 if full
+    uint64_t entry_count;
+    
+    // Key ranges [first, second) a delta deletes before applying its entries
+    std::vector<std::pair<std::string, std::string>> deleted_ranges;
+    
+    SnapshotHeader() : wal_segment(0), start_lsn(0), base_lsn(0), entry_count(0) {}
+    
+    bool is_delta() const { return base_lsn != 0; }
+};
+
+// Writes an image of the key space as a block file. The image may be fuzzy:
+// entries can reflect writes made after start_lsn, and recovery replays the WAL
+// from start_lsn to bring every key to its final value.
+// The file is built under a temporary name and renamed into place by finish(),
+// so a crash mid-write never replaces a good snapshot with a partial one.
+class SnapshotWriter {
+public:
+    SnapshotWriter(const std::string& path, const BlockFileOptions& options = BlockFileOptions());
+    
+    // Start a snapshot; replay resumes at start_lsn, found in wal_segment or later.
+    // A non-zero base_lsn makes this a delta on top of that full snapshot.
+    bool open(uint64_t wal_segment, uint64_t start_lsn, uint64_t base_lsn = 0);
+    
+    // Append an entry
+    bool add(const std::string& key, const std::string& value);
+    
+    // Append an entry that expires at expire_ms, in milliseconds since the epoch
+    bool add_expiring(const std::string& key, const std::string& value, uint64_t expire_ms);
+    
+    // Record that key was deleted since the previous snapshot in the chain
+    bool add_tombstone(const std::string& key);
+    
+    // Record that every key in [start, end) was deleted; recovery drops them
+    // from the chain before this delta's own entries are applied
+    void add_range_tombstone(const std::string& start, const std::string& end);
+    
+    // Write the index and footer, fsync and atomically publish the file
+    bool finish();
+    
+    // Discard a partially written snapshot
+    void abort();
+    
+    uint64_t get_entry_count() const { return writer_.get_entry_count(); }
+    uint64_t get_file_size() const { return writer_.get_file_size(); }
+
+private:
+    BlockFileWriter writer_;
+    BlockFileProperties properties_;
+};
+
+// PUT_TTL entries, and WAL records of the same name, hold the expiry time
+// as 8 bytes ahead of the value
+std::string encode_expiring_value(const std::string& value, uint64_t expire_ms);
+
+// Strip the expiry time off an encoded value; false if it is too short
+bool decode_expiring_value(std::string& value, uint64_t& expire_ms);
+
+// Reads snapshots written by SnapshotWriter
+class SnapshotReader {
+public:
+    using EntryCallback = std::function<void(BlockEntryType type, std::string&& key, std::string&& value)>;
+    
+    // Read only the header, e.g. to check which chain a delta belongs to
+    static bool read_header(const std::string& path, SnapshotHeader& header);
+    
+    // Stream every entry to on_entry, decoding blocks on up to `threads`
+    // threads; on_entry must be thread-safe when threads > 1. Returns false if
+    // the file is missing or any block fails its checksum; entries already
+    // delivered should then be discarded.
+    static bool load(const std::string& path, SnapshotHeader& header,
+                     const EntryCallback& on_entry, size_t threads = 1);
+};
+
+} // namespace distributeddb
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "storage/block_file.h"
+#include "storage/bloom_filter.h"
+#include "storage/entry_iterator.h"
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Immutable sorted run of an LSM tree, stored in the block file format with a
+// bloom filter over its keys kept in the index
+class SSTableBuilder {
+public:
+    SSTableBuilder(const std::string& path, const BlockFileOptions& options, size_t bloom_bits_per_key);
+    
+    bool open();
+    
+    // Keys must be added in strictly increasing order
+    bool add(BlockEntryType type, const std::string& key, const std::string& value);
+    
+    bool finish();
+    void abort();
+    
+    uint64_t entry_count() const { return writer_.get_entry_count(); }
+    uint64_t file_size() const { return writer_.get_file_size(); }
+
+private:
+    BlockFileWriter writer_;
+    BloomFilterBuilder filter_;
+};
+
+class SSTable : public std::enable_shared_from_this<SSTable> {
+public:
+    SSTable(uint64_t number, const std::string& path);
+    ~SSTable();
+    
+    SSTable(const SSTable&) = delete;
+    SSTable& operator=(const SSTable&) = delete;
+    
+    // Open the file and check that it is sorted
+    bool open();
+    
+    // Point lookup. Returns true if the key is in this table; type tells a
+    // value from a tombstone. A bloom filter miss avoids touching the disk.
+    bool get(const std::string& key, std::string& value, BlockEntryType& type) const;
+    
+    // The iterator keeps the table alive; the table must be owned by a shared_ptr
+    std::unique_ptr<EntryIterator> new_iterator() const;
+    
+    uint64_t number() const { return number_; }
+    const std::string& path() const { return path_; }
+    uint64_t file_size() const { return reader_.file_size(); }
+    uint64_t entry_count() const { return reader_.properties().entry_count; }
+    const std::string& smallest_key() const { return smallest_; }
+    const std::string& largest_key() const { return largest_; }
+    
+    // True if [smallest, largest] overlaps [begin, end] (inclusive)
+    bool overlaps(const std::string& begin, const std::string& end) const {
+        return !(largest_ < begin || end < smallest_);
+    }
+    
+    // Delete the file once the last reader lets go of the table
+    void mark_obsolete() { obsolete_ = true; }
+    
+    // Lookups answered by the bloom filter alone
+    uint64_t filter_negatives() const { return filter_negatives_.load(std::memory_order_relaxed); }
+    
+    const BlockFileReader& reader() const { return reader_; }
+
+private:
+    uint64_t number_;
+    std::string path_;
+    BlockFileReader reader_;
+    std::string smallest_;
+    std::string largest_;
+    std::atomic<bool> obsolete_;
+    mutable std::atomic<uint64_t> filter_negatives_;
+};
+
+} // namespace distributeddb
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "storage/sharded_table.h"
+#include "storage/value_log.h"
+#include "storage/value_compressor.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+
+namespace distributeddb {
+
+struct TierOptions {
+    // Bytes of values kept in memory; 0 keeps every value resident
+    uint64_t memory_budget;
+    
+    // Smaller values stay resident: their stub would cost about as much
+    uint64_t min_spill_size;
+    
+    // Segment size and collection threshold of the spill files
+    ValueLogOptions spill_log;
+    
+    // Cold values at least this large are compressed in memory, and only
+    // spilled once they go cold again; 0 turns compression off. Values
+    // untouched for compress_interval_ms are compressed even within budget.
+    uint64_t compress_min_size;
+    uint32_t compress_level;   // zlib level, 1 (fastest) to 9 (smallest)
+    uint32_t compress_interval_ms;
+    
+    // Bytes of sampled values that prime compression; 0 for none
+    size_t compress_dictionary_size;
+    
+    TierOptions()
+        : memory_budget(0), min_spill_size(256), compress_min_size(0), compress_level(6),
+          compress_interval_ms(10000), compress_dictionary_size(16 * 1024) {}
+};
+
+// Keeps the values of a ShardedTable within a memory budget by moving cold
+// ones to disk. A spilled value is appended to a ValueLog used as scratch
+// space, and its entry in the table is left holding an empty stub; the key
+// itself stays resident. Reading a stub faults the value back in.
+//
+// Cold values are picked by CLOCK. Each shard has a bitmap of reference
+// bits indexed by key hash, set without a lock on every access; a sweep
+// walks the shard's hash buckets from where it last stopped, clears the
+// bit of a recently used key and spills a key whose bit is already clear.
+// Keys sharing a bit protect each other, which costs some precision but no
+// per-key memory.
+//
+// With compression on, a cold value is first compressed in place; it is
+// spilled only if it is found cold again. Compressed entries are listed per
+// shard, and reading one decompresses it and puts the value back as it was.
+//
+// The spill files and compressed forms only describe the running process:
+// spill files are wiped on open, and checkpoints and backups write every
+// value in full. Every
+// method that takes a shard index expects the caller to hold that shard's
+// lock as noted; the others take the locks they need.
+class TierManager {
+public:
+    static constexpr size_t REFERENCE_BITS = 1 << 16;
+    
+    TierManager(ShardedTable& table, const TierOptions& options);
+    ~TierManager();
+    
+    TierManager(const TierManager&) = delete;
+    TierManager& operator=(const TierManager&) = delete;
+    
+    // Start with an empty spill directory
+    bool open(const std::string& dir);
+    
+    // Remove the spill files; every stub must have been resolved or dropped
+    void close();
+    
+    // Mark a key as recently used. Any shard lock mode.
+    void touch(size_t shard, const std::string& key) const;
+    
+    // A read found key's value resident; counts toward the hit ratio
+    void hit(size_t shard, const std::string& key) const;
+    
+    // What a spilled or compressed entry held when it was read, so that
+    // promote can tell whether it changed since
+    struct PackedEntry {
+        std::string stored;
+        bool spilled = false;
+        ValuePointer pointer;
+    };
+    
+    // The location of key's value if its entry is a stub. Any shard lock mode.
+    const ValuePointer* find_spilled(size_t shard, const std::string& key) const;
+    
+    // Whether key's entry, holding stored, is a stub or compressed rather
+    // than the value itself. Any shard lock mode.
+    bool is_packed(size_t shard, const std::string& key, const std::string& stored) const;
+    
+    // Replace stored, key's entry, with the value it stands for if it is a
+    // stub or compressed; false only if the value could not be read. The
+    // shard lock, in any mode, keeps spill segments from being collected.
+    bool resolve(size_t shard, const std::string& key, std::string& stored) const;
+    
+    // resolve, remembering in from what the entry was for promote. Any shard lock mode.
+    bool unpack(size_t shard, const std::string& key, std::string& stored, PackedEntry& from) const;
+    
+    // Record that key's entry went from old_size to new_size bytes, dropping
+    // the spilled or compressed form it had. Shard lock held exclusively.
+    void changed(size_t shard, const std::string& key, size_t old_size, size_t new_size);
+    
+    // Put a value read by unpack back into the table as it is, unless the
+    // key changed meanwhile. Takes the shard lock.
+    void promote(size_t shard, const std::string& key, std::string stored, const PackedEntry& from);
+    
+    bool over_budget() const { return budget_ > 0 && resident_bytes_ > budget_; }
+    bool compressing() const { return compress_min_size_ > 0; }
+    
+    // Compress or spill from one shard until bytes are freed or a full sweep
+    // finds nothing more. Shard lock held exclusively. Returns the bytes freed.
+    uint64_t evict(size_t shard, uint64_t bytes);
+    
+    // Compress the values no read or write touched since the previous call,
+    // one shard lock at a time
+    void compress_cold();
+    
+    // Evict round-robin over the shards until the budget holds. One thread
+    // evicts at a time; others return at once and the budget may be
+    // overshot by the writes in flight.
+    void enforce_budget();
+    
+    // Forget every spilled value and recount what is resident, after the
+    // table's data was replaced wholesale. Every shard lock held.
+    void reset();
+    
+    // Move the live records out of spill segments at least min_dead_ratio
+    // dead and delete them. Nothing may read the spill files without a
+    // shard lock meanwhile, e.g. a fork checkpoint child.
+    bool collect(double min_dead_ratio);
+    
+    // Close the active spill segment so collect can reclaim all of it
+    bool rotate() { return spill_.rotate(); }
+    
+    // Taken before fork() so the child can read spilled values
+    std::shared_lock<std::shared_mutex> hold_spill_segments() const { return spill_.hold_segments(); }
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+    
+private:
+    // Sizes of a compressed value; size 0 marks one that did not compress,
+    // which is not tried again until it changes
+    struct Compressed {
+        uint32_t raw_size;
+        uint32_t size;
+    };
+    
+    struct alignas(64) ShardState {
+        std::unique_ptr<std::atomic<uint64_t>[]> referenced;
+        std::unordered_map<std::string, ValuePointer> spilled;
+        std::unordered_map<std::string, Compressed> compressed;
+        size_t hand = 0;                        // Next bucket the sweep visits
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+    
+    ShardedTable& table_;
+    uint64_t budget_;
+    uint64_t min_spill_size_;
+    uint64_t compress_min_size_;
+    ValueLog spill_;
+    ValueCompressor compressor_;
+    std::string dir_;
+    std::unique_ptr<ShardState[]> states_;
+    std::hash<std::string> hasher_;
+    
+    std::atomic<uint64_t> resident_bytes_;
+    std::atomic<uint64_t> spilled_keys_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> promotions_;
+    mutable std::atomic<uint64_t> spill_errors_;
+    std::atomic<uint64_t> compressed_keys_;
+    std::atomic<uint64_t> compressed_bytes_;
+    std::atomic<uint64_t> compressed_raw_bytes_;
+    
+    std::mutex evict_mutex_;
+    size_t shard_hand_;                         // Guarded by evict_mutex_
+    
+    bool read(const ValuePointer& pointer, const std::string& key, std::string& stored) const;
+    bool test_and_clear(ShardState& state, const std::string& key);
+    void forget(ShardState& state, const std::string& key);
+    void forget_compressed(ShardState& state, const std::string& key);
+    bool is_compressed(const ShardState& state, const std::string& key) const;
+    
+    // Walk up to `buckets` buckets of a shard from its hand, compressing and,
+    // if spill is set, spilling cold values until bytes are freed
+    uint64_t sweep(size_t shard, uint64_t bytes, size_t buckets, bool spill);
+    bool collect_segment(uint64_t segment);
+};
+
+} // namespace distributeddb
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Hierarchical timing wheel of key expiry times, so that finding the keys due
+// never walks the key space. Level 0 has one slot per tick; each higher level
+// has slots SLOTS times as wide. A timer goes into the lowest level whose span
+// reaches it and is re-placed one level down whenever the wheel reaches its
+// slot there, so every timer moves at most LEVELS times. Timers beyond the
+// top level wait in an overflow list that is re-placed once per top-level lap.
+//
+// Timers cannot be cancelled. The owner keeps the authoritative expiry time
+// per key and ignores a due timer that no longer matches it.
+class TimingWheel {
+public:
+    static constexpr size_t LEVELS = 4;
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1 << SLOT_BITS;
+    
+    struct Timer {
+        std::string key;
+        uint64_t expire_ms;     // Milliseconds since the epoch
+    };
+    
+    explicit TimingWheel(uint64_t tick_ms = 10);
+    
+    // Drop every timer and start counting ticks at now_ms
+    void reset(uint64_t now_ms);
+    
+    void schedule(const std::string& key, uint64_t expire_ms);
+    
+    // Hand out at most max_timers timers due by now_ms; the rest of those due
+    // are handed out by the next calls. Returns the number added to due.
+    size_t advance(uint64_t now_ms, std::vector<Timer>& due, size_t max_timers);
+    
+    // Timers scheduled and not yet handed out
+    size_t size() const;
+    
+private:
+    mutable std::mutex mutex_;
+    uint64_t tick_ms_;
+    uint64_t current_tick_;
+    size_t count_;
+    
+    std::vector<Timer> slots_[LEVELS][SLOTS];
+    std::vector<Timer> overflow_;
+    std::vector<Timer> ready_;      // Due, waiting to be handed out
+    
+    void place(Timer&& timer);
+};
+
+} // namespace distributeddb
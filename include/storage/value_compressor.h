@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+
+namespace distributeddb {
+
+// Compresses individual values with zlib. Small values compress poorly on
+// their own, so once enough of them have been seen their leading bytes are
+// kept as a preset dictionary that primes every later stream. The dictionary
+// exists only in memory: compressed values never leave the process, and each
+// run builds its own. A compressed value records whether it used it.
+//
+// Streams are kept per thread and reset between values, so compress and
+// decompress are safe to call concurrently and allocate nothing but output.
+class ValueCompressor {
+public:
+    // dictionary_size of 0 compresses every value on its own
+    ValueCompressor(int level, size_t dictionary_size);
+    
+    // False in builds without zlib
+    static bool supported();
+    
+    // Compress value into packed; false if that would not save at least 1/8
+    bool compress(const std::string& value, std::string& packed);
+    
+    bool decompress(const std::string& packed, std::string& value) const;
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+    
+private:
+    int level_;
+    size_t dictionary_size_;
+    
+    // Leading bytes of the values seen so far; becomes the dictionary once full
+    std::mutex sample_mutex_;
+    std::string samples_;
+    std::atomic<bool> dictionary_ready_;
+    std::string dictionary_;                    // Immutable once dictionary_ready_
+    
+    std::atomic<uint64_t> compressions_;
+    std::atomic<uint64_t> compress_ns_;
+    mutable std::atomic<uint64_t> decompressions_;
+    mutable std::atomic<uint64_t> decompress_ns_;
+    
+    void sample(const std::string& value);
+};
+
+} // namespace distributeddb
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+namespace distributeddb {
+
+struct ValueLogOptions {
+    // The active segment is closed and a new one started past this size
+    uint64_t segment_size;
+    
+    // Collect a closed segment once this fraction of it is dead
+    double gc_dead_ratio;
+    
+    // How often the collector looks for such a segment
+    uint32_t gc_check_interval_ms;
+    
+    // fdatasync the active segment after every append
+    bool sync_writes;
+    
+    ValueLogOptions()
+        : segment_size(64 * 1024 * 1024), gc_dead_ratio(0.5), gc_check_interval_ms(1000),
+          sync_writes(false) {}
+};
+
+// Location of one value in the log
+struct ValuePointer {
+    uint64_t segment = 0;
+    uint64_t offset = 0;    // Start of the record
+    uint32_t size = 0;      // Value length
+};
+
+// Append-only log holding values kept out of an index, as in WiscKey. The
+// index stores a ValuePointer instead of the value, so rehashing, snapshots
+// and compaction of the index never move the value bytes. The log is a run
+// of segment files vlog_<id>.log; only the newest one is appended to.
+//
+// The log does not know which records are live, the index does. The owner
+// reports each record it starts or stops referencing through mark_live and
+// mark_dead, which drive the per-segment dead-space figures a collector uses
+// to pick segments; the collector then re-appends the still-referenced values
+// and removes the segment.
+//
+// Record: u32 crc32c | u32 key_len | u32 value_len | key | value
+// The CRC covers everything after it. The key lets reads verify they found
+// the right record and lets the collector ask the index about each one.
+class ValueLog {
+public:
+    explicit ValueLog(const ValueLogOptions& options = ValueLogOptions());
+    ~ValueLog();
+    
+    ValueLog(const ValueLog&) = delete;
+    ValueLog& operator=(const ValueLog&) = delete;
+    
+    // Open the segments in dir, creating it if needed, and start a new active
+    // segment. Every segment starts with no live bytes.
+    bool open(const std::string& dir);
+    void close();
+    
+    // Append a record to the active segment; it counts as live
+    bool append(const std::string& key, const std::string& value, ValuePointer& pointer);
+    
+    // Read and verify the value a pointer refers to
+    bool read(const ValuePointer& pointer, const std::string& key, std::string& value) const;
+    
+    // Space accounting for the records the owner references
+    void mark_live(const std::string& key, const ValuePointer& pointer);
+    void mark_dead(const std::string& key, const ValuePointer& pointer);
+    
+    // The closed segment with the largest dead fraction, if that fraction is
+    // at least min_dead_ratio and some bytes are dead; 0 if there is none
+    uint64_t pick_segment(double min_dead_ratio) const;
+    
+    // Visit every record of a closed segment front to back, stopping at a
+    // torn tail. Returning false from the callback stops the walk and fails it.
+    bool for_each(uint64_t segment,
+                  const std::function<bool(const std::string& key, const std::string& value,
+                                           const ValuePointer& pointer)>& fn) const;
+    
+    // Unlink a segment; its records must no longer be referenced
+    bool remove_segment(uint64_t segment);
+    
+    // Close the active segment and start a new one
+    bool rotate();
+    
+    // fdatasync the active segment
+    bool sync();
+    
+    // Copy a segment file written elsewhere into the log as a closed segment
+    // under a fresh id, which is returned; 0 on failure
+    uint64_t import_segment(const std::string& path);
+    
+    std::vector<uint64_t> list_segments() const;
+    uint64_t active_segment() const;
+    std::string segment_path(uint64_t segment) const;
+    
+    // Segment id from a file name written by this log, or 0
+    static uint64_t parse_segment_name(const std::string& name);
+    
+    std::unordered_map<std::string, std::string> get_stats() const;
+    
+    // While held no segment is opened or removed, so a process forked under
+    // it never inherits segments_mutex_ held exclusively by another thread
+    std::shared_lock<std::shared_mutex> hold_segments() const {
+        return std::shared_lock<std::shared_mutex>(segments_mutex_);
+    }
+
+private:
+    // One segment, pinned by readers for the length of a read so a removal
+    // never closes the descriptor under them
+    struct Segment {
+        uint64_t id;
+        std::string path;
+        int fd;
+        std::atomic<uint64_t> size;
+        std::atomic<uint64_t> live_bytes;
+        
+        Segment(uint64_t segment_id, std::string segment_path, int segment_fd, uint64_t segment_size)
+            : id(segment_id), path(std::move(segment_path)), fd(segment_fd), size(segment_size),
+              live_bytes(0) {}
+        ~Segment();
+    };
+    
+    ValueLogOptions options_;
+    std::string dir_;
+    
+    // Guards segments_
+    mutable std::shared_mutex segments_mutex_;
+    std::map<uint64_t, std::shared_ptr<Segment>> segments_;
+    
+    // Serializes appends, rotation and imports
+    std::mutex append_mutex_;
+    std::shared_ptr<Segment> active_;
+    std::atomic<uint64_t> active_id_;
+    uint64_t next_segment_;
+    
+    std::atomic<uint64_t> removed_segments_;
+    std::atomic<uint64_t> removed_bytes_;
+    
+    std::shared_ptr<Segment> pin(uint64_t segment) const;
+    std::shared_ptr<Segment> open_segment(uint64_t segment, bool create);
+    bool rotate_locked();
+};
+
+} // namespace distributeddb
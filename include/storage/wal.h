@@ -15,12 +15,24 @@ enum class WALRecordType : uint8_t {
     PUT = 1,
     DELETE = 2,
     COMMIT = 3,
-    CHECKPOINT = 4
+    CHECKPOINT = 4,
+    PUT_TTL = 5,    // PUT whose value is prefixed with its expiry time
+    EXPIRE = 6,     // Batch of keys removed because their time ran out
+    BULK_LOAD = 7,      // Keys of the bulk files named by key, one per line, entered the table
+    DELETE_RANGE = 8    // Every key from key up to, not including, value was deleted
 };
 
+// Every segment starts with WAL_SEGMENT_MAGIC and the format version of its
+// records. Segments without the header come from before it existed and hold
+// version 1 records, which have no LSN; the reader numbers those itself.
+constexpr uint32_t WAL_SEGMENT_MAGIC = 0x4C415744;   // "DWAL"
+constexpr uint32_t WAL_FORMAT_VERSION = 2;
+constexpr size_t WAL_SEGMENT_HEADER_SIZE = 8;
+
 // WAL record structure
 struct WALRecord {
     WALRecordType type;
+    uint64_t lsn;           // Log sequence number, assigned on append
     uint64_t timestamp;
     uint32_t key_length;
     uint32_t value_length;
@@ -28,14 +40,14 @@ struct WALRecord {
     std::string value;
     uint64_t transaction_id;
     
-    WALRecord() : type(WALRecordType::PUT), timestamp(0), key_length(0), 
+    WALRecord() : type(WALRecordType::PUT), lsn(0), timestamp(0), key_length(0), 
                   value_length(0), transaction_id(0) {}
     
     // Serialize record to bytes
     std::vector<uint8_t> serialize() const;
     
-    // Deserialize record from bytes
-    static WALRecord deserialize(const std::vector<uint8_t>& data);
+    // Deserialize record from bytes in the given format version
+    static WALRecord deserialize(const std::vector<uint8_t>& data, uint32_t format = WAL_FORMAT_VERSION);
     
     // Get record size
     size_t size() const;
@@ -44,11 +56,12 @@ struct WALRecord {
 // Write-Ahead Log implementation
 class WriteAheadLog {
 public:
+    // Throws std::runtime_error if a segment was written in a newer format
     explicit WriteAheadLog(const std::string& log_dir);
     ~WriteAheadLog();
     
-    // Append a record to the log
-    bool append_record(const WALRecord& record);
+    // Append a record to the log; the LSN it was given is stored in assigned_lsn
+    bool append_record(const WALRecord& record, uint64_t* assigned_lsn = nullptr);
     
     // Read all records from the log
     std::vector<WALRecord> read_all_records();
@@ -67,6 +80,40 @@ public:
     
     // Flush log to disk
     void flush();
+    
+    // Close the current segment and start appending to a new one
+    bool rotate_segment();
+    
+    // Sequence number of the segment currently being appended to
+    uint64_t current_segment() const;
+    
+    // Read records from all segments with id >= first_segment, oldest first
+    std::vector<WALRecord> read_records_from(uint64_t first_segment);
+    
+    // Delete segments older than segment_id (they are covered by a snapshot)
+    size_t remove_segments_before(uint64_t segment_id);
+    
+    // LSN the next appended record will receive
+    uint64_t next_lsn() const;
+    
+    // Continue numbering at lsn or later, e.g. when the LSNs in use are
+    // recorded outside the log and its segments have been deleted
+    void advance_lsn(uint64_t lsn);
+    
+    // Segment ids present in the log directory, sorted ascending
+    std::vector<uint64_t> list_segments() const;
+    
+    // Path of a segment file, whether or not it exists
+    std::string segment_path(uint64_t segment_id) const;
+    
+    // Read one segment file, stopping at the first torn or corrupt record.
+    // Version 1 records are numbered on from the last record in records.
+    // Throws std::runtime_error for a format version newer than this build's.
+    static void read_segment(const std::string& path, std::vector<WALRecord>& records);
+    
+    // Monotonic append counters, used to drive checkpoint scheduling
+    uint64_t get_total_records() const;
+    uint64_t get_total_bytes() const;
 
 private:
     std::string log_dir_;
@@ -75,10 +122,16 @@ private:
     mutable std::mutex mutex_;
     uint64_t total_records_;
     uint64_t total_bytes_;
+    uint64_t current_segment_;
+    uint64_t next_lsn_;
     
     // Open new log file
     bool open_new_log_file();
     
+    // Format version of a segment; leaves in positioned at its first record
+    static uint32_t read_segment_header(std::ifstream& in, const std::string& path);
+    static uint32_t segment_format(const std::string& path);
+    
     // Get current timestamp
     uint64_t get_current_timestamp() const;
     
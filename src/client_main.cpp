@@ -1,17 +1,24 @@
 #include "network/client.h"
 #include <iostream>
 #include <string>
+#include <vector>
 #include <chrono>
 
 void print_usage() {
-    std::cout << "Usage: distributeddb_client <host> <port> <command> [args...]" << std::endl;
+    std::cout << "Usage: distributeddb_client <host> <port> [--namespace ID] <command> [args...]" << std::endl;
     std::cout << "Commands:" << std::endl;
     std::cout << "  get <key>                    - Get value for key" << std::endl;
-    std::cout << "  put <key> <value>          - Put key-value pair" << std::endl;
+    std::cout << "  put <key> <value> [ttl_ms]   - Put key-value pair, expiring after ttl_ms" << std::endl;
     std::cout << "  del <key>                    - Delete key" << std::endl;
+    std::cout << "  del-range <start_key> <end_key> - Delete every key in range" << std::endl;
     std::cout << "  scan <start_key> <end_key>   - Scan keys in range" << std::endl;
     std::cout << "  ping                         - Ping server" << std::endl;
     std::cout << "  benchmark <num_operations>   - Run performance benchmark" << std::endl;
+    std::cout << "  backup <dir>                 - Stream snapshot and WAL files into dir" << std::endl;
+    std::cout << "  bulk-load <path>             - Load a sorted key<TAB>value file from the server's import dir" << std::endl;
+    std::cout << "  ingest <path>...             - Copy sorted block files from the server's import dir into the store" << std::endl;
+    std::cout << "  drop-namespace <id>          - Delete a namespace and all its keys" << std::endl;
+    std::cout << "  truncate-namespace <id>      - Delete every key in a namespace" << std::endl;
 }
 
 void run_benchmark(distributeddb::DatabaseClient& client, int num_operations) {
@@ -63,6 +70,12 @@ int main(int argc, char* argv[]) {
     
     std::string host = argv[1];
     uint16_t port = static_cast<uint16_t>(std::stoi(argv[2]));
+    uint32_t namespace_id = 0;
+    if (argc >= 6 && std::string(argv[3]) == "--namespace") {
+        namespace_id = static_cast<uint32_t>(std::stoul(argv[4]));
+        argv += 2;
+        argc -= 2;
+    }
     std::string command = argv[3];
     
     try {
@@ -72,6 +85,7 @@ int main(int argc, char* argv[]) {
             std::cerr << "Failed to connect to server" << std::endl;
             return 1;
         }
+        client.use_namespace(namespace_id);
         
         if (command == "get" && argc >= 5) {
             std::string key = argv[4];
@@ -81,7 +95,8 @@ int main(int argc, char* argv[]) {
         } else if (command == "put" && argc >= 6) {
             std::string key = argv[4];
             std::string value = argv[5];
-            bool success = client.put(key, value);
+            uint64_t ttl_ms = argc >= 7 ? std::stoull(argv[6]) : 0;
+            bool success = client.put(key, value, ttl_ms);
             std::cout << (success ? "OK" : "ERROR") << std::endl;
             
         } else if (command == "del" && argc >= 5) {
@@ -89,6 +104,10 @@ int main(int argc, char* argv[]) {
             bool success = client.del(key);
             std::cout << (success ? "OK" : "ERROR") << std::endl;
             
+        } else if (command == "del-range" && argc >= 6) {
+            bool success = client.del_range(argv[4], argv[5]);
+            std::cout << (success ? "OK" : "ERROR") << std::endl;
+            
         } else if (command == "scan" && argc >= 6) {
             std::string start_key = argv[4];
             std::string end_key = argv[5];
@@ -111,6 +130,39 @@ int main(int argc, char* argv[]) {
             int num_operations = std::stoi(argv[4]);
             run_benchmark(client, num_operations);
             
+        } else if (command == "backup" && argc >= 5) {
+            std::string target_dir = argv[4];
+            auto start = std::chrono::high_resolution_clock::now();
+            uint64_t bytes = client.backup(target_dir);
+            auto end = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+            std::cout << "Backed up " << bytes << " bytes to " << target_dir
+                      << " in " << duration.count() << " ms" << std::endl;
+            
+        } else if (command == "bulk-load" && argc >= 5) {
+            std::string path = argv[4];
+            auto start = std::chrono::high_resolution_clock::now();
+            uint64_t entries = client.bulk_load(path);
+            auto end = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+            std::cout << "Loaded " << entries << " keys from " << path
+                      << " in " << duration.count() << " ms" << std::endl;
+            
+        } else if (command == "ingest" && argc >= 5) {
+            std::vector<std::string> paths(argv + 4, argv + argc);
+            auto start = std::chrono::high_resolution_clock::now();
+            uint64_t entries = client.ingest(paths);
+            auto end = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+            std::cout << "Ingested " << entries << " keys from " << paths.size() << " files"
+                      << " in " << duration.count() << " ms" << std::endl;
+            
+        } else if ((command == "drop-namespace" || command == "truncate-namespace") && argc >= 5) {
+            uint32_t target = static_cast<uint32_t>(std::stoul(argv[4]));
+            bool success = command == "drop-namespace" ? client.drop_namespace(target)
+                                                       : client.truncate_namespace(target);
+            std::cout << (success ? "OK" : "ERROR") << std::endl;
+            
         } else {
             print_usage();
             return 1;
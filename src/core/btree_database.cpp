@@ -0,0 +1,267 @@
+#include "core/btree_database.h"
+#include <iostream>
+#include <filesystem>
+#include <map>
+
+namespace distributeddb {
+
+class BTreeTransaction : public Transaction {
+public:
+    BTreeTransaction(BTreeDatabase& db, uint64_t id) : db_(db), id_(id) {}
+    
+    std::string get(const std::string& key) override {
+        auto it = writes_.find(key);
+        if (it != writes_.end()) {
+            return it->second.is_delete ? "" : it->second.value;
+        }
+        
+        std::string value;
+        const MmapBTree::Snapshot* view = snapshot();
+        return view != nullptr && db_.tree_.get(*view, key, value) ? value : "";
+    }
+    
+    OperationResult put(const std::string& key, const std::string& value) override {
+        if (key.size() > db_.tree_.max_key_size()) {
+            return OperationResult::SYSTEM_ERROR;
+        }
+        
+        MmapBTree::WriteOp& op = writes_[key];
+        op.is_delete = false;
+        op.value = value;
+        return OperationResult::SUCCESS;
+    }
+    
+    OperationResult del(const std::string& key) override {
+        auto it = writes_.find(key);
+        std::string value;
+        const MmapBTree::Snapshot* view = snapshot();
+        bool exists = it != writes_.end() ? !it->second.is_delete
+                                          : view != nullptr && db_.tree_.get(*view, key, value);
+        if (!exists) {
+            return OperationResult::KEY_NOT_FOUND;
+        }
+        
+        MmapBTree::WriteOp& op = writes_[key];
+        op.is_delete = true;
+        op.value.clear();
+        return OperationResult::SUCCESS;
+    }
+    
+    std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key,
+                                                          const std::string& end_key,
+                                                          size_t limit) override {
+        // Each buffered delete can hide one snapshot entry, so read that many extra
+        auto first = writes_.lower_bound(start_key);
+        auto last = writes_.lower_bound(end_key);
+        size_t hidden = 0;
+        for (auto it = first; it != last; ++it) {
+            hidden += it->second.is_delete ? 1 : 0;
+        }
+        
+        std::vector<std::pair<std::string, std::string>> entries;
+        const MmapBTree::Snapshot* view = snapshot();
+        if (view != nullptr) {
+            db_.tree_.scan(*view, start_key, end_key, limit + hidden, entries);
+        }
+        if (first == last) {
+            if (entries.size() > limit) {
+                entries.resize(limit);
+            }
+            return entries;
+        }
+        
+        std::map<std::string, std::string> merged(entries.begin(), entries.end());
+        for (auto it = first; it != last; ++it) {
+            if (it->second.is_delete) {
+                merged.erase(it->first);
+            } else {
+                merged[it->first] = it->second.value;
+            }
+        }
+        
+        std::vector<std::pair<std::string, std::string>> result;
+        for (auto& entry : merged) {
+            if (result.size() >= limit) break;
+            result.emplace_back(entry.first, std::move(entry.second));
+        }
+        return result;
+    }
+    
+    OperationResult commit() override {
+        if (!writes_.empty()) {
+            if (!db_.tree_.apply(writes_)) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+            writes_.clear();
+        }
+        
+        // Later reads see the new commit
+        snapshot_.reset();
+        return OperationResult::SUCCESS;
+    }
+    
+    void rollback() override {
+        writes_.clear();
+        std::cout << "Transaction " << id_ << " rolled back" << std::endl;
+    }
+    
+    uint64_t get_id() const override {
+        return id_;
+    }
+
+private:
+    // Pinned on first read and held until commit, so reads are repeatable.
+    // Null once the database is shut down.
+    const MmapBTree::Snapshot* snapshot() {
+        if (!snapshot_) {
+            snapshot_ = db_.tree_.snapshot();
+        }
+        return snapshot_.get();
+    }
+    
+    BTreeDatabase& db_;
+    uint64_t id_;
+    std::shared_ptr<const MmapBTree::Snapshot> snapshot_;
+    MmapBTree::WriteBatch writes_;
+};
+
+BTreeDatabase::BTreeDatabase(const MmapBTreeOptions& options)
+    : initialized_(false), next_transaction_id_(1), next_stream_id_(1), tree_(options) {
+}
+
+BTreeDatabase::~BTreeDatabase() {
+    shutdown();
+}
+
+OperationResult BTreeDatabase::initialize(const std::string& data_dir) {
+    data_dir_ = data_dir;
+    std::error_code ec;
+    std::filesystem::create_directories(data_dir_, ec);
+    if (ec) {
+        std::cerr << "Failed to create data directory " << data_dir_ << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Leftovers of an interrupted copy, compaction or restore
+    for (const char* suffix : {".tmp", ".compact", ".compact.tmp", ".restore"}) {
+        std::filesystem::remove(tree_path() + suffix, ec);
+    }
+    
+    if (!tree_.open(tree_path())) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    initialized_ = true;
+    std::cout << "B+tree database initialized with data directory: " << data_dir_ << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+void BTreeDatabase::shutdown() {
+    if (!initialized_) {
+        return;
+    }
+    
+    // Every commit is already on disk; there is nothing to flush
+    tree_.close();
+    std::cout << "B+tree database shutting down..." << std::endl;
+    initialized_ = false;
+}
+
+std::shared_ptr<Transaction> BTreeDatabase::begin_transaction() {
+    if (!initialized_) {
+        return nullptr;
+    }
+    
+    uint64_t id = next_transaction_id_++;
+    return std::make_shared<BTreeTransaction>(*this, id);
+}
+
+std::unordered_map<std::string, std::string> BTreeDatabase::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    stats["engine"] = "btree";
+    stats["data_directory"] = data_dir_;
+    stats["initialized"] = initialized_ ? "true" : "false";
+    stats["next_transaction_id"] = std::to_string(next_transaction_id_);
+    
+    if (!initialized_) {
+        return stats;
+    }
+    
+    for (const auto& [key, value] : tree_.get_stats()) {
+        stats["btree_" + key] = value;
+    }
+    stats["total_keys"] = stats["btree_entries"];
+    return stats;
+}
+
+OperationResult BTreeDatabase::compact() {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    return tree_.compact() ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult BTreeDatabase::backup(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::error_code ec;
+    std::filesystem::create_directories(backup_path, ec);
+    if (ec) {
+        std::cerr << "Failed to create backup directory " << backup_path << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // A snapshot copy; the writer carries on meanwhile
+    if (!tree_.copy_to(backup_path + "/btree.db")) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::cout << "B+tree backup written to " << backup_path << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+OperationResult BTreeDatabase::restore(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    if (!tree_.restore_from(backup_path + "/btree.db")) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::cout << "B+tree database restored from " << backup_path << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+OperationResult BTreeDatabase::freeze_backup_files(BackupFileSet& file_set) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    file_set.staging_dir = data_dir_ + "/backup-stream-" + std::to_string(next_stream_id_++);
+    file_set.files.clear();
+    if (backup(file_set.staging_dir) != OperationResult::SUCCESS) {
+        release_backup_files(file_set);
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    file_set.files.push_back({file_set.staging_dir + "/btree.db", "btree.db"});
+    return OperationResult::SUCCESS;
+}
+
+void BTreeDatabase::release_backup_files(const BackupFileSet& file_set) {
+    if (file_set.staging_dir.empty()) {
+        return;
+    }
+    
+    std::error_code ec;
+    std::filesystem::remove_all(file_set.staging_dir, ec);
+}
+
+std::shared_ptr<Database> DatabaseFactory::create_btree_database() {
+    return std::make_shared<BTreeDatabase>();
+}
+
+} // namespace distributeddb
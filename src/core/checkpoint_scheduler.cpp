@@ -0,0 +1,131 @@
+#include "core/checkpoint_scheduler.h"
+#include <iostream>
+
+namespace distributeddb {
+
+CheckpointScheduler::CheckpointScheduler(const CheckpointPolicy& policy,
+                                         ProgressFunction progress,
+                                         CheckpointFunction checkpoint)
+    : policy_(policy), progress_(std::move(progress)), checkpoint_(std::move(checkpoint)),
+      running_(false), base_bytes_(0), base_records_(0),
+      last_checkpoint_(std::chrono::steady_clock::now()),
+      checkpoints_completed_(0), checkpoints_failed_(0), last_duration_ms_(0) {
+    auto [bytes, records] = progress_();
+    base_bytes_ = bytes;
+    base_records_ = records;
+}
+
+CheckpointScheduler::~CheckpointScheduler() {
+    stop();
+}
+
+void CheckpointScheduler::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    
+    running_ = true;
+    thread_ = std::thread([this]() { scheduler_loop(); });
+}
+
+void CheckpointScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    condition_.notify_all();
+    
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool CheckpointScheduler::run_now(const std::string& reason) {
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    
+    // Anything appended after this point is not guaranteed to be in the snapshot
+    auto [bytes, records] = progress_();
+    auto start = std::chrono::steady_clock::now();
+    
+    bool ok = checkpoint_();
+    
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ok) {
+        base_bytes_ = bytes;
+        base_records_ = records;
+        last_checkpoint_ = start;
+        checkpoints_completed_++;
+    } else {
+        checkpoints_failed_++;
+    }
+    last_duration_ms_ = static_cast<uint64_t>(duration.count());
+    last_reason_ = reason;
+    
+    return ok;
+}
+
+bool CheckpointScheduler::run_exclusive(const std::function<bool()>& fn) {
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    return fn();
+}
+
+std::unordered_map<std::string, std::string> CheckpointScheduler::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    std::unordered_map<std::string, std::string> stats;
+    stats["completed"] = std::to_string(checkpoints_completed_);
+    stats["failed"] = std::to_string(checkpoints_failed_);
+    stats["last_duration_ms"] = std::to_string(last_duration_ms_);
+    stats["last_reason"] = last_reason_;
+    stats["seconds_since_last"] = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - last_checkpoint_).count());
+    
+    return stats;
+}
+
+void CheckpointScheduler::scheduler_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    while (running_) {
+        condition_.wait_for(lock, policy_.poll_interval, [this]() { return !running_; });
+        if (!running_) break;
+        
+        std::string reason = due_reason();
+        if (reason.empty()) continue;
+        
+        lock.unlock();
+        if (!run_now(reason)) {
+            std::cerr << "Scheduled checkpoint failed (" << reason << ")" << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+std::string CheckpointScheduler::due_reason() {
+    auto [bytes, records] = progress_();
+    
+    // Counters went backwards (log truncated elsewhere), restart the window
+    if (bytes < base_bytes_ || records < base_records_) {
+        base_bytes_ = bytes;
+        base_records_ = records;
+    }
+    
+    if (policy_.wal_bytes_threshold > 0 && bytes - base_bytes_ >= policy_.wal_bytes_threshold) {
+        return "wal_bytes";
+    }
+    if (policy_.wal_records_threshold > 0 && records - base_records_ >= policy_.wal_records_threshold) {
+        return "wal_records";
+    }
+    
+    // Only checkpoint on time when there is something new to cover
+    if (policy_.interval.count() > 0 && records != base_records_ &&
+        std::chrono::steady_clock::now() - last_checkpoint_ >= policy_.interval) {
+        return "interval";
+    }
+    
+    return "";
+}
+
+} // namespace distributeddb
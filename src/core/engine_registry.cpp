@@ -0,0 +1,323 @@
+#include "core/engine_registry.h"
+#include "core/persistent_database.h"
+#include "core/lsm_database.h"
+#include "core/bitcask_database.h"
+#include "core/btree_database.h"
+#include "core/mmap_hash_database.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+namespace distributeddb {
+
+namespace {
+
+void read_block_format(EngineOptionReader& reader, const std::string& prefix, BlockFileOptions& format) {
+    reader.read(prefix + "block_size", format.block_size);
+    
+    std::string compression;
+    reader.read(prefix + "compression", compression);
+    if (compression == "zlib") {
+        format.compression = BlockCompression::ZLIB;
+    } else if (compression == "none") {
+        format.compression = BlockCompression::NONE;
+    } else if (!compression.empty()) {
+        reader.fail("unknown " + prefix + "compression '" + compression + "' (none or zlib)");
+    }
+    if (!block_compression_supported(format.compression)) {
+        reader.fail(prefix + "compression=zlib needs a build with zlib");
+    }
+}
+
+std::shared_ptr<Database> create_hash_engine(const EngineOptions& options, std::string& error) {
+    PersistentDatabaseOptions settings;
+    EngineOptionReader reader(options);
+    
+    std::string mode;
+    reader.read("checkpoint_mode", mode);
+    if (mode == "fork") {
+        settings.checkpoint_mode = CheckpointMode::FORK;
+    } else if (mode == "fuzzy") {
+        settings.checkpoint_mode = CheckpointMode::FUZZY;
+    } else if (!mode.empty()) {
+        reader.fail("unknown checkpoint_mode '" + mode + "' (fuzzy or fork)");
+    }
+    
+    uint64_t interval = static_cast<uint64_t>(settings.checkpoint.interval.count());
+    reader.read("checkpoint_wal_bytes", settings.checkpoint.wal_bytes_threshold);
+    reader.read("checkpoint_wal_records", settings.checkpoint.wal_records_threshold);
+    reader.read("checkpoint_interval_s", interval);
+    settings.checkpoint.interval = std::chrono::seconds(interval);
+    
+    reader.read("shard_count", settings.shard_count);
+    reader.read("checkpoint_fork_timeout_ms", settings.fork_timeout_ms);
+    reader.read("max_delta_chain", settings.max_delta_chain);
+    reader.read("recovery_threads", settings.recovery_threads);
+    reader.read("backup_partitions", settings.backup_partitions);
+    read_block_format(reader, "snapshot_", settings.snapshot_format);
+    
+    reader.read("value_separation_threshold", settings.value_separation_threshold);
+    reader.read("value_log_segment_size", settings.value_log.segment_size);
+    reader.read("value_log_gc_ratio", settings.value_log.gc_dead_ratio);
+    reader.read("value_log_gc_interval_ms", settings.value_log.gc_check_interval_ms);
+    reader.read("value_log_sync_writes", settings.value_log.sync_writes);
+    
+    reader.read("memory_budget", settings.tiering.memory_budget);
+    reader.read("spill_min_value_size", settings.tiering.min_spill_size);
+    reader.read("spill_segment_size", settings.tiering.spill_log.segment_size);
+    reader.read("spill_gc_ratio", settings.tiering.spill_log.gc_dead_ratio);
+    reader.read("compress_min_value_size", settings.tiering.compress_min_size);
+    reader.read("compress_level", settings.tiering.compress_level);
+    reader.read("compress_interval_ms", settings.tiering.compress_interval_ms);
+    reader.read("compress_dictionary_size", settings.tiering.compress_dictionary_size);
+    
+    reader.read("expiry_interval_ms", settings.expiry_interval_ms);
+    reader.read("expiry_budget", settings.expiry_budget);
+    
+    reader.read("ordered_index", settings.ordered_index);
+    reader.read("range_split_keys", settings.ranges.split_keys);
+    reader.read("range_split_ops", settings.ranges.split_ops);
+    reader.read("range_merge_ops", settings.ranges.merge_ops);
+    reader.read("range_rebalance_interval_ms", settings.ranges.rebalance_interval_ms);
+    
+    if (!reader.finish(error)) {
+        return nullptr;
+    }
+    return std::make_shared<PersistentDatabase>(settings);
+}
+
+std::shared_ptr<Database> create_lsm_engine(const EngineOptions& options, std::string& error) {
+    LSMDatabaseOptions settings;
+    EngineOptionReader reader(options);
+    
+    reader.read("memtable_size", settings.memtable_size);
+    reader.read("max_immutable_memtables", settings.max_immutable_memtables);
+    reader.read("level0_compaction_trigger", settings.level0_compaction_trigger);
+    reader.read("level0_stop_writes", settings.level0_stop_writes);
+    reader.read("level1_max_bytes", settings.level1_max_bytes);
+    reader.read("level_size_multiplier", settings.level_size_multiplier);
+    reader.read("max_levels", settings.max_levels);
+    reader.read("target_file_size", settings.target_file_size);
+    reader.read("bloom_bits_per_key", settings.bloom_bits_per_key);
+    read_block_format(reader, "table_", settings.table_format);
+    
+    if (!reader.finish(error)) {
+        return nullptr;
+    }
+    return std::make_shared<LSMDatabase>(settings);
+}
+
+std::shared_ptr<Database> create_bitcask_engine(const EngineOptions& options, std::string& error) {
+    BitcaskOptions settings;
+    EngineOptionReader reader(options);
+    
+    reader.read("max_file_size", settings.max_file_size);
+    reader.read("merge_dead_ratio", settings.merge_dead_ratio);
+    reader.read("merge_min_dead_bytes", settings.merge_min_dead_bytes);
+    reader.read("merge_check_interval_ms", settings.merge_check_interval_ms);
+    reader.read("sync_writes", settings.sync_writes);
+    reader.read("keydir_shards", settings.keydir_shards);
+    reader.read("recovery_threads", settings.recovery_threads);
+    
+    if (!reader.finish(error)) {
+        return nullptr;
+    }
+    return std::make_shared<BitcaskDatabase>(settings);
+}
+
+std::shared_ptr<Database> create_btree_engine(const EngineOptions& options, std::string& error) {
+    MmapBTreeOptions settings;
+    EngineOptionReader reader(options);
+    
+    reader.read("page_size", settings.page_size);
+    reader.read("sync_on_commit", settings.sync_on_commit);
+    reader.read("initial_map_size", settings.initial_map_size);
+    
+    if (!reader.finish(error)) {
+        return nullptr;
+    }
+    return std::make_shared<BTreeDatabase>(settings);
+}
+
+std::shared_ptr<Database> create_mmap_hash_engine(const EngineOptions& options, std::string& error) {
+    MmapHashDatabaseOptions settings;
+    EngineOptionReader reader(options);
+    
+    uint64_t interval = static_cast<uint64_t>(settings.checkpoint.interval.count());
+    reader.read("checkpoint_wal_bytes", settings.checkpoint.wal_bytes_threshold);
+    reader.read("checkpoint_wal_records", settings.checkpoint.wal_records_threshold);
+    reader.read("checkpoint_interval_s", interval);
+    settings.checkpoint.interval = std::chrono::seconds(interval);
+    
+    reader.read("max_file_size", settings.table.max_file_size);
+    reader.read("initial_buckets", settings.table.initial_buckets);
+    reader.read("compact_dead_ratio", settings.compact_dead_ratio);
+    reader.read("compact_min_dead_bytes", settings.compact_min_dead_bytes);
+    
+    if (!reader.finish(error)) {
+        return nullptr;
+    }
+    return std::make_shared<MmapHashDatabase>(settings);
+}
+
+} // namespace
+
+EngineRegistry& EngineRegistry::instance() {
+    static EngineRegistry registry;
+    return registry;
+}
+
+EngineRegistry::EngineRegistry() {
+    register_engine("hash", "In-memory hash table made durable by a WAL and snapshots", create_hash_engine);
+    register_engine("lsm", "Log-structured merge tree for data sets larger than memory", create_lsm_engine);
+    register_engine("bitcask", "Log-structured hash keeping only keys in memory", create_bitcask_engine);
+    register_engine("btree", "Copy-on-write B+tree in a memory-mapped file", create_btree_engine);
+    register_engine("mmap_hash", "Hash table in memory-mapped files, restarted without reloading",
+                    create_mmap_hash_engine);
+}
+
+bool EngineRegistry::register_engine(const std::string& name, const std::string& description,
+                                     EngineFactory factory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return engines_.emplace(name, Engine{description, std::move(factory)}).second;
+}
+
+std::shared_ptr<Database> EngineRegistry::create(const std::string& name, const EngineOptions& options,
+                                                 std::string& error) const {
+    EngineFactory factory;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = engines_.find(name);
+        if (it == engines_.end()) {
+            error = "unknown engine '" + name + "'";
+            return nullptr;
+        }
+        factory = it->second.factory;
+    }
+    
+    auto database = factory(options, error);
+    if (!database && error.empty()) {
+        error = "engine '" + name + "' could not be created";
+    }
+    return database;
+}
+
+bool EngineRegistry::contains(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return engines_.count(name) > 0;
+}
+
+std::vector<std::string> EngineRegistry::engine_names() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (const auto& [name, engine] : engines_) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+std::string EngineRegistry::description(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = engines_.find(name);
+    return it == engines_.end() ? std::string() : it->second.description;
+}
+
+void EngineOptionReader::fail(const std::string& message) {
+    errors_ += errors_.empty() ? message : "; " + message;
+}
+
+bool EngineOptionReader::finish(std::string& error) const {
+    std::vector<std::string> unknown;
+    for (const auto& [name, value] : options_) {
+        if (std::find(used_.begin(), used_.end(), name) == used_.end()) {
+            unknown.push_back(name);
+        }
+    }
+    std::sort(unknown.begin(), unknown.end());
+    
+    error = errors_;
+    for (const auto& name : unknown) {
+        error += (error.empty() ? "unknown option " : "; unknown option ") + name;
+    }
+    return error.empty();
+}
+
+bool EngineOptionReader::take(const std::string& name, std::string& text) {
+    used_.push_back(name);
+    auto it = options_.find(name);
+    if (it == options_.end()) {
+        return false;
+    }
+    text = it->second;
+    return true;
+}
+
+bool EngineOptionReader::parse_bool(const std::string& text, bool& value) {
+    if (text == "true" || text == "1") {
+        value = true;
+    } else if (text == "false" || text == "0") {
+        value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool EngineOptionReader::parse_double(const std::string& text, double& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtod(text.c_str(), &end);
+    return errno == 0 && *end == '\0' && value >= 0.0;
+}
+
+bool EngineOptionReader::parse_unsigned(const std::string& text, uint64_t& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text.c_str(), &end, 10);
+    if (errno != 0) {
+        return false;
+    }
+    
+    int shift = 0;
+    switch (std::tolower(static_cast<unsigned char>(*end))) {
+        case '\0': return true;
+        case 'k': shift = 10; break;
+        case 'm': shift = 20; break;
+        case 'g': shift = 30; break;
+        default: return false;
+    }
+    if (end[1] != '\0' || value > (std::numeric_limits<uint64_t>::max() >> shift)) {
+        return false;
+    }
+    value <<= shift;
+    return true;
+}
+
+bool parse_engine_option(const std::string& argument, EngineOptions& options) {
+    size_t equals = argument.find('=');
+    if (equals == 0 || equals == std::string::npos) {
+        return false;
+    }
+    options[argument.substr(0, equals)] = argument.substr(equals + 1);
+    return true;
+}
+
+std::shared_ptr<Database> DatabaseFactory::create_database(const std::string& engine_name,
+                                                           const EngineOptions& options) {
+    std::string error;
+    auto database = EngineRegistry::instance().create(engine_name, options, error);
+    if (!database) {
+        std::cerr << "Cannot create " << engine_name << " database: " << error << std::endl;
+    }
+    return database;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,30 @@
+#include "core/import_paths.h"
+#include <filesystem>
+
+namespace distributeddb {
+
+std::string resolve_import_paths(const std::string& import_dir, std::vector<std::string>& paths) {
+    if (import_dir.empty()) {
+        return "Imports are disabled; start the server with --import-dir";
+    }
+    
+    for (auto& path : paths) {
+        std::filesystem::path full(path);
+        if (full.is_relative()) {
+            full = std::filesystem::path(import_dir) / full;
+        }
+        // One answer for both failures, so clients cannot probe for files
+        // outside the directory
+        std::error_code ec;
+        auto resolved = std::filesystem::canonical(full, ec);
+        auto relative = resolved.lexically_relative(import_dir);
+        if (ec || relative.empty() || *relative.begin() == ".." ||
+            !std::filesystem::is_regular_file(resolved, ec)) {
+            return "Not a file in the import directory: " + path;
+        }
+        path = resolved.string();
+    }
+    return "";
+}
+
+} // namespace distributeddb
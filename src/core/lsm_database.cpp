@@ -0,0 +1,1259 @@
+#include "core/lsm_database.h"
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+namespace distributeddb {
+
+namespace {
+
+const char* const MANIFEST_TMP_SUFFIX = ".tmp";
+
+// Concatenates the non-overlapping, key-ordered tables of one level
+class LevelIterator : public EntryIterator {
+public:
+    explicit LevelIterator(std::vector<std::shared_ptr<SSTable>> tables)
+        : tables_(std::move(tables)), index_(0) {}
+    
+    void seek(const std::string& target) override {
+        auto it = std::lower_bound(tables_.begin(), tables_.end(), target,
+                                   [](const std::shared_ptr<SSTable>& table, const std::string& key) {
+                                       return table->largest_key() < key;
+                                   });
+        open_table(static_cast<size_t>(it - tables_.begin()));
+        if (current_) {
+            current_->seek(target);
+        }
+        skip_exhausted_tables();
+    }
+    
+    void seek_to_first() override {
+        open_table(0);
+        if (current_) {
+            current_->seek_to_first();
+        }
+        skip_exhausted_tables();
+    }
+    
+    bool valid() const override { return current_ && current_->valid(); }
+    
+    void next() override {
+        current_->next();
+        skip_exhausted_tables();
+    }
+    
+    const std::string& key() const override { return current_->key(); }
+    const std::string& value() const override { return current_->value(); }
+    BlockEntryType type() const override { return current_->type(); }
+    bool ok() const override { return !current_ || current_->ok(); }
+
+private:
+    void open_table(size_t index) {
+        index_ = index;
+        current_ = index_ < tables_.size() ? tables_[index_]->new_iterator() : nullptr;
+    }
+    
+    void skip_exhausted_tables() {
+        while (current_ && !current_->valid() && current_->ok()) {
+            open_table(index_ + 1);
+            if (current_) {
+                current_->seek_to_first();
+            }
+        }
+    }
+    
+    std::vector<std::shared_ptr<SSTable>> tables_;
+    size_t index_;
+    std::unique_ptr<EntryIterator> current_;
+};
+
+// Tables of a level whose key range intersects [begin, end]
+std::vector<std::shared_ptr<SSTable>> overlapping_tables(const std::vector<std::shared_ptr<SSTable>>& level,
+                                                         const std::string& begin,
+                                                         const std::string& end) {
+    std::vector<std::shared_ptr<SSTable>> result;
+    for (const auto& table : level) {
+        if (table->overlaps(begin, end)) {
+            result.push_back(table);
+        }
+    }
+    return result;
+}
+
+void key_range(const std::vector<std::shared_ptr<SSTable>>& tables, std::string& begin, std::string& end) {
+    for (size_t i = 0; i < tables.size(); ++i) {
+        if (i == 0 || tables[i]->smallest_key() < begin) begin = tables[i]->smallest_key();
+        if (i == 0 || tables[i]->largest_key() > end) end = tables[i]->largest_key();
+    }
+}
+
+bool contains_table(const std::vector<std::shared_ptr<SSTable>>& tables, const std::shared_ptr<SSTable>& table) {
+    return std::find(tables.begin(), tables.end(), table) != tables.end();
+}
+
+// True if the memtable holds a key in any of the inclusive ranges
+bool memtable_overlaps(const MemTable& mem, const std::vector<std::pair<std::string, std::string>>& ranges) {
+    if (mem.empty()) {
+        return false;
+    }
+    auto it = mem.new_iterator();
+    for (const auto& [smallest, largest] : ranges) {
+        it->seek(smallest);
+        if (it->valid() && !(largest < it->key())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t level_bytes(const std::vector<std::shared_ptr<SSTable>>& level) {
+    uint64_t bytes = 0;
+    for (const auto& table : level) {
+        bytes += table->file_size();
+    }
+    return bytes;
+}
+
+} // namespace
+
+class LSMTransaction : public Transaction {
+public:
+    LSMTransaction(LSMDatabase& db, uint64_t id) : db_(db), id_(id), has_writes_(false) {}
+    
+    std::string get(const std::string& key) override {
+        std::string value;
+        return db_.get_value(key, value) ? value : "";
+    }
+    
+    OperationResult put(const std::string& key, const std::string& value) override {
+        OperationResult result = db_.write(BlockEntryType::PUT, key, value, id_);
+        has_writes_ = has_writes_ || result == OperationResult::SUCCESS;
+        return result;
+    }
+    
+    OperationResult del(const std::string& key) override {
+        std::string value;
+        if (!db_.get_value(key, value)) {
+            return OperationResult::KEY_NOT_FOUND;
+        }
+        
+        OperationResult result = db_.write(BlockEntryType::DELETE, key, "", id_);
+        has_writes_ = has_writes_ || result == OperationResult::SUCCESS;
+        return result;
+    }
+    
+    std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key,
+                                                          const std::string& end_key,
+                                                          size_t limit) override {
+        return db_.scan_range(start_key, end_key, limit);
+    }
+    
+    OperationResult commit() override {
+        if (has_writes_) {
+            WALRecord record;
+            record.type = WALRecordType::COMMIT;
+            record.transaction_id = id_;
+            
+            if (!db_.wal_->append_record(record)) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+        }
+        
+        return OperationResult::SUCCESS;
+    }
+    
+    void rollback() override {
+        std::cout << "Transaction " << id_ << " rolled back" << std::endl;
+    }
+    
+    uint64_t get_id() const override {
+        return id_;
+    }
+
+private:
+    LSMDatabase& db_;
+    uint64_t id_;
+    bool has_writes_;
+};
+
+LSMDatabase::LSMDatabase(const LSMDatabaseOptions& options)
+    : options_(options), initialized_(false), next_transaction_id_(1), log_segment_(0),
+      stopping_(false), next_file_(1), user_bytes_written_(0), flush_count_(0), flush_bytes_(0),
+      compaction_count_(0), trivial_move_count_(0), compaction_bytes_read_(0),
+      compaction_bytes_written_(0), stall_count_(0), stall_us_(0), ingested_files_(0), ingested_keys_(0),
+      next_stream_id_(1) {
+    options_.max_levels = std::max<size_t>(2, options_.max_levels);
+    options_.max_immutable_memtables = std::max<size_t>(1, options_.max_immutable_memtables);
+    compact_pointer_.resize(options_.max_levels);
+}
+
+LSMDatabase::~LSMDatabase() {
+    shutdown();
+}
+
+OperationResult LSMDatabase::initialize(const std::string& data_dir) {
+    data_dir_ = data_dir;
+    std::error_code ec;
+    std::filesystem::create_directories(data_dir_, ec);
+    if (ec) {
+        std::cerr << "Failed to create data directory " << data_dir_ << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Open the tables the manifest lists
+    auto version = std::make_shared<Version>();
+    version->levels.resize(options_.max_levels);
+    std::vector<std::vector<uint64_t>> manifest_levels;
+    uint64_t next_file = 1;
+    uint64_t log_segment = 0;
+    
+    if (std::filesystem::exists(manifest_path())) {
+        if (!read_manifest(manifest_path(), manifest_levels, next_file, log_segment)) {
+            std::cerr << "Corrupt LSM manifest: " << manifest_path() << std::endl;
+            return OperationResult::SYSTEM_ERROR;
+        }
+    }
+    
+    for (size_t level = 0; level < manifest_levels.size() && level < options_.max_levels; ++level) {
+        for (uint64_t number : manifest_levels[level]) {
+            auto table = std::make_shared<SSTable>(number, table_path(number));
+            if (!table->open()) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+            version->levels[level].push_back(table);
+        }
+    }
+    
+    std::sort(version->levels[0].begin(), version->levels[0].end(),
+              [](const auto& a, const auto& b) { return a->number() > b->number(); });
+    for (size_t level = 1; level < options_.max_levels; ++level) {
+        std::sort(version->levels[level].begin(), version->levels[level].end(),
+                  [](const auto& a, const auto& b) { return a->smallest_key() < b->smallest_key(); });
+    }
+    
+    // Tables a crash left behind mid-flush or mid-compaction are not in the manifest
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        bool live = false;
+        for (const auto& level : version->levels) {
+            for (const auto& table : level) {
+                live = live || table->path() == entry.path().string();
+            }
+        }
+        bool stale_table = name.rfind("table_", 0) == 0 && !live;
+        bool stale_tmp = name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0;
+        if (stale_table || stale_tmp) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+    
+    // Replay the WAL tail that no table covers yet
+    try {
+        wal_ = std::make_shared<WriteAheadLog>(data_dir_ + "/wal");
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to open WAL: " << e.what() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    auto mem = std::make_shared<MemTable>(log_segment);
+    auto records = wal_->read_records_from(log_segment);
+    if (!records.empty()) {
+        std::cout << "Recovering " << records.size() << " records from WAL..." << std::endl;
+    }
+    for (const auto& record : records) {
+        if (record.type == WALRecordType::PUT) {
+            mem->add(BlockEntryType::PUT, record.key, record.value, record.lsn);
+        } else if (record.type == WALRecordType::DELETE) {
+            mem->add(BlockEntryType::DELETE, record.key, "", record.lsn);
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        mem_ = mem;
+        imm_.clear();
+        version_ = version;
+        log_segment_ = log_segment;
+        stopping_ = false;
+    }
+    next_file_ = next_file;
+    
+    background_ = std::thread([this]() { background_loop(); });
+    
+    initialized_ = true;
+    std::cout << "LSM database initialized with data directory: " << data_dir_ << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+void LSMDatabase::shutdown() {
+    if (!initialized_) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    done_cv_.notify_all();
+    if (background_.joinable()) {
+        background_.join();
+    }
+    
+    // Put every memtable on disk so the next start has no WAL to replay
+    {
+        std::lock_guard<std::mutex> work(compaction_mutex_);
+        {
+            std::unique_lock<std::shared_mutex> switch_lock(switch_mutex_);
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            if (!mem_->empty()) {
+                seal_memtable_locked();
+            }
+        }
+        
+        bool pending = true;
+        while (pending) {
+            if (!flush_oldest_immutable()) {
+                std::cerr << "LSM flush failed during shutdown; the WAL will be replayed" << std::endl;
+                break;
+            }
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            pending = !imm_.empty();
+        }
+    }
+    
+    std::cout << "LSM database shutting down..." << std::endl;
+    initialized_ = false;
+}
+
+std::shared_ptr<Transaction> LSMDatabase::begin_transaction() {
+    if (!initialized_) {
+        return nullptr;
+    }
+    
+    uint64_t id = next_transaction_id_++;
+    return std::make_shared<LSMTransaction>(*this, id);
+}
+
+std::unordered_map<std::string, std::string> LSMDatabase::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    stats["engine"] = "lsm";
+    stats["data_directory"] = data_dir_;
+    stats["initialized"] = initialized_ ? "true" : "false";
+    stats["next_transaction_id"] = std::to_string(next_transaction_id_);
+    
+    if (!initialized_) {
+        return stats;
+    }
+    
+    ReadView view = read_view();
+    uint64_t approximate_keys = view.mem->entry_count();
+    uint64_t memtable_bytes = view.mem->approximate_memory();
+    for (const auto& mem : view.imm) {
+        approximate_keys += mem->entry_count();
+        memtable_bytes += mem->approximate_memory();
+    }
+    
+    uint64_t filter_negatives = 0;
+    for (size_t level = 0; level < view.version->levels.size(); ++level) {
+        const auto& tables = view.version->levels[level];
+        for (const auto& table : tables) {
+            approximate_keys += table->entry_count();
+            filter_negatives += table->filter_negatives();
+        }
+        stats["level" + std::to_string(level) + "_files"] = std::to_string(tables.size());
+        stats["level" + std::to_string(level) + "_bytes"] = std::to_string(level_bytes(tables));
+    }
+    
+    stats["approximate_keys"] = std::to_string(approximate_keys);
+    stats["memtable_bytes"] = std::to_string(memtable_bytes);
+    stats["immutable_memtables"] = std::to_string(view.imm.size());
+    stats["flush_count"] = std::to_string(flush_count_.load());
+    stats["compaction_count"] = std::to_string(compaction_count_.load());
+    stats["compaction_trivial_moves"] = std::to_string(trivial_move_count_.load());
+    stats["compaction_bytes_read"] = std::to_string(compaction_bytes_read_.load());
+    stats["compaction_bytes_written"] = std::to_string(compaction_bytes_written_.load());
+    stats["bloom_filter_negatives"] = std::to_string(filter_negatives);
+    stats["ingested_files"] = std::to_string(ingested_files_.load());
+    stats["ingested_keys"] = std::to_string(ingested_keys_.load());
+    stats["write_stall_count"] = std::to_string(stall_count_.load());
+    stats["write_stall_ms"] = std::to_string(stall_us_.load() / 1000);
+    
+    // Bytes written to tables per byte of user data
+    uint64_t user_bytes = user_bytes_written_.load();
+    if (user_bytes > 0) {
+        double amplification = static_cast<double>(flush_bytes_ + compaction_bytes_written_) /
+                               static_cast<double>(user_bytes);
+        stats["write_amplification"] = std::to_string(amplification);
+    }
+    
+    for (const auto& [key, value] : wal_->get_stats()) {
+        stats["wal_" + key] = value;
+    }
+    
+    return stats;
+}
+
+OperationResult LSMDatabase::write(BlockEntryType type, const std::string& key, const std::string& value,
+                                   uint64_t transaction_id) {
+    WALRecord record;
+    record.type = type == BlockEntryType::PUT ? WALRecordType::PUT : WALRecordType::DELETE;
+    record.key = key;
+    record.value = value;
+    record.key_length = static_cast<uint32_t>(key.length());
+    record.value_length = static_cast<uint32_t>(value.length());
+    record.transaction_id = transaction_id;
+    
+    while (true) {
+        {
+            // The shared lock keeps mem_ from being sealed between the WAL
+            // append and the insert, so the write lands in the memtable that
+            // owns its WAL segment
+            std::shared_lock<std::shared_mutex> lock(switch_mutex_);
+            if (mem_->approximate_memory() < options_.memtable_size) {
+                uint64_t lsn = 0;
+                if (!wal_->append_record(record, &lsn)) {
+                    return OperationResult::SYSTEM_ERROR;
+                }
+                mem_->add(type, key, value, lsn);
+                user_bytes_written_ += key.size() + value.size();
+                return OperationResult::SUCCESS;
+            }
+        }
+        
+        if (!make_room_for_write()) {
+            return OperationResult::SYSTEM_ERROR;
+        }
+    }
+}
+
+bool LSMDatabase::get_value(const std::string& key, std::string& value) const {
+    ReadView view = read_view();
+    BlockEntryType type;
+    
+    // Newest source first; the first hit, value or tombstone, decides
+    if (view.mem->get(key, value, type)) {
+        return type == BlockEntryType::PUT;
+    }
+    for (const auto& mem : view.imm) {
+        if (mem->get(key, value, type)) {
+            return type == BlockEntryType::PUT;
+        }
+    }
+    
+    for (const auto& table : view.version->levels[0]) {
+        if (table->get(key, value, type)) {
+            return type == BlockEntryType::PUT;
+        }
+    }
+    
+    // Deeper levels do not overlap, so at most one table per level can hold the key
+    for (size_t level = 1; level < view.version->levels.size(); ++level) {
+        const auto& tables = view.version->levels[level];
+        auto it = std::lower_bound(tables.begin(), tables.end(), key,
+                                   [](const std::shared_ptr<SSTable>& table, const std::string& target) {
+                                       return table->largest_key() < target;
+                                   });
+        if (it != tables.end() && (*it)->get(key, value, type)) {
+            return type == BlockEntryType::PUT;
+        }
+    }
+    
+    return false;
+}
+
+std::vector<std::pair<std::string, std::string>> LSMDatabase::scan_range(const std::string& start_key,
+                                                                         const std::string& end_key,
+                                                                         size_t limit) const {
+    ReadView view = read_view();
+    
+    std::vector<std::unique_ptr<EntryIterator>> children;
+    children.push_back(view.mem->new_iterator());
+    for (const auto& mem : view.imm) {
+        children.push_back(mem->new_iterator());
+    }
+    for (const auto& table : view.version->levels[0]) {
+        children.push_back(table->new_iterator());
+    }
+    for (size_t level = 1; level < view.version->levels.size(); ++level) {
+        if (!view.version->levels[level].empty()) {
+            children.push_back(std::make_unique<LevelIterator>(view.version->levels[level]));
+        }
+    }
+    
+    std::vector<std::pair<std::string, std::string>> result;
+    MergingIterator it(std::move(children));
+    for (it.seek(start_key); it.valid() && it.key() < end_key && result.size() < limit; it.next()) {
+        if (it.type() == BlockEntryType::PUT) {
+            result.emplace_back(it.key(), it.value());
+        }
+    }
+    
+    return result;
+}
+
+LSMDatabase::ReadView LSMDatabase::read_view() const {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    ReadView view;
+    view.mem = mem_;
+    view.imm.assign(imm_.begin(), imm_.end());
+    view.version = version_;
+    return view;
+}
+
+bool LSMDatabase::make_room_for_write() {
+    std::unique_lock<std::shared_mutex> switch_lock(switch_mutex_);
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    
+    // Another writer may have sealed it while we waited
+    if (mem_->approximate_memory() < options_.memtable_size) {
+        return true;
+    }
+    
+    // Stall while flushing or level 0 compaction cannot keep up
+    auto start = std::chrono::steady_clock::now();
+    bool stalled = false;
+    while (!stopping_ && (imm_.size() >= options_.max_immutable_memtables ||
+                          version_->levels[0].size() >= options_.level0_stop_writes)) {
+        stalled = true;
+        done_cv_.wait(lock);
+    }
+    if (stalled) {
+        stall_count_++;
+        stall_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    if (stopping_) {
+        return false;
+    }
+    
+    return seal_memtable_locked();
+}
+
+bool LSMDatabase::seal_memtable_locked() {
+    // Start a new WAL segment so the sealed memtable's log can be dropped on its own
+    if (!wal_->rotate_segment()) {
+        return false;
+    }
+    
+    imm_.push_front(mem_);
+    mem_ = std::make_shared<MemTable>(wal_->current_segment());
+    work_cv_.notify_one();
+    return true;
+}
+
+OperationResult LSMDatabase::flush() {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::unique_lock<std::shared_mutex> switch_lock(switch_mutex_);
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    if (!mem_->empty() && !seal_memtable_locked()) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    switch_lock.unlock();
+    
+    done_cv_.wait(lock, [this]() { return imm_.empty() || stopping_; });
+    return imm_.empty() ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult LSMDatabase::ingest_files(const std::vector<std::string>& paths, uint64_t& entries) {
+    entries = 0;
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Copy under temporary names; table numbers are taken at install time so
+    // they sort after every table flushed meanwhile. After a crash the next
+    // start deletes the .tmp files. The copies, not the caller's files, are
+    // what is verified and installed, so the caller may reuse its files.
+    std::vector<std::string> staged;
+    auto discard = [&staged]() {
+        std::error_code ec;
+        for (const auto& path : staged) {
+            std::filesystem::remove(path, ec);
+        }
+        return OperationResult::SYSTEM_ERROR;
+    };
+    
+    // Verifying a copy is the only pass over the data
+    std::vector<std::tuple<BlockFileSummary, size_t, std::string>> files;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::string target = data_dir_ + "/ingest_" + std::to_string(next_file_++) + MANIFEST_TMP_SUFFIX;
+        std::error_code ec;
+        std::filesystem::copy_file(paths[i], target, ec);
+        if (ec || !sync_path(target)) {
+            std::cerr << "Ingest: cannot copy " << paths[i] << " into " << data_dir_ << std::endl;
+            std::filesystem::remove(target, ec);
+            return discard();
+        }
+        staged.push_back(target);
+        
+        BlockFileSummary summary;
+        if (!verify_sorted_file(target, summary)) {
+            return discard();
+        }
+        if (summary.entry_count == 0) {
+            std::filesystem::remove(target, ec);
+            staged.pop_back();
+            continue;
+        }
+        files.emplace_back(std::move(summary), i, target);
+    }
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+        return std::get<0>(a).smallest < std::get<0>(b).smallest;
+    });
+    for (size_t i = 1; i < files.size(); ++i) {
+        if (!(std::get<0>(files[i - 1]).largest < std::get<0>(files[i]).smallest)) {
+            std::cerr << "Ingest: " << paths[std::get<1>(files[i - 1])] << " and " << paths[std::get<1>(files[i])]
+                      << " overlap" << std::endl;
+            return discard();
+        }
+    }
+    
+    // Tables are installed in key order
+    std::vector<std::pair<std::string, std::string>> ranges;
+    staged.clear();
+    for (const auto& [summary, index, target] : files) {
+        ranges.emplace_back(summary.smallest, summary.largest);
+        entries += summary.entry_count;
+        staged.push_back(target);
+    }
+    if (files.empty()) {
+        return OperationResult::SUCCESS;
+    }
+    
+    for (size_t attempt = 0;; ++attempt) {
+        // Older writes still in memtables would shadow the files; put them on disk first
+        ReadView view = read_view();
+        bool overlap = memtable_overlaps(*view.mem, ranges);
+        for (const auto& mem : view.imm) {
+            overlap = overlap || memtable_overlaps(*mem, ranges);
+        }
+        view = ReadView();
+        if (overlap && flush() != OperationResult::SUCCESS) {
+            return discard();
+        }
+        
+        std::lock_guard<std::mutex> work(compaction_mutex_);
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        
+        // Writes that landed in the ranges since the flush are older than the files too
+        overlap = memtable_overlaps(*mem_, ranges);
+        for (const auto& mem : imm_) {
+            overlap = overlap || memtable_overlaps(*mem, ranges);
+        }
+        if (overlap) {
+            if (attempt < 8) continue;
+            std::cerr << "Ingest: writes keep arriving in the ingested key ranges" << std::endl;
+            return discard();
+        }
+        
+        Level tables;
+        for (const auto& path : staged) {
+            uint64_t number = next_file_++;
+            std::error_code ec;
+            std::filesystem::rename(path, table_path(number), ec);
+            auto table = std::make_shared<SSTable>(number, table_path(number));
+            if (ec || !table->open()) {
+                table->mark_obsolete();
+                for (const auto& linked : tables) {
+                    linked->mark_obsolete();
+                }
+                return discard();
+            }
+            tables.push_back(table);
+        }
+        
+        // The deepest level such that it and every level above it are clear
+        // of the ranges; level 0 if a level 0 table overlaps
+        size_t target = 0;
+        for (size_t level = 0; level < options_.max_levels; ++level) {
+            bool clear = true;
+            for (const auto& range : ranges) {
+                clear = clear && overlapping_tables(version_->levels[level], range.first, range.second).empty();
+            }
+            if (!clear) break;
+            target = level;
+        }
+        
+        auto next = std::make_shared<Version>(*version_);
+        auto& to = next->levels[target];
+        if (target == 0) {
+            to.insert(to.begin(), tables.rbegin(), tables.rend());
+        } else {
+            to.insert(to.end(), tables.begin(), tables.end());
+            std::sort(to.begin(), to.end(),
+                      [](const auto& a, const auto& b) { return a->smallest_key() < b->smallest_key(); });
+        }
+        if (!write_manifest(manifest_path(), *next, log_segment_)) {
+            for (const auto& table : tables) {
+                table->mark_obsolete();
+            }
+            return OperationResult::SYSTEM_ERROR;
+        }
+        version_ = next;
+        work_cv_.notify_one();
+        
+        ingested_files_ += tables.size();
+        ingested_keys_ += entries;
+        std::cout << "Ingested " << tables.size() << " files with " << entries << " keys into level "
+                  << target << std::endl;
+        return OperationResult::SUCCESS;
+    }
+}
+
+void LSMDatabase::background_loop() {
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    
+    while (true) {
+        work_cv_.wait(lock, [this]() {
+            return stopping_ || !imm_.empty() ||
+                   pick_compaction_level(*version_) < options_.max_levels;
+        });
+        if (stopping_) {
+            break;
+        }
+        
+        bool flush_pending = !imm_.empty();
+        lock.unlock();
+        
+        bool ok;
+        {
+            std::lock_guard<std::mutex> work(compaction_mutex_);
+            ok = flush_pending ? flush_oldest_immutable() : compact_once();
+        }
+        
+        lock.lock();
+        done_cv_.notify_all();
+        
+        if (!ok) {
+            // Typically a full disk; back off instead of spinning
+            std::cerr << "LSM background " << (flush_pending ? "flush" : "compaction")
+                      << " failed, retrying" << std::endl;
+            work_cv_.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping_; });
+        }
+    }
+}
+
+bool LSMDatabase::flush_oldest_immutable() {
+    std::shared_ptr<MemTable> mem;
+    std::shared_ptr<const Version> base;
+    uint64_t next_log_segment;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        if (imm_.empty()) {
+            return true;
+        }
+        mem = imm_.back();
+        base = version_;
+        next_log_segment = imm_.size() > 1 ? imm_[imm_.size() - 2]->log_segment() : mem_->log_segment();
+    }
+    
+    Level outputs;
+    uint64_t bytes_written = 0;
+    auto input = mem->new_iterator();
+    if (!write_tables(*input, false, std::numeric_limits<uint64_t>::max(), outputs, bytes_written)) {
+        return false;
+    }
+    input.reset();
+    
+    auto next = std::make_shared<Version>(*base);
+    next->levels[0].insert(next->levels[0].begin(), outputs.begin(), outputs.end());
+    if (!write_manifest(manifest_path(), *next, next_log_segment)) {
+        for (const auto& table : outputs) {
+            table->mark_obsolete();
+        }
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        version_ = next;
+        imm_.pop_back();
+        log_segment_ = next_log_segment;
+    }
+    
+    // The memtable is durable in level 0 now
+    wal_->remove_segments_before(next_log_segment);
+    flush_count_++;
+    flush_bytes_ += bytes_written;
+    return true;
+}
+
+size_t LSMDatabase::pick_compaction_level(const Version& version) const {
+    size_t best_level = options_.max_levels;
+    double best_score = 1.0;
+    
+    for (size_t level = 0; level + 1 < options_.max_levels; ++level) {
+        double score;
+        if (level == 0) {
+            // Count files, not bytes: every level 0 file is probed by every read
+            score = static_cast<double>(version.levels[0].size()) /
+                    static_cast<double>(options_.level0_compaction_trigger);
+        } else {
+            score = static_cast<double>(level_bytes(version.levels[level])) /
+                    static_cast<double>(max_bytes_for_level(level));
+        }
+        
+        if (score >= best_score) {
+            best_score = score;
+            best_level = level;
+        }
+    }
+    
+    return best_level;
+}
+
+uint64_t LSMDatabase::max_bytes_for_level(size_t level) const {
+    double bytes = static_cast<double>(options_.level1_max_bytes);
+    for (size_t i = 1; i < level; ++i) {
+        bytes *= options_.level_size_multiplier;
+    }
+    return static_cast<uint64_t>(bytes);
+}
+
+bool LSMDatabase::compact_once() {
+    std::shared_ptr<const Version> base;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        base = version_;
+    }
+    
+    size_t level = pick_compaction_level(*base);
+    if (level >= options_.max_levels) {
+        return true;
+    }
+    
+    // Level 0 files overlap each other, so they all go at once. Deeper levels
+    // take one file at a time, round-robin through the key space.
+    Level inputs;
+    if (level == 0) {
+        inputs = base->levels[0];
+    } else {
+        const auto& tables = base->levels[level];
+        auto it = std::find_if(tables.begin(), tables.end(), [&](const std::shared_ptr<SSTable>& table) {
+            return table->smallest_key() > compact_pointer_[level];
+        });
+        inputs.push_back(it != tables.end() ? *it : tables.front());
+    }
+    
+    return compact_level(level, inputs);
+}
+
+bool LSMDatabase::compact_level(size_t level, const Level& inputs) {
+    if (inputs.empty() || level + 1 >= options_.max_levels) {
+        return true;
+    }
+    
+    std::shared_ptr<const Version> base;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        base = version_;
+    }
+    
+    std::string begin, end;
+    key_range(inputs, begin, end);
+    Level next_inputs = overlapping_tables(base->levels[level + 1], begin, end);
+    
+    auto next = std::make_shared<Version>(*base);
+    Level outputs;
+    uint64_t bytes_read = level_bytes(inputs) + level_bytes(next_inputs);
+    uint64_t bytes_written = 0;
+    bool trivial_move = level > 0 && inputs.size() == 1 && next_inputs.empty();
+    
+    if (trivial_move) {
+        // Nothing to merge with: move the file down without rewriting it
+        outputs = inputs;
+    } else {
+        // Tombstones can go once no deeper level may hold an older version of the key
+        Level all_inputs = inputs;
+        all_inputs.insert(all_inputs.end(), next_inputs.begin(), next_inputs.end());
+        key_range(all_inputs, begin, end);
+        bool bottommost = true;
+        for (size_t deeper = level + 2; deeper < options_.max_levels && bottommost; ++deeper) {
+            bottommost = overlapping_tables(base->levels[deeper], begin, end).empty();
+        }
+        
+        // Children newest first: the input level shadows the level below it
+        std::vector<std::unique_ptr<EntryIterator>> children;
+        if (level == 0) {
+            for (const auto& table : inputs) {
+                children.push_back(table->new_iterator());
+            }
+        } else {
+            children.push_back(std::make_unique<LevelIterator>(inputs));
+        }
+        children.push_back(std::make_unique<LevelIterator>(next_inputs));
+        
+        MergingIterator merged(std::move(children));
+        if (!write_tables(merged, bottommost, options_.target_file_size, outputs, bytes_written)) {
+            return false;
+        }
+    }
+    
+    auto& from = next->levels[level];
+    auto& to = next->levels[level + 1];
+    from.erase(std::remove_if(from.begin(), from.end(),
+                              [&](const auto& table) { return contains_table(inputs, table); }),
+               from.end());
+    to.erase(std::remove_if(to.begin(), to.end(),
+                            [&](const auto& table) { return contains_table(next_inputs, table); }),
+             to.end());
+    to.insert(to.end(), outputs.begin(), outputs.end());
+    std::sort(to.begin(), to.end(),
+              [](const auto& a, const auto& b) { return a->smallest_key() < b->smallest_key(); });
+    
+    uint64_t log_segment;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        log_segment = log_segment_;
+    }
+    if (!write_manifest(manifest_path(), *next, log_segment)) {
+        if (!trivial_move) {
+            for (const auto& table : outputs) {
+                table->mark_obsolete();
+            }
+        }
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        version_ = next;
+    }
+    
+    // Files are unlinked when the last reader drops its view
+    if (trivial_move) {
+        trivial_move_count_++;
+    } else {
+        for (const auto& table : inputs) {
+            table->mark_obsolete();
+        }
+        for (const auto& table : next_inputs) {
+            table->mark_obsolete();
+        }
+        compaction_count_++;
+        compaction_bytes_read_ += bytes_read;
+        compaction_bytes_written_ += bytes_written;
+    }
+    compact_pointer_[level] = inputs.back()->largest_key();
+    return true;
+}
+
+bool LSMDatabase::write_tables(EntryIterator& input, bool drop_tombstones, uint64_t max_file_size,
+                               Level& outputs, uint64_t& bytes_written) {
+    std::unique_ptr<SSTableBuilder> builder;
+    uint64_t number = 0;
+    
+    auto finish_table = [&]() {
+        bool ok = builder->finish();
+        builder.reset();
+        if (!ok) {
+            return false;
+        }
+        
+        auto table = std::make_shared<SSTable>(number, table_path(number));
+        if (!table->open()) {
+            table->mark_obsolete();
+            return false;
+        }
+        bytes_written += table->file_size();
+        outputs.push_back(table);
+        return true;
+    };
+    
+    auto fail = [&]() {
+        if (builder) {
+            builder->abort();
+        }
+        for (const auto& table : outputs) {
+            table->mark_obsolete();
+        }
+        outputs.clear();
+        return false;
+    };
+    
+    for (input.seek_to_first(); input.valid(); input.next()) {
+        if (drop_tombstones && input.type() == BlockEntryType::DELETE) {
+            continue;
+        }
+        
+        if (!builder) {
+            number = next_file_++;
+            builder = std::make_unique<SSTableBuilder>(table_path(number), options_.table_format,
+                                                       options_.bloom_bits_per_key);
+            if (!builder->open()) {
+                return fail();
+            }
+        }
+        
+        if (!builder->add(input.type(), input.key(), input.value())) {
+            return fail();
+        }
+        
+        // Cut between keys only; each key appears once in the merged input
+        if (builder->file_size() >= max_file_size && !finish_table()) {
+            return fail();
+        }
+    }
+    
+    if (!input.ok()) {
+        std::cerr << "LSM read error while writing tables" << std::endl;
+        return fail();
+    }
+    if (builder && !finish_table()) {
+        return fail();
+    }
+    return true;
+}
+
+OperationResult LSMDatabase::compact() {
+    if (flush() != OperationResult::SUCCESS) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::lock_guard<std::mutex> work(compaction_mutex_);
+    
+    // Push every level down into the deepest populated one
+    size_t target = 1;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        for (size_t level = 1; level < version_->levels.size(); ++level) {
+            if (!version_->levels[level].empty()) {
+                target = level;
+            }
+        }
+    }
+    
+    for (size_t level = 0; level < target; ++level) {
+        Level inputs;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            inputs = version_->levels[level];
+        }
+        if (!compact_level(level, inputs)) {
+            return OperationResult::SYSTEM_ERROR;
+        }
+    }
+    
+    done_cv_.notify_all();
+    return OperationResult::SUCCESS;
+}
+
+OperationResult LSMDatabase::backup(const std::string& backup_path) {
+    if (flush() != OperationResult::SUCCESS) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Tables are immutable, so a hard link is a consistent copy; fall back to
+    // copying when the backup is on another file system
+    std::lock_guard<std::mutex> work(compaction_mutex_);
+    std::shared_ptr<const Version> version;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        version = version_;
+    }
+    
+    std::error_code ec;
+    std::filesystem::create_directories(backup_path, ec);
+    if (ec) {
+        std::cerr << "Failed to create backup directory " << backup_path << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    for (const auto& level : version->levels) {
+        for (const auto& table : level) {
+            std::string target = backup_path + "/" + std::filesystem::path(table->path()).filename().string();
+            std::filesystem::remove(target, ec);
+            std::filesystem::create_hard_link(table->path(), target, ec);
+            if (ec) {
+                std::filesystem::copy_file(table->path(), target, ec);
+            }
+            if (ec) {
+                std::cerr << "Failed to back up " << table->path() << ": " << ec.message() << std::endl;
+                return OperationResult::SYSTEM_ERROR;
+            }
+        }
+    }
+    
+    // The backup has no WAL; everything it holds is in the tables
+    if (!write_manifest(backup_path + "/MANIFEST", *version, 0)) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::cout << "LSM backup written to " << backup_path << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+OperationResult LSMDatabase::restore(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::vector<std::vector<uint64_t>> backup_levels;
+    uint64_t backup_next_file = 0;
+    uint64_t backup_log_segment = 0;
+    if (!read_manifest(backup_path + "/MANIFEST", backup_levels, backup_next_file, backup_log_segment)) {
+        std::cerr << "No LSM manifest in " << backup_path << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::lock_guard<std::mutex> work(compaction_mutex_);
+    
+    // Copy the backup's tables in under fresh numbers
+    auto next = std::make_shared<Version>();
+    next->levels.resize(options_.max_levels);
+    std::error_code ec;
+    for (size_t level = 0; level < backup_levels.size(); ++level) {
+        for (uint64_t number : backup_levels[level]) {
+            std::string source = backup_path + "/table_" + std::to_string(number) + ".sst";
+            uint64_t restored = next_file_++;
+            std::filesystem::copy_file(source, table_path(restored), ec);
+            auto table = std::make_shared<SSTable>(restored, table_path(restored));
+            if (ec || !table->open()) {
+                std::cerr << "Failed to restore " << source << std::endl;
+                table->mark_obsolete();
+                for (const auto& tables : next->levels) {
+                    for (const auto& copied : tables) {
+                        copied->mark_obsolete();
+                    }
+                }
+                return OperationResult::SYSTEM_ERROR;
+            }
+            next->levels[std::min(level, options_.max_levels - 1)].push_back(table);
+        }
+    }
+    std::sort(next->levels[0].begin(), next->levels[0].end(),
+              [](const auto& a, const auto& b) { return a->number() > b->number(); });
+    for (size_t level = 1; level < next->levels.size(); ++level) {
+        std::sort(next->levels[level].begin(), next->levels[level].end(),
+                  [](const auto& a, const auto& b) { return a->smallest_key() < b->smallest_key(); });
+    }
+    
+    // Swap in the restored tables with writers held off; current memtables are discarded
+    std::unique_lock<std::shared_mutex> switch_lock(switch_mutex_);
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    if (!wal_->rotate_segment()) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    uint64_t log_segment = wal_->current_segment();
+    if (!write_manifest(manifest_path(), *next, log_segment)) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    for (const auto& level : version_->levels) {
+        for (const auto& table : level) {
+            table->mark_obsolete();
+        }
+    }
+    version_ = next;
+    mem_ = std::make_shared<MemTable>(log_segment);
+    imm_.clear();
+    log_segment_ = log_segment;
+    wal_->remove_segments_before(log_segment);
+    done_cv_.notify_all();
+    
+    std::cout << "LSM database restored from " << backup_path << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+OperationResult LSMDatabase::freeze_backup_files(BackupFileSet& file_set) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // A local backup made of hard links is already a frozen file set
+    file_set.staging_dir = data_dir_ + "/backup-stream-" + std::to_string(next_stream_id_++);
+    file_set.files.clear();
+    if (backup(file_set.staging_dir) != OperationResult::SUCCESS) {
+        release_backup_files(file_set);
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(file_set.staging_dir, ec)) {
+        file_set.files.push_back({entry.path().string(), entry.path().filename().string()});
+    }
+    return ec ? OperationResult::SYSTEM_ERROR : OperationResult::SUCCESS;
+}
+
+void LSMDatabase::release_backup_files(const BackupFileSet& file_set) {
+    if (file_set.staging_dir.empty()) {
+        return;
+    }
+    
+    std::error_code ec;
+    std::filesystem::remove_all(file_set.staging_dir, ec);
+}
+
+bool LSMDatabase::write_manifest(const std::string& path, const Version& version, uint64_t log_segment) const {
+    {
+        std::ofstream out(path + MANIFEST_TMP_SUFFIX, std::ios::trunc);
+        out << "version 1\n";
+        out << "next_file " << next_file_.load() << "\n";
+        out << "log_segment " << log_segment << "\n";
+        for (size_t level = 0; level < version.levels.size(); ++level) {
+            for (const auto& table : version.levels[level]) {
+                out << "table " << level << " " << table->number() << "\n";
+            }
+        }
+        out.flush();
+        if (!out.good()) {
+            return false;
+        }
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(path + MANIFEST_TMP_SUFFIX, path, ec);
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    return !ec && sync_path(path) && sync_path(dir.empty() ? "." : dir);
+}
+
+bool LSMDatabase::read_manifest(const std::string& path, std::vector<std::vector<uint64_t>>& levels,
+                                uint64_t& next_file, uint64_t& log_segment) const {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return false;
+    }
+    
+    std::string field;
+    bool versioned = false;
+    while (in >> field) {
+        if (field == "version") {
+            std::string value;
+            in >> value;
+            versioned = value == "1";
+        } else if (field == "next_file") {
+            in >> next_file;
+        } else if (field == "log_segment") {
+            in >> log_segment;
+        } else if (field == "table") {
+            size_t level;
+            uint64_t number;
+            if (!(in >> level >> number)) {
+                return false;
+            }
+            if (levels.size() <= level) {
+                levels.resize(level + 1);
+            }
+            levels[level].push_back(number);
+        } else {
+            return false;
+        }
+    }
+    
+    return versioned;
+}
+
+// Factory implementation
+std::shared_ptr<Database> DatabaseFactory::create_lsm_database() {
+    return std::make_shared<LSMDatabase>();
+}
+
+} // namespace distributeddb
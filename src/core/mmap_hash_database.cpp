@@ -0,0 +1,351 @@
+#include "core/mmap_hash_database.h"
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+
+namespace distributeddb {
+
+class MmapHashTransaction : public Transaction {
+public:
+    MmapHashTransaction(MmapHashDatabase& db, uint64_t id) : db_(db), id_(id), has_writes_(false) {}
+    
+    std::string get(const std::string& key) override {
+        uint64_t hash = MmapHashTable::hash(key);
+        std::shared_lock<std::shared_mutex> lock(db_.table_.stripe_for(hash).mutex);
+        std::string value;
+        return db_.table_.get(hash, key, value) ? value : "";
+    }
+    
+    OperationResult put(const std::string& key, const std::string& value) override {
+        uint64_t hash = MmapHashTable::hash(key);
+        {
+            // The stripe lock is held across the WAL append so that a key's
+            // records reach the table in LSN order
+            std::unique_lock<std::shared_mutex> lock(db_.table_.stripe_for(hash).mutex);
+            bool ok = db_.table_.put(hash, key, value, [&](uint64_t& lsn) {
+                WALRecord record;
+                record.type = WALRecordType::PUT;
+                record.key = key;
+                record.value = value;
+                record.key_length = static_cast<uint32_t>(key.length());
+                record.value_length = static_cast<uint32_t>(value.length());
+                record.transaction_id = id_;
+                return db_.wal_->append_record(record, &lsn);
+            });
+            if (!ok) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+            has_writes_ = true;
+        }
+        
+        db_.table_.grow_if_needed();
+        return OperationResult::SUCCESS;
+    }
+    
+    OperationResult del(const std::string& key) override {
+        uint64_t hash = MmapHashTable::hash(key);
+        std::unique_lock<std::shared_mutex> lock(db_.table_.stripe_for(hash).mutex);
+        
+        std::string value;
+        if (!db_.table_.get(hash, key, value)) {
+            return OperationResult::KEY_NOT_FOUND;
+        }
+        
+        bool ok = db_.table_.remove(hash, key, [&](uint64_t& lsn) {
+            WALRecord record;
+            record.type = WALRecordType::DELETE;
+            record.key = key;
+            record.key_length = static_cast<uint32_t>(key.length());
+            record.transaction_id = id_;
+            return db_.wal_->append_record(record, &lsn);
+        });
+        if (!ok) {
+            return OperationResult::SYSTEM_ERROR;
+        }
+        has_writes_ = true;
+        return OperationResult::SUCCESS;
+    }
+    
+    std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key,
+                                                          const std::string& end_key,
+                                                          size_t limit) override {
+        std::vector<std::pair<std::string, std::string>> result;
+        if (limit == 0) {
+            return result;
+        }
+        
+        db_.table_.for_each([&](const std::string& key, const std::string& value) {
+            if (key >= start_key && key < end_key) {
+                result.emplace_back(key, value);
+            }
+            return result.size() < limit;
+        });
+        return result;
+    }
+    
+    OperationResult commit() override {
+        // Read-only transactions leave no trace in the WAL
+        if (has_writes_) {
+            WALRecord record;
+            record.type = WALRecordType::COMMIT;
+            record.transaction_id = id_;
+            
+            if (!db_.wal_->append_record(record)) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+        }
+        return OperationResult::SUCCESS;
+    }
+    
+    void rollback() override {
+        std::cout << "Transaction " << id_ << " rolled back" << std::endl;
+    }
+    
+    uint64_t get_id() const override {
+        return id_;
+    }
+
+private:
+    MmapHashDatabase& db_;
+    uint64_t id_;
+    bool has_writes_;
+};
+
+MmapHashDatabase::MmapHashDatabase(const MmapHashDatabaseOptions& options)
+    : options_(options), table_(options.table), initialized_(false), next_transaction_id_(1),
+      next_stream_id_(1), last_recovery_us_(0), replayed_records_(0) {
+}
+
+MmapHashDatabase::~MmapHashDatabase() {
+    shutdown();
+}
+
+OperationResult MmapHashDatabase::initialize(const std::string& data_dir) {
+    data_dir_ = data_dir;
+    std::error_code ec;
+    std::filesystem::create_directories(data_dir_, ec);
+    if (ec) {
+        std::cerr << "Failed to create data directory " << data_dir_ << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Leftovers of an interrupted compaction, backup or restore
+    for (const char* suffix : {".compact", ".restore"}) {
+        std::filesystem::remove(data_dir_ + "/mmap_hash.dat" + suffix, ec);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    try {
+        wal_ = std::make_shared<WriteAheadLog>(data_dir_ + "/wal");
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to open WAL: " << e.what() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    if (!table_.open(data_dir_)) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // A clean shutdown leaves no WAL behind. Anything logged means the table
+    // may be missing changes, so check every record against it.
+    auto records = wal_->read_records_from(0);
+    replayed_records_ = 0;
+    if (!records.empty()) {
+        if (table_.opened_clean() && !table_.rebuild()) {
+            return OperationResult::SYSTEM_ERROR;
+        }
+        
+        std::cout << "Replaying " << records.size() << " WAL records into the mmap hash table..." << std::endl;
+        for (const auto& record : records) {
+            if (record.type != WALRecordType::PUT && record.type != WALRecordType::DELETE) {
+                continue;
+            }
+            if (!table_.replay(record.type == WALRecordType::DELETE, record.key, record.value, record.lsn)) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+            replayed_records_++;
+        }
+    }
+    table_.finish_recovery();
+    wal_->advance_lsn(table_.max_lsn() + 1);
+    last_recovery_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    scheduler_ = std::make_unique<CheckpointScheduler>(
+        options_.checkpoint,
+        [this]() { return std::make_pair(wal_->get_total_bytes(), wal_->get_total_records()); },
+        [this]() { return write_checkpoint(); });
+    scheduler_->start();
+    
+    initialized_ = true;
+    std::cout << "Mmap hash database initialized with data directory: " << data_dir_ << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+void MmapHashDatabase::shutdown() {
+    if (!initialized_) {
+        return;
+    }
+    
+    scheduler_->stop();
+    
+    // Once the table is synced and marked clean the WAL holds nothing it lacks
+    table_.close();
+    discard_wal();
+    
+    std::cout << "Mmap hash database shutting down..." << std::endl;
+    initialized_ = false;
+}
+
+std::shared_ptr<Transaction> MmapHashDatabase::begin_transaction() {
+    if (!initialized_) {
+        return nullptr;
+    }
+    
+    uint64_t id = next_transaction_id_++;
+    return std::make_shared<MmapHashTransaction>(*this, id);
+}
+
+bool MmapHashDatabase::discard_wal() {
+    if (!wal_->rotate_segment()) {
+        return false;
+    }
+    wal_->remove_segments_before(wal_->current_segment());
+    return true;
+}
+
+bool MmapHashDatabase::write_checkpoint() {
+    uint64_t covered_segment = 0;
+    bool ok = table_.checkpoint([this, &covered_segment]() {
+        if (!wal_->rotate_segment()) {
+            return false;
+        }
+        covered_segment = wal_->current_segment();
+        return true;
+    });
+    if (!ok) {
+        return false;
+    }
+    wal_->remove_segments_before(covered_segment);
+    
+    if (table_.dead_bytes() >= options_.compact_min_dead_bytes &&
+        table_.dead_ratio() >= options_.compact_dead_ratio) {
+        return compact_table();
+    }
+    return true;
+}
+
+bool MmapHashDatabase::compact_table() {
+    return table_.compact([this]() { return discard_wal(); });
+}
+
+OperationResult MmapHashDatabase::checkpoint() {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    return scheduler_->run_now() ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult MmapHashDatabase::compact() {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    bool ok = scheduler_->run_exclusive([this]() { return compact_table(); });
+    return ok ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+std::unordered_map<std::string, std::string> MmapHashDatabase::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    stats["engine"] = "mmap_hash";
+    stats["data_directory"] = data_dir_;
+    stats["initialized"] = initialized_ ? "true" : "false";
+    stats["next_transaction_id"] = std::to_string(next_transaction_id_);
+    
+    if (!initialized_) {
+        return stats;
+    }
+    
+    stats["total_keys"] = std::to_string(table_.size());
+    stats["recovery_us"] = std::to_string(last_recovery_us_);
+    stats["recovery_replayed_records"] = std::to_string(replayed_records_);
+    for (const auto& [key, value] : table_.get_stats()) {
+        stats["mmap_" + key] = value;
+    }
+    for (const auto& [key, value] : wal_->get_stats()) {
+        stats["wal_" + key] = value;
+    }
+    for (const auto& [key, value] : scheduler_->get_stats()) {
+        stats["checkpoint_" + key] = value;
+    }
+    return stats;
+}
+
+OperationResult MmapHashDatabase::backup(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::error_code ec;
+    std::filesystem::create_directories(backup_path, ec);
+    if (ec) {
+        std::cerr << "Failed to create backup directory " << backup_path << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // The live records alone; the index is rebuilt on restore
+    if (!table_.copy_to(backup_path + "/mmap_hash.dat")) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::cout << "Mmap hash backup written to " << backup_path << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+OperationResult MmapHashDatabase::restore(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Sync the current table before the WAL goes, so a failed restore loses nothing
+    bool ok = scheduler_->run_exclusive([this, &backup_path]() {
+        return table_.checkpoint([this]() { return wal_->rotate_segment(); }) && discard_wal() &&
+               table_.restore_from(backup_path + "/mmap_hash.dat");
+    });
+    if (!ok) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    wal_->advance_lsn(table_.max_lsn() + 1);
+    
+    std::cout << "Mmap hash database restored from " << backup_path << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+OperationResult MmapHashDatabase::freeze_backup_files(BackupFileSet& file_set) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    file_set.staging_dir = data_dir_ + "/backup-stream-" + std::to_string(next_stream_id_++);
+    file_set.files.clear();
+    if (backup(file_set.staging_dir) != OperationResult::SUCCESS) {
+        release_backup_files(file_set);
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    file_set.files.push_back({file_set.staging_dir + "/mmap_hash.dat", "mmap_hash.dat"});
+    return OperationResult::SUCCESS;
+}
+
+void MmapHashDatabase::release_backup_files(const BackupFileSet& file_set) {
+    if (file_set.staging_dir.empty()) {
+        return;
+    }
+    
+    std::error_code ec;
+    std::filesystem::remove_all(file_set.staging_dir, ec);
+}
+
+std::shared_ptr<Database> DatabaseFactory::create_mmap_hash_database() {
+    return std::make_shared<MmapHashDatabase>();
+}
+
+} // namespace distributeddb
@@ -0,0 +1,791 @@
+#include "core/namespaced_database.h"
+#include "core/engine_registry.h"
+#include "storage/block_file.h"
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+namespace distributeddb {
+
+namespace {
+
+constexpr const char* MANIFEST_NAME = "NAMESPACES";
+constexpr auto REAP_INTERVAL = std::chrono::milliseconds(100);
+
+// Keeps the namespace's instance alive for as long as the transaction is, so
+// a drop never shuts an engine down underneath a running request. On a
+// namespace that does not exist yet it reads as empty, and only its first
+// write creates the namespace.
+class NamespaceTransaction : public Transaction {
+public:
+    using CreateFunction = std::function<std::shared_ptr<Database>()>;
+    
+    NamespaceTransaction(std::shared_ptr<Database> database, std::shared_ptr<Transaction> transaction)
+        : database_(std::move(database)), transaction_(std::move(transaction)) {}
+    
+    explicit NamespaceTransaction(CreateFunction create) : create_(std::move(create)) {}
+    
+    std::string get(const std::string& key) override {
+        return transaction_ ? transaction_->get(key) : std::string();
+    }
+    
+    OperationResult put(const std::string& key, const std::string& value) override {
+        return attach() ? transaction_->put(key, value) : OperationResult::SYSTEM_ERROR;
+    }
+    
+    OperationResult put_with_ttl(const std::string& key, const std::string& value, uint64_t ttl_ms) override {
+        return attach() ? transaction_->put_with_ttl(key, value, ttl_ms) : OperationResult::SYSTEM_ERROR;
+    }
+    
+    OperationResult del(const std::string& key) override {
+        return transaction_ ? transaction_->del(key) : OperationResult::KEY_NOT_FOUND;
+    }
+    
+    OperationResult del_range(const std::string& start_key, const std::string& end_key) override {
+        // A namespace never written has nothing in any range
+        return transaction_ ? transaction_->del_range(start_key, end_key) : OperationResult::SUCCESS;
+    }
+    
+    std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key,
+                                                         const std::string& end_key,
+                                                         size_t limit) override {
+        if (!transaction_) {
+            return {};
+        }
+        return transaction_->scan(start_key, end_key, limit);
+    }
+    
+    OperationResult commit() override {
+        return transaction_ ? transaction_->commit() : OperationResult::SUCCESS;
+    }
+    
+    void rollback() override {
+        if (transaction_) {
+            transaction_->rollback();
+        }
+    }
+    
+    uint64_t get_id() const override {
+        return transaction_ ? transaction_->get_id() : 0;
+    }
+    
+private:
+    std::shared_ptr<Database> database_;
+    std::shared_ptr<Transaction> transaction_;
+    CreateFunction create_;
+    
+    // Create the namespace for a first write
+    bool attach() {
+        if (transaction_) {
+            return true;
+        }
+        database_ = create_ ? create_() : nullptr;
+        transaction_ = database_ ? database_->begin_transaction() : nullptr;
+        return transaction_ != nullptr;
+    }
+};
+
+EngineOptions namespace_settings(const NamespacedDatabaseOptions& options, uint32_t namespace_id) {
+    EngineOptions settings = options.defaults;
+    auto it = options.overrides.find(namespace_id);
+    if (it != options.overrides.end()) {
+        for (const auto& [name, value] : it->second) {
+            settings[name] = value;
+        }
+    }
+    return settings;
+}
+
+// "<id>.<generation>"; false for anything else
+bool parse_namespace_dir(const std::string& name, uint32_t& namespace_id, uint64_t& generation) {
+    size_t dot = name.find('.');
+    if (dot == 0 || dot == std::string::npos || dot + 1 == name.size() ||
+        name.find_first_not_of("0123456789.") != std::string::npos || name.find('.', dot + 1) != std::string::npos) {
+        return false;
+    }
+    uint64_t id = std::stoull(name.substr(0, dot));
+    if (id == 0 || id > UINT32_MAX) {
+        return false;
+    }
+    namespace_id = static_cast<uint32_t>(id);
+    generation = std::stoull(name.substr(dot + 1));
+    return true;
+}
+
+bool write_manifest_file(const std::string& path, const std::map<uint32_t, uint64_t>& generations,
+                         uint64_t next_generation) {
+    {
+        std::ofstream out(path + ".tmp", std::ios::trunc);
+        out << "version 1\n";
+        out << "next_generation " << next_generation << "\n";
+        for (const auto& [namespace_id, generation] : generations) {
+            out << "namespace " << namespace_id << " " << generation << "\n";
+        }
+        out.flush();
+        if (!out.good()) {
+            return false;
+        }
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(path + ".tmp", path, ec);
+    return !ec && sync_path(path) && sync_path(std::filesystem::path(path).parent_path().string());
+}
+
+} // namespace
+
+NamespacedDatabase::NamespacedDatabase(const NamespacedDatabaseOptions& options)
+    : options_(options), initialized_(false), next_generation_(1), stopping_(false),
+      namespaces_created_(0), namespaces_dropped_(0), namespaces_truncated_(0), instances_reaped_(0) {
+}
+
+NamespacedDatabase::~NamespacedDatabase() {
+    shutdown();
+}
+
+bool NamespacedDatabase::validate(const NamespacedDatabaseOptions& options, std::string& error) {
+    if (!EngineRegistry::instance().create(options.engine, options.defaults, error)) {
+        return false;
+    }
+    for (const auto& [namespace_id, overrides] : options.overrides) {
+        if (!EngineRegistry::instance().create(options.engine, namespace_settings(options, namespace_id), error)) {
+            error = "namespace " + std::to_string(namespace_id) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string NamespacedDatabase::namespaces_dir() const {
+    return data_dir_ + "/namespaces";
+}
+
+std::string NamespacedDatabase::manifest_path() const {
+    return namespaces_dir() + "/" + MANIFEST_NAME;
+}
+
+std::string NamespacedDatabase::namespace_dir(uint32_t namespace_id, uint64_t generation) const {
+    if (namespace_id == 0) {
+        return data_dir_;
+    }
+    return namespaces_dir() + "/" + std::to_string(namespace_id) + "." + std::to_string(generation);
+}
+
+OperationResult NamespacedDatabase::initialize(const std::string& data_dir) {
+    if (initialized_) {
+        return OperationResult::SUCCESS;
+    }
+    data_dir_ = data_dir;
+    
+    std::error_code ec;
+    std::filesystem::create_directories(namespaces_dir(), ec);
+    if (ec) {
+        std::cerr << "Failed to create " << namespaces_dir() << ": " << ec.message() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::map<uint32_t, uint64_t> generations;
+    next_generation_ = 1;
+    if (std::filesystem::exists(manifest_path()) && !read_manifest(generations)) {
+        std::cerr << "Invalid namespace manifest " << manifest_path() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::map<uint32_t, Namespace> namespaces;
+    generations[0] = 0;
+    for (const auto& [namespace_id, generation] : generations) {
+        auto database = open_namespace(namespace_id, generation);
+        if (!database) {
+            for (auto& [opened_id, opened] : namespaces) {
+                opened.database->shutdown();
+            }
+            return OperationResult::SYSTEM_ERROR;
+        }
+        namespaces[namespace_id] = Namespace{generation, std::move(database)};
+    }
+    
+    // Generations a crash left behind: dropped or truncated before the old
+    // directory was deleted, or created without reaching the manifest
+    for (const auto& entry : std::filesystem::directory_iterator(namespaces_dir(), ec)) {
+        uint32_t namespace_id = 0;
+        uint64_t generation = 0;
+        if (!parse_namespace_dir(entry.path().filename().string(), namespace_id, generation)) {
+            continue;
+        }
+        next_generation_ = std::max(next_generation_, generation + 1);
+        auto live = namespaces.find(namespace_id);
+        if (live == namespaces.end() || live->second.generation != generation) {
+            retired_.push_back(Retired{nullptr, entry.path().string()});
+        }
+    }
+    
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        namespaces_ = std::move(namespaces);
+    }
+    stopping_ = false;
+    reaper_ = std::thread(&NamespacedDatabase::reaper_loop, this);
+    initialized_ = true;
+    
+    std::cout << "Opened " << generations.size() << " namespaces in " << data_dir_ << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+void NamespacedDatabase::shutdown() {
+    if (!initialized_) {
+        return;
+    }
+    initialized_ = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        stopping_ = true;
+    }
+    retired_cv_.notify_all();
+    if (reaper_.joinable()) {
+        reaper_.join();
+    }
+    
+    std::map<uint32_t, Namespace> namespaces;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        namespaces.swap(namespaces_);
+    }
+    for (auto& [namespace_id, entry] : namespaces) {
+        entry.database->shutdown();
+    }
+    reap(true);
+}
+
+std::shared_ptr<Database> NamespacedDatabase::open_namespace(uint32_t namespace_id, uint64_t generation) {
+    std::string error;
+    auto database = EngineRegistry::instance().create(options_.engine, namespace_settings(options_, namespace_id),
+                                                      error);
+    if (!database) {
+        std::cerr << "Cannot create namespace " << namespace_id << ": " << error << std::endl;
+        return nullptr;
+    }
+    
+    std::string dir = namespace_dir(namespace_id, generation);
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec || database->initialize(dir) != OperationResult::SUCCESS) {
+        std::cerr << "Failed to open namespace " << namespace_id << " in " << dir << std::endl;
+        return nullptr;
+    }
+    return database;
+}
+
+std::shared_ptr<Database> NamespacedDatabase::find(uint32_t namespace_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = namespaces_.find(namespace_id);
+    return it == namespaces_.end() ? nullptr : it->second.database;
+}
+
+std::map<uint32_t, uint64_t> NamespacedDatabase::live_generations() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::map<uint32_t, uint64_t> generations;
+    for (const auto& [namespace_id, entry] : namespaces_) {
+        if (namespace_id != 0) {
+            generations[namespace_id] = entry.generation;
+        }
+    }
+    return generations;
+}
+
+std::shared_ptr<Transaction> NamespacedDatabase::begin_transaction() {
+    return begin_transaction_in(0);
+}
+
+std::shared_ptr<Database> NamespacedDatabase::find_or_create(uint32_t namespace_id) {
+    auto database = find(namespace_id);
+    if (database || !initialized_) {
+        return database;
+    }
+    
+    std::unique_lock<std::mutex> manifest_lock(manifest_mutex_);
+    wait_opened(manifest_lock, namespace_id);
+    database = find(namespace_id);
+    if (database) {
+        return database;
+    }
+    
+    // Namespaces still opening count against the limit too
+    size_t count = live_generations().size() + opening_.size() + 1;
+    if (count >= options_.max_namespaces) {
+        std::cerr << "Refusing namespace " << namespace_id << ": already " << count << " namespaces" << std::endl;
+        return nullptr;
+    }
+    
+    database = open_and_publish(manifest_lock, namespace_id);
+    if (database) {
+        namespaces_created_++;
+    }
+    return database;
+}
+
+void NamespacedDatabase::wait_opened(std::unique_lock<std::mutex>& manifest_lock, uint32_t namespace_id, bool all) {
+    opening_cv_.wait(manifest_lock, [this, namespace_id, all]() {
+        return all ? opening_.empty() : opening_.count(namespace_id) == 0;
+    });
+}
+
+std::shared_ptr<Database> NamespacedDatabase::open_and_publish(std::unique_lock<std::mutex>& manifest_lock,
+                                                               uint32_t namespace_id) {
+    // Replaying a WAL or loading a snapshot can take a while; other
+    // namespaces are created, dropped and truncated meanwhile
+    uint64_t generation = next_generation_++;
+    opening_.insert(namespace_id);
+    manifest_lock.unlock();
+    auto database = open_namespace(namespace_id, generation);
+    manifest_lock.lock();
+    opening_.erase(namespace_id);
+    opening_cv_.notify_all();
+    
+    if (!database) {
+        retire(nullptr, namespace_dir(namespace_id, generation));
+        return nullptr;
+    }
+    if (replace_namespace(namespace_id, generation, database) != OperationResult::SUCCESS) {
+        retire(database, namespace_dir(namespace_id, generation));
+        return nullptr;
+    }
+    return database;
+}
+
+std::shared_ptr<Transaction> NamespacedDatabase::begin_transaction_in(uint32_t namespace_id) {
+    if (!initialized_) {
+        return nullptr;
+    }
+    
+    // Reads of an unknown id must not create it: that would cost an engine
+    // open each and let reads alone use up max_namespaces
+    auto database = find(namespace_id);
+    if (!database) {
+        return std::make_shared<NamespaceTransaction>([this, namespace_id]() { return find_or_create(namespace_id); });
+    }
+    
+    auto transaction = database->begin_transaction();
+    if (!transaction || namespace_id == 0) {
+        return transaction;
+    }
+    return std::make_shared<NamespaceTransaction>(std::move(database), std::move(transaction));
+}
+
+OperationResult NamespacedDatabase::bulk_load(const std::string& input_path, uint64_t& entries) {
+    return bulk_load_in(0, input_path, entries);
+}
+
+OperationResult NamespacedDatabase::bulk_load_in(uint32_t namespace_id, const std::string& input_path,
+                                                 uint64_t& entries) {
+    entries = 0;
+    auto database = find_or_create(namespace_id);
+    if (!database) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // A drop meanwhile retires the instance, which is reaped once this returns
+    return database->bulk_load(input_path, entries);
+}
+
+OperationResult NamespacedDatabase::ingest_files(const std::vector<std::string>& paths, uint64_t& entries) {
+    return ingest_files_in(0, paths, entries);
+}
+
+OperationResult NamespacedDatabase::ingest_files_in(uint32_t namespace_id, const std::vector<std::string>& paths,
+                                                    uint64_t& entries) {
+    entries = 0;
+    auto database = find_or_create(namespace_id);
+    if (!database) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    return database->ingest_files(paths, entries);
+}
+
+OperationResult NamespacedDatabase::replace_namespace(uint32_t namespace_id, uint64_t generation,
+                                                      std::shared_ptr<Database> fresh) {
+    // The manifest goes first: after a crash the namespace is either wholly
+    // the old generation or wholly the new one
+    auto generations = live_generations();
+    if (fresh) {
+        generations[namespace_id] = generation;
+    } else {
+        generations.erase(namespace_id);
+    }
+    if (!write_manifest(generations)) {
+        std::cerr << "Failed to write " << manifest_path() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    Namespace old{0, nullptr};
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = namespaces_.find(namespace_id);
+        if (it != namespaces_.end()) {
+            old = std::move(it->second);
+            namespaces_.erase(it);
+        }
+        if (fresh) {
+            namespaces_[namespace_id] = Namespace{generation, std::move(fresh)};
+        }
+    }
+    if (old.database) {
+        retire(std::move(old.database), namespace_dir(namespace_id, old.generation));
+    }
+    return OperationResult::SUCCESS;
+}
+
+OperationResult NamespacedDatabase::drop_namespace(uint32_t namespace_id) {
+    if (namespace_id == 0 || !initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::unique_lock<std::mutex> manifest_lock(manifest_mutex_);
+    wait_opened(manifest_lock, namespace_id);
+    if (!find(namespace_id)) {
+        return OperationResult::KEY_NOT_FOUND;
+    }
+    OperationResult result = replace_namespace(namespace_id, 0, nullptr);
+    if (result == OperationResult::SUCCESS) {
+        namespaces_dropped_++;
+    }
+    return result;
+}
+
+OperationResult NamespacedDatabase::truncate_namespace(uint32_t namespace_id) {
+    if (namespace_id == 0 || !initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    std::unique_lock<std::mutex> manifest_lock(manifest_mutex_);
+    wait_opened(manifest_lock, namespace_id);
+    if (!find(namespace_id)) {
+        return OperationResult::SUCCESS;    // Never used, so already empty
+    }
+    
+    // An empty instance in a new directory replaces the old one
+    if (!open_and_publish(manifest_lock, namespace_id)) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    namespaces_truncated_++;
+    return OperationResult::SUCCESS;
+}
+
+bool NamespacedDatabase::write_manifest(const std::map<uint32_t, uint64_t>& generations) {
+    return write_manifest_file(manifest_path(), generations, next_generation_);
+}
+
+bool NamespacedDatabase::read_manifest(std::map<uint32_t, uint64_t>& generations) {
+    std::ifstream in(manifest_path());
+    if (!in.is_open()) {
+        return false;
+    }
+    
+    std::string field;
+    bool versioned = false;
+    while (in >> field) {
+        if (field == "version") {
+            std::string value;
+            in >> value;
+            versioned = value == "1";
+        } else if (field == "next_generation") {
+            in >> next_generation_;
+        } else if (field == "namespace") {
+            uint32_t namespace_id;
+            uint64_t generation;
+            if (!(in >> namespace_id >> generation) || namespace_id == 0) {
+                return false;
+            }
+            generations[namespace_id] = generation;
+        } else {
+            return false;
+        }
+    }
+    
+    return versioned;
+}
+
+void NamespacedDatabase::retire(std::shared_ptr<Database> database, const std::string& dir) {
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_.push_back(Retired{std::move(database), dir});
+    }
+    retired_cv_.notify_all();
+}
+
+void NamespacedDatabase::reaper_loop() {
+    std::unique_lock<std::mutex> lock(retired_mutex_);
+    while (!stopping_) {
+        if (!retired_.empty()) {
+            lock.unlock();
+            reap(false);
+            lock.lock();
+        }
+        retired_cv_.wait_for(lock, REAP_INTERVAL);
+    }
+}
+
+void NamespacedDatabase::reap(bool force) {
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        for (auto it = retired_.begin(); it != retired_.end();) {
+            // The retired entry holds the last reference once transactions are done
+            if (force || !it->database || it->database.use_count() == 1) {
+                ready.push_back(std::move(*it));
+                it = retired_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    for (auto& retired : ready) {
+        if (retired.database) {
+            retired.database->shutdown();
+            retired.database.reset();
+        }
+        std::error_code ec;
+        std::filesystem::remove_all(retired.dir, ec);
+        if (ec) {
+            std::cerr << "Failed to delete " << retired.dir << ": " << ec.message() << std::endl;
+        }
+        instances_reaped_++;
+    }
+}
+
+std::unordered_map<std::string, std::string> NamespacedDatabase::get_stats() const {
+    std::map<uint32_t, Namespace> namespaces;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        namespaces = namespaces_;
+    }
+    
+    std::unordered_map<std::string, std::string> stats;
+    for (const auto& [namespace_id, entry] : namespaces) {
+        std::string prefix = namespace_id == 0 ? "" : "ns" + std::to_string(namespace_id) + "_";
+        for (const auto& [name, value] : entry.database->get_stats()) {
+            stats[prefix + name] = value;
+        }
+    }
+    
+    size_t retired;
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired = retired_.size();
+    }
+    stats["namespaces"] = std::to_string(namespaces.size());
+    stats["namespaces_created"] = std::to_string(namespaces_created_.load());
+    stats["namespaces_dropped"] = std::to_string(namespaces_dropped_.load());
+    stats["namespaces_truncated"] = std::to_string(namespaces_truncated_.load());
+    stats["namespaces_retired"] = std::to_string(retired);
+    stats["namespaces_reaped"] = std::to_string(instances_reaped_.load());
+    return stats;
+}
+
+OperationResult NamespacedDatabase::compact() {
+    std::map<uint32_t, Namespace> namespaces;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        namespaces = namespaces_;
+    }
+    
+    OperationResult result = OperationResult::SUCCESS;
+    for (const auto& [namespace_id, entry] : namespaces) {
+        OperationResult compacted = entry.database->compact();
+        if (compacted != OperationResult::SUCCESS) {
+            result = compacted;
+        }
+    }
+    return result;
+}
+
+OperationResult NamespacedDatabase::backup(const std::string& backup_path) {
+    std::map<uint32_t, Namespace> namespaces;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        namespaces = namespaces_;
+    }
+    if (namespaces.empty()) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Namespace 0 is the backup itself, the others go in namespaces/<id>
+    std::string namespaces_backup = backup_path + "/namespaces";
+    std::error_code ec;
+    std::filesystem::remove_all(namespaces_backup, ec);
+    OperationResult result = namespaces[0].database->backup(backup_path);
+    for (const auto& [namespace_id, entry] : namespaces) {
+        if (result != OperationResult::SUCCESS) {
+            break;
+        }
+        if (namespace_id == 0) {
+            continue;
+        }
+        std::string dir = namespaces_backup + "/" + std::to_string(namespace_id);
+        std::filesystem::create_directories(dir, ec);
+        result = ec ? OperationResult::SYSTEM_ERROR : entry.database->backup(dir);
+    }
+    return result;
+}
+
+OperationResult NamespacedDatabase::restore(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    std::unique_lock<std::mutex> manifest_lock(manifest_mutex_);
+    wait_opened(manifest_lock, 0, true);
+    
+    // Every namespace in the backup is restored into a new generation first;
+    // nothing is swapped in until all of them have loaded
+    std::map<uint32_t, Namespace> restored;
+    auto discard = [this, &restored]() {
+        for (auto& [namespace_id, entry] : restored) {
+            retire(std::move(entry.database), namespace_dir(namespace_id, entry.generation));
+        }
+        return OperationResult::SYSTEM_ERROR;
+    };
+    
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(backup_path + "/namespaces", ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.empty() || name.find_first_not_of("0123456789") != std::string::npos || name.size() > 10) {
+            continue;
+        }
+        uint64_t id = std::stoull(name);
+        if (id == 0 || id > UINT32_MAX) {
+            continue;
+        }
+        
+        uint32_t namespace_id = static_cast<uint32_t>(id);
+        uint64_t generation = next_generation_++;
+        auto database = open_namespace(namespace_id, generation);
+        if (!database) {
+            retire(nullptr, namespace_dir(namespace_id, generation));
+            return discard();
+        }
+        restored[namespace_id] = Namespace{generation, database};
+        if (database->restore(entry.path().string()) != OperationResult::SUCCESS) {
+            return discard();
+        }
+    }
+    
+    auto root = find(0);
+    if (!root || root->restore(backup_path) != OperationResult::SUCCESS) {
+        return discard();
+    }
+    
+    std::map<uint32_t, uint64_t> generations;
+    for (const auto& [namespace_id, entry] : restored) {
+        generations[namespace_id] = entry.generation;
+    }
+    if (!write_manifest(generations)) {
+        std::cerr << "Failed to write " << manifest_path() << std::endl;
+        return discard();
+    }
+    
+    std::map<uint32_t, Namespace> old;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        old.swap(namespaces_);
+        namespaces_ = std::move(restored);
+        namespaces_[0] = std::move(old[0]);
+        old.erase(0);
+    }
+    for (auto& [namespace_id, entry] : old) {
+        retire(std::move(entry.database), namespace_dir(namespace_id, entry.generation));
+    }
+    return OperationResult::SUCCESS;
+}
+
+OperationResult NamespacedDatabase::freeze_backup_files(BackupFileSet& file_set) {
+    std::map<uint32_t, Namespace> namespaces;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        namespaces = namespaces_;
+    }
+    if (namespaces.empty() || namespaces[0].database->freeze_backup_files(file_set) != OperationResult::SUCCESS) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // The streamed tree is a data directory of its own, so each namespace
+    // starts over at generation 1 under a manifest written for it
+    std::vector<std::pair<std::shared_ptr<Database>, BackupFileSet>> frozen;
+    std::map<uint32_t, uint64_t> generations;
+    bool ok = !file_set.staging_dir.empty();
+    for (const auto& [namespace_id, entry] : namespaces) {
+        if (!ok) {
+            break;
+        }
+        if (namespace_id == 0) {
+            continue;
+        }
+        BackupFileSet part;
+        if (entry.database->freeze_backup_files(part) != OperationResult::SUCCESS) {
+            ok = false;
+            break;
+        }
+        std::string prefix = "namespaces/" + std::to_string(namespace_id) + ".1/";
+        for (const auto& file : part.files) {
+            file_set.files.push_back(BackupFileSet::File{file.path, prefix + file.name});
+        }
+        generations[namespace_id] = 1;
+        frozen.emplace_back(entry.database, std::move(part));
+    }
+    
+    std::string manifest = file_set.staging_dir + "/" + MANIFEST_NAME;
+    if (ok && write_manifest_file(manifest, generations, 2)) {
+        file_set.files.push_back(BackupFileSet::File{manifest, std::string("namespaces/") + MANIFEST_NAME});
+        std::lock_guard<std::mutex> lock(frozen_mutex_);
+        frozen_[file_set.staging_dir] = std::move(frozen);
+        return OperationResult::SUCCESS;
+    }
+    
+    for (auto& [database, part] : frozen) {
+        database->release_backup_files(part);
+    }
+    namespaces[0].database->release_backup_files(file_set);
+    return OperationResult::SYSTEM_ERROR;
+}
+
+void NamespacedDatabase::release_backup_files(const BackupFileSet& file_set) {
+    std::vector<std::pair<std::shared_ptr<Database>, BackupFileSet>> frozen;
+    {
+        std::lock_guard<std::mutex> lock(frozen_mutex_);
+        auto it = frozen_.find(file_set.staging_dir);
+        if (it != frozen_.end()) {
+            frozen = std::move(it->second);
+            frozen_.erase(it);
+        }
+    }
+    for (auto& [database, part] : frozen) {
+        database->release_backup_files(part);
+    }
+    
+    auto root = find(0);
+    if (root) {
+        root->release_backup_files(file_set);
+    }
+}
+
+// Factory implementation
+std::shared_ptr<Database> DatabaseFactory::create_namespaced_database(
+    const std::string& engine_name, const EngineOptions& options,
+    const std::unordered_map<uint32_t, EngineOptions>& namespace_options) {
+    NamespacedDatabaseOptions settings;
+    settings.engine = engine_name;
+    settings.defaults = options;
+    settings.overrides = namespace_options;
+    
+    std::string error;
+    if (!NamespacedDatabase::validate(settings, error)) {
+        std::cerr << "Cannot create " << engine_name << " database: " << error << std::endl;
+        return nullptr;
+    }
+    return std::make_shared<NamespacedDatabase>(settings);
+}
+
+} // namespace distributeddb
@@ -1,65 +1,450 @@
-#include "core/database.h"
+#include "core/persistent_database.h"
 #include "storage/wal.h"
+#include "storage/snapshot.h"
+#include "storage/block_file.h"
+#include "storage/value_log.h"
 #include <iostream>
+#include <filesystem>
+#include <algorithm>
 #include <shared_mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <climits>
 
 namespace distributeddb {
 
-class PersistentTransaction : public Transaction {
-public:
-    PersistentTransaction(std::unordered_map<std::string, std::string>& data,
-                         std::shared_mutex& mutex,
-                         std::shared_ptr<WriteAheadLog> wal,
-                         uint64_t id)
-        : data_(data), mutex_(mutex), wal_(wal), id_(id), has_writes_(false) {}
+namespace {
+
+// Pages this process no longer shares with its parent, read from
+// /proc/self/smaps_rollup. Called in a fork child it is the copy-on-write cost.
+uint64_t read_private_dirty_pages() {
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string line;
+    uint64_t kb = 0;
     
-    std::string get(const std::string& key) override {
-        std::shared_lock<std::shared_mutex> lock(mutex_);
-        auto it = data_.find(key);
-        return (it != data_.end()) ? it->second : "";
+    while (std::getline(smaps, line)) {
+        if (line.compare(0, 14, "Private_Dirty:") == 0) {
+            kb += std::strtoull(line.c_str() + 14, nullptr, 10);
+        }
     }
     
-    OperationResult put(const std::string& key, const std::string& value) override {
-        std::unique_lock<std::shared_mutex> lock(mutex_);
+    long page_size = ::sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? kb * 1024 / static_cast<uint64_t>(page_size) : 0;
+}
+
+size_t resolve_threads(size_t configured) {
+    return configured > 0 ? configured : std::max(1u, std::thread::hardware_concurrency());
+}
+
+double megabytes_per_second(uint64_t bytes, int64_t microseconds) {
+    return microseconds > 0 ? static_cast<double>(bytes) / static_cast<double>(microseconds) : 0.0;
+}
+
+// Describes a backup directory; written last so a partial backup has none
+struct BackupManifest {
+    uint64_t start_lsn = 0;
+    uint64_t end_lsn = 0;
+    std::vector<std::string> partitions;
+    std::vector<std::string> wal_segments;
+    bool value_separation = false;
+    std::vector<std::string> value_log_segments;
+};
+
+const char* const BACKUP_MANIFEST = "backup.manifest";
+
+bool write_manifest(const std::string& dir, const BackupManifest& manifest) {
+    std::string path = dir + "/" + BACKUP_MANIFEST;
+    {
+        std::ofstream out(path + ".tmp", std::ios::trunc);
+        out << "version 1\n";
+        out << "start_lsn " << manifest.start_lsn << "\n";
+        out << "end_lsn " << manifest.end_lsn << "\n";
+        for (const auto& partition : manifest.partitions) {
+            out << "partition " << partition << "\n";
+        }
+        for (const auto& segment : manifest.wal_segments) {
+            out << "wal " << segment << "\n";
+        }
+        if (manifest.value_separation) {
+            out << "value_separation 1\n";
+        }
+        for (const auto& segment : manifest.value_log_segments) {
+            out << "vlog " << segment << "\n";
+        }
+        out.flush();
+        if (!out.good()) {
+            return false;
+        }
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(path + ".tmp", path, ec);
+    return !ec && sync_path(path) && sync_path(dir);
+}
+
+bool read_manifest(const std::string& dir, BackupManifest& manifest) {
+    std::ifstream in(dir + "/" + BACKUP_MANIFEST);
+    if (!in.is_open()) {
+        return false;
+    }
+    
+    std::string field, value;
+    bool versioned = false;
+    while (in >> field >> value) {
+        if (field == "version") {
+            versioned = value == "1";
+        } else if (field == "start_lsn") {
+            manifest.start_lsn = std::stoull(value);
+        } else if (field == "end_lsn") {
+            manifest.end_lsn = std::stoull(value);
+        } else if (field == "partition") {
+            manifest.partitions.push_back(value);
+        } else if (field == "wal") {
+            manifest.wal_segments.push_back(value);
+        } else if (field == "value_separation") {
+            manifest.value_separation = value == "1";
+        } else if (field == "vlog") {
+            manifest.value_log_segments.push_back(value);
+        }
+    }
+    
+    return versioned && !manifest.partitions.empty();
+}
+
+// With a value log every table value starts with a tag: an inline value
+// follows its tag, a separated one is replaced by a ValuePointer
+const char VALUE_INLINE = 0;
+const char VALUE_POINTER = 1;
+constexpr size_t POINTER_SIZE = 1 + 8 + 8 + 4;
+
+std::string encode_inline(const std::string& value) {
+    std::string stored;
+    stored.reserve(value.size() + 1);
+    stored.push_back(VALUE_INLINE);
+    stored.append(value);
+    return stored;
+}
+
+std::string encode_pointer(const ValuePointer& pointer) {
+    std::string stored(POINTER_SIZE, VALUE_POINTER);
+    std::memcpy(&stored[1], &pointer.segment, 8);
+    std::memcpy(&stored[9], &pointer.offset, 8);
+    std::memcpy(&stored[17], &pointer.size, 4);
+    return stored;
+}
+
+bool decode_pointer(const std::string& stored, ValuePointer& pointer) {
+    if (stored.size() != POINTER_SIZE || stored[0] != VALUE_POINTER) {
+        return false;
+    }
+    std::memcpy(&pointer.segment, &stored[1], 8);
+    std::memcpy(&pointer.offset, &stored[9], 8);
+    std::memcpy(&pointer.size, &stored[17], 4);
+    return true;
+}
+
+// The value a table entry stands for. Caller holds the shard lock, which
+// keeps the collector from deleting the segment a pointer refers to.
+std::string load_value(const ValueLog* value_log, const std::string& key, const std::string& stored) {
+    if (value_log == nullptr) {
+        return stored;
+    }
+    
+    ValuePointer pointer;
+    if (!decode_pointer(stored, pointer)) {
+        return stored.empty() ? stored : stored.substr(1);
+    }
+    
+    std::string value;
+    if (!value_log->read(pointer, key, value)) {
+        std::cerr << "Failed to read value of key " << key << " from the value log" << std::endl;
+    }
+    return value;
+}
+
+// Give up the value log record a replaced or deleted entry referred to
+void release_value(ValueLog* value_log, const std::string& key, const std::string& stored) {
+    ValuePointer pointer;
+    if (value_log != nullptr && decode_pointer(stored, pointer)) {
+        value_log->mark_dead(key, pointer);
+    }
+}
+
+uint64_t epoch_ms() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Add an entry to a snapshot, with its expiry time if it has one
+bool add_entry(SnapshotWriter& writer, const std::unordered_map<std::string, uint64_t>& expires,
+               const std::string& key, const std::string& value) {
+    if (!expires.empty()) {
+        auto it = expires.find(key);
+        if (it != expires.end()) {
+            return writer.add_expiring(key, value, it->second);
+        }
+    }
+    return writer.add(key, value);
+}
+
+// A delta carries the ranges still pending in a shard as range tombstones,
+// and every key written into them since as a dirty key, so recovery can drop
+// what they hide and put back what was rewritten. Caller holds the shard lock.
+void collect_dropped(const ShardedTable::Shard& shard,
+                     std::vector<std::pair<std::string, std::string>>& ranges,
+                     std::unordered_set<std::string>& dirty) {
+    for (const auto& [start, range] : shard.dropped) {
+        ranges.emplace_back(start, range.end);
+    }
+    for (const auto& [key, lsn] : shard.rewritten) {
+        if (ShardedTable::covering(shard, key) != nullptr) {
+            dirty.insert(key);
+        }
+    }
+}
+
+// Shards hold the same ranges, split where newer ones overlap; write each
+// covered span once
+void add_range_tombstones(SnapshotWriter& writer, std::vector<std::pair<std::string, std::string>>& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 0; i < ranges.size();) {
+        std::string start = ranges[i].first;
+        std::string end = ranges[i].second;
+        for (++i; i < ranges.size() && !(end < ranges[i].first); ++i) {
+            end = std::max(end, ranges[i].second);
+        }
+        writer.add_range_tombstone(start, end);
+    }
+}
+
+// An EXPIRE record lists keys that were removed when their expiry time, at
+// most the batch's horizon, ran out: u64 horizon, then (u32 length, key)
+// per key. Replay removes a key only if its expiry in the replayed state is
+// within the horizon, so a batch logged after the key was put again is harmless.
+constexpr size_t EXPIRE_BATCH_BYTES = 64 * 1024;
+
+bool decode_expire_batch(const std::string& value, uint64_t& horizon, std::vector<std::string>& keys) {
+    if (value.size() < sizeof(horizon)) {
+        return false;
+    }
+    std::memcpy(&horizon, value.data(), sizeof(horizon));
+    
+    size_t offset = sizeof(horizon);
+    while (offset < value.size()) {
+        uint32_t length;
+        if (value.size() - offset < sizeof(length)) {
+            return false;
+        }
+        std::memcpy(&length, value.data() + offset, sizeof(length));
+        offset += sizeof(length);
+        if (value.size() - offset < length) {
+            return false;
+        }
+        keys.emplace_back(value, offset, length);
+        offset += length;
+    }
+    return true;
+}
+
+// Replay an EXPIRE record into a table; on_removed, if set, is told the
+// shard, key and stored size of every entry the record removes
+void replay_expire(ShardedTable& table, const WALRecord& record,
+                   const std::function<void(size_t, const std::string&, size_t)>& on_removed) {
+    uint64_t horizon = 0;
+    std::vector<std::string> keys;
+    if (!decode_expire_batch(record.value, horizon, keys)) {
+        std::cerr << "Skipping malformed expire record at LSN " << record.lsn << std::endl;
+        return;
+    }
+    
+    for (const auto& key : keys) {
+        size_t index = table.shard_index(key);
+        auto& shard = table.shard(index);
+        auto expiry = shard.expires.find(key);
+        if (expiry == shard.expires.end() || expiry->second > horizon) continue;
         
-        // Update data first for better performance
-        data_[key] = value;
-        has_writes_ = true;
+        shard.expires.erase(expiry);
+        auto it = shard.data.find(key);
+        if (it != shard.data.end()) {
+            if (on_removed) {
+                on_removed(index, key, it->second.size());
+            }
+            shard.data.erase(it);
+        }
+        table.mark_dirty(shard, key);
+    }
+}
+
+// Replay a DELETE_RANGE record into a table; on_removed, if set, is told the
+// shard, key and stored size of every entry the record removes
+void replay_delete_range(ShardedTable& table, const WALRecord& record,
+                         const std::function<void(size_t, const std::string&, size_t)>& on_removed) {
+    for (size_t i = 0; i < table.shard_count(); ++i) {
+        auto& shard = table.shard(i);
+        for (auto it = shard.data.begin(); it != shard.data.end();) {
+            if (it->first < record.key || !(it->first < record.value)) {
+                ++it;
+                continue;
+            }
+            if (on_removed) {
+                on_removed(i, it->first, it->second.size());
+            }
+            shard.expires.erase(it->first);
+            table.mark_dirty(shard, it->first);
+            it = shard.data.erase(it);
+        }
+    }
+}
+
+// Bulk loaded and ingested entries stay in data_dir/bulk.<lsn>.<n>, block
+// files the BULK_LOAD record names, until a checkpoint covers the record
+const char* const BULK_PREFIX = "bulk.";
+
+// Keys erased per shard lock by the background purge of deleted ranges
+constexpr size_t PURGE_BATCH = 1024;
+
+// Undo the escaping of a bulk input field; false on a stray backslash
+bool unescape_field(const std::string& line, size_t begin, size_t end, std::string& field) {
+    field.clear();
+    field.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        if (line[i] != '\\') {
+            field.push_back(line[i]);
+            continue;
+        }
+        if (++i == end) {
+            return false;
+        }
+        switch (line[i]) {
+            case '\\': field.push_back('\\'); break;
+            case 't': field.push_back('\t'); break;
+            case 'n': field.push_back('\n'); break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+// Replay the file of a BULK_LOAD record into a table; on_put, if set, is told
+// the shard, key and old and new stored sizes of every entry, under the shard lock
+bool replay_bulk_file(ShardedTable& table, const std::string& path, size_t threads,
+                      const std::function<void(size_t, const std::string&, size_t, size_t)>& on_put) {
+    SnapshotHeader header;
+    return SnapshotReader::load(path, header, [&table, &on_put](BlockEntryType, std::string&& key,
+                                                                std::string&& value) {
+        size_t index = table.shard_index(key);
+        auto& shard = table.shard(index);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
         
-        // Log the operation to WAL (async batching could be added here)
-        WALRecord record;
-        record.type = WALRecordType::PUT;
-        record.key = key;
-        record.value = value;
-        record.key_length = static_cast<uint32_t>(key.length());
-        record.value_length = static_cast<uint32_t>(value.length());
-        record.transaction_id = id_;
+        // Bulk loaded keys never expire
+        if (!shard.expires.empty()) {
+            shard.expires.erase(key);
+        }
+        std::string& stored = shard.data[key];
+        size_t old_size = stored.size();
+        stored = std::move(value);
+        table.mark_dirty(shard, key);
+        if (on_put) {
+            on_put(index, key, old_size, stored.size());
+        }
+    }, threads);
+}
+
+} // namespace
+
+class PersistentTransaction : public Transaction {
+public:
+    PersistentTransaction(PersistentDatabase& db, uint64_t id)
+        : db_(db), table_(db.table_), wal_(db.wal_), id_(id), has_writes_(false),
+          value_log_(db.value_log_.get()), separation_threshold_(db.options_.value_separation_threshold),
+          tier_(db.tier_.get()), range_index_(db.range_index_.get()) {}
+    
+    std::string get(const std::string& key) override {
+        size_t index = table_.shard_index(key);
+        auto& shard = table_.shard(index);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.data.find(key);
+        if (it == shard.data.end() || ShardedTable::is_dropped(shard, key)) {
+            return "";
+        }
+        if (!shard.expires.empty()) {
+            // Expired but not yet reached by the expiry thread; removing it needs the exclusive lock
+            auto expiry = shard.expires.find(key);
+            if (expiry != shard.expires.end() && expiry->second <= epoch_ms()) {
+                lock.unlock();
+                db_.expire_lazily(index, key);
+                return "";
+            }
+        }
+        if (tier_ == nullptr) {
+            return load_value(value_log_, key, it->second);
+        }
         
-        if (!wal_->append_record(record)) {
-            // Rollback on WAL failure
-            data_.erase(key);
-            has_writes_ = false;
-            return OperationResult::SYSTEM_ERROR;
+        if (!tier_->is_packed(index, key, it->second)) {
+            tier_->hit(index, key);
+            return load_value(value_log_, key, it->second);
         }
         
-        return OperationResult::SUCCESS;
+        // Fault the value in or decompress it; promoting it needs the exclusive lock
+        TierManager::PackedEntry from;
+        std::string stored = it->second;
+        if (!tier_->unpack(index, key, stored, from)) {
+            return "";
+        }
+        lock.unlock();
+        
+        std::string value = load_value(value_log_, key, stored);
+        tier_->promote(index, key, std::move(stored), from);
+        tier_->enforce_budget();
+        return value;
+    }
+    
+    OperationResult put(const std::string& key, const std::string& value) override {
+        return write(key, value, 0);
+    }
+    
+    OperationResult put_with_ttl(const std::string& key, const std::string& value, uint64_t ttl_ms) override {
+        return write(key, value, ttl_ms > 0 ? epoch_ms() + ttl_ms : 0);
     }
     
     OperationResult del(const std::string& key) override {
-        std::unique_lock<std::shared_mutex> lock(mutex_);
+        size_t index = table_.shard_index(key);
+        auto& shard = table_.shard(index);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
         
-        auto it = data_.find(key);
-        if (it == data_.end()) {
+        auto it = shard.data.find(key);
+        if (it == shard.data.end() || ShardedTable::is_dropped(shard, key)) {
             return OperationResult::KEY_NOT_FOUND;
         }
         
+        uint64_t old_expiry = 0;
+        auto expiry = shard.expires.find(key);
+        if (expiry != shard.expires.end()) {
+            if (db_.expire_locked(index, key, epoch_ms())) {
+                return OperationResult::KEY_NOT_FOUND;
+            }
+            old_expiry = expiry->second;
+            shard.expires.erase(expiry);
+        }
+        
         // Store value for potential rollback
         std::string old_value = it->second;
         
         // Remove from data first
-        data_.erase(it);
+        shard.data.erase(it);
+        table_.mark_dirty(shard, key);
         has_writes_ = true;
         
         // Log the operation to WAL
@@ -71,24 +456,70 @@ public:
         
         if (!wal_->append_record(record)) {
             // Rollback on WAL failure
-            data_[key] = old_value;
+            shard.data[key] = old_value;
+            if (old_expiry > 0) {
+                shard.expires[key] = old_expiry;
+            }
             has_writes_ = false;
             return OperationResult::SYSTEM_ERROR;
         }
         
+        release_value(value_log_, key, old_value);
+        if (tier_ != nullptr) {
+            tier_->changed(index, key, old_value.size(), 0);
+        }
+        if (range_index_ != nullptr) {
+            range_index_->remove(key);
+        }
+        return OperationResult::SUCCESS;
+    }
+    
+    OperationResult del_range(const std::string& start_key, const std::string& end_key) override {
+        if (!db_.delete_range(start_key, end_key, id_)) {
+            return OperationResult::SYSTEM_ERROR;
+        }
+        has_writes_ = true;
         return OperationResult::SUCCESS;
     }
     
     std::vector<std::pair<std::string, std::string>> scan(const std::string& start_key, 
                                                           const std::string& end_key, 
                                                           size_t limit) override {
-        std::shared_lock<std::shared_mutex> lock(mutex_);
         std::vector<std::pair<std::string, std::string>> result;
+        uint64_t now = epoch_ms();
+        
+        if (range_index_ != nullptr) {
+            // Keys come in order from the index and their values from the
+            // table; a key deleted or expired in between is skipped, and the
+            // index asked for more until limit is reached
+            std::string cursor = start_key;
+            while (result.size() < limit) {
+                size_t wanted = limit - result.size();
+                auto keys = range_index_->scan(cursor, end_key, wanted);
+                for (const auto& key : keys) {
+                    size_t i = table_.shard_index(key);
+                    const auto& shard = table_.shard(i);
+                    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                    auto it = shard.data.find(key);
+                    if (it != shard.data.end()) {
+                        add_result(i, shard, key, it->second, now, result);
+                    }
+                }
+                if (keys.size() < wanted) break;
+                cursor = keys.back() + '\0';
+            }
+            return result;
+        }
         
-        for (const auto& pair : data_) {
-            if (pair.first >= start_key && pair.first < end_key) {
-                result.emplace_back(pair.first, pair.second);
-                if (result.size() >= limit) break;
+        for (size_t i = 0; i < table_.shard_count() && result.size() < limit; ++i) {
+            const auto& shard = table_.shard(i);
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            
+            for (const auto& pair : shard.data) {
+                if (pair.first >= start_key && pair.first < end_key) {
+                    add_result(i, shard, pair.first, pair.second, now, result);
+                    if (result.size() >= limit) break;
+                }
             }
         }
         
@@ -120,144 +551,2209 @@ public:
     }
 
 private:
-    std::unordered_map<std::string, std::string>& data_;
-    std::shared_mutex& mutex_;
+    PersistentDatabase& db_;
+    ShardedTable& table_;
     std::shared_ptr<WriteAheadLog> wal_;
     uint64_t id_;
     bool has_writes_;
-};
-
-class PersistentDatabase : public Database {
-public:
-    PersistentDatabase() : initialized_(false), next_transaction_id_(1) {}
+    ValueLog* value_log_;
+    size_t separation_threshold_;
+    TierManager* tier_;
+    RangeIndex* range_index_;
     
-    OperationResult initialize(const std::string& data_dir) override {
-        data_dir_ = data_dir;
+    // Append a scanned entry unless it has expired or been deleted with its range. Shard lock held.
+    void add_result(size_t index, const ShardedTable::Shard& shard, const std::string& key, const std::string& stored,
+                    uint64_t now, std::vector<std::pair<std::string, std::string>>& result) {
+        if (ShardedTable::is_dropped(shard, key)) return;
         
-        // Initialize WAL
-        std::string wal_dir = data_dir + "/wal";
-        wal_ = std::make_shared<WriteAheadLog>(wal_dir);
+        // Expired keys are left for the expiry thread; a scan only skips them
+        if (!shard.expires.empty()) {
+            auto expiry = shard.expires.find(key);
+            if (expiry != shard.expires.end() && expiry->second <= now) return;
+        }
+        
+        // Spilled and compressed values are read in place; a scan should not evict the working set
+        if (tier_ != nullptr && tier_->is_packed(index, key, stored)) {
+            std::string resolved = stored;
+            if (!tier_->resolve(index, key, resolved)) return;
+            result.emplace_back(key, load_value(value_log_, key, resolved));
+        } else {
+            result.emplace_back(key, load_value(value_log_, key, stored));
+        }
+    }
+    
+    // Put key, expiring at expire_ms or never if it is 0
+    OperationResult write(const std::string& key, const std::string& value, uint64_t expire_ms) {
+        // A large value goes to the value log before any lock is taken; the
+        // table and the WAL then carry only its pointer
+        std::string stored;
+        ValuePointer pointer;
+        bool separated = false;
+        if (value_log_ == nullptr) {
+            stored = value;
+        } else if (separation_threshold_ > 0 && value.size() >= separation_threshold_) {
+            if (!value_log_->append(key, value, pointer)) {
+                return OperationResult::SYSTEM_ERROR;
+            }
+            stored = encode_pointer(pointer);
+            separated = true;
+        } else {
+            stored = encode_inline(value);
+        }
+        
+        // The shard lock is held across the WAL append so that a key's
+        // in-memory order always matches its LSN order
+        size_t index = table_.shard_index(key);
+        auto& shard = table_.shard(index);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
         
-        // Recover from WAL if exists
-        if (!recover_from_wal()) {
-            std::cerr << "Failed to recover from WAL" << std::endl;
+        // Update data first for better performance
+        auto [it, inserted] = shard.data.try_emplace(key);
+        std::string old_value = inserted ? std::string() : std::move(it->second);
+        it->second = stored;
+        table_.mark_dirty(shard, key);
+        has_writes_ = true;
+        
+        // A plain put makes the key permanent again
+        uint64_t old_expiry = 0;
+        auto expiry = shard.expires.find(key);
+        if (expiry != shard.expires.end()) {
+            old_expiry = expiry->second;
+            if (expire_ms == 0) {
+                shard.expires.erase(expiry);
+            }
+        }
+        if (expire_ms > 0) {
+            shard.expires[key] = expire_ms;
+        }
+        
+        // Log the operation to WAL (async batching could be added here)
+        WALRecord record;
+        record.type = expire_ms > 0 ? WALRecordType::PUT_TTL : WALRecordType::PUT;
+        record.key = key;
+        record.value = expire_ms > 0 ? encode_expiring_value(stored, expire_ms) : std::move(stored);
+        record.key_length = static_cast<uint32_t>(key.length());
+        record.value_length = static_cast<uint32_t>(record.value.length());
+        record.transaction_id = id_;
+        
+        uint64_t lsn = 0;
+        if (!wal_->append_record(record, &lsn)) {
+            // Rollback on WAL failure
+            if (inserted) {
+                shard.data.erase(it);
+            } else {
+                it->second = std::move(old_value);
+            }
+            if (old_expiry > 0) {
+                shard.expires[key] = old_expiry;
+            } else {
+                shard.expires.erase(key);
+            }
+            if (separated) {
+                value_log_->mark_dead(key, pointer);
+            }
+            has_writes_ = false;
             return OperationResult::SYSTEM_ERROR;
         }
         
-        initialized_ = true;
-        std::cout << "Persistent database initialized with data directory: " << data_dir << std::endl;
+        // A range deleted before this write no longer hides the key
+        ShardedTable::note_write(shard, key, lsn);
+        
+        // A timer left by an earlier TTL finds the new expiry and does nothing
+        if (expire_ms > 0) {
+            db_.expiry_wheel_.schedule(key, expire_ms);
+        }
+        
+        if (range_index_ != nullptr) {
+            if (inserted) {
+                range_index_->insert(key);
+            } else {
+                range_index_->touch(key);
+            }
+        }
+        
+        release_value(value_log_, key, old_value);
+        if (tier_ != nullptr) {
+            tier_->changed(index, key, old_value.size(), it->second.size());
+            lock.unlock();
+            tier_->enforce_budget();
+        }
         return OperationResult::SUCCESS;
     }
+};
+
+PersistentDatabase::PersistentDatabase(const PersistentDatabaseOptions& options)
+    : options_(options), table_(options.shard_count), initialized_(false), next_transaction_id_(1),
+      base_lsn_(0), delta_count_(0), need_full_(true), last_checkpoint_entries_(0),
+      fork_count_(0), last_fork_pause_us_(0), last_cow_pages_(0),
+      last_backup_bytes_(0), last_backup_us_(0), last_restore_bytes_(0), last_restore_us_(0),
+      next_stream_id_(1), gc_stopping_(false), gc_count_(0), gc_moved_bytes_(0),
+      expiry_stopping_(false), expired_horizon_(0), expired_count_(0), lazy_expired_count_(0),
+      expire_batches_(0), bulk_loads_(0), bulk_loaded_keys_(0), ranges_deleted_(0), range_purged_keys_(0) {
+    table_.set_dirty_tracking(options_.max_delta_chain > 0);
+}
+
+PersistentDatabase::~PersistentDatabase() {
+    shutdown();
+}
+
+OperationResult PersistentDatabase::initialize(const std::string& data_dir) {
+    data_dir_ = data_dir;
     
-    void shutdown() override {
-        if (initialized_) {
-            // Create checkpoint before shutdown
-            std::string checkpoint_file = data_dir_ + "/checkpoint.db";
-            wal_->create_checkpoint(checkpoint_file);
-            
-            std::cout << "Persistent database shutting down..." << std::endl;
-            initialized_ = false;
-        }
+    // Initialize WAL
+    std::string wal_dir = data_dir + "/wal";
+    try {
+        wal_ = std::make_shared<WriteAheadLog>(wal_dir);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to open WAL: " << e.what() << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    if (options_.ordered_index) {
+        range_index_ = std::make_unique<RangeIndex>(options_.ranges);
     }
     
-    std::shared_ptr<Transaction> begin_transaction() override {
-        if (!initialized_) {
-            return nullptr;
+    // Recovery already spills once the budget is reached
+    if (options_.tiering.memory_budget > 0 || options_.tiering.compress_min_size > 0) {
+        tier_ = std::make_unique<TierManager>(table_, options_.tiering);
+        if (!tier_->open(spill_dir())) {
+            tier_.reset();
+            return OperationResult::SYSTEM_ERROR;
         }
-        
-        uint64_t id = next_transaction_id_++;
-        return std::make_shared<PersistentTransaction>(data_, mutex_, wal_, id);
     }
     
-    std::unordered_map<std::string, std::string> get_stats() const override {
-        std::shared_lock<std::shared_mutex> lock(mutex_);
-        std::unordered_map<std::string, std::string> stats;
-        stats["total_keys"] = std::to_string(data_.size());
-        stats["data_directory"] = data_dir_;
-        stats["initialized"] = initialized_ ? "true" : "false";
-        stats["next_transaction_id"] = std::to_string(next_transaction_id_);
+    // Load the last snapshot, then replay the WAL segments it does not cover
+    uint64_t first_segment = 0;
+    uint64_t start_lsn = 0;
+    if (!recover_from_checkpoint(first_segment, start_lsn)) {
+        std::cerr << "Failed to recover from checkpoint" << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    if (!recover_from_wal(first_segment, start_lsn)) {
+        std::cerr << "Failed to recover from WAL" << std::endl;
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    if (!open_value_log()) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    if (tier_) {
+        tier_->enforce_budget();
+    }
+    rebuild_expiry_wheel();
+    rebuild_range_index();
+    remove_stale_bulk_files();
+    
+    auto wal = wal_;
+    scheduler_ = std::make_unique<CheckpointScheduler>(
+        options_.checkpoint,
+        [wal]() { return std::make_pair(wal->get_total_bytes(), wal->get_total_records()); },
+        [this]() { return write_checkpoint(); });
+    scheduler_->start();
+    
+    if (value_log_ || tier_ || range_index_) {
+        gc_stopping_ = false;
+        gc_thread_ = std::thread([this]() { gc_loop(); });
+    }
+    
+    expiry_stopping_ = false;
+    expiry_thread_ = std::thread([this]() { expiry_loop(); });
+    
+    initialized_ = true;
+    std::cout << "Persistent database initialized with data directory: " << data_dir << std::endl;
+    return OperationResult::SUCCESS;
+}
+
+void PersistentDatabase::shutdown() {
+    if (initialized_) {
+        if (expiry_thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(expiry_wait_mutex_);
+                expiry_stopping_ = true;
+            }
+            expiry_cv_.notify_all();
+            expiry_thread_.join();
+        }
         
-        // Add WAL statistics
-        if (wal_) {
-            auto wal_stats = wal_->get_stats();
-            for (const auto& [key, value] : wal_stats) {
-                stats["wal_" + key] = value;
+        if (gc_thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(gc_wait_mutex_);
+                gc_stopping_ = true;
             }
+            gc_cv_.notify_all();
+            gc_thread_.join();
+        }
+        
+        scheduler_->stop();
+        
+        // Create checkpoint before shutdown
+        scheduler_->run_now("shutdown");
+        if (value_log_) {
+            value_log_->close();
+        }
+        if (tier_) {
+            tier_->close();
         }
         
-        return stats;
+        std::cout << "Persistent database shutting down..." << std::endl;
+        initialized_ = false;
+    }
+}
+
+std::shared_ptr<Transaction> PersistentDatabase::begin_transaction() {
+    if (!initialized_) {
+        return nullptr;
     }
     
-    OperationResult compact() override {
-        if (wal_) {
-            wal_->truncate_log();
+    uint64_t id = next_transaction_id_++;
+    return std::make_shared<PersistentTransaction>(*this, id);
+}
+
+std::unordered_map<std::string, std::string> PersistentDatabase::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    stats["total_keys"] = std::to_string(table_.size());
+    stats["shard_count"] = std::to_string(table_.shard_count());
+    stats["data_directory"] = data_dir_;
+    stats["initialized"] = initialized_ ? "true" : "false";
+    stats["next_transaction_id"] = std::to_string(next_transaction_id_);
+    
+    // Add WAL statistics
+    if (wal_) {
+        auto wal_stats = wal_->get_stats();
+        for (const auto& [key, value] : wal_stats) {
+            stats["wal_" + key] = value;
         }
-        return OperationResult::SUCCESS;
     }
     
-    OperationResult backup(const std::string& backup_path) override {
-        if (wal_) {
-            return wal_->create_checkpoint(backup_path) ? 
-                   OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+    if (scheduler_) {
+        for (const auto& [key, value] : scheduler_->get_stats()) {
+            stats["checkpoint_" + key] = value;
         }
-        return OperationResult::SYSTEM_ERROR;
     }
     
-    OperationResult restore(const std::string& backup_path) override {
-        if (wal_) {
-            return wal_->recover_from_checkpoint(backup_path) ? 
-                   OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+    stats["checkpoint_mode"] = options_.checkpoint_mode == CheckpointMode::FORK ? "fork" : "fuzzy";
+    stats["checkpoint_delta_chain"] = std::to_string(delta_count_.load());
+    stats["checkpoint_last_entries"] = std::to_string(last_checkpoint_entries_.load());
+    if (table_.dirty_tracking()) {
+        stats["dirty_keys"] = std::to_string(table_.dirty_count());
+    }
+    
+    if (last_backup_us_ > 0) {
+        stats["backup_last_bytes"] = std::to_string(last_backup_bytes_.load());
+        stats["backup_last_mb_per_s"] = std::to_string(
+            megabytes_per_second(last_backup_bytes_, static_cast<int64_t>(last_backup_us_)));
+    }
+    if (last_restore_us_ > 0) {
+        stats["restore_last_bytes"] = std::to_string(last_restore_bytes_.load());
+        stats["restore_last_mb_per_s"] = std::to_string(
+            megabytes_per_second(last_restore_bytes_, static_cast<int64_t>(last_restore_us_)));
+    }
+    if (options_.checkpoint_mode == CheckpointMode::FORK) {
+        stats["checkpoint_fork_count"] = std::to_string(fork_count_.load());
+        stats["checkpoint_fork_pause_us"] = std::to_string(last_fork_pause_us_.load());
+        stats["checkpoint_fork_cow_pages"] = std::to_string(last_cow_pages_.load());
+    }
+    
+    if (value_log_) {
+        stats["value_separation_threshold"] = std::to_string(options_.value_separation_threshold);
+        for (const auto& [key, value] : value_log_->get_stats()) {
+            stats["vlog_" + key] = value;
         }
-        return OperationResult::SYSTEM_ERROR;
+        stats["vlog_gc_count"] = std::to_string(gc_count_.load());
+        stats["vlog_gc_moved_bytes"] = std::to_string(gc_moved_bytes_.load());
     }
-
-private:
-    std::unordered_map<std::string, std::string> data_;
-    mutable std::shared_mutex mutex_;
-    std::string data_dir_;
-    bool initialized_;
-    std::atomic<uint64_t> next_transaction_id_;
-    std::shared_ptr<WriteAheadLog> wal_;
     
-    bool recover_from_wal() {
-        try {
-            // Read all records from WAL
-            auto records = wal_->read_all_records();
-            
-            if (records.empty()) {
-                std::cout << "No WAL records found, starting fresh" << std::endl;
-                return true;
-            }
-            
-            std::cout << "Recovering " << records.size() << " records from WAL..." << std::endl;
-            
-            // Process records
-            for (const auto& record : records) {
-                switch (record.type) {
-                    case WALRecordType::PUT:
-                        data_[record.key] = record.value;
-                        break;
-                    case WALRecordType::DELETE:
-                        data_.erase(record.key);
-                        break;
-                    case WALRecordType::COMMIT:
-                        // Transaction committed, no action needed
-                        break;
-                    case WALRecordType::CHECKPOINT:
-                        // Checkpoint reached, no action needed
-                        break;
-                }
-            }
-            
-            std::cout << "Recovery completed. Loaded " << data_.size() << " key-value pairs" << std::endl;
-            return true;
-            
-        } catch (const std::exception& e) {
-            std::cerr << "Recovery error: " << e.what() << std::endl;
-            return false;
+    size_t ttl_keys = 0;
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        const auto& shard = table_.shard(i);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        ttl_keys += shard.expires.size();
+    }
+    stats["ttl_keys"] = std::to_string(ttl_keys);
+    stats["expiry_timers"] = std::to_string(expiry_wheel_.size());
+    stats["expired_keys"] = std::to_string(expired_count_.load());
+    stats["expired_on_read"] = std::to_string(lazy_expired_count_.load());
+    stats["expire_batches"] = std::to_string(expire_batches_.load());
+    
+    if (tier_) {
+        auto tier_stats = tier_->get_stats();
+        uint64_t spilled = std::stoull(tier_stats["spilled_keys"]);
+        uint64_t total = table_.size();
+        stats["tier_resident_keys"] = std::to_string(total - std::min(spilled, total));
+        for (const auto& [key, value] : tier_stats) {
+            stats["tier_" + key] = value;
         }
     }
-};
+    
+    stats["bulk_loads"] = std::to_string(bulk_loads_.load());
+    stats["bulk_loaded_keys"] = std::to_string(bulk_loaded_keys_.load());
+    stats["ranges_deleted"] = std::to_string(ranges_deleted_.load());
+    stats["range_purged_keys"] = std::to_string(range_purged_keys_.load());
+    {
+        std::lock_guard<std::mutex> lock(pending_ranges_mutex_);
+        stats["ranges_pending"] = std::to_string(pending_ranges_.size());
+    }
+    
+    if (range_index_) {
+        for (const auto& [key, value] : range_index_->get_stats()) {
+            stats["range_" + key] = value;
+        }
+        
+        // Load of every range, for placing hot ranges
+        auto loads = range_index_->load();
+        for (size_t i = 0; i < loads.size(); ++i) {
+            stats["range_" + std::to_string(i)] =
+                "start=" + loads[i].start + " keys=" + std::to_string(loads[i].keys) +
+                " ops_per_sec=" + std::to_string(loads[i].ops_per_sec) +
+                " memory_bytes=" + std::to_string(loads[i].memory_bytes);
+        }
+    }
+    
+    return stats;
+}
+
+OperationResult PersistentDatabase::compact() {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Close the active value log segment so every dead value can be reclaimed
+    if (value_log_ && (!value_log_->rotate() || !collect_value_log(0.0))) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    // Rotating opens a spill segment, which a fork checkpoint must not overlap
+    if (tier_ && !scheduler_->run_exclusive([this]() { return tier_->rotate() && tier_->collect(0.0); })) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Truncating the WAL is only safe behind a snapshot, so compaction is a
+    // checkpoint; make it a full one to fold the delta chain as well
+    need_full_ = true;
+    return checkpoint();
+}
+
+OperationResult PersistentDatabase::checkpoint() {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    return scheduler_->run_now() ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult PersistentDatabase::backup(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // Hold off checkpoints so the WAL segments the backup needs stay on disk
+    bool ok = scheduler_->run_exclusive([this, &backup_path]() { return write_backup(backup_path); });
+    return ok ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult PersistentDatabase::restore(const std::string& backup_path) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    bool ok = scheduler_->run_exclusive([this, &backup_path]() { return read_backup(backup_path); });
+    return ok ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult PersistentDatabase::bulk_load(const std::string& input_path, uint64_t& entries) {
+    entries = 0;
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    // A checkpoint may not delete, nor a backup miss, the file of a record
+    // logged while it runs
+    bool ok = scheduler_->run_exclusive([this, &input_path, &entries]() {
+        return write_bulk_load(input_path, entries);
+    });
+    if (tier_) {
+        tier_->enforce_budget();
+    }
+    return ok ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult PersistentDatabase::ingest_files(const std::vector<std::string>& paths, uint64_t& entries) {
+    entries = 0;
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    bool ok = scheduler_->run_exclusive([this, &paths, &entries]() { return write_ingest(paths, entries); });
+    if (tier_) {
+        tier_->enforce_budget();
+    }
+    return ok ? OperationResult::SUCCESS : OperationResult::SYSTEM_ERROR;
+}
+
+OperationResult PersistentDatabase::freeze_backup_files(BackupFileSet& file_set) {
+    if (!initialized_) {
+        return OperationResult::SYSTEM_ERROR;
+    }
+    
+    file_set.staging_dir = data_dir_ + "/backup-stream-" + std::to_string(next_stream_id_++);
+    file_set.files.clear();
+    
+    bool ok = scheduler_->run_exclusive([this, &file_set]() {
+        // Close the live segment so every file in the set is immutable
+        if (!wal_->rotate_segment()) {
+            return false;
+        }
+        uint64_t live_segment = wal_->current_segment();
+        
+        std::error_code ec;
+        std::filesystem::create_directories(file_set.staging_dir + "/wal", ec);
+        if (ec) {
+            return false;
+        }
+        
+        // Hard links pin the inodes; checkpoints may unlink the originals freely
+        auto freeze = [&file_set, &ec](const std::string& source, const std::string& name) {
+            std::string frozen = file_set.staging_dir + "/" + name;
+            std::filesystem::create_hard_link(source, frozen, ec);
+            if (ec) {
+                std::cerr << "Backup stream: cannot freeze " << source << ": " << ec.message() << std::endl;
+                return false;
+            }
+            file_set.files.push_back({frozen, name});
+            return true;
+        };
+        
+        if (std::filesystem::exists(checkpoint_path())) {
+            if (!freeze(checkpoint_path(), "checkpoint.db")) return false;
+            for (const auto& delta : list_deltas()) {
+                if (!freeze(delta, std::filesystem::path(delta).filename().string())) return false;
+            }
+        }
+        
+        for (uint64_t segment : wal_->list_segments()) {
+            if (segment >= live_segment) break;
+            std::string source = wal_->segment_path(segment);
+            if (!freeze(source, "wal/" + std::filesystem::path(source).filename().string())) return false;
+        }
+        
+        // Recovery from the frozen set replays the bulk loads its WAL names
+        for (const auto& [lsn, path] : bulk_files_) {
+            if (!freeze(path, std::filesystem::path(path).filename().string())) return false;
+        }
+        
+        if (value_log_) {
+            // Every value the frozen WAL refers to was appended before the
+            // rotation, so the closed segments hold all of them
+            if (!value_log_->rotate()) {
+                return false;
+            }
+            uint64_t live_log = value_log_->active_segment();
+            std::filesystem::create_directories(file_set.staging_dir + "/vlog", ec);
+            if (ec) {
+                return false;
+            }
+            
+            for (uint64_t segment : value_log_->list_segments()) {
+                if (segment == live_log) continue;
+                std::string source = value_log_->segment_path(segment);
+                if (!freeze(source, "vlog/" + std::filesystem::path(source).filename().string())) return false;
+            }
+        }
+        return true;
+    });
+    
+    if (!ok) {
+        release_backup_files(file_set);
+        return OperationResult::SYSTEM_ERROR;
+    }
+    return OperationResult::SUCCESS;
+}
+
+void PersistentDatabase::release_backup_files(const BackupFileSet& file_set) {
+    if (file_set.staging_dir.empty()) {
+        return;
+    }
+    
+    std::error_code ec;
+    std::filesystem::remove_all(file_set.staging_dir, ec);
+}
+
+bool PersistentDatabase::write_backup(const std::string& backup_dir) {
+    auto start = std::chrono::steady_clock::now();
+    
+    std::error_code ec;
+    std::filesystem::create_directories(backup_dir, ec);
+    if (ec) {
+        std::cerr << "Backup: cannot create " << backup_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    
+    // The partitions are a fuzzy image taken from start_lsn on; the WAL copied
+    // alongside brings them to a consistent state as of end_lsn
+    if (!wal_->rotate_segment()) {
+        return false;
+    }
+    uint64_t first_segment = wal_->current_segment();
+    
+    BackupManifest manifest;
+    manifest.start_lsn = wal_->next_lsn();
+    
+    size_t partitions = std::min(resolve_threads(options_.backup_partitions), table_.shard_count());
+    std::vector<uint64_t> partition_bytes(partitions, 0);
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> workers;
+    
+    for (size_t p = 0; p < partitions; ++p) {
+        manifest.partitions.push_back("part-" + std::to_string(p) + ".blk");
+        
+        workers.emplace_back([this, p, partitions, first_segment, &manifest, &backup_dir,
+                              &partition_bytes, &ok]() {
+            SnapshotWriter writer(backup_dir + "/" + manifest.partitions[p], options_.snapshot_format);
+            if (!writer.open(first_segment, manifest.start_lsn)) {
+                ok = false;
+                return;
+            }
+            
+            // Shards are striped over partitions, each copied under a brief shared lock
+            std::vector<std::pair<std::string, std::string>> buffer;
+            std::unordered_map<std::string, uint64_t> expires;
+            for (size_t i = p; i < table_.shard_count() && ok; i += partitions) {
+                const auto& shard = table_.shard(i);
+                {
+                    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                    buffer.assign(shard.data.begin(), shard.data.end());
+                    ShardedTable::remove_dropped(shard, buffer);
+                    expires = shard.expires;
+                    if (tier_ && !resolve_spilled(i, buffer)) {
+                        ok = false;
+                        break;
+                    }
+                }
+                
+                for (const auto& [key, value] : buffer) {
+                    if (!add_entry(writer, expires, key, value)) {
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+            
+            if (!ok || !writer.finish()) {
+                writer.abort();
+                ok = false;
+                return;
+            }
+            partition_bytes[p] = writer.get_file_size();
+        });
+    }
+    
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (!ok) {
+        std::cerr << "Backup: failed to write partitions" << std::endl;
+        return false;
+    }
+    
+    // Close the segment holding writes made during the dump and copy the tail
+    if (!wal_->rotate_segment()) {
+        return false;
+    }
+    manifest.end_lsn = wal_->next_lsn();
+    uint64_t end_segment = wal_->current_segment();
+    
+    uint64_t total_bytes = 0;
+    for (uint64_t segment = first_segment; segment < end_segment; ++segment) {
+        std::string source = wal_->segment_path(segment);
+        if (!std::filesystem::exists(source)) continue;
+        
+        std::string name = std::filesystem::path(source).filename().string();
+        std::filesystem::copy_file(source, backup_dir + "/" + name,
+                                   std::filesystem::copy_options::overwrite_existing, ec);
+        if (ec) {
+            std::cerr << "Backup: failed to copy " << source << ": " << ec.message() << std::endl;
+            return false;
+        }
+        manifest.wal_segments.push_back(name);
+        total_bytes += std::filesystem::file_size(source);
+    }
+    
+    if (value_log_) {
+        // Values are appended before the WAL record pointing at them, so the
+        // segments as they are now hold every value the backup refers to
+        manifest.value_separation = true;
+        for (uint64_t segment : value_log_->list_segments()) {
+            std::string source = value_log_->segment_path(segment);
+            std::string name = std::filesystem::path(source).filename().string();
+            std::filesystem::copy_file(source, backup_dir + "/" + name,
+                                       std::filesystem::copy_options::overwrite_existing, ec);
+            if (ec) {
+                std::cerr << "Backup: failed to copy " << source << ": " << ec.message() << std::endl;
+                return false;
+            }
+            manifest.value_log_segments.push_back(name);
+            total_bytes += std::filesystem::file_size(backup_dir + "/" + name);
+        }
+    }
+    
+    // The manifest goes last; a backup without one is incomplete
+    if (!write_manifest(backup_dir, manifest)) {
+        return false;
+    }
+    
+    for (uint64_t bytes : partition_bytes) {
+        total_bytes += bytes;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    last_backup_bytes_ = total_bytes;
+    last_backup_us_ = static_cast<uint64_t>(elapsed.count());
+    
+    std::cout << "Backup wrote " << partitions << " partitions, " << total_bytes << " bytes in "
+              << elapsed.count() / 1000 << " ms (" << megabytes_per_second(total_bytes, elapsed.count())
+              << " MB/s)" << std::endl;
+    return true;
+}
+
+bool PersistentDatabase::read_backup(const std::string& backup_dir) {
+    auto start = std::chrono::steady_clock::now();
+    
+    BackupManifest manifest;
+    if (!read_manifest(backup_dir, manifest)) {
+        std::cerr << "Restore: no valid manifest in " << backup_dir << std::endl;
+        return false;
+    }
+    if (manifest.value_separation != (value_log_ != nullptr)) {
+        std::cerr << "Restore: " << backup_dir << (manifest.value_separation ? " uses" : " does not use")
+                  << " a value log and this database " << (value_log_ ? "does" : "does not") << std::endl;
+        return false;
+    }
+    
+    // Open every partition up front to size the table before loading
+    std::vector<std::unique_ptr<BlockFileReader>> readers;
+    uint64_t total_entries = 0;
+    uint64_t total_bytes = 0;
+    for (const auto& name : manifest.partitions) {
+        auto reader = std::make_unique<BlockFileReader>();
+        if (!reader->open(backup_dir + "/" + name)) {
+            std::cerr << "Restore: cannot open partition " << name << std::endl;
+            return false;
+        }
+        total_entries += reader->properties().entry_count;
+        total_bytes += reader->file_size();
+        readers.push_back(std::move(reader));
+    }
+    
+    // Build the restored table on the side; the live one keeps serving meanwhile
+    ShardedTable restored(table_.shard_count());
+    size_t per_shard = static_cast<size_t>(total_entries / restored.shard_count() + 1);
+    for (size_t i = 0; i < restored.shard_count(); ++i) {
+        restored.shard(i).data.reserve(per_shard + per_shard / 8);
+    }
+    
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> workers;
+    for (auto& reader : readers) {
+        workers.emplace_back([&restored, &reader, &ok]() {
+            bool loaded = reader->for_each([&restored](BlockEntry&& entry) {
+                auto& shard = restored.shard_for(entry.key);
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+                uint64_t expire_ms = 0;
+                if (entry.type == BlockEntryType::PUT_TTL && decode_expiring_value(entry.value, expire_ms)) {
+                    shard.expires[entry.key] = expire_ms;
+                }
+                shard.data[std::move(entry.key)] = std::move(entry.value);
+            });
+            if (!loaded) {
+                ok = false;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (!ok) {
+        std::cerr << "Restore: corrupt partition in " << backup_dir << std::endl;
+        return false;
+    }
+    
+    // Replay the writes made while the partitions were being dumped
+    for (const auto& name : manifest.wal_segments) {
+        std::vector<WALRecord> records;
+        WriteAheadLog::read_segment(backup_dir + "/" + name, records);
+        total_bytes += std::filesystem::file_size(backup_dir + "/" + name);
+        
+        for (const auto& record : records) {
+            if (record.lsn < manifest.start_lsn || record.lsn >= manifest.end_lsn) continue;
+            
+            auto& shard = restored.shard_for(record.key);
+            if (record.type == WALRecordType::PUT) {
+                shard.data[record.key] = record.value;
+                shard.expires.erase(record.key);
+            } else if (record.type == WALRecordType::PUT_TTL) {
+                std::string value = record.value;
+                uint64_t expire_ms = 0;
+                if (decode_expiring_value(value, expire_ms)) {
+                    shard.data[record.key] = std::move(value);
+                    shard.expires[record.key] = expire_ms;
+                }
+            } else if (record.type == WALRecordType::DELETE) {
+                shard.data.erase(record.key);
+                shard.expires.erase(record.key);
+            } else if (record.type == WALRecordType::EXPIRE) {
+                replay_expire(restored, record, nullptr);
+            } else if (record.type == WALRecordType::DELETE_RANGE) {
+                replay_delete_range(restored, record, nullptr);
+            }
+        }
+    }
+    
+    if (value_log_) {
+        // Bring the backup's segments in under fresh ids and repoint the
+        // restored table at them. Until the new base snapshot is published
+        // nothing refers to the copies, and the collector removes them.
+        std::unordered_map<uint64_t, uint64_t> imported;
+        for (const auto& name : manifest.value_log_segments) {
+            uint64_t id = value_log_->import_segment(backup_dir + "/" + name);
+            if (id == 0) {
+                return false;
+            }
+            imported[ValueLog::parse_segment_name(name)] = id;
+            total_bytes += std::filesystem::file_size(backup_dir + "/" + name);
+        }
+        
+        for (size_t i = 0; i < restored.shard_count(); ++i) {
+            for (auto& [key, stored] : restored.shard(i).data) {
+                ValuePointer pointer;
+                if (!decode_pointer(stored, pointer)) continue;
+                
+                auto it = imported.find(pointer.segment);
+                if (it == imported.end()) {
+                    std::cerr << "Restore: value of key " << key << " is in a segment missing from "
+                              << backup_dir << std::endl;
+                    return false;
+                }
+                pointer.segment = it->second;
+                stored = encode_pointer(pointer);
+            }
+        }
+    }
+    
+    {
+        // Publish: with the live table quiesced, make the restored image the new
+        // base snapshot, then swap it in. A crash before the snapshot rename
+        // leaves the old database intact; after it, recovery finds the restore.
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(table_.shard_count());
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            locks.emplace_back(table_.shard(i).mutex);
+        }
+        
+        if (!wal_->rotate_segment()) {
+            return false;
+        }
+        uint64_t covered_segment = wal_->current_segment();
+        uint64_t start_lsn = wal_->next_lsn();
+        
+        SnapshotWriter writer(checkpoint_path(), options_.snapshot_format);
+        bool written = writer.open(covered_segment, start_lsn);
+        for (size_t i = 0; written && i < restored.shard_count(); ++i) {
+            for (const auto& [key, value] : restored.shard(i).data) {
+                if (!add_entry(writer, restored.shard(i).expires, key, value)) {
+                    written = false;
+                    break;
+                }
+            }
+        }
+        if (!written || !writer.finish()) {
+            writer.abort();
+            std::cerr << "Restore: failed to write new base snapshot" << std::endl;
+            return false;
+        }
+        
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            table_.shard(i).data.swap(restored.shard(i).data);
+            table_.shard(i).expires.swap(restored.shard(i).expires);
+            table_.shard(i).dirty.clear();
+            table_.shard(i).dropped.clear();
+            table_.shard(i).rewritten.clear();
+        }
+        {
+            std::lock_guard<std::mutex> lock(pending_ranges_mutex_);
+            pending_ranges_.clear();
+        }
+        if (tier_) {
+            tier_->reset();
+        }
+        rebuild_range_index();
+        
+        // The replaced table's values are now dead; the collector reclaims them
+        for (size_t i = 0; value_log_ && i < table_.shard_count(); ++i) {
+            for (const auto& [key, stored] : restored.shard(i).data) {
+                release_value(value_log_.get(), key, stored);
+            }
+            for (const auto& [key, stored] : table_.shard(i).data) {
+                ValuePointer pointer;
+                if (decode_pointer(stored, pointer)) {
+                    value_log_->mark_live(key, pointer);
+                }
+            }
+        }
+        
+        for (const auto& delta : list_deltas()) {
+            std::filesystem::remove(delta);
+        }
+        base_lsn_ = start_lsn;
+        delta_count_ = 0;
+        need_full_ = false;
+        
+        wal_->create_checkpoint(checkpoint_path());
+        wal_->remove_segments_before(covered_segment);
+        remove_bulk_files_before(start_lsn);
+    }
+    if (tier_) {
+        tier_->enforce_budget();
+    }
+    rebuild_expiry_wheel();
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    last_restore_bytes_ = total_bytes;
+    last_restore_us_ = static_cast<uint64_t>(elapsed.count());
+    
+    std::cout << "Restore loaded " << total_entries << " entries from " << readers.size()
+              << " partitions, " << total_bytes << " bytes in " << elapsed.count() / 1000
+              << " ms (" << megabytes_per_second(total_bytes, elapsed.count()) << " MB/s)" << std::endl;
+    return true;
+}
+
+bool PersistentDatabase::store_bulk_value(const std::string& key, std::string&& value, std::string& stored,
+                                          std::vector<std::pair<std::string, ValuePointer>>& separated) {
+    if (value_log_ == nullptr) {
+        stored = std::move(value);
+    } else if (options_.value_separation_threshold > 0 && value.size() >= options_.value_separation_threshold) {
+        ValuePointer pointer;
+        if (!value_log_->append(key, value, pointer)) {
+            return false;
+        }
+        stored = encode_pointer(pointer);
+        separated.emplace_back(key, pointer);
+    } else {
+        stored = encode_inline(value);
+    }
+    return true;
+}
+
+bool PersistentDatabase::write_bulk_load(const std::string& input_path, uint64_t& entries) {
+    std::ifstream in(input_path);
+    if (!in.is_open()) {
+        std::cerr << "Bulk load: cannot open " << input_path << std::endl;
+        return false;
+    }
+    
+    std::string name = bulk_name(0);
+    SnapshotWriter writer(bulk_path(name), options_.snapshot_format);
+    if (!writer.open(wal_->current_segment(), wal_->next_lsn())) {
+        return false;
+    }
+    std::vector<std::pair<std::string, ValuePointer>> separated;
+    auto discard = [this, &writer, &separated]() {
+        writer.abort();
+        for (const auto& [key, pointer] : separated) {
+            value_log_->mark_dead(key, pointer);
+        }
+        return false;
+    };
+    
+    std::string line, key, value, previous, stored;
+    uint64_t line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || !unescape_field(line, 0, tab, key) ||
+            !unescape_field(line, tab + 1, line.size(), value)) {
+            std::cerr << "Bulk load: malformed line " << line_number << " in " << input_path << std::endl;
+            return discard();
+        }
+        if (line_number > 1 && !(previous < key)) {
+            std::cerr << "Bulk load: key on line " << line_number << " of " << input_path
+                      << " is not greater than the one before it" << std::endl;
+            return discard();
+        }
+        if (!store_bulk_value(key, std::move(value), stored, separated) || !writer.add(key, stored)) {
+            return discard();
+        }
+        previous.swap(key);
+    }
+    if (in.bad()) {
+        std::cerr << "Bulk load: failed to read " << input_path << std::endl;
+        return discard();
+    }
+    if (!writer.finish()) {
+        return discard();
+    }
+    
+    if (!link_bulk_files({name}, !separated.empty(), entries)) {
+        std::error_code ec;
+        std::filesystem::remove(bulk_path(name), ec);
+        return discard();
+    }
+    std::cout << "Bulk load of " << input_path << " added " << entries << " keys" << std::endl;
+    return true;
+}
+
+bool PersistentDatabase::write_ingest(const std::vector<std::string>& paths, uint64_t& entries) {
+    std::vector<std::string> names;
+    std::vector<std::pair<std::string, ValuePointer>> separated;
+    auto discard = [this, &names, &separated]() {
+        std::error_code ec;
+        for (const auto& name : names) {
+            std::filesystem::remove(bulk_path(name), ec);
+        }
+        for (const auto& [key, pointer] : separated) {
+            value_log_->mark_dead(key, pointer);
+        }
+        return false;
+    };
+    
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::string name = bulk_name(i);
+        if (value_log_ == nullptr) {
+            // The table stores values as given, so a copy of the file becomes
+            // the bulk file. Never a link: recovery replays the bulk file, and
+            // the caller may rewrite its own file in place afterwards.
+            std::error_code ec;
+            std::filesystem::copy_file(paths[i], bulk_path(name), ec);
+            if (ec || !sync_path(bulk_path(name))) {
+                std::cerr << "Ingest: cannot copy " << paths[i] << " into " << data_dir_ << std::endl;
+                names.push_back(name);
+                return discard();
+            }
+            names.push_back(name);
+            continue;
+        }
+        
+        // With a value log every value needs its tag, and large ones a pointer,
+        // so the entries are rewritten in the stored form
+        SnapshotWriter writer(bulk_path(name), options_.snapshot_format);
+        if (!writer.open(wal_->current_segment(), wal_->next_lsn())) {
+            return discard();
+        }
+        BlockFileSummary summary;
+        bool added = true;
+        std::string stored;
+        bool verified = verify_sorted_file(paths[i], summary, [&](BlockEntry&& entry) {
+            added = added && store_bulk_value(entry.key, std::move(entry.value), stored, separated) &&
+                    writer.add(entry.key, stored);
+        });
+        if (!verified || !added || !writer.finish()) {
+            writer.abort();
+            return discard();
+        }
+        names.push_back(name);
+    }
+    
+    if (!link_bulk_files(names, !separated.empty(), entries)) {
+        return discard();
+    }
+    std::cout << "Ingested " << names.size() << " files with " << entries << " keys" << std::endl;
+    return true;
+}
+
+bool PersistentDatabase::link_bulk_files(const std::vector<std::string>& names, bool sync_value_log,
+                                         uint64_t& entries) {
+    auto start = std::chrono::steady_clock::now();
+    entries = 0;
+    
+    // Check the files without any lock, counting their keys by shard so each
+    // shard's table is sized once; only one block is held at a time
+    std::vector<size_t> shard_entries(table_.shard_count(), 0);
+    std::vector<std::pair<BlockFileSummary, std::string>> files;
+    for (const auto& name : names) {
+        BlockFileSummary summary;
+        bool verified = verify_sorted_file(bulk_path(name), summary, [this, &shard_entries](BlockEntry&& entry) {
+            shard_entries[table_.shard_index(entry.key)]++;
+        });
+        if (!verified) {
+            return false;
+        }
+        entries += summary.entry_count;
+        if (summary.entry_count > 0) {
+            files.emplace_back(std::move(summary), bulk_path(name));
+        }
+    }
+    
+    std::sort(files.begin(), files.end(),
+              [](const auto& a, const auto& b) { return a.first.smallest < b.first.smallest; });
+    for (size_t i = 1; i < files.size(); ++i) {
+        if (!(files[i - 1].first.largest < files[i].first.smallest)) {
+            std::cerr << "Bulk load: the files to link overlap" << std::endl;
+            return false;
+        }
+    }
+    
+    // The record may only be logged once everything it refers to is durable
+    if (sync_value_log && !value_log_->sync()) {
+        return false;
+    }
+    
+    {
+        // Every shard is locked to order the record against writes and stays
+        // locked while the files are streamed into the table, as any block
+        // holds keys of any shard. Readers wait for the whole load, but it
+        // never needs more memory than one block beyond what the table and
+        // index will keep. A checkpoint takes the shards in the same order,
+        // so it never sees a shard before its entries.
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(table_.shard_count());
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            locks.emplace_back(table_.shard(i).mutex);
+        }
+        
+        WALRecord record;
+        record.type = WALRecordType::BULK_LOAD;
+        for (const auto& name : names) {
+            record.key += (record.key.empty() ? "" : "\n") + name;
+        }
+        record.value.assign(reinterpret_cast<const char*>(&entries), sizeof(entries));
+        record.key_length = static_cast<uint32_t>(record.key.length());
+        record.value_length = static_cast<uint32_t>(record.value.length());
+        uint64_t lsn = 0;
+        if (!wal_->append_record(record, &lsn)) {
+            return false;
+        }
+        wal_->flush();
+        for (const auto& name : names) {
+            bulk_files_.emplace_back(lsn, bulk_path(name));
+        }
+        
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            if (shard_entries[i] > 0) {
+                table_.shard(i).data.reserve(table_.shard(i).data.size() + shard_entries[i]);
+            }
+        }
+        
+        // The files are sorted and disjoint, so taken in order their keys are
+        // one sorted run for the index
+        std::vector<std::string> keys;
+        if (range_index_) {
+            keys.reserve(entries);
+        }
+        std::vector<BlockEntry> block;
+        for (const auto& [summary, path] : files) {
+            // The record stands either way: recovery replays the file, or
+            // refuses to start if it is still unreadable
+            BlockFileReader reader;
+            if (!reader.open(path)) {
+                std::cerr << "Bulk load: " << path << " became unreadable after it was checked" << std::endl;
+                continue;
+            }
+            for (size_t b = 0; b < reader.blocks().size(); ++b) {
+                if (!reader.read_block(b, block)) {
+                    std::cerr << "Bulk load: block " << b << " of " << path
+                              << " became unreadable after it was checked" << std::endl;
+                    continue;
+                }
+                for (auto& entry : block) {
+                    size_t index = table_.shard_index(entry.key);
+                    auto& shard = table_.shard(index);
+                    if (!shard.expires.empty()) {
+                        shard.expires.erase(entry.key);
+                    }
+                    auto [it, inserted] = shard.data.try_emplace(entry.key);
+                    size_t old_size = 0;
+                    if (!inserted) {
+                        release_value(value_log_.get(), entry.key, it->second);
+                        old_size = it->second.size();
+                    }
+                    it->second = std::move(entry.value);
+                    table_.mark_dirty(shard, entry.key);
+                    ShardedTable::note_write(shard, entry.key, lsn);
+                    if (tier_) {
+                        tier_->changed(index, entry.key, old_size, it->second.size());
+                    }
+                    if (range_index_) {
+                        keys.push_back(std::move(entry.key));
+                    }
+                }
+                block.clear();
+            }
+        }
+        
+        if (range_index_) {
+            range_index_->insert_sorted(keys);
+        }
+    }
+    
+    bulk_loads_++;
+    bulk_loaded_keys_ += entries;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << "Linked " << names.size() << " bulk files into the table in " << elapsed.count() << " ms"
+              << std::endl;
+    return true;
+}
+
+void PersistentDatabase::remove_bulk_files_before(uint64_t lsn) {
+    auto covered = std::remove_if(bulk_files_.begin(), bulk_files_.end(),
+                                  [lsn](const std::pair<uint64_t, std::string>& file) {
+                                      if (file.first >= lsn) {
+                                          return false;
+                                      }
+                                      std::error_code ec;
+                                      std::filesystem::remove(file.second, ec);
+                                      return true;
+                                  });
+    bulk_files_.erase(covered, bulk_files_.end());
+}
+
+void PersistentDatabase::remove_stale_bulk_files() {
+    std::unordered_set<std::string> referenced;
+    for (const auto& [lsn, path] : bulk_files_) {
+        referenced.insert(path);
+    }
+    
+    // Loads that failed or crashed before logging their record, and files of
+    // records a snapshot covers
+    std::error_code ec;
+    std::vector<std::string> stale;
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, std::strlen(BULK_PREFIX), BULK_PREFIX) == 0 && referenced.count(bulk_path(name)) == 0) {
+            stale.push_back(entry.path().string());
+        }
+    }
+    for (const auto& path : stale) {
+        std::filesystem::remove(path, ec);
+    }
+}
+
+bool PersistentDatabase::write_checkpoint() {
+    // Deltas only make sense on top of a base, and the chain is bounded so
+    // recovery never has to apply more than max_delta_chain files
+    bool full = need_full_ || base_lsn_ == 0 || options_.max_delta_chain == 0 ||
+                delta_count_ >= options_.max_delta_chain;
+    
+    // Anchor the snapshot at the start of a fresh segment so the segments
+    // before it can be deleted once the snapshot is durable
+    if (!wal_->rotate_segment()) {
+        return false;
+    }
+    uint64_t covered_segment = wal_->current_segment();
+    std::string path = full ? checkpoint_path() : delta_path(covered_segment);
+    uint64_t start_lsn = 0;
+    uint64_t entries = 0;
+    
+    bool ok = options_.checkpoint_mode == CheckpointMode::FORK
+        ? write_fork_checkpoint(path, full, covered_segment, start_lsn, entries)
+        : write_fuzzy_checkpoint(path, full, covered_segment, start_lsn, entries);
+    if (!ok && options_.checkpoint_mode == CheckpointMode::FORK) {
+        // The failed child took the dirty sets, so only a full image covers every key
+        std::cerr << "Fork checkpoint failed, writing a fuzzy one instead" << std::endl;
+        full = true;
+        path = checkpoint_path();
+        ok = write_fuzzy_checkpoint(path, full, covered_segment, start_lsn, entries);
+    }
+    if (!ok) {
+        // Dirty keys handed to the failed snapshot are lost, start a new chain
+        need_full_ = true;
+        return false;
+    }
+    
+    if (full) {
+        // The new base supersedes every delta of the old chain
+        for (const auto& delta : list_deltas()) {
+            std::filesystem::remove(delta);
+        }
+        base_lsn_ = start_lsn;
+        delta_count_ = 0;
+        need_full_ = false;
+    } else {
+        delta_count_++;
+    }
+    last_checkpoint_entries_ = entries;
+    
+    // The snapshot is durable, history before it is no longer needed
+    wal_->create_checkpoint(path);
+    size_t removed = wal_->remove_segments_before(covered_segment);
+    remove_bulk_files_before(start_lsn);
+    
+    std::cout << (full ? "Checkpoint" : "Delta checkpoint") << " wrote " << entries
+              << " entries at LSN " << start_lsn << ", removed " << removed
+              << " WAL segments" << std::endl;
+    return true;
+}
+
+bool PersistentDatabase::write_fuzzy_checkpoint(const std::string& path, bool full,
+                                                uint64_t covered_segment, uint64_t& start_lsn,
+                                                uint64_t& entries) {
+    SnapshotWriter writer(path, options_.snapshot_format);
+    
+    // Every write with a smaller LSN is already in the table; later writes may
+    // or may not be captured, and replaying the WAL from start_lsn repairs either case
+    start_lsn = wal_->next_lsn();
+    
+    if (!writer.open(covered_segment, start_lsn, full ? 0 : base_lsn_)) {
+        return false;
+    }
+    
+    // Copy one shard at a time so each lock is held only for the copy,
+    // never for the disk write. Taking the dirty set under the same lock
+    // hands every later change to the next checkpoint.
+    std::vector<std::pair<std::string, std::string>> buffer;
+    std::vector<std::string> deleted;
+    std::unordered_set<std::string> dirty;
+    std::unordered_map<std::string, uint64_t> expires;
+    std::vector<std::pair<std::string, std::string>> ranges;
+    
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        auto& shard = table_.shard(i);
+        buffer.clear();
+        deleted.clear();
+        dirty.clear();
+        
+        if (!table_.dirty_tracking()) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            buffer.assign(shard.data.begin(), shard.data.end());
+            ShardedTable::remove_dropped(shard, buffer);
+            expires = shard.expires;
+            if (tier_ && !resolve_spilled(i, buffer)) {
+                writer.abort();
+                return false;
+            }
+        } else {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            dirty.swap(shard.dirty);
+            
+            if (full) {
+                buffer.assign(shard.data.begin(), shard.data.end());
+                ShardedTable::remove_dropped(shard, buffer);
+                expires = shard.expires;
+            } else {
+                expires.clear();
+                collect_dropped(shard, ranges, dirty);
+                for (const auto& key : dirty) {
+                    auto it = shard.data.find(key);
+                    if (it != shard.data.end() && !ShardedTable::is_dropped(shard, key)) {
+                        buffer.emplace_back(key, it->second);
+                        auto expiry = shard.expires.find(key);
+                        if (expiry != shard.expires.end()) {
+                            expires.insert(*expiry);
+                        }
+                    } else {
+                        deleted.push_back(key);
+                    }
+                }
+            }
+            if (tier_ && !resolve_spilled(i, buffer)) {
+                writer.abort();
+                return false;
+            }
+        }
+        
+        for (const auto& [key, value] : buffer) {
+            if (!add_entry(writer, expires, key, value)) {
+                writer.abort();
+                return false;
+            }
+        }
+        for (const auto& key : deleted) {
+            if (!writer.add_tombstone(key)) {
+                writer.abort();
+                return false;
+            }
+        }
+    }
+    
+    add_range_tombstones(writer, ranges);
+    entries = writer.get_entry_count();
+    return writer.finish();
+}
+
+bool PersistentDatabase::write_fork_checkpoint(const std::string& path, bool full,
+                                               uint64_t covered_segment, uint64_t& start_lsn,
+                                               uint64_t& entries) {
+    // Child reports back through a pipe
+    struct ForkResult {
+        uint8_t ok;
+        uint64_t entries;
+        uint64_t cow_pages;
+    };
+    
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        std::cerr << "Fork checkpoint: pipe failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Dirty sets move out of the table in O(1) per shard while writers are held
+    std::vector<std::unordered_set<std::string>> dirty(table_.shard_count());
+    
+    auto pause_start = std::chrono::steady_clock::now();
+    pid_t pid;
+    {
+        // Hold every shard exclusively across the fork so the child's image is
+        // point-in-time consistent. Readers and writers both wait out this
+        // pause, which is the kernel copying page tables and so grows with
+        // the resident size; after it nobody pays per key, as the kernel
+        // copies pages lazily. The checkpoint_fork_pause_us stat reports it.
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(table_.shard_count());
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            locks.emplace_back(table_.shard(i).mutex);
+            dirty[i].swap(table_.shard(i).dirty);
+        }
+        
+        // The child takes the spill log's segment lock to read spilled values
+        std::shared_lock<std::shared_mutex> spill_lock;
+        if (tier_) {
+            spill_lock = tier_->hold_spill_segments();
+        }
+        
+        start_lsn = wal_->next_lsn();
+        pid = ::fork();
+    }
+    auto pause = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - pause_start);
+    
+    if (pid < 0) {
+        std::cerr << "Fork checkpoint: fork failed: " << std::strerror(errno) << std::endl;
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return false;
+    }
+    
+    if (pid == 0) {
+        // Child: only this thread exists. The shard locks are owned by the
+        // parent's copy of them, so read the table without locking. Spill
+        // files are only appended to under a shard lock, and only rotated and
+        // collected with checkpoints held off, so every stub here can be
+        // read; the parent held their segment lock shared across the fork.
+        ::close(fds[0]);
+        
+        ForkResult result{0, 0, 0};
+        SnapshotWriter writer(path, options_.snapshot_format);
+        bool ok = writer.open(covered_segment, start_lsn, full ? 0 : base_lsn_);
+        std::vector<std::pair<std::string, std::string>> ranges;
+        
+        for (size_t i = 0; ok && i < table_.shard_count(); ++i) {
+            const auto& shard = table_.shard(i);
+            const auto& data = shard.data;
+            const auto& expires = shard.expires;
+            
+            std::string spilled;
+            auto add = [&](const std::string& key, const std::string& value) {
+                if (!tier_ || !tier_->is_packed(i, key, value)) {
+                    return add_entry(writer, expires, key, value);
+                }
+                spilled = value;
+                return tier_->resolve(i, key, spilled) && add_entry(writer, expires, key, spilled);
+            };
+            
+            if (full) {
+                for (const auto& [key, value] : data) {
+                    if (!ShardedTable::is_dropped(shard, key) && !add(key, value)) {
+                        ok = false;
+                        break;
+                    }
+                }
+                continue;
+            }
+            
+            collect_dropped(shard, ranges, dirty[i]);
+            for (const auto& key : dirty[i]) {
+                auto it = data.find(key);
+                bool live = it != data.end() && !ShardedTable::is_dropped(shard, key);
+                bool added = live ? add(key, it->second) : writer.add_tombstone(key);
+                if (!added) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        
+        add_range_tombstones(writer, ranges);
+        result.entries = writer.get_entry_count();
+        if (ok) {
+            ok = writer.finish();
+        } else {
+            writer.abort();
+        }
+        result.ok = ok ? 1 : 0;
+        result.cow_pages = read_private_dirty_pages();
+        
+        ssize_t written = ::write(fds[1], &result, sizeof(result));
+        ::close(fds[1]);
+        ::_exit(ok && written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+    }
+    
+    ::close(fds[1]);
+    
+    // A child stuck on a lock some other parent thread held at the fork would
+    // otherwise hold the checkpoint slot forever
+    pollfd ready{fds[0], POLLIN, 0};
+    int timeout = options_.fork_timeout_ms == 0 ? -1
+                : static_cast<int>(std::min<uint64_t>(options_.fork_timeout_ms, INT_MAX));
+    int polled;
+    while ((polled = ::poll(&ready, 1, timeout)) < 0 && errno == EINTR) {}
+    if (polled == 0) {
+        std::cerr << "Fork checkpoint: child did not finish within " << options_.fork_timeout_ms
+                  << " ms, killing it" << std::endl;
+        ::kill(pid, SIGKILL);
+    }
+    
+    ForkResult result{0, 0, 0};
+    ssize_t got = polled > 0 ? ::read(fds[0], &result, sizeof(result)) : 0;
+    ::close(fds[0]);
+    
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if (polled == 0) {
+        std::error_code ec;
+        std::filesystem::remove(path + ".tmp", ec);
+    }
+    
+    fork_count_++;
+    last_fork_pause_us_ = static_cast<uint64_t>(pause.count());
+    last_cow_pages_ = result.cow_pages;
+    
+    std::cout << "Fork checkpoint: pause " << pause.count() << " us, "
+              << result.cow_pages << " copy-on-write pages" << std::endl;
+    
+    if (got != static_cast<ssize_t>(sizeof(result)) || !result.ok ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Fork checkpoint: child failed" << std::endl;
+        return false;
+    }
+    
+    entries = result.entries;
+    return true;
+}
+
+std::vector<std::string> PersistentDatabase::list_deltas() const {
+    std::vector<std::pair<uint64_t, std::string>> deltas;
+    const std::string prefix = "checkpoint.delta.";
+    
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        
+        std::string segment = name.substr(prefix.size());
+        if (segment.empty() || segment.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        deltas.emplace_back(std::stoull(segment), entry.path().string());
+    }
+    
+    std::sort(deltas.begin(), deltas.end());
+    
+    std::vector<std::string> paths;
+    for (auto& [segment, path] : deltas) {
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+bool PersistentDatabase::recover_from_checkpoint(uint64_t& first_segment, uint64_t& start_lsn) {
+    SnapshotHeader header;
+    auto apply = [this](BlockEntryType type, std::string&& key, std::string&& value) {
+        // Blocks are decoded on several threads, so take the shard lock
+        size_t index = table_.shard_index(key);
+        auto& shard = table_.shard(index);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        
+        // A delta's entry replaces the key's expiry along with its value
+        uint64_t expire_ms = 0;
+        if (type == BlockEntryType::PUT_TTL && !decode_expiring_value(value, expire_ms)) {
+            std::cerr << "Skipping malformed snapshot entry for key " << key << std::endl;
+            return;
+        }
+        if (expire_ms > 0) {
+            shard.expires[key] = expire_ms;
+        } else if (!shard.expires.empty()) {
+            shard.expires.erase(key);
+        }
+        
+        if (type == BlockEntryType::DELETE) {
+            auto it = shard.data.find(key);
+            if (it != shard.data.end()) {
+                if (tier_) {
+                    track_recovered(index, key, it->second.size(), 0);
+                }
+                shard.data.erase(it);
+            }
+        } else if (!tier_) {
+            shard.data[std::move(key)] = std::move(value);
+        } else {
+            std::string& stored = shard.data[key];
+            size_t old_size = stored.size();
+            stored = std::move(value);
+            track_recovered(index, key, old_size, stored.size());
+        }
+    };
+    
+    // Delta range tombstones are sorted and disjoint
+    auto erase_ranges = [this](const std::vector<std::pair<std::string, std::string>>& ranges) {
+        for (size_t index = 0; index < table_.shard_count(); ++index) {
+            auto& shard = table_.shard(index);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto it = shard.data.begin(); it != shard.data.end();) {
+                auto range = std::upper_bound(ranges.begin(), ranges.end(), it->first,
+                                              [](const std::string& key, const std::pair<std::string, std::string>& r) {
+                                                  return key < r.first;
+                                              });
+                if (range == ranges.begin() || !(it->first < std::prev(range)->second)) {
+                    ++it;
+                    continue;
+                }
+                if (tier_) {
+                    track_recovered(index, it->first, it->second.size(), 0);
+                }
+                if (!shard.expires.empty()) {
+                    shard.expires.erase(it->first);
+                }
+                it = shard.data.erase(it);
+            }
+        }
+    };
+    
+    size_t threads = resolve_threads(options_.recovery_threads);
+    
+    first_segment = 0;
+    start_lsn = 0;
+    
+    if (!std::filesystem::exists(checkpoint_path())) {
+        return true;
+    }
+    
+    if (!SnapshotReader::load(checkpoint_path(), header, apply, threads)) {
+        // WAL segments before the snapshot may already be gone, refuse to guess
+        table_.clear();
+        return false;
+    }
+    
+    base_lsn_ = header.start_lsn;
+    first_segment = header.wal_segment;
+    start_lsn = header.start_lsn;
+    std::cout << "Loaded " << header.entry_count << " keys from checkpoint at LSN "
+              << start_lsn << std::endl;
+    
+    // Apply the deltas of this chain in order; leftovers of an older chain are ignored
+    for (const auto& delta : list_deltas()) {
+        SnapshotHeader delta_header;
+        if (!SnapshotReader::read_header(delta, delta_header) || delta_header.base_lsn != base_lsn_) {
+            continue;
+        }
+        
+        // Ranges deleted before the delta are dropped first, its entries put back what was rewritten
+        if (!delta_header.deleted_ranges.empty()) {
+            erase_ranges(delta_header.deleted_ranges);
+        }
+        
+        if (!SnapshotReader::load(delta, delta_header, apply, threads)) {
+            std::cerr << "Corrupt delta checkpoint: " << delta << std::endl;
+            table_.clear();
+            return false;
+        }
+        
+        delta_count_++;
+        first_segment = delta_header.wal_segment;
+        start_lsn = delta_header.start_lsn;
+        std::cout << "Applied " << delta_header.entry_count << " entries from delta at LSN "
+                  << start_lsn << std::endl;
+    }
+    
+    need_full_ = false;
+    return true;
+}
+
+bool PersistentDatabase::recover_from_wal(uint64_t first_segment, uint64_t start_lsn) {
+    try {
+        // Read the records the checkpoint does not cover
+        auto records = wal_->read_records_from(first_segment);
+        records.erase(std::remove_if(records.begin(), records.end(),
+                                     [start_lsn](const WALRecord& record) {
+                                         return record.lsn < start_lsn;
+                                     }),
+                      records.end());
+        
+        if (records.empty()) {
+            std::cout << "No WAL records found, starting fresh" << std::endl;
+            return true;
+        }
+        
+        std::cout << "Recovering " << records.size() << " records from WAL..." << std::endl;
+        
+        // Process records
+        for (const auto& record : records) {
+            switch (record.type) {
+                case WALRecordType::PUT:
+                case WALRecordType::PUT_TTL: {
+                    // Replayed keys are not in any snapshot yet, the next delta must carry them
+                    size_t index = table_.shard_index(record.key);
+                    auto& shard = table_.shard(index);
+                    std::string value = record.value;
+                    uint64_t expire_ms = 0;
+                    if (record.type == WALRecordType::PUT_TTL && !decode_expiring_value(value, expire_ms)) {
+                        std::cerr << "Skipping malformed record at LSN " << record.lsn << std::endl;
+                        break;
+                    }
+                    if (expire_ms > 0) {
+                        shard.expires[record.key] = expire_ms;
+                    } else {
+                        shard.expires.erase(record.key);
+                    }
+                    
+                    std::string& stored = shard.data[record.key];
+                    size_t old_size = stored.size();
+                    stored = std::move(value);
+                    table_.mark_dirty(shard, record.key);
+                    if (tier_) {
+                        track_recovered(index, record.key, old_size, stored.size());
+                    }
+                    break;
+                }
+                case WALRecordType::DELETE: {
+                    size_t index = table_.shard_index(record.key);
+                    auto& shard = table_.shard(index);
+                    auto it = shard.data.find(record.key);
+                    if (it != shard.data.end()) {
+                        if (tier_) {
+                            track_recovered(index, record.key, it->second.size(), 0);
+                        }
+                        shard.data.erase(it);
+                    }
+                    shard.expires.erase(record.key);
+                    table_.mark_dirty(shard, record.key);
+                    break;
+                }
+                case WALRecordType::EXPIRE:
+                    replay_expire(table_, record, [this](size_t index, const std::string& key, size_t size) {
+                        if (tier_) {
+                            tier_->changed(index, key, size, 0);
+                        }
+                    });
+                    break;
+                case WALRecordType::DELETE_RANGE:
+                    replay_delete_range(table_, record, [this](size_t index, const std::string& key, size_t size) {
+                        if (tier_) {
+                            track_recovered(index, key, size, 0);
+                        }
+                    });
+                    break;
+                case WALRecordType::BULK_LOAD: {
+                    // Unlike a checkpoint's, a bulk file is the only copy of its keys
+                    size_t begin = 0;
+                    while (begin < record.key.size()) {
+                        size_t end = std::min(record.key.find('\n', begin), record.key.size());
+                        std::string path = bulk_path(record.key.substr(begin, end - begin));
+                        begin = end + 1;
+                        
+                        bool loaded = replay_bulk_file(table_, path, resolve_threads(options_.recovery_threads),
+                                                       [this](size_t index, const std::string& key,
+                                                              size_t old_size, size_t new_size) {
+                                                           if (tier_) {
+                                                               track_recovered(index, key, old_size, new_size);
+                                                           }
+                                                       });
+                        if (!loaded) {
+                            std::cerr << "Bulk load file " << path << " of LSN " << record.lsn
+                                      << " is missing or corrupt" << std::endl;
+                            return false;
+                        }
+                        bulk_files_.emplace_back(record.lsn, path);
+                    }
+                    break;
+                }
+                case WALRecordType::COMMIT:
+                    // Transaction committed, no action needed
+                    break;
+                case WALRecordType::CHECKPOINT:
+                    // Checkpoint reached, no action needed
+                    break;
+            }
+        }
+        
+        std::cout << "Recovery completed. Loaded " << table_.size() << " key-value pairs" << std::endl;
+        return true;
+    
+    } catch (const std::exception& e) {
+        std::cerr << "Recovery error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool PersistentDatabase::open_value_log() {
+    bool exists = std::filesystem::exists(value_log_dir());
+    if (!exists && options_.value_separation_threshold == 0) {
+        return true;
+    }
+    if (!exists && table_.size() > 0) {
+        std::cerr << "Value separation cannot be enabled on a database that already holds inline values"
+                  << std::endl;
+        return false;
+    }
+    
+    value_log_ = std::make_unique<ValueLog>(options_.value_log);
+    if (!value_log_->open(value_log_dir()) || !sync_path(data_dir_)) {
+        value_log_.reset();
+        return false;
+    }
+    
+    // Only the table knows which records are live
+    uint64_t separated = 0;
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        const auto& shard = table_.shard(i);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (const auto& [key, stored] : shard.data) {
+            ValuePointer pointer;
+            if (decode_pointer(stored, pointer)) {
+                value_log_->mark_live(key, pointer);
+                separated++;
+            }
+        }
+    }
+    
+    std::cout << "Value log opened with " << separated << " separated values" << std::endl;
+    return true;
+}
+
+void PersistentDatabase::gc_loop() {
+    uint32_t interval_ms = value_log_ ? options_.value_log.gc_check_interval_ms
+                                      : options_.tiering.spill_log.gc_check_interval_ms;
+    if (value_log_ && tier_) {
+        interval_ms = std::min(interval_ms, options_.tiering.spill_log.gc_check_interval_ms);
+    }
+    if (tier_ && tier_->compressing()) {
+        interval_ms = std::min(interval_ms, options_.tiering.compress_interval_ms);
+    }
+    if (range_index_) {
+        interval_ms = std::min(interval_ms, options_.ranges.rebalance_interval_ms);
+    }
+    auto last_compress = std::chrono::steady_clock::now();
+    auto last_rebalance = std::chrono::steady_clock::now();
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(gc_wait_mutex_);
+            gc_cv_.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return gc_stopping_; });
+            if (gc_stopping_) {
+                return;
+            }
+        }
+        
+        if (value_log_ && !collect_value_log(options_.value_log.gc_dead_ratio)) {
+            std::cerr << "Value log collection failed; will retry" << std::endl;
+        }
+        
+        if (tier_ && tier_->compressing() &&
+            std::chrono::steady_clock::now() - last_compress >=
+                std::chrono::milliseconds(options_.tiering.compress_interval_ms)) {
+            tier_->compress_cold();
+            last_compress = std::chrono::steady_clock::now();
+        }
+        
+        if (range_index_ &&
+            std::chrono::steady_clock::now() - last_rebalance >=
+                std::chrono::milliseconds(options_.ranges.rebalance_interval_ms)) {
+            range_index_->rebalance();
+            last_rebalance = std::chrono::steady_clock::now();
+        }
+        
+        // A fork checkpoint child reads the spill files, so none may go while it runs
+        if (tier_ && !scheduler_->run_exclusive([this]() {
+                return tier_->collect(options_.tiering.spill_log.gc_dead_ratio);
+            })) {
+            std::cerr << "Spill file collection failed; will retry" << std::endl;
+        }
+    }
+}
+
+bool PersistentDatabase::resolve_spilled(size_t shard,
+                                         std::vector<std::pair<std::string, std::string>>& entries) const {
+    for (auto& [key, stored] : entries) {
+        if (!tier_->resolve(shard, key, stored)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PersistentDatabase::track_recovered(size_t shard, const std::string& key, size_t old_size, size_t new_size) {
+    tier_->changed(shard, key, old_size, new_size);
+    
+    // Keep recovery itself within the budget, spilling from the shard at hand
+    if (tier_->over_budget()) {
+        tier_->evict(shard, new_size);
+    }
+}
+
+bool PersistentDatabase::expire_locked(size_t index, const std::string& key, uint64_t now_ms) {
+    auto& shard = table_.shard(index);
+    auto expiry = shard.expires.find(key);
+    if (expiry == shard.expires.end() || expiry->second > now_ms) {
+        return false;
+    }
+    shard.expires.erase(expiry);
+    
+    auto it = shard.data.find(key);
+    if (it != shard.data.end()) {
+        release_value(value_log_.get(), key, it->second);
+        if (tier_) {
+            tier_->changed(index, key, it->second.size(), 0);
+        }
+        shard.data.erase(it);
+        if (range_index_) {
+            range_index_->remove(key);
+        }
+    }
+    table_.mark_dirty(shard, key);
+    expired_count_++;
+    
+    std::lock_guard<std::mutex> lock(expired_mutex_);
+    expired_keys_.push_back(key);
+    expired_horizon_ = std::max(expired_horizon_, now_ms);
+    return true;
+}
+
+void PersistentDatabase::expire_lazily(size_t index, const std::string& key) {
+    std::unique_lock<std::shared_mutex> lock(table_.shard(index).mutex);
+    if (expire_locked(index, key, epoch_ms())) {
+        lazy_expired_count_++;
+    }
+}
+
+bool PersistentDatabase::flush_expired() {
+    std::vector<std::string> keys;
+    uint64_t horizon;
+    {
+        std::lock_guard<std::mutex> lock(expired_mutex_);
+        keys.swap(expired_keys_);
+        horizon = expired_horizon_;
+    }
+    
+    // Losing a batch is harmless: recovery finds the keys past their expiry
+    // and removes them again
+    size_t next = 0;
+    while (next < keys.size()) {
+        WALRecord record;
+        record.type = WALRecordType::EXPIRE;
+        record.value.assign(sizeof(horizon), '\0');
+        std::memcpy(&record.value[0], &horizon, sizeof(horizon));
+        
+        for (; next < keys.size() && record.value.size() < EXPIRE_BATCH_BYTES; ++next) {
+            uint32_t length = static_cast<uint32_t>(keys[next].size());
+            record.value.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            record.value.append(keys[next]);
+        }
+        record.value_length = static_cast<uint32_t>(record.value.length());
+        
+        if (!wal_->append_record(record)) {
+            return false;
+        }
+        expire_batches_++;
+    }
+    return true;
+}
+
+void PersistentDatabase::rebuild_expiry_wheel() {
+    expiry_wheel_.reset(epoch_ms());
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        const auto& shard = table_.shard(i);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (const auto& [key, expire_ms] : shard.expires) {
+            expiry_wheel_.schedule(key, expire_ms);
+        }
+    }
+}
+
+void PersistentDatabase::rebuild_range_index() {
+    if (!range_index_) {
+        return;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        total += table_.shard(i).data.size();
+    }
+    
+    std::vector<std::string> keys;
+    keys.reserve(total);
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        for (const auto& [key, stored] : table_.shard(i).data) {
+            keys.push_back(key);
+        }
+    }
+    range_index_->rebuild(std::move(keys));
+}
+
+bool PersistentDatabase::delete_range(const std::string& start_key, const std::string& end_key,
+                                      uint64_t transaction_id) {
+    if (!(start_key < end_key)) {
+        return true;
+    }
+    
+    // Every shard lock is held only to record the range, never to walk keys
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(table_.shard_count());
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        locks.emplace_back(table_.shard(i).mutex);
+    }
+    
+    WALRecord record;
+    record.type = WALRecordType::DELETE_RANGE;
+    record.key = start_key;
+    record.value = end_key;
+    record.key_length = static_cast<uint32_t>(start_key.length());
+    record.value_length = static_cast<uint32_t>(end_key.length());
+    record.transaction_id = transaction_id;
+    uint64_t lsn = 0;
+    if (!wal_->append_record(record, &lsn)) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        ShardedTable::add_dropped(table_.shard(i), start_key, end_key, lsn);
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_ranges_mutex_);
+        pending_ranges_.push_back(PendingRange{start_key, end_key, lsn});
+    }
+    
+    // Deltas carry the range until it is purged, and the purge marks the keys it erases dirty
+    ranges_deleted_++;
+    return true;
+}
+
+void PersistentDatabase::purge_keys(size_t index, const std::vector<std::string>& keys) {
+    auto& shard = table_.shard(index);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    uint64_t purged = 0;
+    for (const auto& key : keys) {
+        auto it = shard.data.find(key);
+        if (it == shard.data.end() || !ShardedTable::is_dropped(shard, key)) {
+            continue;
+        }
+        release_value(value_log_.get(), key, it->second);
+        if (tier_) {
+            tier_->changed(index, key, it->second.size(), 0);
+        }
+        if (range_index_) {
+            range_index_->remove(key);
+        }
+        if (!shard.expires.empty()) {
+            shard.expires.erase(key);
+        }
+        table_.mark_dirty(shard, key);
+        shard.data.erase(it);
+        purged++;
+    }
+    range_purged_keys_ += purged;
+}
+
+void PersistentDatabase::purge_dropped_ranges() {
+    std::vector<PendingRange> ranges;
+    {
+        std::lock_guard<std::mutex> lock(pending_ranges_mutex_);
+        ranges = pending_ranges_;
+    }
+    if (ranges.empty()) {
+        return;
+    }
+    uint64_t through = 0;
+    for (const auto& range : ranges) {
+        through = std::max(through, range.lsn);
+    }
+    
+    // Keys written into a range later are hidden from nothing, so whatever
+    // is still hidden when its shard lock is taken can go
+    std::vector<std::string> batch;
+    if (range_index_) {
+        std::vector<std::vector<std::string>> by_shard(table_.shard_count());
+        for (const auto& range : ranges) {
+            std::string cursor = range.start;
+            while (true) {
+                batch = range_index_->scan(cursor, range.end, PURGE_BATCH);
+                bool last = batch.size() < PURGE_BATCH;
+                if (!last) {
+                    cursor = batch.back() + '\0';
+                }
+                for (auto& key : batch) {
+                    by_shard[table_.shard_index(key)].push_back(std::move(key));
+                }
+                for (size_t i = 0; i < by_shard.size(); ++i) {
+                    if (!by_shard[i].empty()) {
+                        purge_keys(i, by_shard[i]);
+                        by_shard[i].clear();
+                    }
+                }
+                if (last) break;
+            }
+        }
+    } else {
+        // Without an index every shard is read, under its shared lock so
+        // reads go on; writers to the shard wait for the one pass
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            const auto& shard = table_.shard(i);
+            batch.clear();
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                for (const auto& entry : shard.data) {
+                    if (ShardedTable::is_dropped(shard, entry.first)) {
+                        batch.push_back(entry.first);
+                    }
+                }
+            }
+            for (size_t from = 0; from < batch.size(); from += PURGE_BATCH) {
+                size_t to = std::min(from + PURGE_BATCH, batch.size());
+                purge_keys(i, std::vector<std::string>(batch.begin() + from, batch.begin() + to));
+            }
+        }
+    }
+    
+    // A delta written while only some shards still held a range would drop
+    // the keys rewritten into it in the others, so checkpoints wait this out
+    scheduler_->run_exclusive([this, through]() {
+        for (size_t i = 0; i < table_.shard_count(); ++i) {
+            std::unique_lock<std::shared_mutex> lock(table_.shard(i).mutex);
+            ShardedTable::remove_dropped_through(table_.shard(i), through);
+        }
+        std::lock_guard<std::mutex> lock(pending_ranges_mutex_);
+        pending_ranges_.erase(std::remove_if(pending_ranges_.begin(), pending_ranges_.end(),
+                                             [through](const PendingRange& range) { return range.lsn <= through; }),
+                              pending_ranges_.end());
+        return true;
+    });
+}
+
+void PersistentDatabase::expiry_loop() {
+    std::vector<TimingWheel::Timer> due;
+    std::vector<std::pair<size_t, const std::string*>> by_shard;
+    
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(expiry_wait_mutex_);
+            expiry_cv_.wait_for(lock, std::chrono::milliseconds(options_.expiry_interval_ms),
+                                [this]() { return expiry_stopping_; });
+            stopping = expiry_stopping_;
+        }
+        if (stopping) {
+            // Reads may have expired keys since the last pass
+            flush_expired();
+            return;
+        }
+        
+        // Whatever is due beyond the budget waits for the next pass
+        uint64_t now = epoch_ms();
+        due.clear();
+        expiry_wheel_.advance(now, due, std::max<size_t>(options_.expiry_budget, 1));
+        
+        // Take each shard lock once for all of its due keys. A timer whose key
+        // was put again since finds a later expiry, or none, and does nothing.
+        by_shard.clear();
+        for (const auto& timer : due) {
+            by_shard.emplace_back(table_.shard_index(timer.key), &timer.key);
+        }
+        std::sort(by_shard.begin(), by_shard.end());
+        for (size_t i = 0; i < by_shard.size();) {
+            size_t index = by_shard[i].first;
+            std::unique_lock<std::shared_mutex> lock(table_.shard(index).mutex);
+            for (; i < by_shard.size() && by_shard[i].first == index; ++i) {
+                expire_locked(index, *by_shard[i].second, now);
+            }
+        }
+        
+        if (!flush_expired()) {
+            std::cerr << "Failed to log expired keys" << std::endl;
+        }
+        
+        purge_dropped_ranges();
+    }
+}
+
+bool PersistentDatabase::collect_value_log(double min_dead_ratio) {
+    // Backups copy the segments their snapshot points into, so none may
+    // disappear while one runs
+    return scheduler_->run_exclusive([this, min_dead_ratio]() {
+        // Bounded so a steady stream of overwrites cannot hold checkpoints off
+        size_t budget = value_log_->list_segments().size();
+        for (; budget > 0; --budget) {
+            uint64_t segment = value_log_->pick_segment(min_dead_ratio);
+            if (segment == 0) {
+                break;
+            }
+            if (!collect_segment(segment)) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+bool PersistentDatabase::collect_segment(uint64_t segment) {
+    uint64_t moved = 0;
+    bool ok = value_log_->for_each(segment, [this, &moved](const std::string& key, const std::string& value,
+                                                           const ValuePointer& pointer) {
+        std::string current = encode_pointer(pointer);
+        auto& shard = table_.shard_for(key);
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.data.find(key);
+            if (it == shard.data.end() || it->second != current || ShardedTable::is_dropped(shard, key)) {
+                return true;
+            }
+        }
+        
+        ValuePointer relocated;
+        if (!value_log_->append(key, value, relocated)) {
+            return false;
+        }
+        
+        // Same order as a put: table, then WAL, under the shard lock
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.data.find(key);
+        if (it == shard.data.end() || it->second != current || ShardedTable::is_dropped(shard, key)) {
+            // Overwritten or deleted meanwhile
+            value_log_->mark_dead(key, relocated);
+            return true;
+        }
+        
+        // Keep the key's expiry, which a plain PUT would clear on replay
+        auto expiry = shard.expires.find(key);
+        WALRecord record;
+        record.type = expiry != shard.expires.end() ? WALRecordType::PUT_TTL : WALRecordType::PUT;
+        record.key = key;
+        record.value = expiry != shard.expires.end()
+            ? encode_expiring_value(encode_pointer(relocated), expiry->second)
+            : encode_pointer(relocated);
+        record.key_length = static_cast<uint32_t>(key.length());
+        record.value_length = static_cast<uint32_t>(record.value.length());
+        if (!wal_->append_record(record)) {
+            value_log_->mark_dead(key, relocated);
+            return false;
+        }
+        
+        it->second = encode_pointer(relocated);
+        table_.mark_dirty(shard, key);
+        moved += value.size();
+        return true;
+    });
+    if (!ok) {
+        return false;
+    }
+    
+    // Recovery reads the new locations from the WAL, so they go out before
+    // the old ones disappear
+    wal_->flush();
+    if (!value_log_->remove_segment(segment)) {
+        return false;
+    }
+    
+    gc_count_++;
+    gc_moved_bytes_ += moved;
+    std::cout << "Value log collected segment " << segment << ", moved " << moved << " bytes" << std::endl;
+    return true;
+}
 
 // Update factory to create persistent database
 std::shared_ptr<Database> DatabaseFactory::create_database() {
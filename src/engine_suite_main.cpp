@@ -0,0 +1,890 @@
+#include "core/database.h"
+#include "core/engine_registry.h"
+#include "core/import_paths.h"
+#include "storage/snapshot.h"
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+
+using namespace distributeddb;
+
+namespace {
+
+struct SuiteConfig {
+    std::vector<std::string> engines;   // Empty runs every registered engine
+    EngineOptions options;
+    std::string work_dir = "./engine-suite";
+    uint64_t keys = 100000;
+    int threads = 4;
+    size_t value_size = 100;
+    bool conformance = true;
+    bool benchmark = true;
+};
+
+std::string make_key(uint64_t i) {
+    // Scramble so inserts land all over the key space
+    uint64_t x = i * 0x9e3779b97f4a7c15ULL;
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "key%016llx", static_cast<unsigned long long>(x));
+    return buffer;
+}
+
+// Sorts above every key the suite writes
+const std::string SCAN_END(8, '\xff');
+
+std::shared_ptr<Database> open_engine(const SuiteConfig& config, const std::string& engine,
+                                      const std::string& dir) {
+    auto database = DatabaseFactory::create_database(engine, config.options);
+    if (!database || database->initialize(dir) != OperationResult::SUCCESS) {
+        return nullptr;
+    }
+    return database;
+}
+
+// Runs fn(thread, begin, end) over [0, operations) split across threads; returns ops/sec
+double run_parallel(int threads, uint64_t operations,
+                    const std::function<void(int, uint64_t, uint64_t)>& fn) {
+    std::vector<std::thread> pool;
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    uint64_t per_thread = operations / threads;
+    for (int t = 0; t < threads; ++t) {
+        uint64_t begin = t * per_thread;
+        uint64_t end = (t == threads - 1) ? operations : begin + per_thread;
+        pool.emplace_back([&fn, t, begin, end]() { fn(t, begin, end); });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return seconds > 0 ? operations / seconds : 0.0;
+}
+
+uint64_t directory_bytes(const std::string& dir) {
+    uint64_t bytes = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(dir, ec)) {
+        if (entry.is_regular_file(ec)) {
+            bytes += entry.file_size(ec);
+        }
+    }
+    return bytes;
+}
+
+// Optional features of the registered engines. An engine without one must
+// refuse it with the interface's default SYSTEM_ERROR.
+struct EngineFeatures {
+    bool ttl = false;
+    bool bulk_load = false;
+    bool ingest = false;
+};
+
+EngineFeatures features_of(const std::string& engine) {
+    EngineFeatures features;
+    features.ttl = engine == "hash";
+    features.bulk_load = engine == "hash";
+    features.ingest = engine == "hash" || engine == "lsm";
+    return features;
+}
+
+// Behaviour every engine must share, checked only through the Database and
+// Transaction interfaces. The expected contents are tracked alongside, so
+// restart, compaction and restore can be verified against them.
+class ConformanceSuite {
+public:
+    ConformanceSuite(const SuiteConfig& config, const std::string& engine, const std::string& dir)
+        : config_(config), engine_(engine), dir_(dir), features_(features_of(engine)) {}
+    
+    // Returns the number of failed checks
+    size_t run() {
+        database_ = open_engine(config_, engine_, dir_);
+        if (!database_) {
+            report("open", {"engine failed to initialize"});
+            return 1;
+        }
+        
+        size_t failed = 0;
+        const std::vector<std::pair<const char*, void (ConformanceSuite::*)()>> cases = {
+            {"put and get", &ConformanceSuite::check_put_get},
+            {"overwrite", &ConformanceSuite::check_overwrite},
+            {"delete", &ConformanceSuite::check_delete},
+            {"read own writes", &ConformanceSuite::check_read_own_writes},
+            {"binary keys and values", &ConformanceSuite::check_binary},
+            {"large value", &ConformanceSuite::check_large_value},
+            {"scan range and limit", &ConformanceSuite::check_scan},
+            {"concurrent writers", &ConformanceSuite::check_concurrent_writers},
+            {"restart", &ConformanceSuite::check_restart},
+            {"TTL", &ConformanceSuite::check_ttl},
+            {"delete range", &ConformanceSuite::check_delete_range},
+            {"bulk load", &ConformanceSuite::check_bulk_load},
+            {"ingest", &ConformanceSuite::check_ingest},
+            {"namespaces", &ConformanceSuite::check_namespaces},
+            {"compact", &ConformanceSuite::check_compact},
+            {"backup and restore", &ConformanceSuite::check_backup_restore},
+        };
+        
+        for (const auto& [name, check] : cases) {
+            errors_.clear();
+            if (database_) {
+                (this->*check)();
+            } else {
+                errors_.push_back("database is not open");
+            }
+            failed += errors_.empty() ? 0 : 1;
+            report(name, errors_);
+        }
+        
+        if (database_) {
+            database_->shutdown();
+        }
+        return failed;
+    }
+
+private:
+    const SuiteConfig& config_;
+    std::string engine_;
+    std::string dir_;
+    EngineFeatures features_;
+    std::shared_ptr<Database> database_;
+    std::map<std::string, std::string> expected_;
+    std::set<std::string> deleted_;
+    std::mutex expected_mutex_;
+    std::vector<std::string> errors_;
+    
+    void report(const std::string& name, const std::vector<std::string>& errors) {
+        std::cout << "  [" << (errors.empty() ? "PASS" : "FAIL") << "] " << engine_ << ": " << name << std::endl;
+        for (size_t i = 0; i < errors.size() && i < 5; ++i) {
+            std::cout << "         " << errors[i] << std::endl;
+        }
+        if (errors.size() > 5) {
+            std::cout << "         ... " << errors.size() - 5 << " more" << std::endl;
+        }
+    }
+    
+    void expect(bool condition, const std::string& what) {
+        if (!condition) {
+            std::lock_guard<std::mutex> lock(expected_mutex_);
+            errors_.push_back(what);
+        }
+    }
+    
+    void put(Transaction& txn, const std::string& key, const std::string& value) {
+        expect(txn.put(key, value) == OperationResult::SUCCESS, "put " + key + " failed");
+        std::lock_guard<std::mutex> lock(expected_mutex_);
+        expected_[key] = value;
+        deleted_.erase(key);
+    }
+    
+    void del(Transaction& txn, const std::string& key) {
+        expect(txn.del(key) == OperationResult::SUCCESS, "delete " + key + " failed");
+        std::lock_guard<std::mutex> lock(expected_mutex_);
+        expected_.erase(key);
+        deleted_.insert(key);
+    }
+    
+    void commit(Transaction& txn) {
+        expect(txn.commit() == OperationResult::SUCCESS, "commit failed");
+    }
+    
+    // Every expected key reads back, deleted keys stay gone, and a full scan
+    // returns exactly the expected contents
+    void verify(const std::string& stage) {
+        auto txn = database_->begin_transaction();
+        if (!txn) {
+            expect(false, stage + ": no transaction");
+            return;
+        }
+        
+        size_t wrong = 0;
+        for (const auto& [key, value] : expected_) {
+            wrong += txn->get(key) == value ? 0 : 1;
+        }
+        for (const auto& key : deleted_) {
+            wrong += txn->get(key).empty() ? 0 : 1;
+        }
+        expect(wrong == 0, stage + ": " + std::to_string(wrong) + " keys read back wrong");
+        
+        auto entries = txn->scan("", SCAN_END, expected_.size() + 10);
+        std::sort(entries.begin(), entries.end());
+        std::vector<std::pair<std::string, std::string>> want(expected_.begin(), expected_.end());
+        expect(entries == want, stage + ": full scan returned " + std::to_string(entries.size()) +
+                                " entries, expected " + std::to_string(want.size()));
+        commit(*txn);
+    }
+    
+    void check_put_get() {
+        auto txn = database_->begin_transaction();
+        put(*txn, "conformance:a", "alpha");
+        put(*txn, "conformance:b", "beta");
+        commit(*txn);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get("conformance:a") == "alpha", "committed value not visible");
+        expect(reader->get("conformance:missing").empty(), "missing key returned a value");
+        commit(*reader);
+    }
+    
+    void check_overwrite() {
+        auto txn = database_->begin_transaction();
+        put(*txn, "conformance:c", "first");
+        put(*txn, "conformance:c", "second");
+        commit(*txn);
+        
+        auto second = database_->begin_transaction();
+        expect(second->get("conformance:c") == "second", "overwrite within a transaction lost");
+        put(*second, "conformance:c", "third");
+        commit(*second);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get("conformance:c") == "third", "overwrite across transactions lost");
+        commit(*reader);
+    }
+    
+    void check_delete() {
+        auto txn = database_->begin_transaction();
+        put(*txn, "conformance:d", "doomed");
+        commit(*txn);
+        
+        auto deleter = database_->begin_transaction();
+        del(*deleter, "conformance:d");
+        expect(deleter->del("conformance:never") == OperationResult::KEY_NOT_FOUND,
+               "deleting a missing key did not report KEY_NOT_FOUND");
+        commit(*deleter);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get("conformance:d").empty(), "deleted key still readable");
+        commit(*reader);
+    }
+    
+    void check_read_own_writes() {
+        auto txn = database_->begin_transaction();
+        put(*txn, "conformance:e", "mine");
+        expect(txn->get("conformance:e") == "mine", "uncommitted put not visible to its transaction");
+        del(*txn, "conformance:a");
+        expect(txn->get("conformance:a").empty(), "uncommitted delete not visible to its transaction");
+        commit(*txn);
+    }
+    
+    void check_binary() {
+        std::string key("conformance:bin\0\x01\xfe", 18);
+        std::string value;
+        for (int i = 0; i < 256; ++i) {
+            value.push_back(static_cast<char>(i));
+        }
+        
+        auto txn = database_->begin_transaction();
+        put(*txn, key, value);
+        commit(*txn);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get(key) == value, "binary key or value not preserved");
+        commit(*reader);
+    }
+    
+    void check_large_value() {
+        std::string value(512 * 1024, '\0');
+        for (size_t i = 0; i < value.size(); ++i) {
+            value[i] = static_cast<char>('a' + i % 26);
+        }
+        
+        auto txn = database_->begin_transaction();
+        put(*txn, "conformance:large", value);
+        commit(*txn);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get("conformance:large") == value, "512 KB value not preserved");
+        commit(*reader);
+    }
+    
+    void check_scan() {
+        auto txn = database_->begin_transaction();
+        for (int i = 0; i < 200; ++i) {
+            char key[32];
+            std::snprintf(key, sizeof(key), "scan:%03d", i);
+            put(*txn, key, "v" + std::to_string(i));
+        }
+        commit(*txn);
+        
+        auto deleter = database_->begin_transaction();
+        del(*deleter, "scan:100");
+        commit(*deleter);
+        
+        auto reader = database_->begin_transaction();
+        auto range = reader->scan("scan:050", "scan:150", 1000);
+        std::sort(range.begin(), range.end());
+        std::vector<std::pair<std::string, std::string>> want;
+        for (auto it = expected_.lower_bound("scan:050"); it != expected_.lower_bound("scan:150"); ++it) {
+            want.push_back(*it);
+        }
+        expect(range == want, "range scan returned " + std::to_string(range.size()) +
+                              " entries, expected " + std::to_string(want.size()));
+        
+        // Which entries a limited scan returns is up to the engine; each must be in range
+        auto limited = reader->scan("scan:050", "scan:150", 10);
+        expect(limited.size() == 10, "limited scan returned " + std::to_string(limited.size()) + " entries");
+        for (const auto& [key, value] : limited) {
+            auto it = expected_.find(key);
+            expect(key >= "scan:050" && key < "scan:150" && it != expected_.end() && it->second == value,
+                   "limited scan returned unexpected entry " + key);
+        }
+        
+        expect(reader->scan("scan:500", "scan:600", 10).empty(), "empty range returned entries");
+        commit(*reader);
+    }
+    
+    void check_concurrent_writers() {
+        const int threads = std::max(2, config_.threads);
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([this, t]() {
+                auto txn = database_->begin_transaction();
+                for (int i = 0; i < 1000; ++i) {
+                    put(*txn, "concurrent:" + std::to_string(t) + ":" + std::to_string(i),
+                        std::string(i % 300, static_cast<char>('a' + t % 26)) + std::to_string(i));
+                    if (i % 100 == 99) {
+                        commit(*txn);
+                        txn = database_->begin_transaction();
+                    }
+                }
+                commit(*txn);
+            });
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        verify("after concurrent writes");
+    }
+    
+    // Shut down and open the data directory again, down for at least downtime
+    bool reopen(std::chrono::milliseconds downtime = std::chrono::milliseconds(0)) {
+        database_->shutdown();
+        database_.reset();
+        std::this_thread::sleep_for(downtime);
+        database_ = open_engine(config_, engine_, dir_);
+        expect(database_ != nullptr, "engine failed to reopen");
+        return database_ != nullptr;
+    }
+    
+    void check_restart() {
+        if (reopen()) {
+            verify("after restart");
+        }
+    }
+    
+    void check_ttl() {
+        auto txn = database_->begin_transaction();
+        OperationResult result = txn->put_with_ttl("ttl:short", "fleeting", 300);
+        deleted_.insert("ttl:short");
+        if (!features_.ttl) {
+            expect(result == OperationResult::SYSTEM_ERROR, "put with a TTL was not refused");
+            commit(*txn);
+            verify("after a refused TTL put");
+            return;
+        }
+        expect(result == OperationResult::SUCCESS, "put with a TTL failed");
+        expect(txn->put_with_ttl("ttl:long", "lasting", 3600 * 1000) == OperationResult::SUCCESS,
+               "put with a TTL failed");
+        expected_["ttl:long"] = "lasting";
+        commit(*txn);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get("ttl:short") == "fleeting", "key read back gone before its TTL");
+        commit(*reader);
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        verify("after the TTL ran out");
+        if (reopen()) {
+            verify("after restart past the TTL");
+        }
+        
+        // A key whose TTL runs out while the engine is down is gone when it opens
+        txn = database_->begin_transaction();
+        expect(txn->put_with_ttl("ttl:down", "fleeting", 300) == OperationResult::SUCCESS,
+               "put with a TTL failed");
+        deleted_.insert("ttl:down");
+        commit(*txn);
+        if (reopen(std::chrono::milliseconds(600))) {
+            verify("after the TTL ran out while down");
+        }
+    }
+    
+    // Every engine deletes ranges, with range tombstones or key by key
+    void delete_range(Transaction& txn, const std::string& start, const std::string& end) {
+        expect(txn.del_range(start, end) == OperationResult::SUCCESS,
+               "deleting [" + start + ", " + end + ") failed");
+        std::lock_guard<std::mutex> lock(expected_mutex_);
+        for (auto it = expected_.lower_bound(start); it != expected_.end() && it->first < end;) {
+            deleted_.insert(it->first);
+            it = expected_.erase(it);
+        }
+    }
+    
+    void check_delete_range() {
+        auto txn = database_->begin_transaction();
+        for (int i = 0; i < 300; ++i) {
+            char key[32];
+            std::snprintf(key, sizeof(key), "range:%03d", i);
+            put(*txn, key, "r" + std::to_string(i));
+        }
+        commit(*txn);
+        
+        // The restart leaves a checkpoint behind, so the next one can be a delta
+        if (!reopen()) {
+            return;
+        }
+        
+        txn = database_->begin_transaction();
+        delete_range(*txn, "range:050", "range:150");
+        commit(*txn);
+        
+        auto reader = database_->begin_transaction();
+        expect(reader->get("range:100").empty(), "key in a deleted range still readable");
+        expect(reader->scan("range:050", "range:150", 1000).empty(), "scan of a deleted range returned entries");
+        expect(reader->get("range:150") == "r150", "key past a deleted range lost");
+        commit(*reader);
+        
+        // A write after the delete is not covered by it
+        txn = database_->begin_transaction();
+        put(*txn, "range:120", "rewritten");
+        commit(*txn);
+        verify("after deleting a range");
+        
+        // Straight away, so engines that purge in the background have not yet
+        if (reopen()) {
+            verify("after restart with the range pending");
+        }
+        
+        // Past the purge, then through the checkpoint the restart writes
+        txn = database_->begin_transaction();
+        delete_range(*txn, "range:200", "range:250");
+        commit(*txn);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        verify("after the deleted range was purged");
+        if (reopen() && reopen()) {
+            verify("after restarts past the purge");
+        }
+    }
+    
+    void check_bulk_load() {
+        std::string import_dir = dir_ + "-import";
+        std::error_code ec;
+        std::filesystem::remove_all(import_dir, ec);
+        std::filesystem::create_directories(import_dir, ec);
+        
+        // Sorted key<TAB>value lines; the last one replaces a key written earlier
+        std::string path = import_dir + "/load.tsv";
+        std::map<std::string, std::string> lines;
+        {
+            std::ofstream out(path);
+            for (int i = 0; i < 1000; ++i) {
+                char key[32];
+                std::snprintf(key, sizeof(key), "bulk:%04d", i);
+                lines[key] = "b" + std::to_string(i);
+                out << key << '\t' << lines[key] << '\n';
+            }
+            out << "bulk:escaped\ttab\\there\\nnewline\\\\backslash\n";
+            lines["bulk:escaped"] = "tab\there\nnewline\\backslash";
+            out << "conformance:b\tbulk loaded\n";
+            lines["conformance:b"] = "bulk loaded";
+        }
+        
+        uint64_t entries = 0;
+        OperationResult result = database_->bulk_load(path, entries);
+        if (!features_.bulk_load) {
+            expect(result == OperationResult::SYSTEM_ERROR && entries == 0, "bulk load was not refused");
+            deleted_.insert("bulk:0000");
+            verify("after a refused bulk load");
+        } else {
+            expect(result == OperationResult::SUCCESS, "bulk load failed");
+            expect(entries == lines.size(), "bulk load reported " + std::to_string(entries) + " keys, expected " +
+                                            std::to_string(lines.size()));
+            for (const auto& [key, value] : lines) {
+                expected_[key] = value;
+                deleted_.erase(key);
+            }
+            verify("after bulk load");
+            if (reopen()) {
+                verify("after restart past a bulk load");
+            }
+        }
+        std::filesystem::remove_all(import_dir, ec);
+    }
+    
+    // A block file of PUT entries prefix000, prefix001, ... as an offline job would build it
+    void write_block_file(const std::string& path, const std::string& prefix, int first, int count,
+                          std::map<std::string, std::string>& entries) {
+        SnapshotWriter writer(path);
+        bool ok = writer.open(0, 0);
+        for (int i = first; ok && i < first + count; ++i) {
+            char key[64];
+            std::snprintf(key, sizeof(key), "%s%03d", prefix.c_str(), i);
+            entries[key] = "i" + std::to_string(i);
+            ok = writer.add(key, entries[key]);
+        }
+        expect(ok && writer.finish(), "writing block file " + path + " failed");
+    }
+    
+    void check_ingest() {
+        std::string import_dir = dir_ + "-import";
+        std::string outside_dir = dir_ + "-outside";
+        std::error_code ec;
+        for (const auto& dir : {import_dir, outside_dir}) {
+            std::filesystem::remove_all(dir, ec);
+            std::filesystem::create_directories(dir, ec);
+        }
+        import_dir = std::filesystem::canonical(import_dir, ec).string();
+        
+        std::map<std::string, std::string> files;
+        std::map<std::string, std::string> overlapping;
+        std::map<std::string, std::string> outside;
+        write_block_file(import_dir + "/a.blk", "ingest:a", 0, 500, files);
+        write_block_file(import_dir + "/b.blk", "ingest:b", 0, 500, files);
+        write_block_file(import_dir + "/c1.blk", "ingest:c", 0, 300, overlapping);
+        write_block_file(import_dir + "/c2.blk", "ingest:c", 200, 300, overlapping);
+        write_block_file(outside_dir + "/d.blk", "ingest:d", 0, 10, outside);
+        std::filesystem::create_symlink(outside_dir + "/d.blk", import_dir + "/link.blk", ec);
+        
+        // Only regular files inside the import directory may be named
+        const std::vector<std::vector<std::string>> refused = {
+            {"../" + std::filesystem::path(outside_dir).filename().string() + "/d.blk"},
+            {outside_dir + "/d.blk"},
+            {"link.blk"},
+            {"missing.blk"},
+            {"a.blk", outside_dir + "/d.blk"},
+        };
+        for (auto paths : refused) {
+            std::string named = paths.back();
+            expect(!resolve_import_paths(import_dir, paths).empty(), named + " accepted for import");
+        }
+        std::vector<std::string> paths = {"a.blk"};
+        expect(!resolve_import_paths("", paths).empty(), "import accepted without an import directory");
+        
+        paths = {"a.blk", import_dir + "/b.blk"};
+        expect(resolve_import_paths(import_dir, paths).empty(), "files in the import directory refused");
+        
+        uint64_t entries = 0;
+        OperationResult result = database_->ingest_files(paths, entries);
+        if (!features_.ingest) {
+            expect(result == OperationResult::SYSTEM_ERROR && entries == 0, "ingest was not refused");
+            deleted_.insert("ingest:a000");
+        } else {
+            expect(result == OperationResult::SUCCESS, "ingest failed");
+            expect(entries == files.size(), "ingest reported " + std::to_string(entries) + " keys, expected " +
+                                            std::to_string(files.size()));
+            for (const auto& [key, value] : files) {
+                expected_[key] = value;
+                deleted_.erase(key);
+            }
+        }
+        
+        // Overlapping files are refused as a set, none of their keys going in
+        paths = {"c1.blk", "c2.blk"};
+        expect(resolve_import_paths(import_dir, paths).empty(), "files in the import directory refused");
+        result = database_->ingest_files(paths, entries);
+        expect(result != OperationResult::SUCCESS, "overlapping files were ingested");
+        expect(features_.ingest || result == OperationResult::SYSTEM_ERROR, "ingest was not refused");
+        for (const auto& [key, value] : overlapping) {
+            deleted_.insert(key);
+        }
+        
+        verify("after ingest");
+        if (reopen()) {
+            verify("after restart past an ingest");
+        }
+        for (const auto& dir : {import_dir, outside_dir}) {
+            std::filesystem::remove_all(dir, ec);
+        }
+    }
+    
+    // Each namespace id holds "shared" and "only:<id>" unless dropped or truncated
+    void verify_namespaces(Database& database, const std::string& stage) {
+        const std::map<uint32_t, std::vector<std::pair<std::string, std::string>>> want = {
+            {0, {{"only:0", "x"}, {"shared", "ns0"}}},
+            {1, {}},
+            {2, {{"after", "truncated"}}},
+            {3, {{"only:3", "x"}, {"shared", "ns3"}}},
+        };
+        for (const auto& [id, entries] : want) {
+            auto txn = database.begin_transaction_in(id);
+            if (!txn) {
+                expect(false, stage + ": no transaction in namespace " + std::to_string(id));
+                continue;
+            }
+            auto found = txn->scan("", SCAN_END, 100);
+            std::sort(found.begin(), found.end());
+            expect(found == entries, stage + ": namespace " + std::to_string(id) + " holds " +
+                                     std::to_string(found.size()) + " keys, expected " +
+                                     std::to_string(entries.size()));
+            std::string shared = id == 0 || id == 3 ? "ns" + std::to_string(id) : "";
+            expect(txn->get("shared") == shared, stage + ": namespace " + std::to_string(id) +
+                                                 " reads the wrong value of a key every namespace wrote");
+            commit(*txn);
+        }
+    }
+    
+    void check_namespaces() {
+        // A plain engine has only namespace 0
+        expect(database_->begin_transaction_in(1) == nullptr, "plain engine opened namespace 1");
+        expect(database_->drop_namespace(1) == OperationResult::SYSTEM_ERROR, "plain engine dropped a namespace");
+        expect(database_->truncate_namespace(1) == OperationResult::SYSTEM_ERROR,
+               "plain engine truncated a namespace");
+        
+        std::string dir = dir_ + "-namespaces";
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+        auto open = [this, &dir]() -> std::shared_ptr<Database> {
+            auto database = DatabaseFactory::create_namespaced_database(engine_, config_.options, {});
+            if (!database || database->initialize(dir) != OperationResult::SUCCESS) {
+                return nullptr;
+            }
+            return database;
+        };
+        auto database = open();
+        if (!database) {
+            expect(false, "namespaced engine failed to initialize");
+            return;
+        }
+        
+        for (uint32_t id = 0; id < 4; ++id) {
+            auto txn = database->begin_transaction_in(id);
+            expect(txn && txn->put("shared", "ns" + std::to_string(id)) == OperationResult::SUCCESS &&
+                   txn->put("only:" + std::to_string(id), "x") == OperationResult::SUCCESS &&
+                   txn->commit() == OperationResult::SUCCESS,
+                   "writing namespace " + std::to_string(id) + " failed");
+        }
+        
+        expect(database->drop_namespace(1) == OperationResult::SUCCESS, "dropping namespace 1 failed");
+        expect(database->truncate_namespace(2) == OperationResult::SUCCESS, "truncating namespace 2 failed");
+        expect(database->drop_namespace(0) == OperationResult::SYSTEM_ERROR, "namespace 0 was dropped");
+        expect(database->truncate_namespace(0) == OperationResult::SYSTEM_ERROR, "namespace 0 was truncated");
+        auto txn = database->begin_transaction_in(2);
+        expect(txn && txn->put("after", "truncated") == OperationResult::SUCCESS &&
+               txn->commit() == OperationResult::SUCCESS, "writing a truncated namespace failed");
+        verify_namespaces(*database, "after drop and truncate");
+        
+        database->shutdown();
+        database = open();
+        if (!database) {
+            expect(false, "namespaced engine failed to reopen");
+        } else {
+            verify_namespaces(*database, "after restart");
+            database->shutdown();
+        }
+        std::filesystem::remove_all(dir, ec);
+    }
+    
+    void check_compact() {
+        expect(database_->compact() == OperationResult::SUCCESS, "compact failed");
+        verify("after compact");
+    }
+    
+    void check_backup_restore() {
+        std::string backup_dir = dir_ + "-backup";
+        std::error_code ec;
+        std::filesystem::remove_all(backup_dir, ec);
+        
+        expect(database_->backup(backup_dir) == OperationResult::SUCCESS, "backup failed");
+        auto saved = expected_;
+        auto saved_deleted = deleted_;
+        
+        auto txn = database_->begin_transaction();
+        put(*txn, "conformance:after-backup", "gone after restore");
+        put(*txn, "conformance:b", "changed after backup");
+        del(*txn, "conformance:c");
+        commit(*txn);
+        
+        expect(database_->restore(backup_dir) == OperationResult::SUCCESS, "restore failed");
+        expected_ = saved;
+        deleted_ = saved_deleted;
+        deleted_.insert("conformance:after-backup");
+        verify("after restore");
+        
+        // The restored state must itself be durable
+        check_restart();
+        std::filesystem::remove_all(backup_dir, ec);
+    }
+};
+
+struct BenchmarkResult {
+    double fill_ops = 0;
+    double read_ops = 0;
+    double scan_ops = 0;
+    double reopen_ms = 0;
+    uint64_t disk_bytes = 0;
+    bool ok = false;
+};
+
+BenchmarkResult run_benchmark(const SuiteConfig& config, const std::string& engine, const std::string& dir) {
+    BenchmarkResult result;
+    auto database = open_engine(config, engine, dir);
+    if (!database) {
+        return result;
+    }
+    
+    const std::string value(config.value_size, 'v');
+    const uint64_t batch = 100;
+    
+    // Each thread writes its own slice, committing every batch
+    result.fill_ops = run_parallel(config.threads, config.keys, [&](int, uint64_t begin, uint64_t end) {
+        auto txn = database->begin_transaction();
+        for (uint64_t i = begin; i < end; ++i) {
+            txn->put(make_key(i), value);
+            if ((i - begin) % batch == batch - 1) {
+                txn->commit();
+                txn = database->begin_transaction();
+            }
+        }
+        txn->commit();
+    });
+    
+    std::atomic<uint64_t> found(0);
+    result.read_ops = run_parallel(config.threads, config.keys, [&](int, uint64_t begin, uint64_t end) {
+        auto txn = database->begin_transaction();
+        uint64_t hits = 0;
+        for (uint64_t i = begin; i < end; ++i) {
+            // Stride through the slice so reads do not follow insert order
+            uint64_t key = begin + (i - begin) * 7919 % (end - begin);
+            hits += txn->get(make_key(key)).size() == value.size() ? 1 : 0;
+        }
+        found += hits;
+        txn->commit();
+    });
+    if (found != config.keys) {
+        std::cerr << engine << ": read " << found << " of " << config.keys << " keys" << std::endl;
+    }
+    
+    const uint64_t scans = std::max<uint64_t>(1, config.keys / 100);
+    result.scan_ops = run_parallel(config.threads, scans, [&](int, uint64_t begin, uint64_t end) {
+        auto txn = database->begin_transaction();
+        for (uint64_t i = begin; i < end; ++i) {
+            txn->scan(make_key(i * 97), SCAN_END, 100);
+        }
+        txn->commit();
+    });
+    
+    auto reopen_start = std::chrono::high_resolution_clock::now();
+    database->shutdown();
+    database.reset();
+    result.disk_bytes = directory_bytes(dir);
+    database = open_engine(config, engine, dir);
+    result.reopen_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - reopen_start).count();
+    
+    result.ok = database != nullptr && found == config.keys;
+    if (database) {
+        database->shutdown();
+    }
+    return result;
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --engine NAME         Engine to run; may be repeated (default: all registered)" << std::endl;
+    std::cout << "  --option KEY=VALUE    Engine setting passed to every engine run; may be repeated" << std::endl;
+    std::cout << "  --conformance-only    Skip the benchmark" << std::endl;
+    std::cout << "  --benchmark-only      Skip the conformance checks" << std::endl;
+    std::cout << "  --keys N              Keys written by the benchmark (default: 100000)" << std::endl;
+    std::cout << "  --threads N           Benchmark threads (default: 4)" << std::endl;
+    std::cout << "  --value-size N        Benchmark value size (default: 100)" << std::endl;
+    std::cout << "  --dir DIR             Scratch directory, wiped per engine (default: ./engine-suite)" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    SuiteConfig config;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--engine" && has_value) {
+            config.engines.push_back(argv[++i]);
+        } else if (arg == "--option" && has_value) {
+            if (!parse_engine_option(argv[++i], config.options)) {
+                std::cerr << "Expected KEY=VALUE after --option, got " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--conformance-only") {
+            config.benchmark = false;
+        } else if (arg == "--benchmark-only") {
+            config.conformance = false;
+        } else if (arg == "--keys" && has_value) {
+            config.keys = std::stoull(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            config.threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--value-size" && has_value) {
+            config.value_size = std::max<size_t>(1, std::stoull(argv[++i]));
+        } else if (arg == "--dir" && has_value) {
+            config.work_dir = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    
+    const auto& registry = EngineRegistry::instance();
+    if (config.engines.empty()) {
+        config.engines = registry.engine_names();
+    }
+    for (const auto& engine : config.engines) {
+        if (!registry.contains(engine)) {
+            std::cerr << "Unknown engine " << engine << std::endl;
+            return 1;
+        }
+    }
+    config.keys = std::max<uint64_t>(config.keys, static_cast<uint64_t>(config.threads));
+    
+    size_t failures = 0;
+    if (config.conformance) {
+        std::cout << "=== Conformance ===" << std::endl;
+        for (const auto& engine : config.engines) {
+            std::string dir = config.work_dir + "/conformance-" + engine;
+            std::filesystem::remove_all(dir);
+            failures += ConformanceSuite(config, engine, dir).run();
+            std::filesystem::remove_all(dir);
+        }
+        std::cout << (failures == 0 ? "All conformance checks passed" :
+                      std::to_string(failures) + " conformance checks failed") << std::endl << std::endl;
+    }
+    
+    if (config.benchmark) {
+        std::vector<std::pair<std::string, BenchmarkResult>> results;
+        for (const auto& engine : config.engines) {
+            std::string dir = config.work_dir + "/benchmark-" + engine;
+            std::filesystem::remove_all(dir);
+            results.emplace_back(engine, run_benchmark(config, engine, dir));
+            std::filesystem::remove_all(dir);
+            failures += results.back().second.ok ? 0 : 1;
+        }
+        
+        std::cout << "=== Benchmark: " << config.keys << " keys, " << config.value_size << "-byte values, "
+                  << config.threads << " threads ===" << std::endl;
+        std::cout << "Throughput in thousand ops/sec; scans return 100 entries" << std::endl << std::endl;
+        std::cout << std::left << std::setw(10) << "engine" << std::setw(10) << "fill" << std::setw(10) << "read"
+                  << std::setw(10) << "scan" << std::setw(12) << "reopen ms" << std::setw(10) << "disk MB"
+                  << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        for (const auto& [engine, result] : results) {
+            std::cout << std::setw(10) << engine << std::setw(10) << result.fill_ops / 1e3
+                      << std::setw(10) << result.read_ops / 1e3 << std::setw(10) << result.scan_ops / 1e3
+                      << std::setw(12) << result.reopen_ms << std::setw(10) << result.disk_bytes / 1048576.0
+                      << (result.ok ? "" : "  FAILED") << std::endl;
+        }
+    }
+    
+    return failures == 0 ? 0 : 1;
+}
@@ -2,12 +2,14 @@
 #include <iostream>
 #include <boost/asio/write.hpp>
 #include <boost/asio/read.hpp>
+#include <filesystem>
+#include <fstream>
 
 namespace distributeddb {
 
 DatabaseClient::DatabaseClient(const std::string& host, uint16_t port)
     : socket_(std::make_unique<boost::asio::ip::tcp::socket>(io_context_)),
-      host_(host), port_(port), connected_(false), request_id_(0) {
+      host_(host), port_(port), connected_(false), request_id_(0), namespace_id_(0) {
 }
 
 DatabaseClient::~DatabaseClient() {
@@ -47,6 +49,7 @@ std::string DatabaseClient::get(const std::string& key) {
     Message request;
     request.type = MessageType::GET;
     request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
     request.key = key;
     request.key_length = static_cast<uint32_t>(key.length());
     
@@ -58,14 +61,16 @@ std::string DatabaseClient::get(const std::string& key) {
     }
 }
 
-bool DatabaseClient::put(const std::string& key, const std::string& value) {
+bool DatabaseClient::put(const std::string& key, const std::string& value, uint64_t ttl_ms) {
     Message request;
     request.type = MessageType::PUT;
     request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
     request.key = key;
     request.value = value;
     request.key_length = static_cast<uint32_t>(key.length());
     request.value_length = static_cast<uint32_t>(value.length());
+    request.ttl_ms = ttl_ms;
     
     Message response = send_request(request);
     return response.type == MessageType::SUCCESS;
@@ -75,6 +80,7 @@ bool DatabaseClient::del(const std::string& key) {
     Message request;
     request.type = MessageType::DELETE;
     request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
     request.key = key;
     request.key_length = static_cast<uint32_t>(key.length());
     
@@ -82,12 +88,27 @@ bool DatabaseClient::del(const std::string& key) {
     return response.type == MessageType::SUCCESS;
 }
 
+bool DatabaseClient::del_range(const std::string& start_key, const std::string& end_key) {
+    Message request;
+    request.type = MessageType::DELETE_RANGE;
+    request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
+    request.key = start_key;
+    request.value = end_key;
+    request.key_length = static_cast<uint32_t>(start_key.length());
+    request.value_length = static_cast<uint32_t>(end_key.length());
+    
+    Message response = send_request(request);
+    return response.type == MessageType::SUCCESS;
+}
+
 std::vector<std::pair<std::string, std::string>> DatabaseClient::scan(const std::string& start_key,
                                                                      const std::string& end_key,
                                                                      size_t limit) {
     Message request;
     request.type = MessageType::SCAN;
     request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
     request.key = start_key;
     request.value = end_key;
     request.key_length = static_cast<uint32_t>(start_key.length());
@@ -135,6 +156,105 @@ bool DatabaseClient::ping() {
     return response.type == MessageType::PONG;
 }
 
+bool DatabaseClient::drop_namespace(uint32_t namespace_id) {
+    Message request;
+    request.type = MessageType::DROP_NAMESPACE;
+    request.id = ++request_id_;
+    request.namespace_id = namespace_id;
+    
+    Message response = send_request(request);
+    return response.type == MessageType::SUCCESS;
+}
+
+bool DatabaseClient::truncate_namespace(uint32_t namespace_id) {
+    Message request;
+    request.type = MessageType::TRUNCATE_NAMESPACE;
+    request.id = ++request_id_;
+    request.namespace_id = namespace_id;
+    
+    Message response = send_request(request);
+    return response.type == MessageType::SUCCESS;
+}
+
+uint64_t DatabaseClient::bulk_load(const std::string& server_path) {
+    Message request;
+    request.type = MessageType::BULK_LOAD;
+    request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
+    request.key = server_path;
+    request.key_length = static_cast<uint32_t>(server_path.length());
+    
+    Message response = send_request(request);
+    if (response.type != MessageType::SUCCESS) {
+        throw std::runtime_error("BULK_LOAD failed: " + response.value);
+    }
+    return std::stoull(response.value);
+}
+
+uint64_t DatabaseClient::ingest(const std::vector<std::string>& server_paths) {
+    Message request;
+    request.type = MessageType::INGEST;
+    request.id = ++request_id_;
+    request.namespace_id = namespace_id_;
+    for (const auto& path : server_paths) {
+        request.key += (request.key.empty() ? "" : "\n") + path;
+    }
+    request.key_length = static_cast<uint32_t>(request.key.length());
+    
+    Message response = send_request(request);
+    if (response.type != MessageType::SUCCESS) {
+        throw std::runtime_error("INGEST failed: " + response.value);
+    }
+    return std::stoull(response.value);
+}
+
+uint64_t DatabaseClient::backup(const std::string& target_dir) {
+    Message request;
+    request.type = MessageType::BACKUP;
+    request.id = ++request_id_;
+    
+    Message response = send_request(request);
+    uint64_t total_bytes = 0;
+    std::vector<char> buffer(1024 * 1024);
+    
+    while (response.type == MessageType::BACKUP_FILE) {
+        // Names come from the server; refuse anything that escapes target_dir
+        std::filesystem::path name(response.key);
+        if (name.is_absolute() || name.lexically_normal().string().rfind("..", 0) == 0) {
+            throw std::runtime_error("BACKUP failed: bad file name " + response.key);
+        }
+        
+        std::filesystem::path target = std::filesystem::path(target_dir) / name;
+        std::filesystem::create_directories(target.parent_path());
+        std::ofstream out(target, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("BACKUP failed: cannot write " + target.string());
+        }
+        
+        uint64_t remaining = std::stoull(response.value);
+        while (remaining > 0) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            boost::asio::read(*socket_, boost::asio::buffer(buffer.data(), chunk));
+            out.write(buffer.data(), chunk);
+            remaining -= chunk;
+            total_bytes += chunk;
+        }
+        
+        out.close();
+        if (!out) {
+            throw std::runtime_error("BACKUP failed: cannot write " + target.string());
+        }
+        
+        response = receive_message();
+    }
+    
+    if (response.type != MessageType::SUCCESS) {
+        throw std::runtime_error("BACKUP failed: " + response.value);
+    }
+    
+    return total_bytes;
+}
+
 Message DatabaseClient::send_request(const Message& request) {
     if (!is_connected()) {
         throw std::runtime_error("Not connected to server");
@@ -9,7 +9,8 @@ std::vector<uint8_t> Message::serialize() const {
     data.reserve(size());
     
     // Write header
-    data.push_back(static_cast<uint8_t>(type));
+    uint8_t type_byte = static_cast<uint8_t>(type);
+    data.push_back(namespace_id != 0 ? type_byte | NAMESPACE_FLAG : type_byte);
     
     // Write ID
     uint8_t id_bytes[4];
@@ -26,12 +27,26 @@ std::vector<uint8_t> Message::serialize() const {
     std::memcpy(value_len_bytes, &value_length, sizeof(value_length));
     data.insert(data.end(), value_len_bytes, value_len_bytes + 4);
     
+    // Write namespace
+    if (namespace_id != 0) {
+        uint8_t namespace_bytes[4];
+        std::memcpy(namespace_bytes, &namespace_id, sizeof(namespace_id));
+        data.insert(data.end(), namespace_bytes, namespace_bytes + 4);
+    }
+    
     // Write key
     data.insert(data.end(), key.begin(), key.end());
     
     // Write value
     data.insert(data.end(), value.begin(), value.end());
     
+    // Write TTL
+    if (has_ttl()) {
+        uint8_t ttl_bytes[8];
+        std::memcpy(ttl_bytes, &ttl_ms, sizeof(ttl_ms));
+        data.insert(data.end(), ttl_bytes, ttl_bytes + 8);
+    }
+    
     return data;
 }
 
@@ -44,7 +59,8 @@ Message Message::deserialize(const std::vector<uint8_t>& data) {
     size_t offset = 0;
     
     // Read type
-    msg.type = static_cast<MessageType>(data[offset++]);
+    uint8_t type_byte = data[offset++];
+    msg.type = static_cast<MessageType>(type_byte & ~NAMESPACE_FLAG);
     
     // Read ID
     std::memcpy(&msg.id, &data[offset], sizeof(msg.id));
@@ -58,6 +74,15 @@ Message Message::deserialize(const std::vector<uint8_t>& data) {
     std::memcpy(&msg.value_length, &data[offset], sizeof(msg.value_length));
     offset += 4;
     
+    // Read namespace
+    if (type_byte & NAMESPACE_FLAG) {
+        if (data.size() < offset + sizeof(msg.namespace_id)) {
+            throw std::runtime_error("Invalid message: incomplete data");
+        }
+        std::memcpy(&msg.namespace_id, &data[offset], sizeof(msg.namespace_id));
+        offset += 4;
+    }
+    
     // Validate sizes
     if (msg.key_length > MAX_KEY_SIZE || msg.value_length > MAX_VALUE_SIZE) {
         throw std::runtime_error("Invalid message: key or value too large");
@@ -73,6 +98,12 @@ Message Message::deserialize(const std::vector<uint8_t>& data) {
     
     // Read value
     msg.value.assign(data.begin() + offset, data.begin() + offset + msg.value_length);
+    offset += msg.value_length;
+    
+    // Read TTL, if the sender gave one
+    if (msg.type == MessageType::PUT && data.size() >= offset + sizeof(msg.ttl_ms)) {
+        std::memcpy(&msg.ttl_ms, &data[offset], sizeof(msg.ttl_ms));
+    }
     
     return msg;
 }
@@ -1,17 +1,38 @@
 #include "network/server.h"
 #include "core/database.h"
+#include "core/import_paths.h"
 #include <iostream>
 #include <boost/asio/write.hpp>
 #include <boost/asio/read.hpp>
 #include <algorithm>
+#include <filesystem>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
 
 namespace distributeddb {
 
+namespace {
+
+std::vector<std::string> split_paths(const std::string& key) {
+    std::vector<std::string> paths;
+    for (size_t begin = 0; begin < key.size();) {
+        size_t end = std::min(key.find('\n', begin), key.size());
+        paths.push_back(key.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return paths;
+}
+
+} // namespace
+
 // ConnectionHandler implementation
 ConnectionHandler::ConnectionHandler(boost::asio::ip::tcp::socket socket,
                                      std::shared_ptr<Database> database,
+                                     std::string import_dir,
                                      std::function<void()> on_disconnect)
-    : socket_(std::move(socket)), database_(database), 
+    : socket_(std::move(socket)), database_(database), import_dir_(std::move(import_dir)),
       on_disconnect_(on_disconnect), active_(true) {
 }
 
@@ -90,6 +111,11 @@ void ConnectionHandler::handle_request(const Message& request) {
         return;
     }
     
+    if (request.type == MessageType::BACKUP) {
+        stream_backup(request);
+        return;
+    }
+    
     // Process request synchronously for now (can be optimized with thread pool)
     Message response = process_request_sync(request);
     write_response(response);
@@ -102,7 +128,7 @@ Message ConnectionHandler::process_request_sync(const Message& request) {
     try {
         switch (request.type) {
             case MessageType::GET: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
                     std::string value = txn->get(request.key);
                     if (!value.empty()) {
@@ -120,9 +146,9 @@ Message ConnectionHandler::process_request_sync(const Message& request) {
             }
             
             case MessageType::PUT: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
-                    auto result = txn->put(request.key, request.value);
+                    auto result = txn->put_with_ttl(request.key, request.value, request.ttl_ms);
                     if (result == OperationResult::SUCCESS) {
                         txn->commit();
                         response.type = MessageType::SUCCESS;
@@ -139,7 +165,7 @@ Message ConnectionHandler::process_request_sync(const Message& request) {
             }
             
             case MessageType::DELETE: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
                     auto result = txn->del(request.key);
                     if (result == OperationResult::SUCCESS) {
@@ -157,8 +183,26 @@ Message ConnectionHandler::process_request_sync(const Message& request) {
                 break;
             }
             
+            case MessageType::DELETE_RANGE: {
+                auto txn = database_->begin_transaction_in(request.namespace_id);
+                if (txn) {
+                    if (txn->del_range(request.key, request.value) == OperationResult::SUCCESS) {
+                        txn->commit();
+                        response.type = MessageType::SUCCESS;
+                        response.value = "OK";
+                    } else {
+                        response.type = MessageType::ERROR;
+                        response.value = "Failed to delete range";
+                    }
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = "Failed to begin transaction";
+                }
+                break;
+            }
+            
             case MessageType::SCAN: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
                     auto results = txn->scan(request.key, request.value, 1000);
                     response.type = MessageType::SUCCESS;
@@ -184,6 +228,56 @@ Message ConnectionHandler::process_request_sync(const Message& request) {
                 break;
             }
             
+            case MessageType::DROP_NAMESPACE:
+            case MessageType::TRUNCATE_NAMESPACE: {
+                bool drop = request.type == MessageType::DROP_NAMESPACE;
+                auto result = drop ? database_->drop_namespace(request.namespace_id)
+                                   : database_->truncate_namespace(request.namespace_id);
+                if (result == OperationResult::SUCCESS) {
+                    response.type = MessageType::SUCCESS;
+                    response.value = "OK";
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = result == OperationResult::KEY_NOT_FOUND ? "No such namespace"
+                                   : drop ? "Failed to drop namespace" : "Failed to truncate namespace";
+                }
+                break;
+            }
+            
+            case MessageType::BULK_LOAD: {
+                std::vector<std::string> paths{request.key};
+                std::string error = resolve_import_paths(import_dir_, paths);
+                uint64_t entries = 0;
+                if (!error.empty()) {
+                    response.type = MessageType::ERROR;
+                    response.value = error;
+                } else if (database_->bulk_load_in(request.namespace_id, paths[0], entries) == OperationResult::SUCCESS) {
+                    response.type = MessageType::SUCCESS;
+                    response.value = std::to_string(entries);
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = "Bulk load failed";
+                }
+                break;
+            }
+            
+            case MessageType::INGEST: {
+                std::vector<std::string> paths = split_paths(request.key);
+                std::string error = resolve_import_paths(import_dir_, paths);
+                uint64_t entries = 0;
+                if (!error.empty()) {
+                    response.type = MessageType::ERROR;
+                    response.value = error;
+                } else if (database_->ingest_files_in(request.namespace_id, paths, entries) == OperationResult::SUCCESS) {
+                    response.type = MessageType::SUCCESS;
+                    response.value = std::to_string(entries);
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = "Ingest failed";
+                }
+                break;
+            }
+            
             default: {
                 response.type = MessageType::ERROR;
                 response.value = "Unsupported operation";
@@ -228,6 +322,117 @@ void ConnectionHandler::write_response(const Message& response) {
         });
 }
 
+void ConnectionHandler::stream_backup(const Message& request) {
+    // A backup can take minutes; keep it off the io_context threads
+    auto self = shared_from_this();
+    uint32_t request_id = request.id;
+    std::thread([this, self, request_id]() {
+        Message done;
+        done.id = request_id;
+        
+        BackupFileSet file_set;
+        if (database_->freeze_backup_files(file_set) != OperationResult::SUCCESS) {
+            done.type = MessageType::ERROR;
+            done.value = "Backup not available";
+        } else {
+            uint64_t total_bytes = 0;
+            bool ok = true;
+            
+            for (const auto& file : file_set.files) {
+                std::error_code ec;
+                uint64_t size = std::filesystem::file_size(file.path, ec);
+                if (ec) {
+                    ok = false;
+                    break;
+                }
+                
+                Message header;
+                header.id = request_id;
+                header.type = MessageType::BACKUP_FILE;
+                header.key = file.name;
+                header.value = std::to_string(size);
+                header.key_length = static_cast<uint32_t>(header.key.length());
+                header.value_length = static_cast<uint32_t>(header.value.length());
+                
+                if (!write_message_sync(header) || !send_file(file.path, size)) {
+                    ok = false;
+                    break;
+                }
+                total_bytes += size;
+            }
+            
+            database_->release_backup_files(file_set);
+            
+            if (!ok) {
+                // The client is mid-file and cannot resync; drop the connection
+                std::cerr << "Backup stream aborted" << std::endl;
+                boost::asio::post(socket_.get_executor(), [this, self]() {
+                    stop();
+                    on_disconnect_();
+                });
+                return;
+            }
+            
+            done.type = MessageType::SUCCESS;
+            done.value = std::to_string(file_set.files.size()) + " files, " +
+                         std::to_string(total_bytes) + " bytes";
+        }
+        
+        done.key_length = 0;
+        done.value_length = static_cast<uint32_t>(done.value.length());
+        boost::asio::post(socket_.get_executor(), [this, self, done]() {
+            write_response(done);
+        });
+    }).detach();
+}
+
+bool ConnectionHandler::write_message_sync(const Message& message) {
+    std::vector<uint8_t> data = message.serialize();
+    uint32_t length = static_cast<uint32_t>(data.size());
+    
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(&length, sizeof(length)));
+    buffers.push_back(boost::asio::buffer(data));
+    
+    boost::system::error_code ec;
+    boost::asio::write(socket_, buffers, ec);
+    return !ec;
+}
+
+bool ConnectionHandler::send_file(const std::string& path, uint64_t size) {
+    int file_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file_fd < 0) {
+        return false;
+    }
+    
+    // Zero-copy: the kernel moves page-cache pages straight to the socket
+    int socket_fd = socket_.native_handle();
+    off_t offset = 0;
+    bool ok = true;
+    while (static_cast<uint64_t>(offset) < size) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(size - offset, 1 << 30));
+        ssize_t sent = ::sendfile(socket_fd, file_fd, &offset, chunk);
+        if (sent > 0) {
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Asio keeps the socket non-blocking; wait for buffer space
+            pollfd pfd{socket_fd, POLLOUT, 0};
+            if (::poll(&pfd, 1, 30000) > 0) {
+                continue;
+            }
+        }
+        ok = false;
+        break;
+    }
+    
+    ::close(file_fd);
+    return ok;
+}
+
 // DatabaseServer implementation
 DatabaseServer::DatabaseServer(boost::asio::io_context& io_context, uint16_t port)
     : acceptor_(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
@@ -253,6 +458,16 @@ void DatabaseServer::start() {
     std::cout << "Database server started with " << MAX_WORKER_THREADS << " worker threads" << std::endl;
 }
 
+bool DatabaseServer::set_import_dir(const std::string& dir) {
+    std::error_code ec;
+    auto resolved = std::filesystem::canonical(dir, ec);
+    if (ec || !std::filesystem::is_directory(resolved, ec)) {
+        return false;
+    }
+    import_dir_ = resolved.string();
+    return true;
+}
+
 void DatabaseServer::stop() {
     running_ = false;
     acceptor_.close();
@@ -291,6 +506,7 @@ void DatabaseServer::handle_accept(std::shared_ptr<boost::asio::ip::tcp::socket>
             auto handler = std::make_shared<ConnectionHandler>(
                 std::move(*socket),
                 database_,
+                import_dir_,
                 [this]() { on_client_disconnect(); }
             );
             handler->start();
@@ -353,7 +569,7 @@ Message DatabaseServer::process_request(const Message& request) {
     try {
         switch (request.type) {
             case MessageType::GET: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
                     std::string value = txn->get(request.key);
                     if (!value.empty()) {
@@ -371,9 +587,9 @@ Message DatabaseServer::process_request(const Message& request) {
             }
             
             case MessageType::PUT: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
-                    auto result = txn->put(request.key, request.value);
+                    auto result = txn->put_with_ttl(request.key, request.value, request.ttl_ms);
                     if (result == OperationResult::SUCCESS) {
                         txn->commit();
                         response.type = MessageType::SUCCESS;
@@ -390,7 +606,7 @@ Message DatabaseServer::process_request(const Message& request) {
             }
             
             case MessageType::DELETE: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
                     auto result = txn->del(request.key);
                     if (result == OperationResult::SUCCESS) {
@@ -408,8 +624,26 @@ Message DatabaseServer::process_request(const Message& request) {
                 break;
             }
             
+            case MessageType::DELETE_RANGE: {
+                auto txn = database_->begin_transaction_in(request.namespace_id);
+                if (txn) {
+                    if (txn->del_range(request.key, request.value) == OperationResult::SUCCESS) {
+                        txn->commit();
+                        response.type = MessageType::SUCCESS;
+                        response.value = "OK";
+                    } else {
+                        response.type = MessageType::ERROR;
+                        response.value = "Failed to delete range";
+                    }
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = "Failed to begin transaction";
+                }
+                break;
+            }
+            
             case MessageType::SCAN: {
-                auto txn = database_->begin_transaction();
+                auto txn = database_->begin_transaction_in(request.namespace_id);
                 if (txn) {
                     auto results = txn->scan(request.key, request.value, 1000);
                     response.type = MessageType::SUCCESS;
@@ -435,6 +669,56 @@ Message DatabaseServer::process_request(const Message& request) {
                 break;
             }
             
+            case MessageType::DROP_NAMESPACE:
+            case MessageType::TRUNCATE_NAMESPACE: {
+                bool drop = request.type == MessageType::DROP_NAMESPACE;
+                auto result = drop ? database_->drop_namespace(request.namespace_id)
+                                   : database_->truncate_namespace(request.namespace_id);
+                if (result == OperationResult::SUCCESS) {
+                    response.type = MessageType::SUCCESS;
+                    response.value = "OK";
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = result == OperationResult::KEY_NOT_FOUND ? "No such namespace"
+                                   : drop ? "Failed to drop namespace" : "Failed to truncate namespace";
+                }
+                break;
+            }
+            
+            case MessageType::BULK_LOAD: {
+                std::vector<std::string> paths{request.key};
+                std::string error = resolve_import_paths(import_dir_, paths);
+                uint64_t entries = 0;
+                if (!error.empty()) {
+                    response.type = MessageType::ERROR;
+                    response.value = error;
+                } else if (database_->bulk_load_in(request.namespace_id, paths[0], entries) == OperationResult::SUCCESS) {
+                    response.type = MessageType::SUCCESS;
+                    response.value = std::to_string(entries);
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = "Bulk load failed";
+                }
+                break;
+            }
+            
+            case MessageType::INGEST: {
+                std::vector<std::string> paths = split_paths(request.key);
+                std::string error = resolve_import_paths(import_dir_, paths);
+                uint64_t entries = 0;
+                if (!error.empty()) {
+                    response.type = MessageType::ERROR;
+                    response.value = error;
+                } else if (database_->ingest_files_in(request.namespace_id, paths, entries) == OperationResult::SUCCESS) {
+                    response.type = MessageType::SUCCESS;
+                    response.value = std::to_string(entries);
+                } else {
+                    response.type = MessageType::ERROR;
+                    response.value = "Ingest failed";
+                }
+                break;
+            }
+            
             default: {
                 response.type = MessageType::ERROR;
                 response.value = "Unsupported operation";
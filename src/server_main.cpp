@@ -1,11 +1,13 @@
 #include "network/server.h"
 #include "core/database.h"
+#include "core/engine_registry.h"
 #include <boost/asio.hpp>
 #include <iostream>
 #include <signal.h>
 #include <memory>
 #include <thread>
 #include <vector>
+#include <unordered_map>
 
 std::unique_ptr<distributeddb::DatabaseServer> server;
 std::unique_ptr<boost::asio::io_context> io_context;
@@ -24,16 +26,78 @@ void signal_handler(int signal) {
     }
 }
 
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [port] [options]" << std::endl;
+    std::cout << "  --engine NAME         Storage engine (default: "
+              << distributeddb::EngineRegistry::DEFAULT_ENGINE << ")" << std::endl;
+    std::cout << "  --option KEY=VALUE    Engine setting; may be repeated" << std::endl;
+    std::cout << "  --namespace-option ID:KEY=VALUE" << std::endl;
+    std::cout << "                        Engine setting for one namespace only" << std::endl;
+    std::cout << "  --data-dir DIR        Data directory (default: ./data)" << std::endl;
+    std::cout << "  --import-dir DIR      Directory bulk-load and ingest may read from" << std::endl;
+    std::cout << "                        (default: none, both are refused)" << std::endl;
+    std::cout << "  --list-engines        Show the available engines and exit" << std::endl;
+}
+
+void print_engines() {
+    const auto& registry = distributeddb::EngineRegistry::instance();
+    std::cout << "Available engines:" << std::endl;
+    for (const auto& name : registry.engine_names()) {
+        std::cout << "  " << name << " - " << registry.description(name) << std::endl;
+    }
+}
+
 int main(int argc, char* argv[]) {
     uint16_t port = 8080;
+    std::string engine = distributeddb::EngineRegistry::DEFAULT_ENGINE;
+    std::string data_dir = "./data";
+    std::string import_dir;
+    distributeddb::EngineOptions engine_options;
+    std::unordered_map<uint32_t, distributeddb::EngineOptions> namespace_options;
     
-    if (argc > 1) {
-        port = static_cast<uint16_t>(std::stoi(argv[1]));
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--engine" && has_value) {
+            engine = argv[++i];
+        } else if (arg == "--option" && has_value) {
+            if (!distributeddb::parse_engine_option(argv[++i], engine_options)) {
+                std::cerr << "Expected KEY=VALUE after --option, got " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--namespace-option" && has_value) {
+            std::string setting = argv[++i];
+            size_t colon = setting.find(':');
+            distributeddb::EngineOptions* target = nullptr;
+            if (colon > 0 && colon <= 9 && setting.find_first_not_of("0123456789") == colon) {
+                target = &namespace_options[static_cast<uint32_t>(std::stoul(setting.substr(0, colon)))];
+            }
+            if (!target || !distributeddb::parse_engine_option(setting.substr(colon + 1), *target)) {
+                std::cerr << "Expected ID:KEY=VALUE after --namespace-option, got " << setting << std::endl;
+                return 1;
+            }
+        } else if (arg == "--data-dir" && has_value) {
+            data_dir = argv[++i];
+        } else if (arg == "--import-dir" && has_value) {
+            import_dir = argv[++i];
+        } else if (arg == "--list-engines") {
+            print_engines();
+            return 0;
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] != '-') {
+            port = static_cast<uint16_t>(std::stoi(arg));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
     }
     
     std::cout << "🚀 DistributedDB Server - High-Performance Database System" << std::endl;
     std::cout << "=========================================================" << std::endl;
-    std::cout << "Starting server on port " << port << std::endl;
+    std::cout << "Starting server on port " << port << " with the " << engine << " engine" << std::endl;
     
     // Set up signal handling
     signal(SIGINT, signal_handler);
@@ -45,15 +109,17 @@ int main(int argc, char* argv[]) {
         work_guard = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(
             boost::asio::make_work_guard(*io_context));
         
-        // Create database
-        auto database = distributeddb::DatabaseFactory::create_database();
+        // Create database; every namespace is an instance of the engine
+        auto database = distributeddb::DatabaseFactory::create_namespaced_database(engine, engine_options,
+                                                                                   namespace_options);
         if (!database) {
             std::cerr << "Failed to create database" << std::endl;
+            print_engines();
             return 1;
         }
         
         // Initialize database
-        auto result = database->initialize("./data");
+        auto result = database->initialize(data_dir);
         if (result != distributeddb::OperationResult::SUCCESS) {
             std::cerr << "Failed to initialize database" << std::endl;
             return 1;
@@ -64,10 +130,17 @@ int main(int argc, char* argv[]) {
         // Create and start server
         server = std::make_unique<distributeddb::DatabaseServer>(*io_context, port);
         server->set_database(database);
+        if (!import_dir.empty() && !server->set_import_dir(import_dir)) {
+            std::cerr << "Import directory " << import_dir << " does not exist" << std::endl;
+            return 1;
+        }
         server->start();
         
         std::cout << "✅ Server started successfully" << std::endl;
         std::cout << "   Port: " << port << std::endl;
+        std::cout << "   Engine: " << engine << std::endl;
+        std::cout << "   Data directory: " << data_dir << std::endl;
+        std::cout << "   Import directory: " << (import_dir.empty() ? "none" : import_dir) << std::endl;
         std::cout << "   Max connections: 50,000" << std::endl;
         std::cout << "   Worker threads: 8" << std::endl;
         std::cout << "Press Ctrl+C to stop the server" << std::endl;
@@ -90,7 +163,7 @@ int main(int argc, char* argv[]) {
         for (auto& thread : io_threads) {
             thread.join();
         }
-        
+    
     } catch (const std::exception& e) {
         std::cerr << "Server error: " << e.what() << std::endl;
         return 1;
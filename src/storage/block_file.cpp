@@ -0,0 +1,571 @@
+#include "storage/block_file.h"
+#include "storage/checksum.h"
+#include <iostream>
+#include <filesystem>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace distributeddb {
+
+namespace {
+
+constexpr char BLOCK_FILE_MAGIC[8] = {'D', 'D', 'B', 'B', 'L', 'O', 'C', 'K'};
+constexpr uint32_t BLOCK_FILE_VERSION = 2;
+constexpr uint32_t BLOCK_FILE_VERSION_NO_RANGES = 1;
+constexpr size_t BLOCK_HEADER_SIZE = 13;
+constexpr size_t FOOTER_SIZE = 8 + 8 + 4 + 4 + sizeof(BLOCK_FILE_MAGIC);
+
+template<typename T>
+void put_pod(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_pod(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+// Bounds-checked cursor over a decoded buffer
+class Decoder {
+public:
+    Decoder(const char* data, size_t size) : data_(data), size_(size), offset_(0) {}
+    
+    template<typename T>
+    bool get_pod(T& value) {
+        if (size_ - offset_ < sizeof(T)) return false;
+        std::memcpy(&value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+    
+    bool get_bytes(std::string& value, size_t length) {
+        if (size_ - offset_ < length) return false;
+        value.assign(data_ + offset_, length);
+        offset_ += length;
+        return true;
+    }
+    
+    bool get_string(std::string& value) {
+        uint32_t length;
+        return get_pod(length) && get_bytes(value, length);
+    }
+    
+    bool done() const { return offset_ == size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_;
+};
+
+bool compress_block(BlockCompression compression, const std::string& raw, std::string& out) {
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+    if (compression == BlockCompression::ZLIB) {
+        uLongf length = compressBound(static_cast<uLong>(raw.size()));
+        out.resize(length);
+        if (compress2(reinterpret_cast<Bytef*>(out.data()), &length,
+                      reinterpret_cast<const Bytef*>(raw.data()),
+                      static_cast<uLong>(raw.size()), Z_BEST_SPEED) != Z_OK) {
+            return false;
+        }
+        out.resize(length);
+        return true;
+    }
+#else
+    (void)raw;
+    (void)out;
+#endif
+    return compression == BlockCompression::NONE;
+}
+
+bool decompress_block(BlockCompression compression, const char* data, size_t size,
+                      size_t raw_size, std::string& out) {
+    if (compression == BlockCompression::NONE) {
+        out.assign(data, size);
+        return size == raw_size;
+    }
+    
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+    if (compression == BlockCompression::ZLIB) {
+        out.resize(raw_size);
+        uLongf length = static_cast<uLongf>(raw_size);
+        return uncompress(reinterpret_cast<Bytef*>(out.data()), &length,
+                          reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size)) == Z_OK &&
+               length == raw_size;
+    }
+#else
+    (void)data;
+    (void)raw_size;
+#endif
+    return false;
+}
+
+} // namespace
+
+bool block_compression_supported(BlockCompression compression) {
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+    return compression == BlockCompression::NONE || compression == BlockCompression::ZLIB;
+#else
+    return compression == BlockCompression::NONE;
+#endif
+}
+
+bool sync_path(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << path << " for fsync" << std::endl;
+        return false;
+    }
+    
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    
+    if (!ok) {
+        std::cerr << "fsync failed for " << path << std::endl;
+    }
+    return ok;
+}
+
+// BlockFileWriter implementation
+BlockFileWriter::BlockFileWriter(const std::string& path, const BlockFileOptions& options)
+    : path_(path), tmp_path_(path + ".tmp"), options_(options), offset_(0),
+      entry_count_(0), sorted_(true), block_entries_(0) {
+    if (!block_compression_supported(options_.compression)) {
+        std::cerr << "Block compression not available in this build, writing uncompressed" << std::endl;
+        options_.compression = BlockCompression::NONE;
+    }
+}
+
+BlockFileWriter::~BlockFileWriter() {
+    if (file_.is_open()) {
+        abort();
+    }
+}
+
+bool BlockFileWriter::open() {
+    file_.open(tmp_path_, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+        std::cerr << "Failed to open block file: " << tmp_path_ << std::endl;
+        return false;
+    }
+    
+    offset_ = 0;
+    entry_count_ = 0;
+    sorted_ = true;
+    last_key_.clear();
+    index_.clear();
+    block_.clear();
+    block_entries_ = 0;
+    return true;
+}
+
+bool BlockFileWriter::add(BlockEntryType type, const std::string& key, const std::string& value) {
+    if (entry_count_ > 0 && key <= last_key_) {
+        sorted_ = false;
+    }
+    last_key_ = key;
+    
+    if (block_entries_ == 0 || key < block_min_) block_min_ = key;
+    if (block_entries_ == 0 || key > block_max_) block_max_ = key;
+    
+    put_pod(block_, static_cast<uint8_t>(type));
+    put_pod(block_, static_cast<uint32_t>(key.size()));
+    put_pod(block_, static_cast<uint32_t>(value.size()));
+    block_.append(key);
+    block_.append(value);
+    block_entries_++;
+    entry_count_++;
+    
+    if (block_.size() >= options_.block_size) {
+        return flush_block();
+    }
+    return true;
+}
+
+bool BlockFileWriter::flush_block() {
+    if (block_entries_ == 0) {
+        return true;
+    }
+    
+    std::string compressed;
+    const std::string* payload = &block_;
+    BlockCompression compression = BlockCompression::NONE;
+    
+    // Keep the block raw unless compression saves at least 1/8
+    if (options_.compression != BlockCompression::NONE &&
+        compress_block(options_.compression, block_, compressed) &&
+        compressed.size() < block_.size() - block_.size() / 8) {
+        payload = &compressed;
+        compression = options_.compression;
+    }
+    
+    std::string header;
+    put_pod(header, static_cast<uint32_t>(block_.size()));
+    put_pod(header, static_cast<uint32_t>(payload->size()));
+    put_pod(header, crc32c(payload->data(), payload->size()));
+    put_pod(header, static_cast<uint8_t>(compression));
+    
+    file_.write(header.data(), header.size());
+    file_.write(payload->data(), payload->size());
+    
+    BlockHandle handle;
+    handle.offset = offset_;
+    handle.size = static_cast<uint32_t>(header.size() + payload->size());
+    handle.entry_count = block_entries_;
+    handle.min_key = std::move(block_min_);
+    handle.max_key = std::move(block_max_);
+    index_.push_back(std::move(handle));
+    
+    offset_ += header.size() + payload->size();
+    block_.clear();
+    block_entries_ = 0;
+    block_min_.clear();
+    block_max_.clear();
+    
+    return file_.good();
+}
+
+bool BlockFileWriter::finish(BlockFileProperties properties) {
+    if (!flush_block()) {
+        abort();
+        return false;
+    }
+    
+    properties.entry_count = entry_count_;
+    properties.sorted = sorted_;
+    
+    std::string index;
+    put_pod(index, properties.wal_segment);
+    put_pod(index, properties.start_lsn);
+    put_pod(index, properties.base_lsn);
+    put_pod(index, properties.entry_count);
+    put_pod(index, static_cast<uint8_t>(properties.sorted ? 1 : 0));
+    put_pod(index, static_cast<uint64_t>(index_.size()));
+    for (const auto& handle : index_) {
+        put_pod(index, handle.offset);
+        put_pod(index, handle.size);
+        put_pod(index, handle.entry_count);
+        put_string(index, handle.min_key);
+        put_string(index, handle.max_key);
+    }
+    uint32_t version = BLOCK_FILE_VERSION_NO_RANGES;
+    if (!properties.range_tombstones.empty()) {
+        version = BLOCK_FILE_VERSION;
+        put_string(index, properties.filter);
+        put_pod(index, static_cast<uint64_t>(properties.range_tombstones.size()));
+        for (const auto& [start, end] : properties.range_tombstones) {
+            put_string(index, start);
+            put_string(index, end);
+        }
+    } else if (!properties.filter.empty()) {
+        put_string(index, properties.filter);
+    }
+    
+    std::string footer;
+    put_pod(footer, offset_);
+    put_pod(footer, static_cast<uint64_t>(index.size()));
+    put_pod(footer, crc32c(index.data(), index.size()));
+    put_pod(footer, version);
+    footer.append(BLOCK_FILE_MAGIC, sizeof(BLOCK_FILE_MAGIC));
+    
+    file_.write(index.data(), index.size());
+    file_.write(footer.data(), footer.size());
+    offset_ += index.size() + footer.size();
+    file_.flush();
+    
+    bool ok = file_.good();
+    file_.close();
+    
+    if (!ok || !sync_path(tmp_path_)) {
+        std::filesystem::remove(tmp_path_);
+        return false;
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(tmp_path_, path_, ec);
+    if (ec) {
+        std::cerr << "Failed to publish " << path_ << ": " << ec.message() << std::endl;
+        std::filesystem::remove(tmp_path_);
+        return false;
+    }
+    
+    // Make the rename itself durable
+    std::string dir = std::filesystem::path(path_).parent_path().string();
+    return sync_path(dir.empty() ? "." : dir);
+}
+
+void BlockFileWriter::abort() {
+    file_.close();
+    std::error_code ec;
+    std::filesystem::remove(tmp_path_, ec);
+}
+
+// BlockFileReader implementation
+BlockFileReader::BlockFileReader() : fd_(-1), file_size_(0) {
+}
+
+BlockFileReader::~BlockFileReader() {
+    close();
+}
+
+bool BlockFileReader::open(const std::string& path) {
+    close();
+    path_ = path;
+    
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+    
+    off_t end = ::lseek(fd_, 0, SEEK_END);
+    if (end < static_cast<off_t>(FOOTER_SIZE)) {
+        std::cerr << "Block file too small: " << path << std::endl;
+        close();
+        return false;
+    }
+    file_size_ = static_cast<uint64_t>(end);
+    
+    char footer[FOOTER_SIZE];
+    if (!pread_exact(file_size_ - FOOTER_SIZE, footer, sizeof(footer))) {
+        close();
+        return false;
+    }
+    
+    uint64_t index_offset, index_size;
+    uint32_t index_crc, version;
+    Decoder footer_decoder(footer, sizeof(footer));
+    footer_decoder.get_pod(index_offset);
+    footer_decoder.get_pod(index_size);
+    footer_decoder.get_pod(index_crc);
+    footer_decoder.get_pod(version);
+    
+    if (std::memcmp(footer + FOOTER_SIZE - sizeof(BLOCK_FILE_MAGIC), BLOCK_FILE_MAGIC,
+                    sizeof(BLOCK_FILE_MAGIC)) != 0 || (version != BLOCK_FILE_VERSION && version != BLOCK_FILE_VERSION_NO_RANGES) ||
+        index_offset + index_size + FOOTER_SIZE != file_size_) {
+        std::cerr << "Invalid block file footer: " << path << std::endl;
+        close();
+        return false;
+    }
+    
+    std::string index(index_size, '\0');
+    if (!pread_exact(index_offset, index.data(), index.size()) ||
+        crc32c(index.data(), index.size()) != index_crc) {
+        std::cerr << "Block file index checksum mismatch: " << path << std::endl;
+        close();
+        return false;
+    }
+    
+    Decoder decoder(index.data(), index.size());
+    uint8_t sorted = 0;
+    uint64_t block_count = 0;
+    bool ok = decoder.get_pod(properties_.wal_segment) && decoder.get_pod(properties_.start_lsn) &&
+              decoder.get_pod(properties_.base_lsn) && decoder.get_pod(properties_.entry_count) &&
+              decoder.get_pod(sorted) && decoder.get_pod(block_count);
+    properties_.sorted = sorted != 0;
+    
+    for (uint64_t i = 0; ok && i < block_count; ++i) {
+        BlockHandle handle;
+        ok = decoder.get_pod(handle.offset) && decoder.get_pod(handle.size) &&
+             decoder.get_pod(handle.entry_count) && decoder.get_string(handle.min_key) &&
+             decoder.get_string(handle.max_key) &&
+             handle.offset + handle.size <= index_offset;
+        index_.push_back(std::move(handle));
+    }
+    
+    if (ok && !decoder.done()) {
+        ok = decoder.get_string(properties_.filter);
+    }
+    
+    uint64_t range_count = 0;
+    if (ok && version == BLOCK_FILE_VERSION) {
+        ok = decoder.get_pod(range_count);
+    }
+    for (uint64_t i = 0; ok && i < range_count; ++i) {
+        std::pair<std::string, std::string> range;
+        ok = decoder.get_string(range.first) && decoder.get_string(range.second);
+        properties_.range_tombstones.push_back(std::move(range));
+    }
+    
+    if (!ok || !decoder.done()) {
+        std::cerr << "Corrupt block file index: " << path << std::endl;
+        close();
+        return false;
+    }
+    
+    return true;
+}
+
+void BlockFileReader::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    file_size_ = 0;
+    properties_ = BlockFileProperties();
+    index_.clear();
+}
+
+bool BlockFileReader::read_raw_block(size_t index, std::string& data) const {
+    if (index >= index_.size()) {
+        return false;
+    }
+    
+    const auto& handle = index_[index];
+    data.resize(handle.size);
+    return pread_exact(handle.offset, data.data(), data.size());
+}
+
+bool BlockFileReader::read_block(size_t index, std::vector<BlockEntry>& entries) const {
+    std::string stored;
+    if (!read_raw_block(index, stored) || stored.size() < BLOCK_HEADER_SIZE) {
+        return false;
+    }
+    
+    uint32_t raw_size, stored_size, crc;
+    uint8_t compression;
+    Decoder header(stored.data(), BLOCK_HEADER_SIZE);
+    header.get_pod(raw_size);
+    header.get_pod(stored_size);
+    header.get_pod(crc);
+    header.get_pod(compression);
+    
+    const char* payload = stored.data() + BLOCK_HEADER_SIZE;
+    if (stored_size != stored.size() - BLOCK_HEADER_SIZE || crc32c(payload, stored_size) != crc) {
+        std::cerr << "Block " << index << " checksum mismatch in " << path_ << std::endl;
+        return false;
+    }
+    
+    std::string raw;
+    if (!decompress_block(static_cast<BlockCompression>(compression), payload, stored_size,
+                          raw_size, raw)) {
+        std::cerr << "Block " << index << " failed to decompress in " << path_ << std::endl;
+        return false;
+    }
+    
+    Decoder decoder(raw.data(), raw.size());
+    entries.clear();
+    entries.reserve(index_[index].entry_count);
+    
+    while (!decoder.done()) {
+        BlockEntry entry;
+        uint8_t type;
+        uint32_t key_length, value_length;
+        if (!decoder.get_pod(type) || !decoder.get_pod(key_length) || !decoder.get_pod(value_length) ||
+            !decoder.get_bytes(entry.key, key_length) || !decoder.get_bytes(entry.value, value_length) ||
+            type < static_cast<uint8_t>(BlockEntryType::PUT) ||
+            type > static_cast<uint8_t>(BlockEntryType::PUT_TTL)) {
+            std::cerr << "Block " << index << " is malformed in " << path_ << std::endl;
+            return false;
+        }
+        entry.type = static_cast<BlockEntryType>(type);
+        entries.push_back(std::move(entry));
+    }
+    
+    return entries.size() == index_[index].entry_count;
+}
+
+bool BlockFileReader::for_each(const EntryCallback& on_entry, size_t threads) const {
+    std::atomic<size_t> next_block(0);
+    std::atomic<bool> ok(true);
+    
+    auto worker = [&]() {
+        std::vector<BlockEntry> entries;
+        size_t index;
+        while (ok && (index = next_block++) < index_.size()) {
+            if (!read_block(index, entries)) {
+                ok = false;
+                return;
+            }
+            for (auto& entry : entries) {
+                on_entry(std::move(entry));
+            }
+        }
+    };
+    
+    threads = std::max<size_t>(1, std::min(threads, index_.size()));
+    if (threads == 1) {
+        worker();
+        return ok;
+    }
+    
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    
+    return ok;
+}
+
+bool BlockFileReader::pread_exact(uint64_t offset, void* buffer, size_t length) const {
+    char* out = static_cast<char*>(buffer);
+    while (length > 0) {
+        ssize_t n = ::pread(fd_, out, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return false;
+        }
+        out += n;
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool verify_sorted_file(const std::string& path, BlockFileSummary& summary,
+                        const BlockFileReader::EntryCallback& on_entry) {
+    BlockFileReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Cannot open block file " << path << std::endl;
+        return false;
+    }
+    
+    summary = BlockFileSummary();
+    std::vector<BlockEntry> entries;
+    for (size_t i = 0; i < reader.blocks().size(); ++i) {
+        if (!reader.read_block(i, entries)) {
+            std::cerr << "Block " << i << " of " << path << " is corrupt" << std::endl;
+            return false;
+        }
+        
+        for (auto& entry : entries) {
+            if (entry.type != BlockEntryType::PUT) {
+                std::cerr << "Entry " << summary.entry_count << " of " << path << " is not a PUT" << std::endl;
+                return false;
+            }
+            if (summary.entry_count > 0 && !(summary.largest < entry.key)) {
+                std::cerr << "Keys of " << path << " are not strictly increasing at entry "
+                          << summary.entry_count << std::endl;
+                return false;
+            }
+            if (summary.entry_count == 0) {
+                summary.smallest = entry.key;
+            }
+            summary.largest = entry.key;
+            summary.entry_count++;
+            if (on_entry) {
+                on_entry(std::move(entry));
+            }
+        }
+    }
+    
+    if (summary.entry_count != reader.properties().entry_count) {
+        std::cerr << path << " holds " << summary.entry_count << " entries, its index says "
+                  << reader.properties().entry_count << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace distributeddb
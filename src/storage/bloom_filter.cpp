@@ -0,0 +1,95 @@
+#include "storage/bloom_filter.h"
+#include <algorithm>
+#include <cstring>
+
+namespace distributeddb {
+
+uint64_t hash_key(const std::string& key) {
+    // MurmurHash64A
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const size_t length = key.size();
+    const char* data = key.data();
+    uint64_t h = 0x8445d61a4e774912ULL ^ (length * m);
+    
+    size_t blocks = length / 8;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k;
+        std::memcpy(&k, data + i * 8, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    
+    const unsigned char* tail = reinterpret_cast<const unsigned char*>(data + blocks * 8);
+    switch (length & 7) {
+        case 7: h ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+        case 6: h ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+        case 5: h ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+        case 4: h ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+        case 3: h ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+        case 2: h ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+        case 1: h ^= uint64_t(tail[0]);
+                h *= m;
+    }
+    
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+BloomFilterBuilder::BloomFilterBuilder(size_t bits_per_key)
+    : bits_per_key_(std::max<size_t>(1, bits_per_key)) {
+}
+
+void BloomFilterBuilder::add(const std::string& key) {
+    hashes_.push_back(hash_key(key));
+}
+
+std::string BloomFilterBuilder::finish() {
+    // k = bits_per_key * ln(2) minimizes the false positive rate
+    size_t probes = std::clamp<size_t>(static_cast<size_t>(bits_per_key_ * 0.69), 1, 30);
+    size_t bits = std::max<size_t>(64, hashes_.size() * bits_per_key_);
+    size_t bytes = (bits + 7) / 8;
+    bits = bytes * 8;
+    
+    std::string filter(bytes, '\0');
+    for (uint64_t hash : hashes_) {
+        // Double hashing: probe i is h1 + i * h2
+        uint64_t delta = (hash >> 33) | (hash << 31);
+        for (size_t i = 0; i < probes; ++i) {
+            uint64_t bit = hash % bits;
+            filter[bit / 8] |= static_cast<char>(1 << (bit % 8));
+            hash += delta;
+        }
+    }
+    
+    filter.push_back(static_cast<char>(probes));
+    hashes_.clear();
+    return filter;
+}
+
+bool BloomFilter::may_contain(const std::string& filter, const std::string& key) {
+    if (filter.size() < 2) {
+        return true;
+    }
+    
+    size_t probes = static_cast<unsigned char>(filter.back());
+    uint64_t bits = (filter.size() - 1) * 8;
+    uint64_t hash = hash_key(key);
+    uint64_t delta = (hash >> 33) | (hash << 31);
+    
+    for (size_t i = 0; i < probes; ++i) {
+        uint64_t bit = hash % bits;
+        if ((filter[bit / 8] & (1 << (bit % 8))) == 0) {
+            return false;
+        }
+        hash += delta;
+    }
+    return true;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,74 @@
+#include "storage/checksum.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace distributeddb {
+
+namespace {
+
+constexpr uint32_t CRC32C_POLY = 0x82F63B78;
+
+std::array<uint32_t, 256> make_crc_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t crc32c_software(const uint8_t* data, size_t length, uint32_t crc) {
+    static const std::array<uint32_t, 256> table = make_crc_table();
+    
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hardware(const uint8_t* data, size_t length, uint32_t crc) {
+    uint64_t crc64 = crc;
+    
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    
+    uint32_t crc32 = static_cast<uint32_t>(crc64);
+    while (length > 0) {
+        crc32 = _mm_crc32_u8(crc32, *data++);
+        length--;
+    }
+    return crc32;
+}
+#endif
+
+} // namespace
+
+uint32_t crc32c(const void* data, size_t length, uint32_t crc) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    
+#if defined(__x86_64__)
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    if (has_sse42) {
+        return ~crc32c_hardware(bytes, length, crc);
+    }
+#endif
+    
+    return ~crc32c_software(bytes, length, crc);
+}
+
+} // namespace distributeddb
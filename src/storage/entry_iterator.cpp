@@ -0,0 +1,57 @@
+#include "storage/entry_iterator.h"
+
+namespace distributeddb {
+
+MergingIterator::MergingIterator(std::vector<std::unique_ptr<EntryIterator>> children)
+    : children_(std::move(children)), current_(nullptr) {
+}
+
+void MergingIterator::seek(const std::string& target) {
+    for (auto& child : children_) {
+        child->seek(target);
+    }
+    find_smallest();
+}
+
+void MergingIterator::seek_to_first() {
+    for (auto& child : children_) {
+        child->seek_to_first();
+    }
+    find_smallest();
+}
+
+void MergingIterator::next() {
+    if (!current_) {
+        return;
+    }
+    
+    // Step past this key in every child, dropping the shadowed older versions
+    std::string key = current_->key();
+    for (auto& child : children_) {
+        if (child->valid() && child->key() == key) {
+            child->next();
+        }
+    }
+    find_smallest();
+}
+
+bool MergingIterator::ok() const {
+    for (const auto& child : children_) {
+        if (!child->ok()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MergingIterator::find_smallest() {
+    current_ = nullptr;
+    for (auto& child : children_) {
+        // Strictly smaller only, so the newest child keeps ties
+        if (child->valid() && (!current_ || child->key() < current_->key())) {
+            current_ = child.get();
+        }
+    }
+}
+
+} // namespace distributeddb
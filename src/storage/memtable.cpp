@@ -0,0 +1,161 @@
+#include "storage/memtable.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace distributeddb {
+
+namespace {
+
+// Packed entry: u32 key_len | key | u64 lsn | u8 type | u32 value_len | value
+constexpr size_t ENTRY_FIXED_SIZE = 4 + 8 + 1 + 4;
+
+// Skiplist node overhead beyond the packed entry, on average
+constexpr size_t NODE_OVERHEAD = 32;
+
+struct EntryView {
+    const char* key;
+    uint32_t key_length;
+    uint64_t lsn;
+    BlockEntryType type;
+    const char* value;
+    uint32_t value_length;
+};
+
+EntryView decode_entry(const char* entry) {
+    EntryView view;
+    std::memcpy(&view.key_length, entry, 4);
+    view.key = entry + 4;
+    const char* p = view.key + view.key_length;
+    std::memcpy(&view.lsn, p, 8);
+    view.type = static_cast<BlockEntryType>(static_cast<uint8_t>(p[8]));
+    std::memcpy(&view.value_length, p + 9, 4);
+    view.value = p + 13;
+    return view;
+}
+
+void encode_entry(char* out, BlockEntryType type, const std::string& key, const std::string& value,
+                  uint64_t lsn) {
+    uint32_t key_length = static_cast<uint32_t>(key.size());
+    uint32_t value_length = static_cast<uint32_t>(value.size());
+    std::memcpy(out, &key_length, 4);
+    std::memcpy(out + 4, key.data(), key.size());
+    char* p = out + 4 + key.size();
+    std::memcpy(p, &lsn, 8);
+    p[8] = static_cast<char>(type);
+    std::memcpy(p + 9, &value_length, 4);
+    std::memcpy(p + 13, value.data(), value.size());
+}
+
+// Search key that sorts before every version of key
+std::string lookup_entry(const std::string& key) {
+    std::string entry(ENTRY_FIXED_SIZE + key.size(), '\0');
+    encode_entry(entry.data(), BlockEntryType::PUT, key, std::string(),
+                 std::numeric_limits<uint64_t>::max());
+    return entry;
+}
+
+bool same_key(const EntryView& entry, const std::string& key) {
+    return entry.key_length == key.size() && std::memcmp(entry.key, key.data(), key.size()) == 0;
+}
+
+} // namespace
+
+int MemTable::EntryComparator::operator()(const char* a, const char* b) const {
+    // The skiplist head holds a null key and is never compared
+    EntryView left = decode_entry(a);
+    EntryView right = decode_entry(b);
+    
+    int cmp = std::memcmp(left.key, right.key, std::min(left.key_length, right.key_length));
+    if (cmp != 0) return cmp;
+    if (left.key_length != right.key_length) return left.key_length < right.key_length ? -1 : 1;
+    
+    // Newer versions first
+    if (left.lsn != right.lsn) return left.lsn > right.lsn ? -1 : 1;
+    return 0;
+}
+
+class MemTable::Iterator : public EntryIterator {
+public:
+    explicit Iterator(const MemTable& table) : it_(&table.table_) {}
+    
+    void seek(const std::string& target) override {
+        std::string lookup = lookup_entry(target);
+        it_.seek(lookup.data());
+        load();
+    }
+    
+    void seek_to_first() override {
+        it_.seek_to_first();
+        load();
+    }
+    
+    bool valid() const override { return it_.valid(); }
+    
+    void next() override {
+        // Skip the older versions of the current key
+        do {
+            it_.next();
+        } while (it_.valid() && same_key(decode_entry(it_.key()), key_));
+        load();
+    }
+    
+    const std::string& key() const override { return key_; }
+    const std::string& value() const override { return value_; }
+    BlockEntryType type() const override { return type_; }
+
+private:
+    void load() {
+        if (it_.valid()) {
+            EntryView entry = decode_entry(it_.key());
+            key_.assign(entry.key, entry.key_length);
+            value_.assign(entry.value, entry.value_length);
+            type_ = entry.type;
+        }
+    }
+    
+    Table::Iterator it_;
+    std::string key_;
+    std::string value_;
+    BlockEntryType type_ = BlockEntryType::PUT;
+};
+
+MemTable::MemTable(uint64_t log_segment)
+    : table_(EntryComparator(), &arena_), memory_(0), entries_(0), log_segment_(log_segment) {
+}
+
+void MemTable::add(BlockEntryType type, const std::string& key, const std::string& value, uint64_t lsn) {
+    size_t size = ENTRY_FIXED_SIZE + key.size() + value.size();
+    char* entry = arena_.allocate(size);
+    encode_entry(entry, type, key, value, lsn);
+    
+    // A duplicate (key, LSN) only comes from replaying a record twice
+    if (table_.insert(entry)) {
+        memory_.fetch_add(size + NODE_OVERHEAD, std::memory_order_relaxed);
+        entries_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool MemTable::get(const std::string& key, std::string& value, BlockEntryType& type) const {
+    std::string lookup = lookup_entry(key);
+    Table::Iterator it(&table_);
+    it.seek(lookup.data());
+    if (!it.valid()) {
+        return false;
+    }
+    
+    EntryView entry = decode_entry(it.key());
+    if (!same_key(entry, key)) {
+        return false;
+    }
+    
+    type = entry.type;
+    value.assign(entry.value, entry.value_length);
+    return true;
+}
+
+std::unique_ptr<EntryIterator> MemTable::new_iterator() const {
+    return std::make_unique<Iterator>(*this);
+}
+
+} // namespace distributeddb
@@ -0,0 +1,1167 @@
+#include "storage/mmap_btree.h"
+#include "storage/checksum.h"
+#include "storage/block_file.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace distributeddb {
+
+namespace {
+
+const char META_MAGIC[8] = {'D', 'D', 'B', 'B', 'T', 'R', 'E', 'E'};
+const uint32_t META_VERSION = 1;
+
+// magic | u32 version | u32 page_size | six u64 fields, then the u32 CRC
+constexpr size_t META_SIZE = 8 + 4 + 4 + 6 * 8;
+
+constexpr size_t PAGE_HEADER_SIZE = 16;
+constexpr size_t SLOT_SIZE = 2;
+constexpr size_t LEAF_CELL_FIXED = 2 + 1 + 4;
+constexpr size_t BRANCH_CELL_FIXED = 2 + 8;
+
+const uint16_t PAGE_LEAF = 1;
+const uint16_t PAGE_BRANCH = 2;
+const uint16_t PAGE_OVERFLOW = 4;
+const uint16_t PAGE_FREELIST = 8;
+
+const uint8_t CELL_OVERFLOW = 1;
+
+template<typename T>
+T load(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+template<typename T>
+void store(char* p, T value) {
+    std::memcpy(p, &value, sizeof(T));
+}
+
+bool pwrite_all(int fd, const char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+bool pread_all(int fd, char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t got = ::pread(fd, data, length, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        length -= static_cast<size_t>(got);
+        offset += static_cast<uint64_t>(got);
+    }
+    return true;
+}
+
+// Key of slot i on a leaf or branch page
+struct CellKey {
+    const char* data;
+    uint16_t length;
+};
+
+const char* cell_at(const char* page, size_t index) {
+    return page + load<uint16_t>(page + PAGE_HEADER_SIZE + index * SLOT_SIZE);
+}
+
+CellKey cell_key(const char* page, bool leaf, size_t index) {
+    const char* cell = cell_at(page, index);
+    CellKey key;
+    key.length = load<uint16_t>(cell);
+    key.data = cell + (leaf ? LEAF_CELL_FIXED : BRANCH_CELL_FIXED);
+    return key;
+}
+
+int compare_key(const CellKey& a, const std::string& b) {
+    int cmp = std::memcmp(a.data, b.data(), std::min<size_t>(a.length, b.size()));
+    if (cmp != 0) return cmp;
+    if (a.length == b.size()) return 0;
+    return a.length < b.size() ? -1 : 1;
+}
+
+// First slot whose key is >= key (or > key when upper)
+size_t search_page(const char* page, bool leaf, const std::string& key, bool upper) {
+    size_t lo = 0;
+    size_t hi = load<uint16_t>(page + 2);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = compare_key(cell_key(page, leaf, mid), key);
+        if (cmp < 0 || (upper && cmp == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+uint64_t branch_child(const char* page, size_t index) {
+    if (index == 0) {
+        return load<uint64_t>(page + 8);
+    }
+    return load<uint64_t>(cell_at(page, index - 1) + 2);
+}
+
+} // namespace
+
+struct MmapBTree::Mapping {
+    char* base = nullptr;
+    size_t size = 0;
+    
+    ~Mapping() {
+        if (base != nullptr) {
+            ::munmap(base, size);
+        }
+    }
+};
+
+struct MmapBTree::ReaderTable {
+    std::mutex mutex;
+    std::multiset<uint64_t> txns;   // Snapshot txn ids still open
+};
+
+MmapBTree::Snapshot::~Snapshot() {
+    if (readers_) {
+        std::lock_guard<std::mutex> lock(readers_->mutex);
+        auto it = readers_->txns.find(txn_id_);
+        if (it != readers_->txns.end()) {
+            readers_->txns.erase(it);
+        }
+    }
+}
+
+MmapBTree::MmapBTree(const MmapBTreeOptions& options)
+    : options_(options), fd_(-1), readers_(std::make_shared<ReaderTable>()),
+      freelist_loaded_(false), commit_count_(0), pages_written_(0) {
+    // Slot offsets are 16-bit and a page must hold the meta block
+    options_.page_size = std::clamp<uint32_t>(options_.page_size, 512, 32768);
+}
+
+MmapBTree::~MmapBTree() {
+    close();
+}
+
+bool MmapBTree::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    path_ = path;
+    return reopen_locked();
+}
+
+void MmapBTree::close() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    std::lock_guard<std::mutex> state(state_mutex_);
+    mapping_.reset();
+}
+
+bool MmapBTree::reopen_locked() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open B+tree file " << path_ << std::endl;
+        return false;
+    }
+    
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        return false;
+    }
+    
+    if (st.st_size == 0) {
+        // New file: both meta slots describe the empty tree
+        Meta empty;
+        Meta second = empty;
+        second.txn_id = 1;
+        if (!write_meta(fd_, empty) || !write_meta(fd_, second) || ::fdatasync(fd_) != 0) {
+            std::cerr << "Failed to initialize B+tree file " << path_ << std::endl;
+            return false;
+        }
+    }
+    
+    Meta meta;
+    if (!read_meta(fd_, meta)) {
+        std::cerr << "No valid meta page in " << path_ << std::endl;
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> state(state_mutex_);
+        mapping_.reset();
+        meta_ = meta;
+    }
+    if (!ensure_mapping(meta.page_count)) {
+        return false;
+    }
+    
+    // The freelist is read by the first write transaction, keeping open O(1)
+    freelist_loaded_ = false;
+    free_pages_.clear();
+    pending_.clear();
+    freelist_pages_.clear();
+    return true;
+}
+
+bool MmapBTree::read_meta(int fd, Meta& meta) const {
+    bool found = false;
+    for (uint64_t slot = 0; slot < 2; ++slot) {
+        char buffer[META_SIZE + 4];
+        if (!pread_all(fd, buffer, sizeof(buffer), slot * options_.page_size)) {
+            continue;
+        }
+        if (std::memcmp(buffer, META_MAGIC, sizeof(META_MAGIC)) != 0 ||
+            load<uint32_t>(buffer + 8) != META_VERSION ||
+            crc32c(buffer, META_SIZE) != load<uint32_t>(buffer + META_SIZE)) {
+            continue;
+        }
+        if (load<uint32_t>(buffer + 12) != options_.page_size) {
+            std::cerr << "B+tree page size " << load<uint32_t>(buffer + 12) << " does not match "
+                      << options_.page_size << std::endl;
+            return false;
+        }
+        
+        Meta candidate;
+        candidate.txn_id = load<uint64_t>(buffer + 16);
+        candidate.root = load<uint64_t>(buffer + 24);
+        candidate.page_count = load<uint64_t>(buffer + 32);
+        candidate.freelist_head = load<uint64_t>(buffer + 40);
+        candidate.freelist_count = load<uint64_t>(buffer + 48);
+        candidate.entry_count = load<uint64_t>(buffer + 56);
+        if (!found || candidate.txn_id > meta.txn_id) {
+            meta = candidate;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool MmapBTree::write_meta(int fd, const Meta& meta) const {
+    std::vector<char> buffer(options_.page_size, 0);
+    char* p = buffer.data();
+    std::memcpy(p, META_MAGIC, sizeof(META_MAGIC));
+    store<uint32_t>(p + 8, META_VERSION);
+    store<uint32_t>(p + 12, options_.page_size);
+    store<uint64_t>(p + 16, meta.txn_id);
+    store<uint64_t>(p + 24, meta.root);
+    store<uint64_t>(p + 32, meta.page_count);
+    store<uint64_t>(p + 40, meta.freelist_head);
+    store<uint64_t>(p + 48, meta.freelist_count);
+    store<uint64_t>(p + 56, meta.entry_count);
+    store<uint32_t>(p + META_SIZE, crc32c(p, META_SIZE));
+    
+    // Even and odd commits alternate slots, so a torn write leaves the other intact
+    return pwrite_all(fd, p, buffer.size(), (meta.txn_id % 2) * options_.page_size);
+}
+
+bool MmapBTree::ensure_mapping(uint64_t page_count) {
+    uint64_t needed = page_count * options_.page_size;
+    if (mapping_ && mapping_->size >= needed) {
+        return true;
+    }
+    
+    uint64_t size = std::max<uint64_t>(options_.initial_map_size, mapping_ ? mapping_->size : 0);
+    size = std::max<uint64_t>(size, options_.page_size);
+    while (size < needed) {
+        size *= 2;
+    }
+    
+    void* base = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "Failed to map " << size << " bytes of " << path_ << std::endl;
+        return false;
+    }
+    
+    // Snapshots keep the old mapping alive until they are released
+    auto mapping = std::make_shared<Mapping>();
+    mapping->base = static_cast<char*>(base);
+    mapping->size = size;
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    mapping_ = mapping;
+    return true;
+}
+
+const char* MmapBTree::page(const Mapping& mapping, uint64_t pgno) const {
+    return mapping.base + pgno * options_.page_size;
+}
+
+size_t MmapBTree::usable_size() const {
+    return options_.page_size - PAGE_HEADER_SIZE;
+}
+
+size_t MmapBTree::max_cell_size() const {
+    // At least four cells per page, so a split always leaves two valid halves
+    return usable_size() / 4;
+}
+
+size_t MmapBTree::max_key_size() const {
+    return max_cell_size() - SLOT_SIZE - LEAF_CELL_FIXED - 8;
+}
+
+std::shared_ptr<const MmapBTree::Snapshot> MmapBTree::snapshot() const {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    if (!mapping_) {
+        return nullptr;
+    }
+    
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->mapping_ = mapping_;
+    snapshot->root_ = meta_.root;
+    snapshot->txn_id_ = meta_.txn_id;
+    snapshot->entry_count_ = meta_.entry_count;
+    
+    // Registered before the lock is released, so no commit can free its pages first
+    std::lock_guard<std::mutex> readers(readers_->mutex);
+    readers_->txns.insert(meta_.txn_id);
+    snapshot->readers_ = readers_;
+    return snapshot;
+}
+
+bool MmapBTree::get(const Snapshot& snapshot, const std::string& key, std::string& value) const {
+    const Mapping& mapping = *snapshot.mapping_;
+    uint64_t pgno = snapshot.root_;
+    while (pgno != 0) {
+        const char* p = page(mapping, pgno);
+        uint16_t flags = load<uint16_t>(p);
+        if (flags == PAGE_BRANCH) {
+            pgno = branch_child(p, search_page(p, false, key, true));
+            continue;
+        }
+        
+        size_t index = search_page(p, true, key, false);
+        if (index >= load<uint16_t>(p + 2) || compare_key(cell_key(p, true, index), key) != 0) {
+            return false;
+        }
+        return read_value(mapping, cell_at(p, index), value);
+    }
+    return false;
+}
+
+bool MmapBTree::read_value(const Mapping& mapping, const char* cell, std::string& value) const {
+    uint16_t key_length = load<uint16_t>(cell);
+    uint8_t flags = static_cast<uint8_t>(cell[2]);
+    uint32_t value_length = load<uint32_t>(cell + 3);
+    const char* data = cell + LEAF_CELL_FIXED + key_length;
+    if (flags & CELL_OVERFLOW) {
+        data = page(mapping, load<uint64_t>(data)) + PAGE_HEADER_SIZE;
+    }
+    value.assign(data, value_length);
+    return true;
+}
+
+void MmapBTree::scan(const Snapshot& snapshot, const std::string& start_key, const std::string& end_key,
+                     size_t limit, std::vector<std::pair<std::string, std::string>>& out) const {
+    if (snapshot.root_ != 0 && out.size() < limit) {
+        scan_page(*snapshot.mapping_, snapshot.root_, start_key, end_key, limit, out);
+    }
+}
+
+void MmapBTree::scan_page(const Mapping& mapping, uint64_t pgno, const std::string& start_key,
+                          const std::string& end_key, size_t limit,
+                          std::vector<std::pair<std::string, std::string>>& out) const {
+    const char* p = page(mapping, pgno);
+    uint16_t count = load<uint16_t>(p + 2);
+    
+    if (load<uint16_t>(p) == PAGE_LEAF) {
+        for (size_t i = search_page(p, true, start_key, false); i < count && out.size() < limit; ++i) {
+            CellKey key = cell_key(p, true, i);
+            if (compare_key(key, end_key) >= 0) {
+                return;
+            }
+            std::string value;
+            read_value(mapping, cell_at(p, i), value);
+            out.emplace_back(std::string(key.data, key.length), std::move(value));
+        }
+        return;
+    }
+    
+    // Children past a separator >= end_key hold nothing in range
+    for (size_t i = search_page(p, false, start_key, true); i <= count && out.size() < limit; ++i) {
+        if (i > 0 && compare_key(cell_key(p, false, i - 1), end_key) >= 0) {
+            return;
+        }
+        scan_page(mapping, branch_child(p, i), start_key, end_key, limit, out);
+    }
+}
+
+MmapBTree::PageNode MmapBTree::decode_node(const char* data) const {
+    PageNode node;
+    uint16_t flags = load<uint16_t>(data);
+    uint16_t count = load<uint16_t>(data + 2);
+    node.is_leaf = flags == PAGE_LEAF;
+    node.keys.reserve(count);
+    
+    if (node.is_leaf) {
+        node.values.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const char* cell = cell_at(data, i);
+            uint16_t key_length = load<uint16_t>(cell);
+            NodeValue value;
+            value.size = load<uint32_t>(cell + 3);
+            const char* payload = cell + LEAF_CELL_FIXED + key_length;
+            if (static_cast<uint8_t>(cell[2]) & CELL_OVERFLOW) {
+                value.overflow_page = load<uint64_t>(payload);
+            } else {
+                value.data.assign(payload, value.size);
+            }
+            node.keys.emplace_back(cell + LEAF_CELL_FIXED, key_length);
+            node.values.push_back(std::move(value));
+        }
+    } else {
+        node.children.reserve(count + 1);
+        node.children.push_back(load<uint64_t>(data + 8));
+        for (size_t i = 0; i < count; ++i) {
+            const char* cell = cell_at(data, i);
+            node.keys.emplace_back(cell + BRANCH_CELL_FIXED, load<uint16_t>(cell));
+            node.children.push_back(load<uint64_t>(cell + 2));
+        }
+    }
+    return node;
+}
+
+void MmapBTree::encode_node(const PageNode& node, char* data) const {
+    std::memset(data, 0, options_.page_size);
+    store<uint16_t>(data, node.is_leaf ? PAGE_LEAF : PAGE_BRANCH);
+    store<uint16_t>(data + 2, static_cast<uint16_t>(node.keys.size()));
+    if (!node.is_leaf) {
+        store<uint64_t>(data + 8, node.children[0]);
+    }
+    
+    // Slots grow from the header, cells from the end of the page
+    size_t end = options_.page_size;
+    for (size_t i = 0; i < node.keys.size(); ++i) {
+        const std::string& key = node.keys[i];
+        size_t size = (node.is_leaf ? leaf_cell_size(key, node.values[i]) : branch_cell_size(key)) - SLOT_SIZE;
+        end -= size;
+        char* cell = data + end;
+        store<uint16_t>(cell, static_cast<uint16_t>(key.size()));
+        
+        if (node.is_leaf) {
+            const NodeValue& value = node.values[i];
+            cell[2] = static_cast<char>(value.overflow_page != 0 ? CELL_OVERFLOW : 0);
+            store<uint32_t>(cell + 3, value.size);
+            std::memcpy(cell + LEAF_CELL_FIXED, key.data(), key.size());
+            if (value.overflow_page != 0) {
+                store<uint64_t>(cell + LEAF_CELL_FIXED + key.size(), value.overflow_page);
+            } else {
+                std::memcpy(cell + LEAF_CELL_FIXED + key.size(), value.data.data(), value.data.size());
+            }
+        } else {
+            store<uint64_t>(cell + 2, node.children[i + 1]);
+            std::memcpy(cell + BRANCH_CELL_FIXED, key.data(), key.size());
+        }
+        store<uint16_t>(data + PAGE_HEADER_SIZE + i * SLOT_SIZE, static_cast<uint16_t>(end));
+    }
+}
+
+size_t MmapBTree::leaf_cell_size(const std::string& key, const NodeValue& value) const {
+    return SLOT_SIZE + LEAF_CELL_FIXED + key.size() + (value.overflow_page != 0 ? 8 : value.data.size());
+}
+
+size_t MmapBTree::branch_cell_size(const std::string& key) const {
+    return SLOT_SIZE + BRANCH_CELL_FIXED + key.size();
+}
+
+size_t MmapBTree::encoded_size(const PageNode& node) const {
+    size_t size = PAGE_HEADER_SIZE;
+    for (size_t i = 0; i < node.keys.size(); ++i) {
+        size += node.is_leaf ? leaf_cell_size(node.keys[i], node.values[i]) : branch_cell_size(node.keys[i]);
+    }
+    return size;
+}
+
+bool MmapBTree::apply(const WriteBatch& batch) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (fd_ < 0) {
+        return false;
+    }
+    
+    for (const auto& [key, op] : batch) {
+        if (key.size() > max_key_size()) {
+            std::cerr << "B+tree key of " << key.size() << " bytes exceeds the limit of "
+                      << max_key_size() << std::endl;
+            return false;
+        }
+    }
+    
+    if (!freelist_loaded_ && !load_freelist()) {
+        return false;
+    }
+    release_pending();
+    
+    begin_write();
+    std::set<uint64_t> saved_free = free_pages_;
+    for (const auto& [key, op] : batch) {
+        bool ok = op.is_delete ? erase(key) : insert(key, op.value);
+        if (!ok) {
+            abort_write(saved_free);
+            return false;
+        }
+    }
+    
+    if (!commit_write()) {
+        abort_write(saved_free);
+        return false;
+    }
+    return true;
+}
+
+void MmapBTree::begin_write() {
+    txn_meta_ = meta_;
+    dirty_.clear();
+    txn_allocated_.clear();
+    txn_freed_.clear();
+}
+
+void MmapBTree::abort_write(const std::set<uint64_t>& saved_free) {
+    // Nothing the transaction wrote is reachable from a committed meta page
+    free_pages_ = saved_free;
+    dirty_.clear();
+    txn_allocated_.clear();
+    txn_freed_.clear();
+}
+
+uint64_t MmapBTree::allocate(uint64_t count) {
+    uint64_t pgno = 0;
+    if (count == 1 && !free_pages_.empty()) {
+        pgno = *free_pages_.begin();
+        free_pages_.erase(free_pages_.begin());
+    } else if (count > 1) {
+        // Overflow runs need consecutive pages
+        uint64_t run_start = 0;
+        uint64_t run_length = 0;
+        for (uint64_t free : free_pages_) {
+            if (run_length > 0 && free == run_start + run_length) {
+                run_length++;
+            } else {
+                run_start = free;
+                run_length = 1;
+            }
+            if (run_length == count) {
+                pgno = run_start;
+                break;
+            }
+        }
+        if (pgno != 0) {
+            free_pages_.erase(free_pages_.find(pgno), free_pages_.find(pgno + count - 1));
+            free_pages_.erase(pgno + count - 1);
+        }
+    }
+    
+    if (pgno == 0) {
+        pgno = txn_meta_.page_count;
+        txn_meta_.page_count += count;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        txn_allocated_.insert(pgno + i);
+    }
+    return pgno;
+}
+
+void MmapBTree::free_page(uint64_t pgno) {
+    // A page born in this transaction is invisible to everyone else
+    if (txn_allocated_.erase(pgno) > 0) {
+        dirty_.erase(pgno);
+        free_pages_.insert(pgno);
+    } else {
+        txn_freed_.push_back(pgno);
+    }
+}
+
+void MmapBTree::free_value(const NodeValue& value) {
+    if (value.overflow_page == 0) {
+        return;
+    }
+    uint64_t pages = (PAGE_HEADER_SIZE + value.size + options_.page_size - 1) / options_.page_size;
+    for (uint64_t i = 0; i < pages; ++i) {
+        free_page(value.overflow_page + i);
+    }
+}
+
+uint64_t MmapBTree::touch(uint64_t pgno) {
+    if (dirty_.count(pgno) > 0) {
+        return pgno;
+    }
+    
+    auto node = std::make_unique<PageNode>(decode_node(page(*mapping_, pgno)));
+    uint64_t copy = allocate(1);
+    dirty_[copy] = std::move(node);
+    free_page(pgno);
+    return copy;
+}
+
+bool MmapBTree::insert(const std::string& key, const std::string& data) {
+    NodeValue value;
+    value.data = data;
+    value.size = static_cast<uint32_t>(data.size());
+    
+    // Values that would crowd the leaf go to their own run of pages, written now;
+    // the pages are unreachable until commit
+    if (leaf_cell_size(key, value) > max_cell_size()) {
+        uint64_t pages = (PAGE_HEADER_SIZE + data.size() + options_.page_size - 1) / options_.page_size;
+        uint64_t first = allocate(pages);
+        std::vector<char> buffer(pages * options_.page_size, 0);
+        store<uint16_t>(buffer.data(), PAGE_OVERFLOW);
+        store<uint32_t>(buffer.data() + 4, static_cast<uint32_t>(pages));
+        store<uint64_t>(buffer.data() + 8, data.size());
+        std::memcpy(buffer.data() + PAGE_HEADER_SIZE, data.data(), data.size());
+        if (!pwrite_all(fd_, buffer.data(), buffer.size(), first * options_.page_size)) {
+            std::cerr << "Failed to write overflow pages to " << path_ << std::endl;
+            return false;
+        }
+        pages_written_ += pages;
+        value.data.clear();
+        value.overflow_page = first;
+    }
+    
+    if (txn_meta_.root == 0) {
+        txn_meta_.root = allocate(1);
+        dirty_[txn_meta_.root] = std::make_unique<PageNode>();
+    }
+    
+    // Copy the root-to-leaf path; every node on it becomes dirty
+    uint64_t pgno = touch(txn_meta_.root);
+    txn_meta_.root = pgno;
+    std::vector<std::pair<uint64_t, size_t>> path;
+    while (!node(pgno).is_leaf) {
+        PageNode& branch = node(pgno);
+        size_t index = std::upper_bound(branch.keys.begin(), branch.keys.end(), key) - branch.keys.begin();
+        uint64_t child = touch(branch.children[index]);
+        branch.children[index] = child;
+        path.emplace_back(pgno, index);
+        pgno = child;
+    }
+    
+    PageNode& leaf = node(pgno);
+    auto it = std::lower_bound(leaf.keys.begin(), leaf.keys.end(), key);
+    size_t index = it - leaf.keys.begin();
+    if (it != leaf.keys.end() && *it == key) {
+        free_value(leaf.values[index]);
+        leaf.values[index] = std::move(value);
+    } else {
+        leaf.keys.insert(it, key);
+        leaf.values.insert(leaf.values.begin() + index, std::move(value));
+        txn_meta_.entry_count++;
+    }
+    
+    split_overflowing(path, pgno);
+    return true;
+}
+
+bool MmapBTree::erase(const std::string& key) {
+    if (txn_meta_.root == 0) {
+        return true;
+    }
+    
+    uint64_t pgno = touch(txn_meta_.root);
+    txn_meta_.root = pgno;
+    std::vector<std::pair<uint64_t, size_t>> path;
+    while (!node(pgno).is_leaf) {
+        PageNode& branch = node(pgno);
+        size_t index = std::upper_bound(branch.keys.begin(), branch.keys.end(), key) - branch.keys.begin();
+        uint64_t child = touch(branch.children[index]);
+        branch.children[index] = child;
+        path.emplace_back(pgno, index);
+        pgno = child;
+    }
+    
+    PageNode& leaf = node(pgno);
+    auto it = std::lower_bound(leaf.keys.begin(), leaf.keys.end(), key);
+    if (it == leaf.keys.end() || *it != key) {
+        return true;
+    }
+    
+    size_t index = it - leaf.keys.begin();
+    free_value(leaf.values[index]);
+    leaf.keys.erase(it);
+    leaf.values.erase(leaf.values.begin() + index);
+    txn_meta_.entry_count--;
+    
+    merge_underflowing(path, pgno);
+    return true;
+}
+
+void MmapBTree::split_overflowing(std::vector<std::pair<uint64_t, size_t>>& path, uint64_t pgno) {
+    while (encoded_size(node(pgno)) > options_.page_size) {
+        PageNode& left = node(pgno);
+        auto right = std::make_unique<PageNode>();
+        right->is_leaf = left.is_leaf;
+        
+        // Split by bytes, not count, so both halves fit whatever the cell sizes
+        size_t total = encoded_size(left) - PAGE_HEADER_SIZE;
+        size_t accumulated = 0;
+        size_t split = 1;
+        for (size_t i = 0; i < left.keys.size(); ++i) {
+            accumulated += left.is_leaf ? leaf_cell_size(left.keys[i], left.values[i])
+                                        : branch_cell_size(left.keys[i]);
+            if (accumulated >= total / 2) {
+                split = i + 1;
+                break;
+            }
+        }
+        split = std::clamp<size_t>(split, 1, left.keys.size() - 1);
+        
+        std::string separator;
+        if (left.is_leaf) {
+            separator = left.keys[split];
+            right->keys.assign(left.keys.begin() + split, left.keys.end());
+            right->values.assign(std::make_move_iterator(left.values.begin() + split),
+                                 std::make_move_iterator(left.values.end()));
+            left.keys.resize(split);
+            left.values.resize(split);
+        } else {
+            // keys[split - 1] moves up; its right-hand children go with the new node
+            separator = left.keys[split - 1];
+            right->keys.assign(left.keys.begin() + split, left.keys.end());
+            right->children.assign(left.children.begin() + split, left.children.end());
+            left.keys.resize(split - 1);
+            left.children.resize(split);
+        }
+        
+        uint64_t right_pgno = allocate(1);
+        dirty_[right_pgno] = std::move(right);
+        
+        if (path.empty()) {
+            auto root = std::make_unique<PageNode>();
+            root->is_leaf = false;
+            root->keys.push_back(separator);
+            root->children = {pgno, right_pgno};
+            txn_meta_.root = allocate(1);
+            dirty_[txn_meta_.root] = std::move(root);
+            return;
+        }
+        
+        auto [parent_pgno, index] = path.back();
+        path.pop_back();
+        PageNode& parent = node(parent_pgno);
+        parent.keys.insert(parent.keys.begin() + index, separator);
+        parent.children.insert(parent.children.begin() + index + 1, right_pgno);
+        pgno = parent_pgno;
+    }
+}
+
+void MmapBTree::merge_underflowing(std::vector<std::pair<uint64_t, size_t>>& path, uint64_t pgno) {
+    while (true) {
+        PageNode& current = node(pgno);
+        if (path.empty()) {
+            // Shrink the tree from the top
+            if (!current.is_leaf && current.keys.empty()) {
+                txn_meta_.root = current.children[0];
+                free_page(pgno);
+            } else if (current.is_leaf && current.keys.empty()) {
+                free_page(pgno);
+                txn_meta_.root = 0;
+            }
+            return;
+        }
+        
+        if (!current.keys.empty() && encoded_size(current) >= options_.page_size / 4) {
+            return;
+        }
+        
+        auto [parent_pgno, index] = path.back();
+        path.pop_back();
+        PageNode& parent = node(parent_pgno);
+        
+        if (current.is_leaf && current.keys.empty()) {
+            free_page(pgno);
+            parent.children.erase(parent.children.begin() + index);
+            parent.keys.erase(parent.keys.begin() + (index > 0 ? index - 1 : 0));
+            pgno = parent_pgno;
+            continue;
+        }
+        if (parent.children.size() < 2) {
+            pgno = parent_pgno;
+            continue;
+        }
+        
+        // Merge with a neighbour if the two fit in one page; look before copying it
+        size_t left_index = index > 0 ? index - 1 : index;
+        size_t right_index = left_index + 1;
+        uint64_t sibling = parent.children[index > 0 ? left_index : right_index];
+        PageNode peeked;
+        const PageNode* sibling_node = dirty_.count(sibling) > 0 ? dirty_.at(sibling).get() : nullptr;
+        if (sibling_node == nullptr) {
+            peeked = decode_node(page(*mapping_, sibling));
+            sibling_node = &peeked;
+        }
+        size_t combined = encoded_size(current) + encoded_size(*sibling_node) - PAGE_HEADER_SIZE;
+        if (!current.is_leaf) {
+            combined += branch_cell_size(parent.keys[left_index]);
+        }
+        if (combined > options_.page_size) {
+            return;
+        }
+        
+        uint64_t left_pgno = touch(parent.children[left_index]);
+        parent.children[left_index] = left_pgno;
+        uint64_t right_pgno = touch(parent.children[right_index]);
+        parent.children[right_index] = right_pgno;
+        PageNode& left = node(left_pgno);
+        PageNode& right = node(right_pgno);
+        
+        if (left.is_leaf) {
+            left.keys.insert(left.keys.end(), right.keys.begin(), right.keys.end());
+            left.values.insert(left.values.end(), std::make_move_iterator(right.values.begin()),
+                               std::make_move_iterator(right.values.end()));
+        } else {
+            left.keys.push_back(parent.keys[left_index]);
+            left.keys.insert(left.keys.end(), right.keys.begin(), right.keys.end());
+            left.children.insert(left.children.end(), right.children.begin(), right.children.end());
+        }
+        free_page(right_pgno);
+        parent.keys.erase(parent.keys.begin() + left_index);
+        parent.children.erase(parent.children.begin() + right_index);
+        pgno = parent_pgno;
+    }
+}
+
+bool MmapBTree::commit_write() {
+    const size_t page_size = options_.page_size;
+    
+    // The old freelist pages are garbage once this commit lands
+    txn_freed_.insert(txn_freed_.end(), freelist_pages_.begin(), freelist_pages_.end());
+    
+    // Persist every page that will be free after a restart. The pages holding
+    // the list come out of the free set first, which only shortens it.
+    size_t listed = free_pages_.size() + txn_freed_.size();
+    for (const auto& [txn, pages] : pending_) {
+        listed += pages.size();
+    }
+    const size_t per_page = (page_size - PAGE_HEADER_SIZE) / 8;
+    std::vector<uint64_t> chain((listed + per_page - 1) / per_page);
+    for (auto& pgno : chain) {
+        pgno = allocate(1);
+    }
+    
+    std::vector<uint64_t> list(free_pages_.begin(), free_pages_.end());
+    for (const auto& [txn, pages] : pending_) {
+        list.insert(list.end(), pages.begin(), pages.end());
+    }
+    list.insert(list.end(), txn_freed_.begin(), txn_freed_.end());
+    txn_meta_.freelist_head = chain.empty() ? 0 : chain[0];
+    txn_meta_.freelist_count = list.size();
+    
+    std::vector<char> buffer(page_size);
+    for (size_t i = 0; i < chain.size(); ++i) {
+        std::memset(buffer.data(), 0, page_size);
+        size_t begin = i * per_page;
+        size_t count = std::min(per_page, list.size() - std::min(list.size(), begin));
+        store<uint16_t>(buffer.data(), PAGE_FREELIST);
+        store<uint16_t>(buffer.data() + 2, static_cast<uint16_t>(count));
+        store<uint64_t>(buffer.data() + 8, i + 1 < chain.size() ? chain[i + 1] : 0);
+        if (count > 0) {
+            std::memcpy(buffer.data() + PAGE_HEADER_SIZE, list.data() + begin, count * 8);
+        }
+        if (!pwrite_all(fd_, buffer.data(), page_size, chain[i] * page_size)) {
+            return false;
+        }
+    }
+    
+    for (const auto& [pgno, dirty] : dirty_) {
+        encode_node(*dirty, buffer.data());
+        if (!pwrite_all(fd_, buffer.data(), page_size, pgno * page_size)) {
+            std::cerr << "Failed to write page " << pgno << " of " << path_ << std::endl;
+            return false;
+        }
+    }
+    pages_written_ += dirty_.size() + chain.size();
+    
+    // Pages allocated and freed again may leave the end unwritten
+    struct stat st;
+    uint64_t file_size = txn_meta_.page_count * page_size;
+    if (::fstat(fd_, &st) != 0 ||
+        (static_cast<uint64_t>(st.st_size) < file_size && ::ftruncate(fd_, static_cast<off_t>(file_size)) != 0)) {
+        return false;
+    }
+    
+    // Data before meta: the new root must be durable before anything points at it
+    if (options_.sync_on_commit && ::fdatasync(fd_) != 0) {
+        std::cerr << "fdatasync failed for " << path_ << std::endl;
+        return false;
+    }
+    txn_meta_.txn_id++;
+    if (!write_meta(fd_, txn_meta_) || (options_.sync_on_commit && ::fdatasync(fd_) != 0)) {
+        std::cerr << "Failed to write meta page of " << path_ << std::endl;
+        return false;
+    }
+    if (!ensure_mapping(txn_meta_.page_count)) {
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        meta_ = txn_meta_;
+    }
+    if (!txn_freed_.empty()) {
+        pending_[txn_meta_.txn_id] = std::move(txn_freed_);
+    }
+    freelist_pages_ = std::move(chain);
+    dirty_.clear();
+    txn_allocated_.clear();
+    txn_freed_.clear();
+    commit_count_++;
+    return true;
+}
+
+bool MmapBTree::load_freelist() {
+    uint64_t pgno = meta_.freelist_head;
+    while (pgno != 0) {
+        if (pgno >= meta_.page_count) {
+            std::cerr << "Corrupt freelist in " << path_ << std::endl;
+            return false;
+        }
+        const char* p = page(*mapping_, pgno);
+        if (load<uint16_t>(p) != PAGE_FREELIST) {
+            std::cerr << "Corrupt freelist page " << pgno << " in " << path_ << std::endl;
+            return false;
+        }
+        uint16_t count = load<uint16_t>(p + 2);
+        for (size_t i = 0; i < count; ++i) {
+            free_pages_.insert(load<uint64_t>(p + PAGE_HEADER_SIZE + i * 8));
+        }
+        freelist_pages_.push_back(pgno);
+        pgno = load<uint64_t>(p + 8);
+    }
+    freelist_loaded_ = true;
+    return true;
+}
+
+void MmapBTree::release_pending() {
+    // Pages freed by commit T are still visible to snapshots older than T
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    {
+        std::lock_guard<std::mutex> lock(readers_->mutex);
+        if (!readers_->txns.empty()) {
+            oldest = *readers_->txns.begin();
+        }
+    }
+    
+    for (auto it = pending_.begin(); it != pending_.end() && it->first <= oldest;) {
+        free_pages_.insert(it->second.begin(), it->second.end());
+        it = pending_.erase(it);
+    }
+}
+
+bool MmapBTree::copy_to(const std::string& path) const {
+    auto snap = snapshot();
+    if (!snap) {
+        return false;
+    }
+    const Mapping& mapping = *snap->mapping_;
+    const size_t page_size = options_.page_size;
+    
+    std::string tmp_path = path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create " << tmp_path << std::endl;
+        return false;
+    }
+    
+    // Pages are appended in key order: each leaf after its overflow runs,
+    // then each branch level bottom-up
+    bool ok = true;
+    uint64_t next_pgno = 2;
+    std::vector<char> buffer(page_size);
+    std::vector<std::pair<std::string, uint64_t>> level;
+    PageNode leaf;
+    
+    auto write_node = [&](const PageNode& node) {
+        encode_node(node, buffer.data());
+        uint64_t pgno = next_pgno++;
+        ok = ok && pwrite_all(fd, buffer.data(), page_size, pgno * page_size);
+        return pgno;
+    };
+    
+    std::vector<uint64_t> stack;
+    if (snap->root_ != 0) {
+        stack.push_back(snap->root_);
+    }
+    while (!stack.empty() && ok) {
+        uint64_t pgno = stack.back();
+        stack.pop_back();
+        PageNode source = decode_node(page(mapping, pgno));
+        if (!source.is_leaf) {
+            stack.insert(stack.end(), source.children.rbegin(), source.children.rend());
+            continue;
+        }
+        
+        for (size_t i = 0; i < source.keys.size() && ok; ++i) {
+            NodeValue value = std::move(source.values[i]);
+            if (value.overflow_page != 0) {
+                uint64_t pages = (PAGE_HEADER_SIZE + value.size + page_size - 1) / page_size;
+                ok = pwrite_all(fd, page(mapping, value.overflow_page), pages * page_size, next_pgno * page_size);
+                value.overflow_page = next_pgno;
+                next_pgno += pages;
+            }
+            
+            if (!leaf.keys.empty() &&
+                encoded_size(leaf) + leaf_cell_size(source.keys[i], value) > page_size) {
+                level.emplace_back(leaf.keys[0], write_node(leaf));
+                leaf = PageNode();
+            }
+            leaf.keys.push_back(std::move(source.keys[i]));
+            leaf.values.push_back(std::move(value));
+        }
+    }
+    if (!leaf.keys.empty()) {
+        level.emplace_back(leaf.keys[0], write_node(leaf));
+    }
+    
+    while (level.size() > 1 && ok) {
+        std::vector<std::pair<std::string, uint64_t>> parents;
+        PageNode branch;
+        branch.is_leaf = false;
+        std::string first_key;
+        for (auto& [key, pgno] : level) {
+            if (!branch.children.empty() && encoded_size(branch) + branch_cell_size(key) > page_size) {
+                parents.emplace_back(first_key, write_node(branch));
+                branch.keys.clear();
+                branch.children.clear();
+            }
+            if (branch.children.empty()) {
+                first_key = key;
+            } else {
+                branch.keys.push_back(key);
+            }
+            branch.children.push_back(pgno);
+        }
+        parents.emplace_back(first_key, write_node(branch));
+        level = std::move(parents);
+    }
+    
+    Meta meta;
+    meta.txn_id = snap->txn_id_;
+    meta.root = level.empty() ? 0 : level[0].second;
+    meta.page_count = next_pgno;
+    meta.entry_count = snap->entry_count_;
+    Meta next = meta;
+    next.txn_id++;
+    ok = ok && write_meta(fd, meta) && write_meta(fd, next) && ::fdatasync(fd) == 0;
+    ::close(fd);
+    
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tmp_path, path, ec);
+    }
+    if (!ok || ec) {
+        std::cerr << "Failed to copy B+tree to " << path << std::endl;
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    return sync_path(dir.empty() ? "." : dir);
+}
+
+bool MmapBTree::compact() {
+    // Holding the writer lock means the copy is the latest commit when it replaces the file
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (fd_ < 0) {
+        return false;
+    }
+    
+    std::string compact_path = path_ + ".compact";
+    if (!copy_to(compact_path)) {
+        return false;
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(compact_path, path_, ec);
+    std::string dir = std::filesystem::path(path_).parent_path().string();
+    if (ec || !sync_path(dir.empty() ? "." : dir)) {
+        std::cerr << "Failed to replace " << path_ << " with its compacted copy" << std::endl;
+        return false;
+    }
+    return reopen_locked();
+}
+
+bool MmapBTree::restore_from(const std::string& path) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    
+    std::string restore_path = path_ + ".restore";
+    std::error_code ec;
+    std::filesystem::copy_file(path, restore_path, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        std::cerr << "Failed to copy " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    
+    // Check the copy before it replaces anything
+    int fd = ::open(restore_path.c_str(), O_RDWR);
+    Meta meta;
+    bool valid = fd >= 0 && read_meta(fd, meta) && ::fdatasync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!valid) {
+        std::cerr << "Not a valid B+tree file: " << path << std::endl;
+        std::filesystem::remove(restore_path, ec);
+        return false;
+    }
+    
+    std::filesystem::rename(restore_path, path_, ec);
+    std::string dir = std::filesystem::path(path_).parent_path().string();
+    if (ec || !sync_path(dir.empty() ? "." : dir)) {
+        return false;
+    }
+    return reopen_locked();
+}
+
+std::unordered_map<std::string, std::string> MmapBTree::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    Meta meta;
+    uint64_t map_size = 0;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        meta = meta_;
+        map_size = mapping_ ? mapping_->size : 0;
+    }
+    size_t readers = 0;
+    {
+        std::lock_guard<std::mutex> lock(readers_->mutex);
+        readers = readers_->txns.size();
+    }
+    
+    stats["txn_id"] = std::to_string(meta.txn_id);
+    stats["entries"] = std::to_string(meta.entry_count);
+    stats["page_size"] = std::to_string(options_.page_size);
+    stats["page_count"] = std::to_string(meta.page_count);
+    stats["file_bytes"] = std::to_string(meta.page_count * options_.page_size);
+    stats["map_bytes"] = std::to_string(map_size);
+    stats["free_pages"] = std::to_string(meta.freelist_count);
+    stats["open_snapshots"] = std::to_string(readers);
+    
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    size_t pending = 0;
+    for (const auto& [txn, pages] : pending_) {
+        pending += pages.size();
+    }
+    stats["pending_pages"] = std::to_string(pending);
+    stats["commits"] = std::to_string(commit_count_);
+    stats["pages_written"] = std::to_string(pages_written_);
+    return stats;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,799 @@
+#include "storage/mmap_hash_table.h"
+#include "storage/checksum.h"
+#include "storage/block_file.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace distributeddb {
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'D', 'D', 'B', 'M', 'H', 'I', 'D', 'X'};
+const char ARENA_MAGIC[8] = {'D', 'D', 'B', 'M', 'H', 'D', 'A', 'T'};
+const uint32_t FORMAT_VERSION = 1;
+
+constexpr uint64_t INDEX_HEADER_SIZE = 4096;
+constexpr uint64_t ARENA_HEADER_SIZE = 64;
+constexpr uint64_t ARENA_GROWTH = 1ULL << 30;
+constexpr uint64_t INITIAL_ARENA_SIZE = 16ULL << 20;
+
+const uint8_t RECORD_PUT = 1;
+const uint8_t RECORD_DELETE = 2;
+const uint8_t RECORD_PAD = 3;   // Space whose change failed to log
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t clean;
+    uint64_t bucket_count;
+    uint64_t entry_count;
+    uint64_t arena_end;
+    uint64_t live_bytes;
+    uint64_t max_lsn;
+    uint32_t crc;
+};
+
+uint32_t header_crc(const IndexHeader& header) {
+    return crc32c(&header, offsetof(IndexHeader, crc));
+}
+
+uint64_t record_size(uint64_t key_length, uint64_t value_length) {
+    return (40 + key_length + value_length + 7) & ~7ULL;
+}
+
+// Finalizer from MurmurHash3: spreads every input bit over the whole word
+uint64_t mix_hash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+struct MmapHashTable::Record {
+    uint64_t next;          // Chain link; not covered by the CRC
+    uint32_t crc;
+    uint8_t type;
+    uint8_t pad[3];
+    uint32_t key_length;
+    uint32_t value_length;
+    uint64_t lsn;
+    uint64_t hash;
+    
+    const char* key() const { return reinterpret_cast<const char*>(this + 1); }
+    const char* value() const { return key() + key_length; }
+    uint64_t size() const { return record_size(key_length, value_length); }
+    
+    uint32_t checksum() const {
+        return crc32c(&type, sizeof(Record) - offsetof(Record, type) + key_length + value_length);
+    }
+    
+    bool has_key(uint64_t key_hash, const std::string& other) const {
+        return hash == key_hash && key_length == other.size() && std::memcmp(key(), other.data(), other.size()) == 0;
+    }
+};
+
+MmapHashTable::MmapHashTable(const MmapHashTableOptions& options)
+    : options_(options), is_open_(false), opened_clean_(false), index_fd_(-1), arena_fd_(-1),
+      index_(nullptr), arena_(nullptr), index_reserved_(0), stripes_(new Stripe[STRIPES]),
+      bucket_count_(0), arena_end_(ARENA_HEADER_SIZE), arena_file_size_(0),
+      entry_count_(0), live_bytes_(0), max_lsn_(0), checkpoint_count_(0), compaction_count_(0),
+      last_open_us_(0), rebuilt_records_(0) {
+    // Whole buckets per stripe, so a bucket's stripe is fixed by the hash alone
+    uint64_t buckets = STRIPES;
+    while (buckets < options_.initial_buckets) {
+        buckets *= 2;
+    }
+    options_.initial_buckets = buckets;
+    
+    // Never more buckets than twice the records an arena can hold
+    index_reserved_ = INDEX_HEADER_SIZE + options_.max_file_size / 2;
+}
+
+MmapHashTable::~MmapHashTable() {
+    close();
+}
+
+uint64_t MmapHashTable::hash(const std::string& key) {
+    const char* data = key.data();
+    size_t length = key.size();
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ length;
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        h = ((h << 5 | h >> 59) ^ word) * 0x517cc1b727220a95ULL;
+        data += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, length);
+        h = ((h << 5 | h >> 59) ^ word) * 0x517cc1b727220a95ULL;
+    }
+    return mix_hash(h);
+}
+
+uint64_t* MmapHashTable::buckets() const {
+    return reinterpret_cast<uint64_t*>(index_ + INDEX_HEADER_SIZE);
+}
+
+MmapHashTable::Record* MmapHashTable::record(uint64_t offset) const {
+    return reinterpret_cast<Record*>(arena_ + offset);
+}
+
+uint64_t MmapHashTable::find_link(uint64_t hash, const std::string& key, uint64_t*& slot) const {
+    slot = &buckets()[hash & (bucket_count_ - 1)];
+    while (*slot != 0) {
+        Record* entry = record(*slot);
+        if (entry->has_key(hash, key)) {
+            return *slot;
+        }
+        slot = &entry->next;
+    }
+    return 0;
+}
+
+bool MmapHashTable::open(const std::string& dir) {
+    if (is_open_) {
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    
+    dir_ = dir;
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    index_fd_ = ::open(index_path().c_str(), O_RDWR | O_CREAT, 0644);
+    arena_fd_ = ::open(arena_path().c_str(), O_RDWR | O_CREAT, 0644);
+    if (index_fd_ < 0 || arena_fd_ < 0) {
+        std::cerr << "Failed to open mmap hash table files in " << dir_ << std::endl;
+        close();
+        return false;
+    }
+    
+    struct stat st;
+    if (::fstat(arena_fd_, &st) != 0 || (st.st_size == 0 && !create_files()) || !map_files()) {
+        close();
+        return false;
+    }
+    if (std::memcmp(arena_, ARENA_MAGIC, sizeof(ARENA_MAGIC)) != 0) {
+        std::cerr << arena_path() << " is not a mmap hash table arena" << std::endl;
+        close();
+        return false;
+    }
+    is_open_ = true;
+    
+    opened_clean_ = read_header();
+    if (!opened_clean_ && !rebuild_locked()) {
+        close();
+        return false;
+    }
+    
+    // Until the next clean close the index may run ahead of what is on disk
+    if (!write_header(false)) {
+        close();
+        return false;
+    }
+    
+    last_open_us_ = elapsed_us(start);
+    std::cout << "Mmap hash table opened " << (opened_clean_ ? "clean" : "after rebuilding its index") << " with "
+              << entry_count_ << " keys in " << last_open_us_ << " us" << std::endl;
+    return true;
+}
+
+bool MmapHashTable::create_files() {
+    char header[ARENA_HEADER_SIZE] = {};
+    std::memcpy(header, ARENA_MAGIC, sizeof(ARENA_MAGIC));
+    std::memcpy(header + 8, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+    
+    uint64_t size = std::min(INITIAL_ARENA_SIZE, options_.max_file_size);
+    if (::pwrite(arena_fd_, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        ::ftruncate(arena_fd_, static_cast<off_t>(size)) != 0 || ::ftruncate(index_fd_, 0) != 0 ||
+        ::fdatasync(arena_fd_) != 0 || !sync_path(dir_)) {
+        std::cerr << "Failed to create mmap hash table in " << dir_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MmapHashTable::map_files() {
+    struct stat st;
+    if (::fstat(arena_fd_, &st) != 0 || static_cast<uint64_t>(st.st_size) < ARENA_HEADER_SIZE) {
+        std::cerr << "Mmap hash table arena " << arena_path() << " is truncated" << std::endl;
+        return false;
+    }
+    arena_file_size_ = static_cast<uint64_t>(st.st_size);
+    
+    // Reserve the largest size up front: the files grow under the mapping and
+    // the base addresses never move
+    void* arena = ::mmap(nullptr, options_.max_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, arena_fd_, 0);
+    if (arena == MAP_FAILED) {
+        std::cerr << "Failed to map " << options_.max_file_size << " bytes for " << arena_path() << std::endl;
+        return false;
+    }
+    arena_ = static_cast<char*>(arena);
+    
+    if (::fstat(index_fd_, &st) != 0 ||
+        (static_cast<uint64_t>(st.st_size) < INDEX_HEADER_SIZE && ::ftruncate(index_fd_, INDEX_HEADER_SIZE) != 0)) {
+        std::cerr << "Failed to size " << index_path() << std::endl;
+        return false;
+    }
+    void* index = ::mmap(nullptr, index_reserved_, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd_, 0);
+    if (index == MAP_FAILED) {
+        std::cerr << "Failed to map " << index_reserved_ << " bytes for " << index_path() << std::endl;
+        return false;
+    }
+    index_ = static_cast<char*>(index);
+    return true;
+}
+
+void MmapHashTable::unmap_files() {
+    if (arena_ != nullptr) {
+        ::munmap(arena_, options_.max_file_size);
+        arena_ = nullptr;
+    }
+    if (index_ != nullptr) {
+        ::munmap(index_, index_reserved_);
+        index_ = nullptr;
+    }
+}
+
+void MmapHashTable::close() {
+    if (is_open_) {
+        lock_all();
+        uint64_t index_size = INDEX_HEADER_SIZE + bucket_count_ * sizeof(uint64_t);
+        bool synced = ::msync(arena_, arena_end_, MS_SYNC) == 0 && ::msync(index_, index_size, MS_SYNC) == 0;
+        if (!synced || !write_header(true)) {
+            std::cerr << "Failed to sync mmap hash table in " << dir_ << "; the next open rebuilds its index"
+                      << std::endl;
+        }
+        unlock_all();
+        is_open_ = false;
+    }
+    
+    unmap_files();
+    if (index_fd_ >= 0) {
+        ::close(index_fd_);
+        index_fd_ = -1;
+    }
+    if (arena_fd_ >= 0) {
+        ::close(arena_fd_);
+        arena_fd_ = -1;
+    }
+}
+
+bool MmapHashTable::read_header() {
+    IndexHeader header;
+    std::memcpy(&header, index_, sizeof(header));
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+        header.crc != header_crc(header) || header.clean != 1) {
+        return false;
+    }
+    
+    struct stat st;
+    uint64_t bucket_count = header.bucket_count;
+    bool valid = bucket_count >= STRIPES && (bucket_count & (bucket_count - 1)) == 0 &&
+                 INDEX_HEADER_SIZE + bucket_count * sizeof(uint64_t) <= index_reserved_ &&
+                 ::fstat(index_fd_, &st) == 0 &&
+                 static_cast<uint64_t>(st.st_size) >= INDEX_HEADER_SIZE + bucket_count * sizeof(uint64_t) &&
+                 header.arena_end >= ARENA_HEADER_SIZE && header.arena_end <= arena_file_size_;
+    if (!valid) {
+        std::cerr << "Mmap hash table index in " << dir_ << " does not match its arena" << std::endl;
+        return false;
+    }
+    
+    bucket_count_ = bucket_count;
+    arena_end_ = header.arena_end;
+    entry_count_ = header.entry_count;
+    live_bytes_ = header.live_bytes;
+    max_lsn_ = header.max_lsn;
+    return true;
+}
+
+bool MmapHashTable::write_header(bool clean) {
+    IndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = FORMAT_VERSION;
+    header.clean = clean ? 1 : 0;
+    header.bucket_count = bucket_count_;
+    header.entry_count = entry_count_;
+    header.arena_end = arena_end_;
+    header.live_bytes = live_bytes_;
+    header.max_lsn = max_lsn_;
+    header.crc = header_crc(header);
+    
+    std::memcpy(index_, &header, sizeof(header));
+    if (::msync(index_, INDEX_HEADER_SIZE, MS_SYNC) != 0) {
+        std::cerr << "Failed to write the header of " << index_path() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MmapHashTable::set_bucket_count(uint64_t bucket_count) {
+    uint64_t size = INDEX_HEADER_SIZE + bucket_count * sizeof(uint64_t);
+    if (size > index_reserved_ || ::ftruncate(index_fd_, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Failed to resize " << index_path() << " to " << bucket_count << " buckets" << std::endl;
+        return false;
+    }
+    bucket_count_ = bucket_count;
+    return true;
+}
+
+bool MmapHashTable::rebuild() {
+    lock_all();
+    bool ok = rebuild_locked();
+    unlock_all();
+    return ok;
+}
+
+bool MmapHashTable::rebuild_locked() {
+    auto start = std::chrono::steady_clock::now();
+    if (!set_bucket_count(options_.initial_buckets)) {
+        return false;
+    }
+    std::memset(buckets(), 0, bucket_count_ * sizeof(uint64_t));
+    entry_count_ = 0;
+    live_bytes_ = 0;
+    max_lsn_ = 0;
+    recovered_deletes_.clear();
+    rebuilt_records_ = 0;
+    
+    // Records are complete up to the first one that fails its checks
+    uint64_t offset = ARENA_HEADER_SIZE;
+    while (offset + sizeof(Record) <= arena_file_size_) {
+        Record* entry = record(offset);
+        if (entry->type < RECORD_PUT || entry->type > RECORD_PAD ||
+            entry->key_length > arena_file_size_ - offset ||
+            entry->value_length > arena_file_size_ - offset ||
+            entry->size() > arena_file_size_ - offset || entry->crc != entry->checksum()) {
+            break;
+        }
+        offset += entry->size();
+        rebuilt_records_++;
+        if (entry->type == RECORD_PAD) {
+            continue;
+        }
+        
+        uint64_t lsn = entry->lsn;
+        max_lsn_ = std::max(max_lsn_.load(), lsn);
+        std::string key(entry->key(), entry->key_length);
+        uint64_t* slot;
+        uint64_t current = find_link(entry->hash, key, slot);
+        auto deleted = recovered_deletes_.find(key);
+        if ((current != 0 && record(current)->lsn >= lsn) ||
+            (current == 0 && deleted != recovered_deletes_.end() && deleted->second >= lsn)) {
+            continue;
+        }
+        if (entry->type == RECORD_DELETE) {
+            recovered_deletes_[key] = lsn;
+        }
+        link(reinterpret_cast<char*>(entry) - arena_);
+        
+        if (entry_count_ > bucket_count_ && !double_buckets()) {
+            return false;
+        }
+    }
+    
+    // Zero whatever follows, so a later scan cannot mistake old bytes for records
+    arena_end_ = offset;
+    if (::ftruncate(arena_fd_, static_cast<off_t>(offset)) != 0 ||
+        ::ftruncate(arena_fd_, static_cast<off_t>(arena_file_size_)) != 0) {
+        std::cerr << "Failed to trim " << arena_path() << std::endl;
+        return false;
+    }
+    
+    std::cout << "Rebuilt mmap hash index from " << rebuilt_records_ << " records (" << entry_count_
+              << " keys) in " << elapsed_us(start) / 1000 << " ms" << std::endl;
+    return true;
+}
+
+uint64_t MmapHashTable::allocate(uint64_t size) {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    if (arena_end_ + size > options_.max_file_size) {
+        std::cerr << "Mmap hash table arena is full at " << arena_end_ << " bytes" << std::endl;
+        return 0;
+    }
+    
+    if (arena_end_ + size > arena_file_size_) {
+        uint64_t grown = arena_file_size_ + std::min(arena_file_size_, ARENA_GROWTH);
+        grown = std::min(std::max(grown, arena_end_ + size), options_.max_file_size);
+        if (::ftruncate(arena_fd_, static_cast<off_t>(grown)) != 0) {
+            std::cerr << "Failed to grow " << arena_path() << " to " << grown << " bytes" << std::endl;
+            return 0;
+        }
+        arena_file_size_ = grown;
+    }
+    
+    uint64_t offset = arena_end_;
+    arena_end_ += size;
+    return offset;
+}
+
+uint64_t MmapHashTable::append(uint8_t type, uint64_t hash, const std::string& key, const std::string& value) {
+    uint64_t offset = allocate(record_size(key.size(), value.size()));
+    if (offset == 0) {
+        return 0;
+    }
+    
+    Record* entry = record(offset);
+    entry->next = 0;
+    entry->crc = 0;
+    entry->type = type;
+    std::memset(entry->pad, 0, sizeof(entry->pad));
+    entry->key_length = static_cast<uint32_t>(key.size());
+    entry->value_length = static_cast<uint32_t>(value.size());
+    entry->lsn = 0;
+    entry->hash = hash;
+    std::memcpy(arena_ + offset + sizeof(Record), key.data(), key.size());
+    std::memcpy(arena_ + offset + sizeof(Record) + key.size(), value.data(), value.size());
+    return offset;
+}
+
+void MmapHashTable::publish(uint64_t offset, uint64_t lsn) {
+    Record* entry = record(offset);
+    entry->lsn = lsn;
+    entry->crc = entry->checksum();
+    
+    uint64_t seen = max_lsn_.load();
+    while (seen < lsn && !max_lsn_.compare_exchange_weak(seen, lsn)) {
+    }
+    link(offset);
+}
+
+void MmapHashTable::discard(uint64_t offset) {
+    Record* entry = record(offset);
+    entry->type = RECORD_PAD;
+    entry->crc = entry->checksum();
+}
+
+void MmapHashTable::link(uint64_t offset) {
+    Record* entry = record(offset);
+    std::string key(entry->key(), entry->key_length);
+    uint64_t* slot;
+    uint64_t current = find_link(entry->hash, key, slot);
+    if (current != 0) {
+        *slot = record(current)->next;
+        live_bytes_ -= record(current)->size();
+        entry_count_--;
+    }
+    
+    if (entry->type == RECORD_PUT) {
+        uint64_t& bucket = buckets()[entry->hash & (bucket_count_ - 1)];
+        entry->next = bucket;
+        bucket = offset;
+        live_bytes_ += entry->size();
+        entry_count_++;
+    }
+}
+
+bool MmapHashTable::get(uint64_t hash, const std::string& key, std::string& value) const {
+    uint64_t* slot;
+    uint64_t offset = find_link(hash, key, slot);
+    if (offset == 0) {
+        return false;
+    }
+    const Record* entry = record(offset);
+    value.assign(entry->value(), entry->value_length);
+    return true;
+}
+
+bool MmapHashTable::put(uint64_t hash, const std::string& key, const std::string& value, const LogFunction& log) {
+    uint64_t offset = append(RECORD_PUT, hash, key, value);
+    if (offset == 0) {
+        return false;
+    }
+    
+    uint64_t lsn = 0;
+    if (!log(lsn)) {
+        discard(offset);
+        return false;
+    }
+    publish(offset, lsn);
+    return true;
+}
+
+bool MmapHashTable::remove(uint64_t hash, const std::string& key, const LogFunction& log) {
+    uint64_t offset = append(RECORD_DELETE, hash, key, std::string());
+    if (offset == 0) {
+        return false;
+    }
+    
+    uint64_t lsn = 0;
+    if (!log(lsn)) {
+        discard(offset);
+        return false;
+    }
+    publish(offset, lsn);
+    return true;
+}
+
+bool MmapHashTable::replay(bool is_delete, const std::string& key, const std::string& value, uint64_t lsn) {
+    uint64_t key_hash = hash(key);
+    uint64_t* slot;
+    uint64_t current = find_link(key_hash, key, slot);
+    auto deleted = recovered_deletes_.find(key);
+    if ((current != 0 && record(current)->lsn >= lsn) ||
+        (deleted != recovered_deletes_.end() && deleted->second >= lsn)) {
+        return true;
+    }
+    if (is_delete) {
+        recovered_deletes_[key] = lsn;
+        if (current == 0) {
+            return true;
+        }
+    }
+    
+    uint64_t offset = append(is_delete ? RECORD_DELETE : RECORD_PUT, key_hash, key, is_delete ? std::string() : value);
+    if (offset == 0) {
+        return false;
+    }
+    publish(offset, lsn);
+    if (entry_count_ > bucket_count_) {
+        grow_if_needed();
+    }
+    return true;
+}
+
+void MmapHashTable::finish_recovery() {
+    recovered_deletes_.clear();
+    recovered_deletes_.rehash(0);
+}
+
+void MmapHashTable::grow_if_needed() {
+    if (entry_count_ <= bucket_count_) {
+        return;
+    }
+    
+    lock_all();
+    if (entry_count_ > bucket_count_) {
+        double_buckets();
+    }
+    unlock_all();
+}
+
+bool MmapHashTable::double_buckets() {
+    uint64_t old_count = bucket_count_;
+    if (!set_bucket_count(old_count * 2)) {
+        return false;
+    }
+    
+    // Split each chain between bucket b and bucket b + old_count
+    uint64_t* table = buckets();
+    for (uint64_t b = 0; b < old_count; ++b) {
+        uint64_t offset = table[b];
+        table[b] = 0;
+        table[b + old_count] = 0;
+        while (offset != 0) {
+            Record* entry = record(offset);
+            uint64_t next = entry->next;
+            uint64_t& bucket = table[(entry->hash & old_count) ? b + old_count : b];
+            entry->next = bucket;
+            bucket = offset;
+            offset = next;
+        }
+    }
+    return true;
+}
+
+void MmapHashTable::for_each(const std::function<bool(const std::string&, const std::string&)>& fn) const {
+    for (size_t s = 0; s < STRIPES; ++s) {
+        std::shared_lock<std::shared_mutex> lock(stripes_[s].mutex);
+        for (uint64_t b = s; b < bucket_count_; b += STRIPES) {
+            for (uint64_t offset = buckets()[b]; offset != 0; offset = record(offset)->next) {
+                const Record* entry = record(offset);
+                if (!fn(std::string(entry->key(), entry->key_length),
+                        std::string(entry->value(), entry->value_length))) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void MmapHashTable::lock_all() const {
+    for (size_t s = 0; s < STRIPES; ++s) {
+        stripes_[s].mutex.lock();
+    }
+}
+
+void MmapHashTable::unlock_all() const {
+    for (size_t s = STRIPES; s > 0; --s) {
+        stripes_[s - 1].mutex.unlock();
+    }
+}
+
+bool MmapHashTable::checkpoint(const std::function<bool()>& at_barrier) {
+    // With every stripe held no record is half written, so everything below
+    // end is complete and every later change is logged after the barrier
+    lock_all();
+    bool ok = at_barrier();
+    uint64_t end;
+    {
+        std::lock_guard<std::mutex> lock(arena_mutex_);
+        end = arena_end_;
+    }
+    unlock_all();
+    
+    if (!ok) {
+        return false;
+    }
+    if (::msync(arena_, end, MS_SYNC) != 0) {
+        std::cerr << "Failed to sync " << arena_path() << std::endl;
+        return false;
+    }
+    checkpoint_count_++;
+    return true;
+}
+
+uint64_t MmapHashTable::dead_bytes() const {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    return arena_end_ - ARENA_HEADER_SIZE - live_bytes_;
+}
+
+double MmapHashTable::dead_ratio() const {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    uint64_t used = arena_end_ - ARENA_HEADER_SIZE;
+    return used > 0 ? static_cast<double>(used - live_bytes_) / used : 0.0;
+}
+
+bool MmapHashTable::write_arena(const std::string& path, uint64_t& records) const {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    
+    std::vector<char> buffer(ARENA_HEADER_SIZE, 0);
+    std::memcpy(buffer.data(), ARENA_MAGIC, sizeof(ARENA_MAGIC));
+    std::memcpy(buffer.data() + 8, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+    
+    bool ok = true;
+    auto flush = [&]() {
+        size_t written = 0;
+        while (ok && written < buffer.size()) {
+            ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+            ok = n > 0;
+            written += ok ? static_cast<size_t>(n) : 0;
+        }
+        buffer.clear();
+    };
+    
+    records = 0;
+    for (uint64_t b = 0; ok && b < bucket_count_; ++b) {
+        for (uint64_t offset = buckets()[b]; offset != 0; offset = record(offset)->next) {
+            const Record* entry = record(offset);
+            size_t at = buffer.size();
+            buffer.insert(buffer.end(), arena_ + offset, arena_ + offset + entry->size());
+            std::memset(buffer.data() + at, 0, sizeof(uint64_t));  // next
+            records++;
+            if (buffer.size() >= (1 << 20)) {
+                flush();
+            }
+        }
+    }
+    flush();
+    
+    ok = ok && ::fdatasync(fd) == 0;
+    ::close(fd);
+    if (!ok) {
+        std::cerr << "Failed to write " << path << std::endl;
+        std::filesystem::remove(path);
+    }
+    return ok;
+}
+
+bool MmapHashTable::compact(const std::function<bool()>& at_barrier) {
+    auto start = std::chrono::steady_clock::now();
+    std::string tmp_path = arena_path() + ".compact";
+    
+    lock_all();
+    uint64_t before = arena_end_;
+    uint64_t records = 0;
+    bool ok = ::msync(arena_, arena_end_, MS_SYNC) == 0 && at_barrier() && write_arena(tmp_path, records);
+    if (ok) {
+        // Old and new arena hold the same data, so a crash on either side of
+        // the rename only costs an index rebuild
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, arena_path(), ec);
+        unmap_files();
+        ::close(arena_fd_);
+        arena_fd_ = ::open(arena_path().c_str(), O_RDWR);
+        ok = !ec && arena_fd_ >= 0 && sync_path(dir_) && map_files() && rebuild_locked();
+        if (!ok) {
+            std::cerr << "Failed to replace " << arena_path() << " with its compacted copy" << std::endl;
+        }
+    }
+    unlock_all();
+    
+    if (ok) {
+        compaction_count_++;
+        std::cout << "Compacted mmap hash arena from " << before << " to " << arena_end_ << " bytes in "
+                  << elapsed_us(start) / 1000 << " ms" << std::endl;
+    }
+    return ok;
+}
+
+bool MmapHashTable::copy_to(const std::string& path) const {
+    // Readers carry on; writers wait until the copy is written
+    for (size_t s = 0; s < STRIPES; ++s) {
+        stripes_[s].mutex.lock_shared();
+    }
+    uint64_t records = 0;
+    bool ok = write_arena(path + ".tmp", records);
+    for (size_t s = STRIPES; s > 0; --s) {
+        stripes_[s - 1].mutex.unlock_shared();
+    }
+    
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(path + ".tmp", path, ec);
+    }
+    return ok && !ec;
+}
+
+bool MmapHashTable::restore_from(const std::string& path) {
+    std::string tmp_path = arena_path() + ".restore";
+    std::error_code ec;
+    std::filesystem::copy_file(path, tmp_path, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec || !sync_path(tmp_path)) {
+        std::cerr << "Failed to copy " << path << ": " << ec.message() << std::endl;
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    
+    lock_all();
+    std::filesystem::rename(tmp_path, arena_path(), ec);
+    unmap_files();
+    ::close(arena_fd_);
+    arena_fd_ = ::open(arena_path().c_str(), O_RDWR);
+    bool ok = !ec && arena_fd_ >= 0 && sync_path(dir_) && map_files() &&
+              std::memcmp(arena_, ARENA_MAGIC, sizeof(ARENA_MAGIC)) == 0 && rebuild_locked();
+    unlock_all();
+    
+    if (!ok) {
+        std::cerr << "Failed to restore mmap hash table from " << path << std::endl;
+    }
+    return ok;
+}
+
+std::unordered_map<std::string, std::string> MmapHashTable::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    uint64_t end;
+    uint64_t file_size;
+    {
+        std::lock_guard<std::mutex> lock(arena_mutex_);
+        end = arena_end_;
+        file_size = arena_file_size_;
+    }
+    stats["entries"] = std::to_string(entry_count_.load());
+    stats["buckets"] = std::to_string(bucket_count_.load());
+    stats["arena_bytes"] = std::to_string(end);
+    stats["arena_file_bytes"] = std::to_string(file_size);
+    stats["live_bytes"] = std::to_string(live_bytes_.load());
+    stats["dead_bytes"] = std::to_string(end - ARENA_HEADER_SIZE - live_bytes_);
+    stats["max_lsn"] = std::to_string(max_lsn_.load());
+    stats["opened_clean"] = opened_clean_ ? "true" : "false";
+    stats["open_us"] = std::to_string(last_open_us_);
+    stats["rebuilt_records"] = std::to_string(rebuilt_records_);
+    stats["checkpoints"] = std::to_string(checkpoint_count_.load());
+    stats["compactions"] = std::to_string(compaction_count_.load());
+    return stats;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,298 @@
+#include "storage/range_index.h"
+#include <algorithm>
+#include <iterator>
+
+namespace distributeddb {
+
+RangeIndex::RangeIndex(const RangeIndexOptions& options)
+    : options_(options), last_rebalance_(std::chrono::steady_clock::now()), splits_(0), merges_(0) {
+    ranges_.push_back(std::make_shared<Range>(std::string()));
+}
+
+RangeIndex::RangePtr RangeIndex::locate(const std::string& key, std::string* next_start, bool* last) const {
+    std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), key,
+                               [](const std::string& probe, const RangePtr& range) { return probe < range->start; });
+    auto range = std::prev(it);
+    if (last != nullptr) {
+        *last = it == ranges_.end();
+    }
+    if (next_start != nullptr && it != ranges_.end()) {
+        *next_start = (*it)->start;
+    }
+    return *range;
+}
+
+void RangeIndex::insert(const std::string& key) {
+    while (true) {
+        RangePtr range = locate(key);
+        std::unique_lock<std::shared_mutex> lock(range->mutex);
+        if (range->retired) continue;
+        
+        range->keys.insert(key, 0);
+        range->ops.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+}
+
+void RangeIndex::remove(const std::string& key) {
+    while (true) {
+        RangePtr range = locate(key);
+        std::unique_lock<std::shared_mutex> lock(range->mutex);
+        if (range->retired) continue;
+        
+        range->keys.remove(key);
+        range->ops.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+}
+
+void RangeIndex::touch(const std::string& key) {
+    // A count that lands on a range just retired is lost, which is harmless
+    locate(key)->ops.fetch_add(1, std::memory_order_relaxed);
+}
+
+RangeIndex::RangePtr RangeIndex::build(const std::string& start, const std::vector<std::string>& keys,
+                                       size_t from, size_t to, uint64_t ops_per_sec) {
+    auto range = std::make_shared<Range>(start);
+    for (size_t i = from; i < to; ++i) {
+        range->keys.insert(keys[i], 0);
+    }
+    range->ops_per_sec = ops_per_sec;
+    return range;
+}
+
+std::vector<std::string> RangeIndex::keys_of(const Range& range) {
+    std::vector<std::string> keys;
+    keys.reserve(range.keys.size());
+    range.keys.visit_from(range.start, [&keys](const std::string& key, uint8_t) {
+        keys.push_back(key);
+        return true;
+    });
+    return keys;
+}
+
+void RangeIndex::rebuild(std::vector<std::string> keys) {
+    std::lock_guard<std::mutex> rebalance_lock(rebalance_mutex_);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    
+    size_t chunk = std::max<size_t>(options_.split_keys / 2, 1);
+    std::vector<RangePtr> ranges;
+    for (size_t from = 0; from < keys.size() || ranges.empty(); from += chunk) {
+        size_t to = std::min(from + chunk, keys.size());
+        ranges.push_back(build(ranges.empty() ? std::string() : keys[from], keys, from, to, 0));
+    }
+    
+    std::vector<RangePtr> old;
+    {
+        std::unique_lock<std::shared_mutex> lock(layout_mutex_);
+        old.swap(ranges_);
+        ranges_ = std::move(ranges);
+    }
+    for (auto& range : old) {
+        std::unique_lock<std::shared_mutex> lock(range->mutex);
+        range->retired = true;
+    }
+}
+
+void RangeIndex::insert_sorted(const std::vector<std::string>& keys) {
+    std::lock_guard<std::mutex> rebalance_lock(rebalance_mutex_);
+    std::vector<RangePtr> ranges;
+    {
+        std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+        ranges = ranges_;
+    }
+    
+    // As in rebalance(), going from the back keeps the indexes of ranges not yet visited
+    size_t chunk = std::max<size_t>(options_.split_keys / 2, 1);
+    auto end = keys.end();
+    for (size_t i = ranges.size(); i-- > 0 && end != keys.begin();) {
+        auto begin = i == 0 ? keys.begin() : std::lower_bound(keys.begin(), end, ranges[i]->start);
+        if (begin == end) continue;
+        
+        std::unique_lock<std::shared_mutex> lock(ranges[i]->mutex);
+        std::vector<std::string> existing = keys_of(*ranges[i]);
+        std::vector<std::string> merged;
+        merged.reserve(existing.size() + static_cast<size_t>(end - begin));
+        std::set_union(existing.begin(), existing.end(), begin, end, std::back_inserter(merged));
+        
+        std::vector<RangePtr> replacements;
+        uint64_t rate = ranges[i]->ops_per_sec;
+        for (size_t from = 0; from < merged.size(); from += chunk) {
+            size_t to = std::min(from + chunk, merged.size());
+            replacements.push_back(build(from == 0 ? ranges[i]->start : merged[from], merged, from, to, rate));
+        }
+        swap_in(i, 1, std::move(replacements));
+        end = begin;
+    }
+}
+
+std::vector<std::string> RangeIndex::scan(const std::string& start_key, const std::string& end_key,
+                                          size_t limit) const {
+    std::vector<std::string> keys;
+    std::string cursor = start_key;
+    while (keys.size() < limit && cursor < end_key) {
+        std::string next_start;
+        bool last = false;
+        RangePtr range = locate(cursor, &next_start, &last);
+        {
+            std::shared_lock<std::shared_mutex> lock(range->mutex);
+            if (range->retired) continue;
+            
+            range->ops.fetch_add(1, std::memory_order_relaxed);
+            const std::string& stop = last || end_key < next_start ? end_key : next_start;
+            for (auto& entry : range->keys.scan(cursor, stop, limit - keys.size())) {
+                keys.push_back(std::move(entry.first));
+            }
+        }
+        if (last || !(next_start < end_key)) {
+            break;
+        }
+        cursor = next_start;
+    }
+    return keys;
+}
+
+void RangeIndex::swap_in(size_t index, size_t count, std::vector<RangePtr> replacements) {
+    {
+        std::unique_lock<std::shared_mutex> lock(layout_mutex_);
+        for (size_t i = index; i < index + count; ++i) {
+            ranges_[i]->retired = true;
+        }
+        ranges_.erase(ranges_.begin() + index, ranges_.begin() + index + count);
+        ranges_.insert(ranges_.begin() + index, replacements.begin(), replacements.end());
+    }
+}
+
+bool RangeIndex::split(size_t index) {
+    RangePtr range;
+    {
+        std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+        range = ranges_[index];
+    }
+    
+    // Writers to this range wait while it is copied; every other range goes on
+    std::unique_lock<std::shared_mutex> lock(range->mutex);
+    std::vector<std::string> keys = keys_of(*range);
+    if (keys.size() < 2) {
+        return false;
+    }
+    
+    size_t middle = keys.size() / 2;
+    uint64_t rate = range->ops_per_sec / 2;
+    std::vector<RangePtr> halves;
+    halves.push_back(build(range->start, keys, 0, middle, rate));
+    halves.push_back(build(keys[middle], keys, middle, keys.size(), rate));
+    swap_in(index, 1, std::move(halves));
+    splits_++;
+    return true;
+}
+
+bool RangeIndex::merge(size_t index) {
+    RangePtr left;
+    RangePtr right;
+    {
+        std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+        left = ranges_[index];
+        right = ranges_[index + 1];
+    }
+    
+    // Only the rebalancer holds two range locks, always left before right
+    std::unique_lock<std::shared_mutex> left_lock(left->mutex);
+    std::unique_lock<std::shared_mutex> right_lock(right->mutex);
+    if (left->ops_per_sec >= options_.merge_ops || right->ops_per_sec >= options_.merge_ops ||
+        left->keys.size() + right->keys.size() > options_.split_keys / 2) {
+        return false;
+    }
+    std::vector<std::string> keys = keys_of(*left);
+    std::vector<std::string> right_keys = keys_of(*right);
+    keys.insert(keys.end(), std::make_move_iterator(right_keys.begin()), std::make_move_iterator(right_keys.end()));
+    
+    std::vector<RangePtr> merged;
+    merged.push_back(build(left->start, keys, 0, keys.size(), left->ops_per_sec + right->ops_per_sec));
+    swap_in(index, 2, std::move(merged));
+    merges_++;
+    return true;
+}
+
+void RangeIndex::rebalance() {
+    std::lock_guard<std::mutex> rebalance_lock(rebalance_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    uint64_t elapsed_ms = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - last_rebalance_).count()));
+    last_rebalance_ = now;
+    
+    std::vector<RangePtr> ranges;
+    {
+        std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+        ranges = ranges_;
+    }
+    
+    std::vector<size_t> sizes(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        ranges[i]->ops_per_sec = ranges[i]->ops.exchange(0, std::memory_order_relaxed) * 1000 / elapsed_ms;
+        std::shared_lock<std::shared_mutex> lock(ranges[i]->mutex);
+        sizes[i] = ranges[i]->keys.size();
+    }
+    
+    // Only rebalance() and rebuild() change the list, so indexes hold while it
+    // runs. Going from the back, a split or merge never moves a range not yet visited.
+    for (size_t i = ranges.size(); i-- > 0;) {
+        if (sizes[i] > options_.split_keys || ranges[i]->ops_per_sec > options_.split_ops) {
+            split(i);
+        }
+    }
+    
+    size_t count;
+    {
+        std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+        count = ranges_.size();
+    }
+    for (size_t i = count - 1; i-- > 0;) {
+        merge(i);
+    }
+}
+
+std::vector<RangeIndex::RangeLoad> RangeIndex::load() const {
+    std::vector<RangePtr> ranges;
+    {
+        std::shared_lock<std::shared_mutex> lock(layout_mutex_);
+        ranges = ranges_;
+    }
+    
+    std::vector<RangeLoad> loads;
+    for (const auto& range : ranges) {
+        std::shared_lock<std::shared_mutex> lock(range->mutex);
+        loads.push_back(RangeLoad{range->start, range->keys.size(), range->keys.memory_usage(),
+                                  range->ops_per_sec.load()});
+    }
+    return loads;
+}
+
+std::unordered_map<std::string, std::string> RangeIndex::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    auto loads = load();
+    
+    size_t keys = 0;
+    size_t memory = 0;
+    size_t hottest = 0;
+    for (size_t i = 0; i < loads.size(); ++i) {
+        keys += loads[i].keys;
+        memory += loads[i].memory_bytes;
+        if (loads[i].ops_per_sec > loads[hottest].ops_per_sec) {
+            hottest = i;
+        }
+    }
+    
+    stats["ranges"] = std::to_string(loads.size());
+    stats["keys"] = std::to_string(keys);
+    stats["memory_bytes"] = std::to_string(memory);
+    stats["splits"] = std::to_string(splits_.load());
+    stats["merges"] = std::to_string(merges_.load());
+    stats["hottest_start"] = loads[hottest].start;
+    stats["hottest_ops_per_sec"] = std::to_string(loads[hottest].ops_per_sec);
+    return stats;
+}
+
+} // namespace distributeddb
@@ -0,0 +1,103 @@
+#include "storage/sharded_table.h"
+#include <mutex>
+#include <algorithm>
+#include <iterator>
+
+namespace distributeddb {
+
+ShardedTable::ShardedTable(size_t shard_count) : track_dirty_(false) {
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+size_t ShardedTable::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        total += shard->data.size();
+    }
+    return total;
+}
+
+size_t ShardedTable::dirty_count() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        total += shard->dirty.size();
+    }
+    return total;
+}
+
+const ShardedTable::DroppedRange* ShardedTable::covering(const Shard& shard, const std::string& key) {
+    auto it = shard.dropped.upper_bound(key);
+    if (it == shard.dropped.begin()) {
+        return nullptr;
+    }
+    --it;
+    return key < it->second.end ? &it->second : nullptr;
+}
+
+void ShardedTable::add_dropped(Shard& shard, const std::string& start, const std::string& end, uint64_t lsn) {
+    // The new range is the newest, so it replaces whatever it overlaps; a
+    // range sticking out on either side keeps its own LSN there
+    auto first = shard.dropped.upper_bound(start);
+    if (first != shard.dropped.begin()) {
+        auto before = std::prev(first);
+        if (start < before->second.end) {
+            if (end < before->second.end) {
+                shard.dropped[end] = DroppedRange{before->second.end, before->second.lsn};
+            }
+            before->second.end = start;
+            if (!(before->first < before->second.end)) {
+                shard.dropped.erase(before);
+            }
+        }
+    }
+    auto last = shard.dropped.lower_bound(start);
+    while (last != shard.dropped.end() && last->first < end) {
+        if (end < last->second.end) {
+            shard.dropped[end] = DroppedRange{last->second.end, last->second.lsn};
+        }
+        last = shard.dropped.erase(last);
+    }
+    shard.dropped[start] = DroppedRange{end, lsn};
+}
+
+void ShardedTable::remove_dropped_through(Shard& shard, uint64_t lsn) {
+    for (auto it = shard.dropped.begin(); it != shard.dropped.end();) {
+        it = it->second.lsn <= lsn ? shard.dropped.erase(it) : std::next(it);
+    }
+    if (shard.dropped.empty()) {
+        shard.rewritten.clear();
+    }
+}
+
+void ShardedTable::remove_dropped(const Shard& shard, std::vector<std::pair<std::string, std::string>>& entries) {
+    if (shard.dropped.empty()) {
+        return;
+    }
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&shard](const std::pair<std::string, std::string>& entry) {
+                                     return is_dropped(shard, entry.first);
+                                 }),
+                  entries.end());
+}
+
+void ShardedTable::clear() {
+    for (auto& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard->mutex);
+        shard->data.clear();
+        shard->dirty.clear();
+        shard->expires.clear();
+        shard->dropped.clear();
+        shard->rewritten.clear();
+    }
+}
+
+} // namespace distributeddb
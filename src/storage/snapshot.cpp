@@ -0,0 +1,95 @@
+#include "storage/snapshot.h"
+#include <iostream>
+#include <cstring>
+
+namespace distributeddb {
+
+namespace {
+
+void fill_header(const BlockFileProperties& properties, SnapshotHeader& header) {
+    header.wal_segment = properties.wal_segment;
+    header.start_lsn = properties.start_lsn;
+    header.base_lsn = properties.base_lsn;
+    header.entry_count = properties.entry_count;
+    header.deleted_ranges = properties.range_tombstones;
+}
+
+} // namespace
+
+std::string encode_expiring_value(const std::string& value, uint64_t expire_ms) {
+    std::string encoded(sizeof(expire_ms), '\0');
+    std::memcpy(&encoded[0], &expire_ms, sizeof(expire_ms));
+    encoded.append(value);
+    return encoded;
+}
+
+bool decode_expiring_value(std::string& value, uint64_t& expire_ms) {
+    if (value.size() < sizeof(expire_ms)) {
+        return false;
+    }
+    std::memcpy(&expire_ms, value.data(), sizeof(expire_ms));
+    value.erase(0, sizeof(expire_ms));
+    return true;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path, const BlockFileOptions& options)
+    : writer_(path, options) {
+}
+
+bool SnapshotWriter::open(uint64_t wal_segment, uint64_t start_lsn, uint64_t base_lsn) {
+    properties_.wal_segment = wal_segment;
+    properties_.start_lsn = start_lsn;
+    properties_.base_lsn = base_lsn;
+    return writer_.open();
+}
+
+bool SnapshotWriter::add(const std::string& key, const std::string& value) {
+    return writer_.add(BlockEntryType::PUT, key, value);
+}
+
+bool SnapshotWriter::add_expiring(const std::string& key, const std::string& value, uint64_t expire_ms) {
+    return writer_.add(BlockEntryType::PUT_TTL, key, encode_expiring_value(value, expire_ms));
+}
+
+bool SnapshotWriter::add_tombstone(const std::string& key) {
+    return writer_.add(BlockEntryType::DELETE, key, std::string());
+}
+
+void SnapshotWriter::add_range_tombstone(const std::string& start, const std::string& end) {
+    properties_.range_tombstones.emplace_back(start, end);
+}
+
+bool SnapshotWriter::finish() {
+    return writer_.finish(properties_);
+}
+
+void SnapshotWriter::abort() {
+    writer_.abort();
+}
+
+bool SnapshotReader::read_header(const std::string& path, SnapshotHeader& header) {
+    BlockFileReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    
+    fill_header(reader.properties(), header);
+    return true;
+}
+
+bool SnapshotReader::load(const std::string& path, SnapshotHeader& header,
+                          const EntryCallback& on_entry, size_t threads) {
+    BlockFileReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Failed to open snapshot: " << path << std::endl;
+        return false;
+    }
+    
+    fill_header(reader.properties(), header);
+    
+    return reader.for_each([&on_entry](BlockEntry&& entry) {
+        on_entry(entry.type, std::move(entry.key), std::move(entry.value));
+    }, threads);
+}
+
+} // namespace distributeddb
@@ -0,0 +1,173 @@
+#include "storage/sstable.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+
+namespace distributeddb {
+
+namespace {
+
+// Index of the first block whose max key is >= key, or blocks.size()
+size_t find_block(const std::vector<BlockHandle>& blocks, const std::string& key) {
+    auto it = std::lower_bound(blocks.begin(), blocks.end(), key,
+                               [](const BlockHandle& handle, const std::string& target) {
+                                   return handle.max_key < target;
+                               });
+    return static_cast<size_t>(it - blocks.begin());
+}
+
+size_t find_entry(const std::vector<BlockEntry>& entries, const std::string& key) {
+    auto it = std::lower_bound(entries.begin(), entries.end(), key,
+                               [](const BlockEntry& entry, const std::string& target) {
+                                   return entry.key < target;
+                               });
+    return static_cast<size_t>(it - entries.begin());
+}
+
+// Walks one table block by block; keeps the table alive while in use
+class TableIterator : public EntryIterator {
+public:
+    explicit TableIterator(std::shared_ptr<const SSTable> table)
+        : table_(std::move(table)), block_(0), position_(0), ok_(true) {}
+    
+    void seek(const std::string& target) override {
+        load_block(find_block(table_->reader().blocks(), target));
+        position_ = find_entry(entries_, target);
+        skip_empty_blocks();
+    }
+    
+    void seek_to_first() override {
+        load_block(0);
+        skip_empty_blocks();
+    }
+    
+    bool valid() const override { return ok_ && position_ < entries_.size(); }
+    
+    void next() override {
+        ++position_;
+        skip_empty_blocks();
+    }
+    
+    const std::string& key() const override { return entries_[position_].key; }
+    const std::string& value() const override { return entries_[position_].value; }
+    BlockEntryType type() const override { return entries_[position_].type; }
+    bool ok() const override { return ok_; }
+
+private:
+    void load_block(size_t index) {
+        block_ = index;
+        position_ = 0;
+        entries_.clear();
+        if (block_ < table_->reader().blocks().size() && !table_->reader().read_block(block_, entries_)) {
+            ok_ = false;
+            entries_.clear();
+        }
+    }
+    
+    void skip_empty_blocks() {
+        while (ok_ && position_ >= entries_.size() && block_ < table_->reader().blocks().size()) {
+            load_block(block_ + 1);
+        }
+    }
+    
+    std::shared_ptr<const SSTable> table_;
+    size_t block_;
+    size_t position_;
+    std::vector<BlockEntry> entries_;
+    bool ok_;
+};
+
+} // namespace
+
+// SSTableBuilder implementation
+SSTableBuilder::SSTableBuilder(const std::string& path, const BlockFileOptions& options,
+                               size_t bloom_bits_per_key)
+    : writer_(path, options), filter_(bloom_bits_per_key) {
+}
+
+bool SSTableBuilder::open() {
+    return writer_.open();
+}
+
+bool SSTableBuilder::add(BlockEntryType type, const std::string& key, const std::string& value) {
+    filter_.add(key);
+    return writer_.add(type, key, value);
+}
+
+bool SSTableBuilder::finish() {
+    BlockFileProperties properties;
+    properties.filter = filter_.finish();
+    return writer_.finish(properties);
+}
+
+void SSTableBuilder::abort() {
+    writer_.abort();
+}
+
+// SSTable implementation
+SSTable::SSTable(uint64_t number, const std::string& path)
+    : number_(number), path_(path), obsolete_(false), filter_negatives_(0) {
+}
+
+SSTable::~SSTable() {
+    reader_.close();
+    if (obsolete_) {
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+    }
+}
+
+bool SSTable::open() {
+    if (!reader_.open(path_)) {
+        std::cerr << "Failed to open SSTable: " << path_ << std::endl;
+        return false;
+    }
+    
+    const auto& blocks = reader_.blocks();
+    if (!reader_.properties().sorted && reader_.properties().entry_count > 1) {
+        std::cerr << "SSTable is not sorted: " << path_ << std::endl;
+        return false;
+    }
+    if (!blocks.empty()) {
+        smallest_ = blocks.front().min_key;
+        largest_ = blocks.back().max_key;
+    }
+    return true;
+}
+
+bool SSTable::get(const std::string& key, std::string& value, BlockEntryType& type) const {
+    if (key < smallest_ || largest_ < key) {
+        return false;
+    }
+    
+    if (!BloomFilter::may_contain(reader_.properties().filter, key)) {
+        filter_negatives_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    const auto& blocks = reader_.blocks();
+    size_t index = find_block(blocks, key);
+    if (index >= blocks.size() || key < blocks[index].min_key) {
+        return false;
+    }
+    
+    std::vector<BlockEntry> entries;
+    if (!reader_.read_block(index, entries)) {
+        return false;
+    }
+    
+    size_t position = find_entry(entries, key);
+    if (position >= entries.size() || entries[position].key != key) {
+        return false;
+    }
+    
+    type = entries[position].type;
+    value = std::move(entries[position].value);
+    return true;
+}
+
+std::unique_ptr<EntryIterator> SSTable::new_iterator() const {
+    return std::make_unique<TableIterator>(shared_from_this());
+}
+
+} // namespace distributeddb
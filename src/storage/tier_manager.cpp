@@ -0,0 +1,402 @@
+#include "storage/tier_manager.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+
+namespace distributeddb {
+
+namespace {
+
+constexpr size_t REFERENCE_WORDS = TierManager::REFERENCE_BITS / 64;
+
+// Value log pointers kept by value separation are 21 bytes and must never be
+// spilled or compressed: the value log collector relocates only what it
+// finds in the table
+constexpr uint64_t MIN_SPILL_FLOOR = 64;
+
+bool same_location(const ValuePointer& a, const ValuePointer& b) {
+    return a.segment == b.segment && a.offset == b.offset;
+}
+
+} // namespace
+
+TierManager::TierManager(ShardedTable& table, const TierOptions& options)
+    : table_(table), budget_(options.memory_budget),
+      min_spill_size_(std::max(options.min_spill_size, MIN_SPILL_FLOOR)),
+      compress_min_size_(options.compress_min_size > 0 ? std::max(options.compress_min_size, MIN_SPILL_FLOOR) : 0),
+      spill_(options.spill_log), compressor_(static_cast<int>(options.compress_level), options.compress_dictionary_size),
+      states_(new ShardState[table.shard_count()]), resident_bytes_(0), spilled_keys_(0),
+      evictions_(0), promotions_(0), spill_errors_(0), compressed_keys_(0), compressed_bytes_(0),
+      compressed_raw_bytes_(0), shard_hand_(0) {
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        states_[i].referenced.reset(new std::atomic<uint64_t>[REFERENCE_WORDS]());
+    }
+    if (compress_min_size_ > 0 && !ValueCompressor::supported()) {
+        std::cerr << "Value compression not available in this build, values stay uncompressed" << std::endl;
+        compress_min_size_ = 0;
+    }
+}
+
+TierManager::~TierManager() {
+    close();
+}
+
+bool TierManager::open(const std::string& dir) {
+    dir_ = dir;
+    
+    // Whatever a previous run spilled is in its snapshots and WAL as well
+    std::error_code ec;
+    std::filesystem::remove_all(dir_, ec);
+    if (ec) {
+        std::cerr << "Failed to clear spill directory " << dir_ << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return spill_.open(dir_);
+}
+
+void TierManager::close() {
+    if (dir_.empty()) {
+        return;
+    }
+    
+    spill_.close();
+    std::error_code ec;
+    std::filesystem::remove_all(dir_, ec);
+    dir_.clear();
+}
+
+void TierManager::touch(size_t shard, const std::string& key) const {
+    size_t bit = (hasher_(key) / table_.shard_count()) % REFERENCE_BITS;
+    std::atomic<uint64_t>& word = states_[shard].referenced[bit / 64];
+    uint64_t mask = 1ULL << (bit % 64);
+    
+    // Hot keys find their bit set; skip the write so the line stays shared
+    if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+        word.fetch_or(mask, std::memory_order_relaxed);
+    }
+}
+
+void TierManager::hit(size_t shard, const std::string& key) const {
+    touch(shard, key);
+    states_[shard].hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TierManager::test_and_clear(ShardState& state, const std::string& key) {
+    size_t bit = (hasher_(key) / table_.shard_count()) % REFERENCE_BITS;
+    uint64_t mask = 1ULL << (bit % 64);
+    std::atomic<uint64_t>& word = state.referenced[bit / 64];
+    if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+        return false;
+    }
+    word.fetch_and(~mask, std::memory_order_relaxed);
+    return true;
+}
+
+const ValuePointer* TierManager::find_spilled(size_t shard, const std::string& key) const {
+    const auto& spilled = states_[shard].spilled;
+    auto it = spilled.find(key);
+    return it != spilled.end() ? &it->second : nullptr;
+}
+
+bool TierManager::read(const ValuePointer& pointer, const std::string& key, std::string& stored) const {
+    if (!spill_.read(pointer, key, stored)) {
+        std::cerr << "Failed to read spilled value of key " << key << std::endl;
+        spill_errors_++;
+        return false;
+    }
+    return true;
+}
+
+bool TierManager::is_compressed(const ShardState& state, const std::string& key) const {
+    if (state.compressed.empty()) {
+        return false;
+    }
+    auto it = state.compressed.find(key);
+    return it != state.compressed.end() && it->second.size > 0;
+}
+
+bool TierManager::is_packed(size_t shard, const std::string& key, const std::string& stored) const {
+    return (stored.empty() && find_spilled(shard, key) != nullptr) || is_compressed(states_[shard], key);
+}
+
+bool TierManager::resolve(size_t shard, const std::string& key, std::string& stored) const {
+    PackedEntry from;
+    return unpack(shard, key, stored, from);
+}
+
+bool TierManager::unpack(size_t shard, const std::string& key, std::string& stored, PackedEntry& from) const {
+    from.spilled = false;
+    if (stored.empty()) {
+        const ValuePointer* pointer = find_spilled(shard, key);
+        if (pointer != nullptr) {
+            from.spilled = true;
+            from.pointer = *pointer;
+            if (!read(*pointer, key, stored)) {
+                return false;
+            }
+        }
+    }
+    if (!is_compressed(states_[shard], key)) {
+        return true;
+    }
+    
+    if (!from.spilled) {
+        from.stored = stored;
+    }
+    std::string value;
+    if (!compressor_.decompress(stored, value)) {
+        std::cerr << "Failed to decompress value of key " << key << std::endl;
+        spill_errors_++;
+        return false;
+    }
+    stored.swap(value);
+    return true;
+}
+
+void TierManager::forget(ShardState& state, const std::string& key) {
+    auto it = state.spilled.find(key);
+    if (it != state.spilled.end()) {
+        spill_.mark_dead(key, it->second);
+        state.spilled.erase(it);
+        spilled_keys_--;
+    }
+}
+
+void TierManager::forget_compressed(ShardState& state, const std::string& key) {
+    if (state.compressed.empty()) {
+        return;
+    }
+    auto it = state.compressed.find(key);
+    if (it == state.compressed.end()) {
+        return;
+    }
+    if (it->second.size > 0) {
+        compressed_keys_--;
+        compressed_bytes_ -= it->second.size;
+        compressed_raw_bytes_ -= it->second.raw_size;
+    }
+    state.compressed.erase(it);
+}
+
+void TierManager::changed(size_t shard, const std::string& key, size_t old_size, size_t new_size) {
+    ShardState& state = states_[shard];
+    if (old_size == 0) {
+        forget(state, key);
+    }
+    forget_compressed(state, key);
+    resident_bytes_ += new_size;
+    resident_bytes_ -= old_size;
+    if (new_size > 0) {
+        touch(shard, key);
+    }
+}
+
+void TierManager::promote(size_t shard, const std::string& key, std::string stored, const PackedEntry& from) {
+    ShardState& state = states_[shard];
+    state.misses.fetch_add(1, std::memory_order_relaxed);
+    
+    auto& table_shard = table_.shard(shard);
+    std::unique_lock<std::shared_mutex> lock(table_shard.mutex);
+    auto it = table_shard.data.find(key);
+    if (it == table_shard.data.end()) {
+        return;
+    }
+    if (from.spilled) {
+        auto spilled = state.spilled.find(key);
+        if (!it->second.empty() || spilled == state.spilled.end() || !same_location(spilled->second, from.pointer)) {
+            return;
+        }
+    } else if (!is_compressed(state, key) || it->second != from.stored) {
+        return;
+    }
+    
+    resident_bytes_ += stored.size();
+    resident_bytes_ -= it->second.size();
+    it->second = std::move(stored);
+    forget(state, key);
+    forget_compressed(state, key);
+    touch(shard, key);
+    promotions_++;
+}
+
+uint64_t TierManager::evict(size_t shard, uint64_t bytes) {
+    // Two laps at most: the first may do nothing but clear reference bits
+    return sweep(shard, bytes, 2 * table_.shard(shard).data.bucket_count(), budget_ > 0);
+}
+
+uint64_t TierManager::sweep(size_t shard, uint64_t bytes, size_t buckets, bool spill) {
+    ShardState& state = states_[shard];
+    auto& data = table_.shard(shard).data;
+    size_t bucket_count = data.bucket_count();
+    uint64_t freed = 0;
+    
+    for (size_t visited = 0; freed < bytes && visited < buckets; ++visited) {
+        size_t bucket = state.hand++ % bucket_count;
+        for (auto it = data.begin(bucket); it != data.end(bucket); ++it) {
+            std::string& stored = it->second;
+            bool compress = compress_min_size_ > 0 && stored.size() >= compress_min_size_ &&
+                            state.compressed.find(it->first) == state.compressed.end();
+            if ((!compress && (!spill || stored.size() < min_spill_size_)) || test_and_clear(state, it->first)) {
+                continue;
+            }
+            
+            // A value compressed now is spilled only if it is found cold again
+            if (compress) {
+                std::string packed;
+                if (!compressor_.compress(stored, packed)) {
+                    state.compressed[it->first] = Compressed{0, 0};
+                    continue;
+                }
+                state.compressed[it->first] = Compressed{static_cast<uint32_t>(stored.size()),
+                                                         static_cast<uint32_t>(packed.size())};
+                compressed_keys_++;
+                compressed_bytes_ += packed.size();
+                compressed_raw_bytes_ += stored.size();
+                freed += stored.size() - packed.size();
+                resident_bytes_ -= stored.size() - packed.size();
+                stored.swap(packed);
+                continue;
+            }
+            
+            ValuePointer pointer;
+            if (!spill_.append(it->first, stored, pointer)) {
+                spill_errors_++;
+                return freed;
+            }
+            state.spilled[it->first] = pointer;
+            freed += stored.size();
+            resident_bytes_ -= stored.size();
+            std::string().swap(stored);
+            spilled_keys_++;
+            evictions_++;
+        }
+    }
+    return freed;
+}
+
+void TierManager::compress_cold() {
+    if (compress_min_size_ == 0) {
+        return;
+    }
+    for (size_t shard = 0; shard < table_.shard_count(); ++shard) {
+        std::unique_lock<std::shared_mutex> lock(table_.shard(shard).mutex);
+        sweep(shard, UINT64_MAX, table_.shard(shard).data.bucket_count(), false);
+    }
+}
+
+void TierManager::enforce_budget() {
+    if (!over_budget()) {
+        return;
+    }
+    std::unique_lock<std::mutex> evicting(evict_mutex_, std::try_to_lock);
+    if (!evicting.owns_lock()) {
+        return;
+    }
+    
+    // Give up after a round in which no shard had anything cold enough
+    size_t shards = table_.shard_count();
+    size_t fruitless = 0;
+    while (over_budget() && fruitless < shards) {
+        size_t shard = shard_hand_++ % shards;
+        uint64_t excess = resident_bytes_ - std::min<uint64_t>(budget_, resident_bytes_);
+        
+        std::unique_lock<std::shared_mutex> lock(table_.shard(shard).mutex);
+        fruitless = evict(shard, excess) > 0 ? 0 : fruitless + 1;
+    }
+}
+
+void TierManager::reset() {
+    uint64_t resident = 0;
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        ShardState& state = states_[i];
+        for (const auto& [key, pointer] : state.spilled) {
+            spill_.mark_dead(key, pointer);
+        }
+        state.spilled.clear();
+        state.compressed.clear();
+        for (const auto& [key, stored] : table_.shard(i).data) {
+            resident += stored.size();
+        }
+    }
+    spilled_keys_ = 0;
+    compressed_keys_ = 0;
+    compressed_bytes_ = 0;
+    compressed_raw_bytes_ = 0;
+    resident_bytes_ = resident;
+}
+
+bool TierManager::collect(double min_dead_ratio) {
+    // Bounded so a steady stream of faults cannot keep the caller busy
+    size_t budget = spill_.list_segments().size();
+    for (; budget > 0; --budget) {
+        uint64_t segment = spill_.pick_segment(min_dead_ratio);
+        if (segment == 0) {
+            break;
+        }
+        if (!collect_segment(segment)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TierManager::collect_segment(uint64_t segment) {
+    bool ok = spill_.for_each(segment, [this](const std::string& key, const std::string& value,
+                                              const ValuePointer& pointer) {
+        size_t shard = table_.shard_index(key);
+        ShardState& state = states_[shard];
+        std::unique_lock<std::shared_mutex> lock(table_.shard(shard).mutex);
+        auto it = state.spilled.find(key);
+        if (it == state.spilled.end() || !same_location(it->second, pointer)) {
+            return true;
+        }
+        
+        ValuePointer relocated;
+        if (!spill_.append(key, value, relocated)) {
+            spill_errors_++;
+            return false;
+        }
+        it->second = relocated;
+        return true;
+    });
+    return ok && spill_.remove_segment(segment);
+}
+
+std::unordered_map<std::string, std::string> TierManager::get_stats() const {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    for (size_t i = 0; i < table_.shard_count(); ++i) {
+        hits += states_[i].hits.load(std::memory_order_relaxed);
+        misses += states_[i].misses.load(std::memory_order_relaxed);
+    }
+    
+    std::unordered_map<std::string, std::string> stats;
+    stats["memory_budget"] = std::to_string(budget_);
+    stats["resident_bytes"] = std::to_string(resident_bytes_.load());
+    stats["spilled_keys"] = std::to_string(spilled_keys_.load());
+    stats["hits"] = std::to_string(hits);
+    stats["misses"] = std::to_string(misses);
+    stats["hit_ratio"] = std::to_string(hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0);
+    stats["evictions"] = std::to_string(evictions_.load());
+    stats["promotions"] = std::to_string(promotions_.load());
+    stats["spill_errors"] = std::to_string(spill_errors_.load());
+    for (const auto& [key, value] : spill_.get_stats()) {
+        stats["spill_" + key] = value;
+    }
+    
+    if (compress_min_size_ > 0) {
+        uint64_t packed = compressed_bytes_.load();
+        uint64_t raw = compressed_raw_bytes_.load();
+        stats["compress_min_size"] = std::to_string(compress_min_size_);
+        stats["compressed_keys"] = std::to_string(compressed_keys_.load());
+        stats["compressed_bytes"] = std::to_string(packed);
+        stats["compressed_raw_bytes"] = std::to_string(raw);
+        stats["compression_ratio"] = std::to_string(packed > 0 ? static_cast<double>(raw) / packed : 0.0);
+        for (const auto& [key, value] : compressor_.get_stats()) {
+            stats[key] = value;
+        }
+    }
+    return stats;
+}
+
+} // namespace distributeddb
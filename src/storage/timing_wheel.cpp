@@ -0,0 +1,101 @@
+#include "storage/timing_wheel.h"
+#include <algorithm>
+
+namespace distributeddb {
+
+namespace {
+
+constexpr uint64_t LEVEL_MASK = TimingWheel::SLOTS - 1;
+constexpr size_t WHEEL_BITS = TimingWheel::LEVELS * TimingWheel::SLOT_BITS;
+
+} // namespace
+
+TimingWheel::TimingWheel(uint64_t tick_ms) : tick_ms_(std::max<uint64_t>(tick_ms, 1)), current_tick_(0), count_(0) {
+}
+
+void TimingWheel::reset(uint64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& level : slots_) {
+        for (auto& slot : level) {
+            std::vector<Timer>().swap(slot);
+        }
+    }
+    overflow_.clear();
+    ready_.clear();
+    count_ = 0;
+    current_tick_ = now_ms / tick_ms_;
+}
+
+void TimingWheel::schedule(const std::string& key, uint64_t expire_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    place(Timer{key, expire_ms});
+    count_++;
+}
+
+void TimingWheel::place(Timer&& timer) {
+    // Round up so a timer never fires before its time
+    uint64_t tick = (timer.expire_ms + tick_ms_ - 1) / tick_ms_;
+    if (tick <= current_tick_) {
+        ready_.push_back(std::move(timer));
+        return;
+    }
+    
+    // The highest group of slot bits in which the timer differs from now
+    // picks the level; the timer's own bits there pick the slot
+    uint64_t differ = tick ^ current_tick_;
+    if ((differ >> WHEEL_BITS) != 0) {
+        overflow_.push_back(std::move(timer));
+        return;
+    }
+    size_t level = LEVELS - 1;
+    while (level > 0 && (differ >> (SLOT_BITS * level)) == 0) {
+        level--;
+    }
+    slots_[level][(tick >> (SLOT_BITS * level)) & LEVEL_MASK].push_back(std::move(timer));
+}
+
+size_t TimingWheel::advance(uint64_t now_ms, std::vector<Timer>& due, size_t max_timers) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t target = now_ms / tick_ms_;
+    
+    while (current_tick_ < target && ready_.size() < max_timers) {
+        current_tick_++;
+        
+        // Cascade every level whose lower levels just wrapped, top down
+        if ((current_tick_ & ((1ULL << WHEEL_BITS) - 1)) == 0) {
+            std::vector<Timer> timers;
+            timers.swap(overflow_);
+            for (auto& timer : timers) {
+                place(std::move(timer));
+            }
+        }
+        for (size_t level = LEVELS - 1; level > 0; --level) {
+            if ((current_tick_ & ((1ULL << (SLOT_BITS * level)) - 1)) != 0) {
+                continue;
+            }
+            std::vector<Timer> timers;
+            timers.swap(slots_[level][(current_tick_ >> (SLOT_BITS * level)) & LEVEL_MASK]);
+            for (auto& timer : timers) {
+                place(std::move(timer));
+            }
+        }
+        
+        auto& slot = slots_[0][current_tick_ & LEVEL_MASK];
+        std::move(slot.begin(), slot.end(), std::back_inserter(ready_));
+        std::vector<Timer>().swap(slot);
+    }
+    
+    size_t handed = std::min(max_timers, ready_.size());
+    auto first = ready_.end() - static_cast<std::ptrdiff_t>(handed);
+    std::move(first, ready_.end(), std::back_inserter(due));
+    ready_.erase(first, ready_.end());
+    count_ -= handed;
+    return handed;
+}
+
+size_t TimingWheel::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+} // namespace distributeddb
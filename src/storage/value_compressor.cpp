@@ -0,0 +1,211 @@
+#include "storage/value_compressor.h"
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace distributeddb {
+
+namespace {
+
+// A compressed value: flags, the original size, then the zlib stream
+constexpr uint8_t USES_DICTIONARY = 1;
+constexpr size_t PACKED_HEADER = 1 + 4;
+
+// Each value contributes at most this share of the dictionary, so a few
+// large values cannot crowd out the rest
+constexpr size_t SAMPLES_PER_DICTIONARY = 16;
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+// One deflate and one inflate stream per thread; initializing a stream
+// costs far more than compressing a small value with it
+struct ThreadStreams {
+    z_stream deflater{};
+    z_stream inflater{};
+    int level = -1;
+    bool inflating = false;
+    
+    ~ThreadStreams() {
+        if (level >= 0) {
+            deflateEnd(&deflater);
+        }
+        if (inflating) {
+            inflateEnd(&inflater);
+        }
+    }
+    
+    z_stream* deflate_stream(int wanted) {
+        if (level == wanted) {
+            return deflateReset(&deflater) == Z_OK ? &deflater : nullptr;
+        }
+        if (level >= 0) {
+            deflateEnd(&deflater);
+            level = -1;
+        }
+        deflater = z_stream{};
+        if (deflateInit(&deflater, wanted) != Z_OK) {
+            return nullptr;
+        }
+        level = wanted;
+        return &deflater;
+    }
+    
+    z_stream* inflate_stream() {
+        if (inflating) {
+            return inflateReset(&inflater) == Z_OK ? &inflater : nullptr;
+        }
+        inflater = z_stream{};
+        if (inflateInit(&inflater) != Z_OK) {
+            return nullptr;
+        }
+        inflating = true;
+        return &inflater;
+    }
+};
+
+thread_local ThreadStreams streams;
+#endif
+
+} // namespace
+
+ValueCompressor::ValueCompressor(int level, size_t dictionary_size)
+    : level_(std::min(std::max(level, 1), 9)), dictionary_size_(std::min<size_t>(dictionary_size, 32 * 1024)),
+      dictionary_ready_(false), compressions_(0), compress_ns_(0), decompressions_(0), decompress_ns_(0) {
+}
+
+bool ValueCompressor::supported() {
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ValueCompressor::sample(const std::string& value) {
+    std::lock_guard<std::mutex> lock(sample_mutex_);
+    if (dictionary_ready_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    
+    size_t take = std::min(value.size(), std::max<size_t>(dictionary_size_ / SAMPLES_PER_DICTIONARY, 1));
+    samples_.append(value, 0, std::min(take, dictionary_size_ - samples_.size()));
+    if (samples_.size() >= dictionary_size_) {
+        dictionary_.swap(samples_);
+        dictionary_ready_.store(true, std::memory_order_release);
+    }
+}
+
+bool ValueCompressor::compress(const std::string& value, std::string& packed) {
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+    if (value.size() > UINT32_MAX) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    
+    bool use_dictionary = dictionary_ready_.load(std::memory_order_acquire);
+    if (!use_dictionary && dictionary_size_ > 0) {
+        sample(value);
+    }
+    
+    z_stream* stream = streams.deflate_stream(level_);
+    if (stream == nullptr) {
+        return false;
+    }
+    if (use_dictionary &&
+        deflateSetDictionary(stream, reinterpret_cast<const Bytef*>(dictionary_.data()),
+                             static_cast<uInt>(dictionary_.size())) != Z_OK) {
+        return false;
+    }
+    
+    // Anything not at least 1/8 smaller is kept as it is
+    size_t limit = value.size() - value.size() / 8;
+    if (limit <= PACKED_HEADER) {
+        return false;
+    }
+    packed.resize(limit);
+    packed[0] = static_cast<char>(use_dictionary ? USES_DICTIONARY : 0);
+    uint32_t raw_size = static_cast<uint32_t>(value.size());
+    std::memcpy(&packed[1], &raw_size, sizeof(raw_size));
+    
+    stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(value.data()));
+    stream->avail_in = static_cast<uInt>(value.size());
+    stream->next_out = reinterpret_cast<Bytef*>(&packed[PACKED_HEADER]);
+    stream->avail_out = static_cast<uInt>(limit - PACKED_HEADER);
+    int status = deflate(stream, Z_FINISH);
+    
+    compressions_.fetch_add(1, std::memory_order_relaxed);
+    compress_ns_.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+    if (status != Z_STREAM_END) {
+        return false;
+    }
+    packed.resize(limit - stream->avail_out);
+    packed.shrink_to_fit();
+    return true;
+#else
+    (void)value;
+    (void)packed;
+    return false;
+#endif
+}
+
+bool ValueCompressor::decompress(const std::string& packed, std::string& value) const {
+#ifdef DISTRIBUTEDDB_HAVE_ZLIB
+    if (packed.size() < PACKED_HEADER) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    
+    bool use_dictionary = (static_cast<uint8_t>(packed[0]) & USES_DICTIONARY) != 0;
+    uint32_t raw_size;
+    std::memcpy(&raw_size, &packed[1], sizeof(raw_size));
+    
+    z_stream* stream = streams.inflate_stream();
+    if (stream == nullptr || (use_dictionary && !dictionary_ready_.load(std::memory_order_acquire))) {
+        return false;
+    }
+    
+    value.resize(raw_size);
+    stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(packed.data() + PACKED_HEADER));
+    stream->avail_in = static_cast<uInt>(packed.size() - PACKED_HEADER);
+    stream->next_out = reinterpret_cast<Bytef*>(&value[0]);
+    stream->avail_out = raw_size;
+    
+    int status = inflate(stream, Z_FINISH);
+    if (status == Z_NEED_DICT && use_dictionary) {
+        if (inflateSetDictionary(stream, reinterpret_cast<const Bytef*>(dictionary_.data()),
+                                 static_cast<uInt>(dictionary_.size())) != Z_OK) {
+            return false;
+        }
+        status = inflate(stream, Z_FINISH);
+    }
+    
+    decompressions_.fetch_add(1, std::memory_order_relaxed);
+    decompress_ns_.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+    return status == Z_STREAM_END && stream->avail_out == 0;
+#else
+    (void)packed;
+    (void)value;
+    return false;
+#endif
+}
+
+std::unordered_map<std::string, std::string> ValueCompressor::get_stats() const {
+    std::unordered_map<std::string, std::string> stats;
+    stats["compress_level"] = std::to_string(level_);
+    stats["dictionary_bytes"] = std::to_string(dictionary_ready_.load() ? dictionary_.size() : 0);
+    stats["compressions"] = std::to_string(compressions_.load());
+    stats["compress_us"] = std::to_string(compress_ns_.load() / 1000);
+    stats["decompressions"] = std::to_string(decompressions_.load());
+    stats["decompress_us"] = std::to_string(decompress_ns_.load() / 1000);
+    return stats;
+}
+
+} // namespace distributeddb
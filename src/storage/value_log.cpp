@@ -0,0 +1,419 @@
+#include "storage/value_log.h"
+#include "storage/checksum.h"
+#include "storage/block_file.h"
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace distributeddb {
+
+namespace {
+
+// u32 crc | u32 key_len | u32 value_len
+constexpr size_t RECORD_HEADER_SIZE = 4 + 4 + 4;
+
+const char* const SEGMENT_PREFIX = "vlog_";
+const char* const SEGMENT_SUFFIX = ".log";
+
+uint64_t record_size(size_t key_size, uint32_t value_size) {
+    return RECORD_HEADER_SIZE + key_size + value_size;
+}
+
+bool pwrite_all(int fd, const char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+bool pread_all(int fd, char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t got = ::pread(fd, data, length, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        length -= static_cast<size_t>(got);
+        offset += static_cast<uint64_t>(got);
+    }
+    return true;
+}
+
+} // namespace
+
+ValueLog::Segment::~Segment() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+ValueLog::ValueLog(const ValueLogOptions& options)
+    : options_(options), active_id_(0), next_segment_(1), removed_segments_(0), removed_bytes_(0) {
+}
+
+ValueLog::~ValueLog() {
+    close();
+}
+
+bool ValueLog::open(const std::string& dir) {
+    dir_ = dir;
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if (ec) {
+        std::cerr << "Failed to create value log directory " << dir_ << ": " << ec.message() << std::endl;
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            // Leftover of an interrupted import
+            std::filesystem::remove(entry.path(), ec);
+            continue;
+        }
+        
+        uint64_t id = parse_segment_name(name);
+        if (id == 0) continue;
+        if (!open_segment(id, false)) {
+            return false;
+        }
+        next_segment_ = std::max(next_segment_, id + 1);
+    }
+    
+    // Appends always go to a fresh segment, so a torn tail left by a crash
+    // stays at the end of a closed one
+    return rotate_locked();
+}
+
+void ValueLog::close() {
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    if (active_ && active_->size == 0) {
+        std::error_code ec;
+        std::filesystem::remove(active_->path, ec);
+    } else if (active_) {
+        ::fdatasync(active_->fd);
+    }
+    active_.reset();
+    active_id_ = 0;
+    
+    std::unique_lock<std::shared_mutex> segments_lock(segments_mutex_);
+    segments_.clear();
+}
+
+bool ValueLog::append(const std::string& key, const std::string& value, ValuePointer& pointer) {
+    uint32_t key_length = static_cast<uint32_t>(key.size());
+    uint32_t value_length = static_cast<uint32_t>(value.size());
+    
+    std::string record(record_size(key.size(), value_length), '\0');
+    char* p = record.data();
+    std::memcpy(p + 4, &key_length, 4);
+    std::memcpy(p + 8, &value_length, 4);
+    std::memcpy(p + RECORD_HEADER_SIZE, key.data(), key.size());
+    std::memcpy(p + RECORD_HEADER_SIZE + key.size(), value.data(), value.size());
+    uint32_t crc = crc32c(p + 4, record.size() - 4);
+    std::memcpy(p, &crc, 4);
+    
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    if (!active_) {
+        return false;
+    }
+    if (active_->size > 0 && active_->size + record.size() > options_.segment_size && !rotate_locked()) {
+        return false;
+    }
+    
+    uint64_t offset = active_->size;
+    if (!pwrite_all(active_->fd, record.data(), record.size(), offset)) {
+        std::cerr << "Failed to append to value log " << active_->path << std::endl;
+        return false;
+    }
+    if (options_.sync_writes && ::fdatasync(active_->fd) != 0) {
+        return false;
+    }
+    
+    active_->size += record.size();
+    active_->live_bytes += record.size();
+    pointer.segment = active_->id;
+    pointer.offset = offset;
+    pointer.size = value_length;
+    return true;
+}
+
+bool ValueLog::read(const ValuePointer& pointer, const std::string& key, std::string& value) const {
+    auto segment = pin(pointer.segment);
+    if (!segment) {
+        return false;
+    }
+    
+    std::string record(record_size(key.size(), pointer.size), '\0');
+    if (!pread_all(segment->fd, record.data(), record.size(), pointer.offset)) {
+        return false;
+    }
+    
+    const char* p = record.data();
+    uint32_t crc, key_length, value_length;
+    std::memcpy(&crc, p, 4);
+    std::memcpy(&key_length, p + 4, 4);
+    std::memcpy(&value_length, p + 8, 4);
+    if (key_length != key.size() || value_length != pointer.size ||
+        crc32c(p + 4, record.size() - 4) != crc ||
+        std::memcmp(p + RECORD_HEADER_SIZE, key.data(), key.size()) != 0) {
+        std::cerr << "Corrupt value log record in " << segment->path << " at offset "
+                  << pointer.offset << std::endl;
+        return false;
+    }
+    
+    value.assign(p + RECORD_HEADER_SIZE + key.size(), pointer.size);
+    return true;
+}
+
+void ValueLog::mark_live(const std::string& key, const ValuePointer& pointer) {
+    if (auto segment = pin(pointer.segment)) {
+        segment->live_bytes += record_size(key.size(), pointer.size);
+    }
+}
+
+void ValueLog::mark_dead(const std::string& key, const ValuePointer& pointer) {
+    if (auto segment = pin(pointer.segment)) {
+        uint64_t bytes = record_size(key.size(), pointer.size);
+        uint64_t live = segment->live_bytes.load();
+        while (!segment->live_bytes.compare_exchange_weak(live, live - std::min(live, bytes))) {}
+    }
+}
+
+uint64_t ValueLog::pick_segment(double min_dead_ratio) const {
+    uint64_t active = active_segment();
+    uint64_t best = 0;
+    double best_ratio = 0.0;
+    
+    std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+    for (const auto& [id, segment] : segments_) {
+        uint64_t size = segment->size;
+        uint64_t live = std::min(segment->live_bytes.load(), size);
+        if (id == active || size == live) continue;
+        
+        double ratio = static_cast<double>(size - live) / static_cast<double>(size);
+        if (ratio >= min_dead_ratio && ratio > best_ratio) {
+            best = id;
+            best_ratio = ratio;
+        }
+    }
+    return best;
+}
+
+bool ValueLog::for_each(uint64_t segment_id,
+                        const std::function<bool(const std::string& key, const std::string& value,
+                                                 const ValuePointer& pointer)>& fn) const {
+    auto segment = pin(segment_id);
+    if (!segment || segment_id == active_segment()) {
+        return false;
+    }
+    
+    std::ifstream in(segment->path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Failed to open " << segment->path << std::endl;
+        return false;
+    }
+    
+    uint64_t offset = 0;
+    std::string key, value;
+    char header[RECORD_HEADER_SIZE];
+    while (in.read(header, RECORD_HEADER_SIZE)) {
+        uint32_t crc, key_length, value_length;
+        std::memcpy(&crc, header, 4);
+        std::memcpy(&key_length, header + 4, 4);
+        std::memcpy(&value_length, header + 8, 4);
+        if (record_size(key_length, value_length) > segment->size - offset) {
+            break;
+        }
+        
+        key.resize(key_length);
+        value.resize(value_length);
+        if (!in.read(key.data(), key_length) || !in.read(value.data(), value_length)) {
+            break;
+        }
+        uint32_t actual = crc32c(header + 4, RECORD_HEADER_SIZE - 4);
+        actual = crc32c(key.data(), key.size(), actual);
+        actual = crc32c(value.data(), value.size(), actual);
+        if (actual != crc) {
+            break;
+        }
+        
+        ValuePointer pointer;
+        pointer.segment = segment_id;
+        pointer.offset = offset;
+        pointer.size = value_length;
+        if (!fn(key, value, pointer)) {
+            return false;
+        }
+        offset += record_size(key_length, value_length);
+    }
+    return true;
+}
+
+bool ValueLog::remove_segment(uint64_t segment_id) {
+    std::shared_ptr<Segment> segment;
+    {
+        std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+        auto it = segments_.find(segment_id);
+        if (it == segments_.end() || segment_id == active_id_) {
+            return false;
+        }
+        segment = it->second;
+        segments_.erase(it);
+    }
+    
+    std::error_code ec;
+    std::filesystem::remove(segment->path, ec);
+    if (ec) {
+        std::cerr << "Failed to remove value log segment " << segment->path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    removed_segments_++;
+    removed_bytes_ += segment->size;
+    return true;
+}
+
+bool ValueLog::rotate() {
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    return rotate_locked();
+}
+
+bool ValueLog::sync() {
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    return active_ && ::fdatasync(active_->fd) == 0;
+}
+
+uint64_t ValueLog::import_segment(const std::string& path) {
+    std::lock_guard<std::mutex> lock(append_mutex_);
+    uint64_t id = next_segment_++;
+    std::string target = segment_path(id);
+    
+    // Copy under a temporary name so a crash never leaves a partial segment
+    std::error_code ec;
+    std::filesystem::copy_file(path, target + ".tmp", std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec || !sync_path(target + ".tmp")) {
+        std::cerr << "Failed to import value log segment " << path << std::endl;
+        std::filesystem::remove(target + ".tmp", ec);
+        return 0;
+    }
+    std::filesystem::rename(target + ".tmp", target, ec);
+    if (ec || !sync_path(dir_) || !open_segment(id, false)) {
+        return 0;
+    }
+    return id;
+}
+
+std::vector<uint64_t> ValueLog::list_segments() const {
+    std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+    std::vector<uint64_t> ids;
+    ids.reserve(segments_.size());
+    for (const auto& [id, segment] : segments_) {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+uint64_t ValueLog::active_segment() const {
+    return active_id_;
+}
+
+std::string ValueLog::segment_path(uint64_t segment) const {
+    return dir_ + "/" + SEGMENT_PREFIX + std::to_string(segment) + SEGMENT_SUFFIX;
+}
+
+uint64_t ValueLog::parse_segment_name(const std::string& name) {
+    const size_t prefix = std::strlen(SEGMENT_PREFIX);
+    const size_t suffix = std::strlen(SEGMENT_SUFFIX);
+    if (name.size() <= prefix + suffix || name.compare(0, prefix, SEGMENT_PREFIX) != 0 ||
+        name.compare(name.size() - suffix, suffix, SEGMENT_SUFFIX) != 0) {
+        return 0;
+    }
+    
+    std::string digits = name.substr(prefix, name.size() - prefix - suffix);
+    if (digits.find_first_not_of("0123456789") != std::string::npos) {
+        return 0;
+    }
+    return std::stoull(digits);
+}
+
+std::unordered_map<std::string, std::string> ValueLog::get_stats() const {
+    uint64_t bytes = 0;
+    uint64_t live = 0;
+    size_t count = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+        for (const auto& [id, segment] : segments_) {
+            uint64_t size = segment->size;
+            bytes += size;
+            live += std::min(segment->live_bytes.load(), size);
+        }
+        count = segments_.size();
+    }
+    
+    std::unordered_map<std::string, std::string> stats;
+    stats["segments"] = std::to_string(count);
+    stats["bytes"] = std::to_string(bytes);
+    stats["live_bytes"] = std::to_string(live);
+    stats["dead_bytes"] = std::to_string(bytes - live);
+    stats["removed_segments"] = std::to_string(removed_segments_.load());
+    stats["removed_bytes"] = std::to_string(removed_bytes_.load());
+    return stats;
+}
+
+std::shared_ptr<ValueLog::Segment> ValueLog::pin(uint64_t segment) const {
+    std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+    auto it = segments_.find(segment);
+    return it == segments_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<ValueLog::Segment> ValueLog::open_segment(uint64_t segment, bool create) {
+    std::string path = segment_path(segment);
+    int flags = create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY;
+    int fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open value log segment " << path << std::endl;
+        return nullptr;
+    }
+    
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    
+    auto file = std::make_shared<Segment>(segment, path, fd, static_cast<uint64_t>(st.st_size));
+    std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+    segments_[segment] = file;
+    return file;
+}
+
+bool ValueLog::rotate_locked() {
+    if (active_ && ::fdatasync(active_->fd) != 0) {
+        std::cerr << "Failed to close value log segment " << active_->path << std::endl;
+        return false;
+    }
+    
+    auto segment = open_segment(next_segment_, true);
+    if (!segment) {
+        return false;
+    }
+    next_segment_++;
+    active_ = segment;
+    active_id_ = segment->id;
+    return sync_path(dir_);
+}
+
+} // namespace distributeddb
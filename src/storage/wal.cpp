@@ -3,6 +3,7 @@
 #include <filesystem>
 #include <chrono>
 #include <cstring>
+#include <algorithm>
 
 namespace distributeddb {
 
@@ -13,6 +14,11 @@ std::vector<uint8_t> WALRecord::serialize() const {
     // Write header
     data.push_back(static_cast<uint8_t>(type));
     
+    // Write LSN
+    uint8_t lsn_bytes[8];
+    std::memcpy(lsn_bytes, &lsn, sizeof(lsn));
+    data.insert(data.end(), lsn_bytes, lsn_bytes + 8);
+    
     // Write timestamp
     uint8_t timestamp_bytes[8];
     std::memcpy(timestamp_bytes, &timestamp, sizeof(timestamp));
@@ -42,8 +48,10 @@ std::vector<uint8_t> WALRecord::serialize() const {
     return data;
 }
 
-WALRecord WALRecord::deserialize(const std::vector<uint8_t>& data) {
-    if (data.size() < 25) { // Minimum header size
+WALRecord WALRecord::deserialize(const std::vector<uint8_t>& data, uint32_t format) {
+    // Version 1 has no LSN
+    size_t header_size = format == 1 ? 25 : 33;
+    if (data.size() < header_size) { // Minimum header size
         throw std::runtime_error("Invalid WAL record: too short");
     }
     
@@ -53,6 +61,12 @@ WALRecord WALRecord::deserialize(const std::vector<uint8_t>& data) {
     // Read type
     record.type = static_cast<WALRecordType>(data[offset++]);
     
+    // Read LSN
+    if (format != 1) {
+        std::memcpy(&record.lsn, &data[offset], sizeof(record.lsn));
+        offset += 8;
+    }
+    
     // Read timestamp
     std::memcpy(&record.timestamp, &data[offset], sizeof(record.timestamp));
     offset += 8;
@@ -85,16 +99,43 @@ WALRecord WALRecord::deserialize(const std::vector<uint8_t>& data) {
 }
 
 size_t WALRecord::size() const {
-    return sizeof(WALRecordType) + sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2 + 
+    return sizeof(WALRecordType) + sizeof(uint64_t) * 3 + sizeof(uint32_t) * 2 + 
            key_length + value_length;
 }
 
 WriteAheadLog::WriteAheadLog(const std::string& log_dir) 
-    : log_dir_(log_dir), total_records_(0), total_bytes_(0) {
+    : log_dir_(log_dir), total_records_(0), total_bytes_(0), current_segment_(0), next_lsn_(1) {
     
     // Create log directory if it doesn't exist
     std::filesystem::create_directories(log_dir_);
     
+    // Continue numbering after any segments left by a previous run
+    auto segments = list_segments();
+    current_segment_ = segments.empty() ? 1 : segments.back() + 1;
+    
+    // Refuse a log this build cannot read before anything is replayed from it
+    for (uint64_t segment_id : segments) {
+        segment_format(segment_path(segment_id));
+    }
+    
+    // Resume LSNs after the last record of the newest non-empty segment.
+    // Version 1 records are numbered by reading from the first segment, so
+    // a log that still has them is counted whole.
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        std::vector<WALRecord> tail;
+        if (segment_format(segment_path(*it)) == 1) {
+            for (uint64_t segment_id : segments) {
+                read_segment(segment_path(segment_id), tail);
+            }
+        } else {
+            read_segment(segment_path(*it), tail);
+        }
+        if (!tail.empty()) {
+            next_lsn_ = tail.back().lsn + 1;
+            break;
+        }
+    }
+    
     // Open new log file
     open_new_log_file();
     
@@ -107,7 +148,7 @@ WriteAheadLog::~WriteAheadLog() {
     }
 }
 
-bool WriteAheadLog::append_record(const WALRecord& record) {
+bool WriteAheadLog::append_record(const WALRecord& record, uint64_t* assigned_lsn) {
     std::lock_guard<std::mutex> lock(mutex_);
     
     try {
@@ -116,6 +157,7 @@ bool WriteAheadLog::append_record(const WALRecord& record) {
         if (record_with_timestamp.timestamp == 0) {
             record_with_timestamp.timestamp = get_current_timestamp();
         }
+        record_with_timestamp.lsn = next_lsn_;
         
         // Write record to file
         if (!write_record_to_file(record_with_timestamp)) {
@@ -123,6 +165,10 @@ bool WriteAheadLog::append_record(const WALRecord& record) {
         }
         
         // Update statistics
+        if (assigned_lsn) {
+            *assigned_lsn = next_lsn_;
+        }
+        next_lsn_++;
         total_records_++;
         total_bytes_ += record_with_timestamp.size();
         
@@ -137,56 +183,24 @@ bool WriteAheadLog::append_record(const WALRecord& record) {
 }
 
 std::vector<WALRecord> WriteAheadLog::read_all_records() {
+    return read_records_from(0);
+}
+
+std::vector<WALRecord> WriteAheadLog::read_records_from(uint64_t first_segment) {
     std::lock_guard<std::mutex> lock(mutex_);
     std::vector<WALRecord> records;
     
     try {
-        // Close current file and reopen for reading
-        log_file_.close();
-        std::ifstream read_file(current_log_file_, std::ios::binary);
-        
-        if (!read_file.is_open()) {
-            std::cerr << "Failed to open WAL file for reading: " << current_log_file_ << std::endl;
-            return records;
+        // Make sure everything appended so far is visible to the reader
+        if (log_file_.is_open()) {
+            log_file_.flush();
         }
         
-        // Read records
-        while (read_file.good()) {
-            // Read record size (4 bytes)
-            uint32_t record_size;
-            read_file.read(reinterpret_cast<char*>(&record_size), sizeof(record_size));
-            
-            if (read_file.eof()) break;
-            
-            if (record_size > 1024 * 1024) { // 1MB limit
-                std::cerr << "WAL record too large: " << record_size << " bytes" << std::endl;
-                break;
-            }
-            
-            // Read record data
-            std::vector<uint8_t> data(record_size);
-            read_file.read(reinterpret_cast<char*>(data.data()), record_size);
-            
-            if (read_file.gcount() != static_cast<std::streamsize>(record_size)) {
-                std::cerr << "Failed to read complete WAL record" << std::endl;
-                break;
-            }
-            
-            // Deserialize record
-            try {
-                WALRecord record = WALRecord::deserialize(data);
-                records.push_back(record);
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to deserialize WAL record: " << e.what() << std::endl;
-                break;
-            }
+        for (uint64_t segment_id : list_segments()) {
+            if (segment_id < first_segment) continue;
+            read_segment(segment_path(segment_id), records);
         }
         
-        read_file.close();
-        
-        // Reopen for writing
-        log_file_.open(current_log_file_, std::ios::binary | std::ios::app);
-        
     } catch (const std::exception& e) {
         std::cerr << "WAL read error: " << e.what() << std::endl;
     }
@@ -194,6 +208,53 @@ std::vector<WALRecord> WriteAheadLog::read_all_records() {
     return records;
 }
 
+void WriteAheadLog::read_segment(const std::string& path, std::vector<WALRecord>& records) {
+    std::ifstream read_file(path, std::ios::binary);
+    
+    if (!read_file.is_open()) {
+        std::cerr << "Failed to open WAL file for reading: " << path << std::endl;
+        return;
+    }
+    
+    uint32_t format = read_segment_header(read_file, path);
+    
+    // Read records
+    while (read_file.good()) {
+        // Read record size (4 bytes)
+        uint32_t record_size;
+        read_file.read(reinterpret_cast<char*>(&record_size), sizeof(record_size));
+        
+        if (read_file.eof()) break;
+        
+        if (record_size > 1024 * 1024 + 1024) { // 1MB value plus header and key
+            std::cerr << "WAL record too large: " << record_size << " bytes" << std::endl;
+            break;
+        }
+        
+        // Read record data
+        std::vector<uint8_t> data(record_size);
+        read_file.read(reinterpret_cast<char*>(data.data()), record_size);
+        
+        if (read_file.gcount() != static_cast<std::streamsize>(record_size)) {
+            // Torn write at the tail of a segment, later segments are still valid
+            std::cerr << "Failed to read complete WAL record in " << path << std::endl;
+            break;
+        }
+        
+        // Deserialize record
+        try {
+            WALRecord record = WALRecord::deserialize(data, format);
+            if (format == 1) {
+                record.lsn = records.empty() ? 1 : records.back().lsn + 1;
+            }
+            records.push_back(std::move(record));
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to deserialize WAL record: " << e.what() << std::endl;
+            break;
+        }
+    }
+}
+
 bool WriteAheadLog::create_checkpoint(const std::string& checkpoint_file) {
     std::lock_guard<std::mutex> lock(mutex_);
     
@@ -204,11 +265,13 @@ bool WriteAheadLog::create_checkpoint(const std::string& checkpoint_file) {
         checkpoint_record.timestamp = get_current_timestamp();
         checkpoint_record.key = checkpoint_file;
         checkpoint_record.key_length = static_cast<uint32_t>(checkpoint_file.length());
+        checkpoint_record.lsn = next_lsn_;
         
         // Write checkpoint record
         if (!write_record_to_file(checkpoint_record)) {
             return false;
         }
+        next_lsn_++;
         
         // Flush to disk
         log_file_.flush();
@@ -223,8 +286,6 @@ bool WriteAheadLog::create_checkpoint(const std::string& checkpoint_file) {
 }
 
 bool WriteAheadLog::recover_from_checkpoint(const std::string& checkpoint_file) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     try {
         // Read all records from WAL
         auto records = read_all_records();
@@ -270,6 +331,9 @@ std::unordered_map<std::string, std::string> WriteAheadLog::get_stats() const {
     stats["total_records"] = std::to_string(total_records_);
     stats["total_bytes"] = std::to_string(total_bytes_);
     stats["log_file_open"] = log_file_.is_open() ? "true" : "false";
+    stats["current_segment"] = std::to_string(current_segment_);
+    stats["next_lsn"] = std::to_string(next_lsn_);
+    stats["segment_count"] = std::to_string(list_segments().size());
     
     return stats;
 }
@@ -282,10 +346,18 @@ bool WriteAheadLog::truncate_log() {
         log_file_.close();
         
         // Create new log file
+        current_segment_++;
         if (!open_new_log_file()) {
             return false;
         }
         
+        // Drop every older segment. Only safe once a snapshot covers them.
+        for (uint64_t segment_id : list_segments()) {
+            if (segment_id < current_segment_) {
+                std::filesystem::remove(segment_path(segment_id));
+            }
+        }
+        
         // Reset statistics
         total_records_ = 0;
         total_bytes_ = 0;
@@ -306,14 +378,103 @@ void WriteAheadLog::flush() {
     }
 }
 
-bool WriteAheadLog::open_new_log_file() {
+bool WriteAheadLog::rotate_segment() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     try {
-        // Generate new log file name with timestamp
-        auto now = std::chrono::system_clock::now();
-        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now.time_since_epoch()).count();
+        if (log_file_.is_open()) {
+            log_file_.flush();
+            log_file_.close();
+        }
+        
+        current_segment_++;
+        return open_new_log_file();
         
-        current_log_file_ = log_dir_ + "/wal_" + std::to_string(timestamp) + ".log";
+    } catch (const std::exception& e) {
+        std::cerr << "WAL rotate error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+uint64_t WriteAheadLog::current_segment() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_segment_;
+}
+
+size_t WriteAheadLog::remove_segments_before(uint64_t segment_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t removed = 0;
+    
+    // Never delete the segment we are appending to
+    segment_id = std::min(segment_id, current_segment_);
+    
+    for (uint64_t id : list_segments()) {
+        if (id >= segment_id) break;
+        
+        std::error_code ec;
+        if (std::filesystem::remove(segment_path(id), ec)) {
+            removed++;
+        } else if (ec) {
+            std::cerr << "Failed to remove WAL segment " << id << ": " << ec.message() << std::endl;
+        }
+    }
+    
+    return removed;
+}
+
+uint64_t WriteAheadLog::next_lsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return next_lsn_;
+}
+
+void WriteAheadLog::advance_lsn(uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_lsn_ = std::max(next_lsn_, lsn);
+}
+
+uint64_t WriteAheadLog::get_total_records() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_records_;
+}
+
+uint64_t WriteAheadLog::get_total_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_bytes_;
+}
+
+std::vector<uint64_t> WriteAheadLog::list_segments() const {
+    std::vector<uint64_t> segments;
+    
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(log_dir_, ec)) {
+        std::string name = entry.path().filename().string();
+        
+        // Expect wal_<id>.log
+        if (name.size() <= 8 || name.compare(0, 4, "wal_") != 0 ||
+            name.compare(name.size() - 4, 4, ".log") != 0) {
+            continue;
+        }
+        
+        std::string id = name.substr(4, name.size() - 8);
+        if (id.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        
+        segments.push_back(std::stoull(id));
+    }
+    
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+std::string WriteAheadLog::segment_path(uint64_t segment_id) const {
+    return log_dir_ + "/wal_" + std::to_string(segment_id) + ".log";
+}
+
+bool WriteAheadLog::open_new_log_file() {
+    try {
+        // Segment files are named by a monotonically increasing sequence number
+        current_log_file_ = segment_path(current_segment_);
         
         // Open file for writing
         log_file_.open(current_log_file_, std::ios::binary | std::ios::app);
@@ -323,7 +484,15 @@ bool WriteAheadLog::open_new_log_file() {
             return false;
         }
         
-        return true;
+        // A new segment starts with its header
+        std::error_code ec;
+        if (std::filesystem::file_size(current_log_file_, ec) == 0 && !ec) {
+            uint32_t header[2] = {WAL_SEGMENT_MAGIC, WAL_FORMAT_VERSION};
+            log_file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+            log_file_.flush();
+        }
+        
+        return log_file_.good();
         
     } catch (const std::exception& e) {
         std::cerr << "WAL file open error: " << e.what() << std::endl;
@@ -331,6 +500,28 @@ bool WriteAheadLog::open_new_log_file() {
     }
 }
 
+uint32_t WriteAheadLog::read_segment_header(std::ifstream& in, const std::string& path) {
+    uint32_t header[2] = {0, 0};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (in.gcount() == static_cast<std::streamsize>(sizeof(header)) && header[0] == WAL_SEGMENT_MAGIC) {
+        if (header[1] == 0 || header[1] > WAL_FORMAT_VERSION) {
+            throw std::runtime_error("WAL segment " + path + " has format version " + std::to_string(header[1]) +
+                                     ", this build reads versions up to " + std::to_string(WAL_FORMAT_VERSION));
+        }
+        return header[1];
+    }
+    
+    // No header: the whole file is version 1 records
+    in.clear();
+    in.seekg(0);
+    return 1;
+}
+
+uint32_t WriteAheadLog::segment_format(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return in.is_open() ? read_segment_header(in, path) : WAL_FORMAT_VERSION;
+}
+
 uint64_t WriteAheadLog::get_current_timestamp() const {
     auto now = std::chrono::system_clock::now();
     return std::chrono::duration_cast<std::chrono::milliseconds>(
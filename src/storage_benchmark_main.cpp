@@ -0,0 +1,319 @@
+#include "storage/memtable.h"
+#include "storage/art.h"
+#include "storage/btree.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <map>
+#include <cstdio>
+
+using namespace distributeddb;
+
+namespace {
+
+std::string make_key(uint64_t i) {
+    // Scramble so inserts land all over the key space
+    uint64_t x = i * 0x9e3779b97f4a7c15ULL;
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "key%016llx", static_cast<unsigned long long>(x));
+    return buffer;
+}
+
+// Runs fn(thread, begin, end) over [0, operations) split across threads; returns ops/sec
+double run_parallel(int threads, uint64_t operations,
+                    const std::function<void(int, uint64_t, uint64_t)>& fn) {
+    std::vector<std::thread> pool;
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    uint64_t per_thread = operations / threads;
+    for (int t = 0; t < threads; ++t) {
+        uint64_t begin = t * per_thread;
+        uint64_t end = (t == threads - 1) ? operations : begin + per_thread;
+        pool.emplace_back([&fn, t, begin, end]() { fn(t, begin, end); });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return seconds > 0 ? operations / seconds : 0.0;
+}
+
+struct Result {
+    double insert_ops;
+    double lookup_ops;
+};
+
+Result bench_locked_map(int threads, uint64_t operations, const std::string& value) {
+    std::unordered_map<std::string, std::string> map;
+    std::mutex mutex;
+    std::atomic<uint64_t> found(0);
+    
+    Result result;
+    result.insert_ops = run_parallel(threads, operations, [&](int, uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            std::string key = make_key(i);
+            std::lock_guard<std::mutex> lock(mutex);
+            map[key] = value;
+        }
+    });
+    result.lookup_ops = run_parallel(threads, operations, [&](int, uint64_t begin, uint64_t end) {
+        uint64_t hits = 0;
+        for (uint64_t i = begin; i < end; ++i) {
+            std::string key = make_key(i);
+            std::lock_guard<std::mutex> lock(mutex);
+            hits += map.count(key);
+        }
+        found += hits;
+    });
+    
+    if (found != operations) {
+        std::cerr << "unordered_map lookup mismatch: " << found << " of " << operations << std::endl;
+    }
+    return result;
+}
+
+Result bench_skiplist(int threads, uint64_t operations, const std::string& value) {
+    MemTable table(0);
+    std::atomic<uint64_t> found(0);
+    
+    Result result;
+    result.insert_ops = run_parallel(threads, operations, [&](int, uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            table.add(BlockEntryType::PUT, make_key(i), value, i + 1);
+        }
+    });
+    result.lookup_ops = run_parallel(threads, operations, [&](int, uint64_t begin, uint64_t end) {
+        uint64_t hits = 0;
+        std::string out;
+        BlockEntryType type;
+        for (uint64_t i = begin; i < end; ++i) {
+            hits += table.get(make_key(i), out, type) ? 1 : 0;
+        }
+        found += hits;
+    });
+    
+    if (found != operations) {
+        std::cerr << "skiplist lookup mismatch: " << found << " of " << operations << std::endl;
+    }
+    
+    // Iteration must see every key once, in order
+    auto it = table.new_iterator();
+    uint64_t count = 0;
+    std::string previous;
+    for (it->seek_to_first(); it->valid(); it->next()) {
+        if (count > 0 && it->key() <= previous) {
+            std::cerr << "skiplist iteration out of order" << std::endl;
+            break;
+        }
+        previous = it->key();
+        count++;
+    }
+    if (count != operations) {
+        std::cerr << "skiplist iteration saw " << count << " of " << operations << " keys" << std::endl;
+    }
+    return result;
+}
+
+// Counts the bytes a container allocates, so std::map memory can be measured
+size_t g_allocated_bytes = 0;
+
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+    
+    CountingAllocator() = default;
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        g_allocated_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        g_allocated_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+    
+    template<typename U>
+    bool operator==(const CountingAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+using CountedString = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+using CountedMap = std::map<CountedString, uint64_t, std::less<CountedString>,
+                            CountingAllocator<std::pair<const CountedString, uint64_t>>>;
+
+const char* const FIELDS[] = {"name", "email", "plan", "created"};
+constexpr uint64_t FIELD_COUNT = 4;
+
+// Keys shaped like a multi-tenant schema, so most of each key is a prefix it
+// shares with its neighbours
+std::string make_index_key(uint64_t i) {
+    uint64_t record = (i / FIELD_COUNT) * 0x9e3779b97f4a7c15ULL >> 20;
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "tenant:%04llu:user:%08llu:%s",
+                  static_cast<unsigned long long>(record % 1000),
+                  static_cast<unsigned long long>(record / 1000 % 100000000), FIELDS[i % FIELD_COUNT]);
+    return buffer;
+}
+
+struct IndexResult {
+    double insert_ops;
+    double lookup_ns;
+    double prefix_scan_ns;
+    size_t bytes;
+};
+
+double elapsed_ns(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Single-threaded: inserts, point lookups in a scattered order, and prefix
+// scans that fetch every field of one user
+template<typename InsertFn, typename LookupFn, typename ScanFn>
+IndexResult bench_index(const std::vector<std::string>& keys, InsertFn insert, LookupFn lookup, ScanFn scan,
+                        const std::function<size_t()>& bytes) {
+    IndexResult result;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        insert(keys[i], i);
+    }
+    result.insert_ops = keys.size() / (elapsed_ns(start) / 1e9);
+    result.bytes = bytes();
+    
+    uint64_t found = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        found += lookup(keys[(i * 7919) % keys.size()]) ? 1 : 0;
+    }
+    result.lookup_ns = elapsed_ns(start) / keys.size();
+    if (found != keys.size()) {
+        std::cerr << "index lookup mismatch: " << found << " of " << keys.size() << std::endl;
+    }
+    
+    size_t scans = keys.size() / FIELD_COUNT;
+    uint64_t scanned = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < scans; ++i) {
+        const std::string& key = keys[((i * 7919) % scans) * FIELD_COUNT];
+        scanned += scan(key.substr(0, key.rfind(':') + 1));
+    }
+    result.prefix_scan_ns = scans > 0 ? elapsed_ns(start) / scans : 0.0;
+    if (scanned < scans * FIELD_COUNT) {
+        std::cerr << "index prefix scan saw " << scanned << " of " << keys.size() << " keys" << std::endl;
+    }
+    return result;
+}
+
+IndexResult bench_std_map(const std::vector<std::string>& keys) {
+    g_allocated_bytes = 0;
+    CountedMap map;
+    return bench_index(keys,
+        [&](const std::string& key, uint64_t value) { map[CountedString(key.data(), key.size())] = value; },
+        [&](const std::string& key) { return map.find(CountedString(key.data(), key.size())) != map.end(); },
+        [&](const std::string& prefix) {
+            size_t count = 0;
+            for (auto it = map.lower_bound(CountedString(prefix.data(), prefix.size()));
+                 it != map.end() && it->first.compare(0, prefix.size(), prefix.data()) == 0; ++it) {
+                count++;
+            }
+            return count;
+        },
+        []() { return g_allocated_bytes; });
+}
+
+IndexResult bench_btree(const std::vector<std::string>& keys) {
+    BTree<std::string, uint64_t> tree;
+    IndexResult result = bench_index(keys,
+        [&](const std::string& key, uint64_t value) { tree.insert(key, value); },
+        [&](const std::string& key) { return tree.find(key) != nullptr; },
+        [&](const std::string& prefix) {
+            std::string end = prefix;
+            end.back()++;
+            return tree.scan(prefix, end).size();
+        },
+        [&]() { return tree.memory_usage(); });
+    
+    auto stats = tree.get_stats();
+    std::cout << "B+tree: height " << stats["height"] << ", " << stats["leaf_nodes"] << " leaves, "
+              << stats["inner_nodes"] << " inner nodes" << std::endl;
+    return result;
+}
+
+IndexResult bench_art(const std::vector<std::string>& keys) {
+    AdaptiveRadixTree<uint64_t> tree;
+    IndexResult result = bench_index(keys,
+        [&](const std::string& key, uint64_t value) { tree.insert(key, value); },
+        [&](const std::string& key) { return tree.find(key) != nullptr; },
+        [&](const std::string& prefix) { return tree.scan_prefix(prefix).size(); },
+        [&]() { return tree.memory_usage(); });
+    
+    auto stats = tree.get_stats();
+    std::cout << "ART nodes: " << stats["node4"] << " Node4, " << stats["node16"] << " Node16, "
+              << stats["node48"] << " Node48, " << stats["node256"] << " Node256" << std::endl;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    uint64_t operations = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    int max_threads = argc > 2 ? std::stoi(argv[2]) : 32;
+    std::string value(100, 'v');
+    
+    std::cout << "Memtable benchmark: " << operations << " inserts then " << operations
+              << " lookups, 19-byte keys, " << value.size() << "-byte values" << std::endl;
+    std::cout << "Throughput in million ops/sec" << std::endl << std::endl;
+    
+    std::cout << std::left << std::setw(9) << "threads"
+              << std::setw(22) << "unordered_map insert" << std::setw(22) << "unordered_map lookup"
+              << std::setw(18) << "skiplist insert" << std::setw(18) << "skiplist lookup" << std::endl;
+    
+    std::cout << std::fixed << std::setprecision(2);
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        Result locked = bench_locked_map(threads, operations, value);
+        Result skiplist = bench_skiplist(threads, operations, value);
+        
+        std::cout << std::setw(9) << threads
+                  << std::setw(22) << locked.insert_ops / 1e6 << std::setw(22) << locked.lookup_ops / 1e6
+                  << std::setw(18) << skiplist.insert_ops / 1e6 << std::setw(18) << skiplist.lookup_ops / 1e6
+                  << std::endl;
+    }
+    
+    // Ordered index comparison
+    std::vector<std::string> keys;
+    keys.reserve(operations);
+    for (uint64_t i = 0; i < operations; ++i) {
+        keys.push_back(make_index_key(i));
+    }
+    
+    std::cout << std::endl << "Ordered index benchmark: " << operations << " keys like " << keys[0]
+              << ", single thread" << std::endl << std::endl;
+    IndexResult map_result = bench_std_map(keys);
+    IndexResult btree_result = bench_btree(keys);
+    IndexResult art_result = bench_art(keys);
+    
+    std::cout << std::endl << std::left << std::setw(10) << "index" << std::setw(14) << "insert Mops"
+              << std::setw(14) << "lookup ns" << std::setw(18) << "prefix scan ns"
+              << std::setw(12) << "memory MB" << std::setw(14) << "bytes/key" << std::endl;
+    const std::pair<const char*, IndexResult> results[] = {
+        {"std::map", map_result}, {"B+tree", btree_result}, {"ART", art_result}};
+    for (const auto& [name, result] : results) {
+        std::cout << std::setw(10) << name << std::setw(14) << result.insert_ops / 1e6
+                  << std::setw(14) << result.lookup_ns << std::setw(18) << result.prefix_scan_ns
+                  << std::setw(12) << result.bytes / (1024.0 * 1024.0)
+                  << std::setw(14) << static_cast<double>(result.bytes) / operations << std::endl;
+    }
+    
+    return 0;
+}